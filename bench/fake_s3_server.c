@@ -0,0 +1,977 @@
+#include "fake_s3_server.h"
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef G_OS_UNIX
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+#define MAX_LIST_KEYS 1000
+#define IO_CHUNK (64 * 1024)
+
+typedef struct {
+    GBytes *data;
+    gchar *etag;
+    gint64 mtime;    // Unix seconds
+} FakeObject;
+
+typedef struct {
+    gchar *name;
+    gint64 created;
+    GTree *objects;  // key -> FakeObject, sorted like S3 (byte order)
+} FakeBucket;
+
+typedef struct {
+    gchar *bucket;
+    gchar *key;
+    GTree *parts;    // part number -> GBytes
+} FakeUpload;
+
+struct _FakeS3Server {
+    GThread *thread;
+    GMainContext *context;
+    GMainLoop *loop;
+    GSocketService *service;
+    guint16 port;
+    gchar *endpoint;
+    GError *start_error;
+    gboolean ready;
+    GMutex ready_mutex;
+    GCond ready_cond;
+
+    GMutex lock;     // Protects everything below
+    GHashTable *buckets;   // name -> FakeBucket
+    GHashTable *uploads;   // upload id -> FakeUpload
+    guint next_upload_id;
+    FakeS3Faults faults;
+    GRand *rand;
+    guint64 get_count;
+    FakeS3Stats stats;
+};
+
+typedef struct {
+    gchar *method;
+    gchar *bucket;
+    gchar *key;
+    GHashTable *query;
+    GHashTable *headers;   // lower-case names
+    GBytes *body;
+} FakeRequest;
+
+typedef struct {
+    gboolean slowdown;
+    gboolean disconnect;
+} FakeDecision;
+
+// Bandwidth pacing of one connection. Each connection is served on its own
+// thread for its whole life, so the state is thread-local.
+typedef struct {
+    gint64 free_at_us;   // When the bytes sent or received so far are paid for
+} FakePacing;
+
+static GPrivate pacing_key = G_PRIVATE_INIT(g_free);
+
+// #############################################################################
+// # Storage
+// #############################################################################
+
+static void fake_object_free(FakeObject *obj) {
+    g_bytes_unref(obj->data);
+    g_free(obj->etag);
+    g_free(obj);
+}
+
+static void fake_bucket_free(FakeBucket *bucket) {
+    g_free(bucket->name);
+    g_tree_unref(bucket->objects);
+    g_free(bucket);
+}
+
+static void fake_upload_free(FakeUpload *upload) {
+    g_free(upload->bucket);
+    g_free(upload->key);
+    g_tree_unref(upload->parts);
+    g_free(upload);
+}
+
+static gint compare_keys(gconstpointer a, gconstpointer b, gpointer user_data) {
+    (void)user_data;
+    return strcmp((const gchar*)a, (const gchar*)b);
+}
+
+static gint compare_part_numbers(gconstpointer a, gconstpointer b, gpointer user_data) {
+    (void)user_data;
+    return GPOINTER_TO_INT(a) - GPOINTER_TO_INT(b);
+}
+
+static FakeBucket *ensure_bucket(FakeS3Server *server, const gchar *name) {
+    FakeBucket *bucket = g_hash_table_lookup(server->buckets, name);
+    if (!bucket) {
+        bucket = g_new0(FakeBucket, 1);
+        bucket->name = g_strdup(name);
+        bucket->created = g_get_real_time() / G_USEC_PER_SEC;
+        bucket->objects = g_tree_new_full(compare_keys, NULL, g_free, (GDestroyNotify)fake_object_free);
+        g_hash_table_insert(server->buckets, bucket->name, bucket);
+    }
+    return bucket;
+}
+
+static FakeObject *fake_object_new(GBytes *data, const gchar *etag) {
+    FakeObject *obj = g_new0(FakeObject, 1);
+    obj->data = g_bytes_ref(data);
+    obj->etag = etag ? g_strdup(etag) : g_compute_checksum_for_bytes(G_CHECKSUM_MD5, data);
+    obj->mtime = g_get_real_time() / G_USEC_PER_SEC;
+    return obj;
+}
+
+// #############################################################################
+// # Formatting Helpers
+// #############################################################################
+
+static gchar *format_iso8601(gint64 unix_seconds) {
+    g_autoptr(GDateTime) dt = g_date_time_new_from_unix_utc(unix_seconds);
+    return g_date_time_format(dt, "%Y-%m-%dT%H:%M:%S.000Z");
+}
+
+static gchar *format_http_date(gint64 unix_seconds) {
+    static const gchar *days[] = { "Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun" };
+    static const gchar *months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    g_autoptr(GDateTime) dt = g_date_time_new_from_unix_utc(unix_seconds);
+    return g_strdup_printf("%s, %02d %s %04d %02d:%02d:%02d GMT",
+                           days[g_date_time_get_day_of_week(dt) - 1],
+                           g_date_time_get_day_of_month(dt),
+                           months[g_date_time_get_month(dt) - 1],
+                           g_date_time_get_year(dt),
+                           g_date_time_get_hour(dt),
+                           g_date_time_get_minute(dt),
+                           g_date_time_get_second(dt));
+}
+
+static void append_escaped(GString *xml, const gchar *tag, const gchar *value) {
+    g_autofree gchar *escaped = g_markup_escape_text(value ? value : "", -1);
+    g_string_append_printf(xml, "<%s>%s</%s>", tag, escaped, tag);
+}
+
+// #############################################################################
+// # Wire I/O
+// #############################################################################
+
+// Charges `bytes` to the current connection's bandwidth, shared by request
+// and response bodies, and sleeps until they are paid for. Idle time does
+// not build up credit.
+static void throttle(FakeS3Server *server, gsize bytes) {
+    guint64 bandwidth;
+    g_mutex_lock(&server->lock);
+    bandwidth = server->faults.bandwidth_bytes_per_sec;
+    g_mutex_unlock(&server->lock);
+    if (bandwidth == 0) return;
+
+    FakePacing *pacing = g_private_get(&pacing_key);
+    if (!pacing) {
+        pacing = g_new0(FakePacing, 1);
+        g_private_set(&pacing_key, pacing);
+    }
+    gint64 now_us = g_get_monotonic_time();
+    pacing->free_at_us = MAX(pacing->free_at_us, now_us) + (gint64)((guint64)bytes * G_USEC_PER_SEC / bandwidth);
+    if (pacing->free_at_us > now_us) {
+        g_usleep(pacing->free_at_us - now_us);
+    }
+}
+
+// Writes a body, honouring the bandwidth cap. Stops after `limit` bytes if
+// limit is not G_MAXUINT64 and returns FALSE in that case or on error.
+static gboolean write_body(FakeS3Server *server, GOutputStream *out, const guint8 *data, gsize len, guint64 limit) {
+    gsize sent = 0;
+    while (sent < len) {
+        gsize n = MIN((gsize)IO_CHUNK, len - sent);
+        if (limit != G_MAXUINT64 && sent + n > limit) {
+            n = limit - sent;
+        }
+        if (n > 0 && !g_output_stream_write_all(out, data + sent, n, NULL, NULL, NULL)) {
+            return FALSE;
+        }
+        sent += n;
+        g_mutex_lock(&server->lock);
+        server->stats.bytes_out += n;
+        g_mutex_unlock(&server->lock);
+        if (limit != G_MAXUINT64 && sent >= limit) {
+            return FALSE;
+        }
+        throttle(server, n);
+    }
+    return TRUE;
+}
+
+static gboolean send_response(FakeS3Server *server, GOutputStream *out, guint status, const gchar *reason,
+                              GPtrArray *extra_headers, const guint8 *body, gsize body_len,
+                              gboolean head_only, guint64 disconnect_after) {
+    GString *head = g_string_new(NULL);
+    g_autofree gchar *date = format_http_date(g_get_real_time() / G_USEC_PER_SEC);
+    g_string_append_printf(head, "HTTP/1.1 %u %s\r\n", status, reason);
+    g_string_append_printf(head, "Date: %s\r\nServer: mys3-fake\r\nx-amz-request-id: fake\r\n", date);
+    g_string_append_printf(head, "Content-Length: %" G_GSIZE_FORMAT "\r\n", body_len);
+    if (extra_headers) {
+        for (guint i = 0; i < extra_headers->len; i++) {
+            g_string_append_printf(head, "%s\r\n", (const gchar*)g_ptr_array_index(extra_headers, i));
+        }
+    }
+    g_string_append(head, "\r\n");
+
+    gboolean ok = g_output_stream_write_all(out, head->str, head->len, NULL, NULL, NULL);
+    g_string_free(head, TRUE);
+    if (!ok) return FALSE;
+    if (head_only || body_len == 0) return TRUE;
+    return write_body(server, out, body, body_len, disconnect_after);
+}
+
+static gboolean send_xml(FakeS3Server *server, GOutputStream *out, guint status, const gchar *reason, GString *xml) {
+    g_autoptr(GPtrArray) headers = g_ptr_array_new_with_free_func(g_free);
+    g_ptr_array_add(headers, g_strdup("Content-Type: application/xml"));
+    gboolean ok = send_response(server, out, status, reason, headers, (const guint8*)xml->str, xml->len, FALSE, G_MAXUINT64);
+    g_string_free(xml, TRUE);
+    return ok;
+}
+
+static gboolean send_error(FakeS3Server *server, GOutputStream *out, guint status, const gchar *reason,
+                           const gchar *code, const gchar *message, gboolean head_only) {
+    if (head_only) {
+        return send_response(server, out, status, reason, NULL, NULL, 0, TRUE, G_MAXUINT64);
+    }
+    GString *xml = g_string_new("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<Error>");
+    append_escaped(xml, "Code", code);
+    append_escaped(xml, "Message", message);
+    g_string_append(xml, "<RequestId>fake</RequestId></Error>");
+    return send_xml(server, out, status, reason, xml);
+}
+
+static GHashTable *parse_query(const gchar *query) {
+    GHashTable *table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    if (!query) return table;
+    g_auto(GStrv) pairs = g_strsplit(query, "&", -1);
+    for (guint i = 0; pairs[i]; i++) {
+        if (!*pairs[i]) continue;
+        gchar *eq = strchr(pairs[i], '=');
+        gchar *name = g_uri_unescape_string(pairs[i], NULL);
+        gchar *value = g_strdup("");
+        if (eq) {
+            *eq = '\0';
+            g_free(name);
+            name = g_uri_unescape_string(pairs[i], NULL);
+            g_free(value);
+            value = g_uri_unescape_string(eq + 1, NULL);
+        }
+        if (name && value) {
+            g_hash_table_replace(table, name, value);
+        } else {
+            g_free(name);
+            g_free(value);
+        }
+    }
+    return table;
+}
+
+static void fake_request_free(FakeRequest *req) {
+    g_free(req->method);
+    g_free(req->bucket);
+    g_free(req->key);
+    if (req->query) g_hash_table_unref(req->query);
+    if (req->headers) g_hash_table_unref(req->headers);
+    if (req->body) g_bytes_unref(req->body);
+    g_free(req);
+}
+
+static gchar *read_line(GDataInputStream *in) {
+    gsize len = 0;
+    gchar *line = g_data_input_stream_read_line(in, &len, NULL, NULL);
+    if (line && len > 0 && line[len - 1] == '\r') {
+        line[len - 1] = '\0';
+    }
+    return line;
+}
+
+static GBytes *read_body(FakeS3Server *server, GDataInputStream *in, GOutputStream *out, GHashTable *headers) {
+    const gchar *expect = g_hash_table_lookup(headers, "expect");
+    if (expect && g_ascii_strcasecmp(expect, "100-continue") == 0) {
+        static const gchar cont[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        g_output_stream_write_all(out, cont, sizeof(cont) - 1, NULL, NULL, NULL);
+    }
+
+    GByteArray *body = g_byte_array_new();
+    const gchar *encoding = g_hash_table_lookup(headers, "transfer-encoding");
+    if (encoding && g_ascii_strcasecmp(encoding, "chunked") == 0) {
+        while (TRUE) {
+            g_autofree gchar *size_line = read_line(in);
+            if (!size_line) goto fail;
+            gsize chunk = g_ascii_strtoull(size_line, NULL, 16);
+            if (chunk == 0) {
+                g_autofree gchar *trailer = NULL;
+                while ((trailer = read_line(in)) && *trailer) g_clear_pointer(&trailer, g_free);
+                break;
+            }
+            gsize old_len = body->len;
+            g_byte_array_set_size(body, old_len + chunk);
+            if (!g_input_stream_read_all(G_INPUT_STREAM(in), body->data + old_len, chunk, NULL, NULL, NULL)) goto fail;
+            g_free(read_line(in));
+            throttle(server, chunk);
+        }
+    } else {
+        const gchar *length = g_hash_table_lookup(headers, "content-length");
+        gsize remaining = length ? g_ascii_strtoull(length, NULL, 10) : 0;
+        while (remaining > 0) {
+            gsize n = MIN((gsize)IO_CHUNK, remaining);
+            gsize old_len = body->len;
+            gsize got = 0;
+            g_byte_array_set_size(body, old_len + n);
+            if (!g_input_stream_read_all(G_INPUT_STREAM(in), body->data + old_len, n, &got, NULL, NULL) || got != n) goto fail;
+            remaining -= n;
+            throttle(server, n);
+        }
+    }
+
+    g_mutex_lock(&server->lock);
+    server->stats.bytes_in += body->len;
+    g_mutex_unlock(&server->lock);
+    return g_byte_array_free_to_bytes(body);
+
+fail:
+    g_byte_array_unref(body);
+    return NULL;
+}
+
+static FakeRequest *read_request(FakeS3Server *server, GDataInputStream *in, GOutputStream *out) {
+    g_autofree gchar *request_line = read_line(in);
+    if (!request_line || !*request_line) return NULL;
+
+    g_auto(GStrv) parts = g_strsplit(request_line, " ", 3);
+    if (g_strv_length(parts) < 2) return NULL;
+
+    FakeRequest *req = g_new0(FakeRequest, 1);
+    req->method = g_strdup(parts[0]);
+    req->headers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    gchar *target = parts[1];
+    gchar *query = strchr(target, '?');
+    if (query) *query++ = '\0';
+    req->query = parse_query(query);
+
+    // Path-style addressing: /bucket/key
+    const gchar *path = target[0] == '/' ? target + 1 : target;
+    const gchar *slash = strchr(path, '/');
+    if (slash) {
+        g_autofree gchar *bucket = g_strndup(path, slash - path);
+        req->bucket = g_uri_unescape_string(bucket, NULL);
+        req->key = *(slash + 1) ? g_uri_unescape_string(slash + 1, NULL) : NULL;
+    } else if (*path) {
+        req->bucket = g_uri_unescape_string(path, NULL);
+    }
+
+    gchar *line;
+    while ((line = read_line(in)) && *line) {
+        gchar *colon = strchr(line, ':');
+        if (colon) {
+            *colon = '\0';
+            g_hash_table_replace(req->headers, g_ascii_strdown(line, -1), g_strdup(g_strstrip(colon + 1)));
+        }
+        g_free(line);
+    }
+    if (!line) {
+        fake_request_free(req);
+        return NULL;
+    }
+    g_free(line);
+
+    req->body = read_body(server, in, out, req->headers);
+    if (!req->body) {
+        fake_request_free(req);
+        return NULL;
+    }
+    return req;
+}
+
+// #############################################################################
+// # Operations
+// #############################################################################
+
+static gboolean handle_list_buckets(FakeS3Server *server, GOutputStream *out) {
+    GString *xml = g_string_new("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                                "<ListAllMyBucketsResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">"
+                                "<Owner><ID>fake</ID><DisplayName>fake</DisplayName></Owner><Buckets>");
+    g_mutex_lock(&server->lock);
+    g_autoptr(GList) names = g_list_sort(g_hash_table_get_keys(server->buckets), (GCompareFunc)strcmp);
+    for (GList *l = names; l; l = l->next) {
+        FakeBucket *bucket = g_hash_table_lookup(server->buckets, l->data);
+        g_autofree gchar *created = format_iso8601(bucket->created);
+        g_string_append(xml, "<Bucket>");
+        append_escaped(xml, "Name", bucket->name);
+        append_escaped(xml, "CreationDate", created);
+        g_string_append(xml, "</Bucket>");
+    }
+    g_mutex_unlock(&server->lock);
+    g_string_append(xml, "</Buckets></ListAllMyBucketsResult>");
+    return send_xml(server, out, 200, "OK", xml);
+}
+
+typedef struct {
+    const gchar *prefix;
+    const gchar *delimiter;
+    const gchar *start_after;
+    guint max_keys;
+    guint count;
+    GString *contents;
+    GString *prefixes;
+    gchar *last_prefix;
+    gchar *last_key;
+    gboolean truncated;
+} ListState;
+
+// Called for keys in order from the first that can be listed; returns TRUE to stop.
+static gboolean list_visit(gpointer key, gpointer value, gpointer user_data) {
+    ListState *st = (ListState*)user_data;
+    const gchar *k = (const gchar*)key;
+    FakeObject *obj = (FakeObject*)value;
+
+    if (st->start_after && strcmp(k, st->start_after) <= 0) return FALSE;
+    if (st->prefix && !g_str_has_prefix(k, st->prefix)) {
+        // Keys are sorted, so once we are past the prefix we can stop.
+        return st->prefix && strcmp(k, st->prefix) > 0;
+    }
+
+    const gchar *rest = k + (st->prefix ? strlen(st->prefix) : 0);
+    const gchar *delim = (st->delimiter && *st->delimiter) ? strstr(rest, st->delimiter) : NULL;
+    g_autofree gchar *common = delim ? g_strndup(k, (delim - k) + strlen(st->delimiter)) : NULL;
+    // Keys rolled up into the prefix just listed add no entry, so they never
+    // make a full page truncated.
+    if (common && g_strcmp0(common, st->last_prefix) == 0) {
+        g_free(st->last_key);
+        st->last_key = g_strdup(k);
+        return FALSE;
+    }
+
+    if (st->count >= st->max_keys) {
+        st->truncated = TRUE;
+        return TRUE;
+    }
+
+    if (common) {
+        g_string_append(st->prefixes, "<CommonPrefixes>");
+        append_escaped(st->prefixes, "Prefix", common);
+        g_string_append(st->prefixes, "</CommonPrefixes>");
+        g_free(st->last_prefix);
+        st->last_prefix = g_steal_pointer(&common);
+    } else {
+        g_autofree gchar *modified = format_iso8601(obj->mtime);
+        g_string_append(st->contents, "<Contents>");
+        append_escaped(st->contents, "Key", k);
+        append_escaped(st->contents, "LastModified", modified);
+        g_string_append_printf(st->contents, "<ETag>&quot;%s&quot;</ETag><Size>%" G_GSIZE_FORMAT "</Size><StorageClass>STANDARD</StorageClass></Contents>",
+                               obj->etag, g_bytes_get_size(obj->data));
+    }
+    st->count++;
+    g_free(st->last_key);
+    st->last_key = g_strdup(k);
+    return FALSE;
+}
+
+static gboolean handle_list_objects(FakeS3Server *server, GOutputStream *out, FakeRequest *req) {
+    ListState st = {0};
+    st.prefix = g_hash_table_lookup(req->query, "prefix");
+    st.delimiter = g_hash_table_lookup(req->query, "delimiter");
+    const gchar *max_keys = g_hash_table_lookup(req->query, "max-keys");
+    st.max_keys = max_keys ? (guint)CLAMP(g_ascii_strtoull(max_keys, NULL, 10), 1, MAX_LIST_KEYS) : MAX_LIST_KEYS;
+    g_autofree gchar *token = NULL;
+    const gchar *continuation = g_hash_table_lookup(req->query, "continuation-token");
+    if (continuation) {
+        gsize len = 0;
+        guchar *decoded = g_base64_decode(continuation, &len);
+        token = g_strndup((const gchar*)decoded, len);
+        g_free(decoded);
+        st.start_after = token;
+    } else {
+        st.start_after = g_hash_table_lookup(req->query, "start-after");
+    }
+    st.contents = g_string_new(NULL);
+    st.prefixes = g_string_new(NULL);
+
+    g_mutex_lock(&server->lock);
+    FakeBucket *bucket = g_hash_table_lookup(server->buckets, req->bucket);
+    if (server->faults.max_keys) st.max_keys = MIN(st.max_keys, server->faults.max_keys);
+    if (bucket) {
+        if (st.delimiter && *st.delimiter && st.start_after) {
+            // Skip the rest of a common prefix that was already returned.
+            const gchar *rest = st.start_after + (st.prefix ? strlen(st.prefix) : 0);
+            const gchar *delim = g_str_has_prefix(st.start_after, st.prefix ? st.prefix : "") ? strstr(rest, st.delimiter) : NULL;
+            if (delim) st.last_prefix = g_strndup(st.start_after, (delim - st.start_after) + strlen(st.delimiter));
+        }
+        // Start at the marker, or the prefix, rather than walking the keys
+        // before it, so a page costs the same however deep it is.
+        const gchar *from = st.start_after;
+        if (st.prefix && (!from || strcmp(st.prefix, from) > 0)) from = st.prefix;
+        GTreeNode *node = from ? g_tree_lower_bound(bucket->objects, from) : g_tree_node_first(bucket->objects);
+        for (; node; node = g_tree_node_next(node)) {
+            if (list_visit(g_tree_node_key(node), g_tree_node_value(node), &st)) break;
+        }
+    }
+    g_mutex_unlock(&server->lock);
+
+    if (!bucket) {
+        g_string_free(st.contents, TRUE);
+        g_string_free(st.prefixes, TRUE);
+        return send_error(server, out, 404, "Not Found", "NoSuchBucket", "The specified bucket does not exist", FALSE);
+    }
+
+    GString *xml = g_string_new("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                                "<ListBucketResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">");
+    append_escaped(xml, "Name", req->bucket);
+    append_escaped(xml, "Prefix", st.prefix);
+    if (st.delimiter) append_escaped(xml, "Delimiter", st.delimiter);
+    g_string_append_printf(xml, "<KeyCount>%u</KeyCount><MaxKeys>%u</MaxKeys><IsTruncated>%s</IsTruncated>",
+                           st.count, st.max_keys, st.truncated ? "true" : "false");
+    if (continuation) append_escaped(xml, "ContinuationToken", continuation);
+    if (st.truncated && st.last_key) {
+        g_autofree gchar *next = g_base64_encode((const guchar*)st.last_key, strlen(st.last_key));
+        append_escaped(xml, "NextContinuationToken", next);
+    }
+    g_string_append_len(xml, st.contents->str, st.contents->len);
+    g_string_append_len(xml, st.prefixes->str, st.prefixes->len);
+    g_string_append(xml, "</ListBucketResult>");
+
+    g_string_free(st.contents, TRUE);
+    g_string_free(st.prefixes, TRUE);
+    g_free(st.last_prefix);
+    g_free(st.last_key);
+    return send_xml(server, out, 200, "OK", xml);
+}
+
+static gboolean parse_range(const gchar *range, gsize total, gsize *start, gsize *end) {
+    if (!range || !g_str_has_prefix(range, "bytes=") || total == 0) return FALSE;
+    const gchar *spec = range + 6;
+    gchar *dash = strchr(spec, '-');
+    if (!dash) return FALSE;
+    if (dash == spec) {
+        guint64 suffix = g_ascii_strtoull(dash + 1, NULL, 10);
+        if (suffix == 0) return FALSE;
+        *start = suffix >= total ? 0 : total - suffix;
+        *end = total - 1;
+    } else {
+        *start = g_ascii_strtoull(spec, NULL, 10);
+        *end = *(dash + 1) ? g_ascii_strtoull(dash + 1, NULL, 10) : total - 1;
+        if (*end >= total) *end = total - 1;
+    }
+    return *start <= *end && *start < total;
+}
+
+static gboolean handle_get_object(FakeS3Server *server, GOutputStream *out, FakeRequest *req, gboolean head_only, FakeDecision *decision) {
+    g_mutex_lock(&server->lock);
+    FakeBucket *bucket = g_hash_table_lookup(server->buckets, req->bucket);
+    FakeObject *obj = bucket ? g_tree_lookup(bucket->objects, req->key) : NULL;
+    GBytes *data = obj ? g_bytes_ref(obj->data) : NULL;
+    g_autofree gchar *etag = obj ? g_strdup(obj->etag) : NULL;
+    gint64 mtime = obj ? obj->mtime : 0;
+    g_mutex_unlock(&server->lock);
+
+    if (!data) {
+        return send_error(server, out, 404, "Not Found", "NoSuchKey", "The specified key does not exist.", head_only);
+    }
+
+    gsize total = 0;
+    const guint8 *bytes = g_bytes_get_data(data, &total);
+    gsize start = 0, end = total ? total - 1 : 0;
+    gboolean ranged = parse_range(g_hash_table_lookup(req->headers, "range"), total, &start, &end);
+
+    g_autoptr(GPtrArray) headers = g_ptr_array_new_with_free_func(g_free);
+    g_autofree gchar *modified = format_http_date(mtime);
+    g_ptr_array_add(headers, g_strdup_printf("ETag: \"%s\"", etag));
+    g_ptr_array_add(headers, g_strdup_printf("Last-Modified: %s", modified));
+    g_ptr_array_add(headers, g_strdup("Content-Type: application/octet-stream"));
+    g_ptr_array_add(headers, g_strdup("Accept-Ranges: bytes"));
+    if (ranged) {
+        g_ptr_array_add(headers, g_strdup_printf("Content-Range: bytes %" G_GSIZE_FORMAT "-%" G_GSIZE_FORMAT "/%" G_GSIZE_FORMAT, start, end, total));
+    }
+
+    gsize len = total ? end - start + 1 : 0;
+    guint64 limit = G_MAXUINT64;
+    if (decision->disconnect && !head_only) {
+        g_mutex_lock(&server->lock);
+        limit = MIN(server->faults.disconnect_after_bytes, len > 0 ? (guint64)len - 1 : 0);
+        server->stats.disconnects++;
+        g_mutex_unlock(&server->lock);
+    }
+    gboolean ok = send_response(server, out, ranged ? 206 : 200, ranged ? "Partial Content" : "OK", headers,
+                                bytes + start, len, head_only, limit);
+    g_bytes_unref(data);
+    return ok;
+}
+
+static gboolean handle_put_object(FakeS3Server *server, GOutputStream *out, FakeRequest *req) {
+    const gchar *copy_source = g_hash_table_lookup(req->headers, "x-amz-copy-source");
+    const gchar *upload_id = g_hash_table_lookup(req->query, "uploadId");
+    const gchar *part_number = g_hash_table_lookup(req->query, "partNumber");
+    g_autoptr(GPtrArray) headers = g_ptr_array_new_with_free_func(g_free);
+
+    if (upload_id && part_number) {
+        // UploadPartCopy takes the part from an existing object, optionally
+        // a byte range of it; UploadPart takes the request body.
+        g_autoptr(GBytes) part = NULL;
+        g_mutex_lock(&server->lock);
+        FakeUpload *upload = g_hash_table_lookup(server->uploads, upload_id);
+        if (upload && copy_source) {
+            g_autofree gchar *source = g_uri_unescape_string(copy_source[0] == '/' ? copy_source + 1 : copy_source, NULL);
+            gchar *slash = source ? strchr(source, '/') : NULL;
+            if (slash) *slash = '\0';
+            FakeBucket *src_bucket = slash ? g_hash_table_lookup(server->buckets, source) : NULL;
+            FakeObject *src = src_bucket ? g_tree_lookup(src_bucket->objects, slash + 1) : NULL;
+            if (src) {
+                gsize total = g_bytes_get_size(src->data), start = 0, end = total ? total - 1 : 0;
+                const gchar *range = g_hash_table_lookup(req->headers, "x-amz-copy-source-range");
+                part = range && parse_range(range, total, &start, &end) ? g_bytes_new_from_bytes(src->data, start, end - start + 1)
+                                                                         : g_bytes_ref(src->data);
+            }
+        } else if (upload) {
+            part = g_bytes_ref(req->body);
+        }
+        if (part) {
+            g_tree_replace(upload->parts, GINT_TO_POINTER(atoi(part_number)), g_bytes_ref(part));
+        }
+        g_mutex_unlock(&server->lock);
+        if (!upload) {
+            return send_error(server, out, 404, "Not Found", "NoSuchUpload", "The specified upload does not exist.", FALSE);
+        }
+        if (!part) {
+            return send_error(server, out, 404, "Not Found", "NoSuchKey", "The specified key does not exist.", FALSE);
+        }
+        g_autofree gchar *etag = g_compute_checksum_for_bytes(G_CHECKSUM_MD5, part);
+        if (copy_source) {
+            GString *xml = g_string_new("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<CopyPartResult>");
+            g_autofree gchar *modified = format_iso8601(g_get_real_time() / G_USEC_PER_SEC);
+            append_escaped(xml, "LastModified", modified);
+            g_string_append_printf(xml, "<ETag>&quot;%s&quot;</ETag></CopyPartResult>", etag);
+            return send_xml(server, out, 200, "OK", xml);
+        }
+        g_ptr_array_add(headers, g_strdup_printf("ETag: \"%s\"", etag));
+        return send_response(server, out, 200, "OK", headers, NULL, 0, FALSE, G_MAXUINT64);
+    }
+
+    if (copy_source) {
+        g_autofree gchar *source = g_uri_unescape_string(copy_source[0] == '/' ? copy_source + 1 : copy_source, NULL);
+        gchar *slash = source ? strchr(source, '/') : NULL;
+        FakeObject *copy = NULL;
+        if (slash) {
+            *slash = '\0';
+            g_mutex_lock(&server->lock);
+            FakeBucket *src_bucket = g_hash_table_lookup(server->buckets, source);
+            FakeObject *src = src_bucket ? g_tree_lookup(src_bucket->objects, slash + 1) : NULL;
+            FakeBucket *dst_bucket = g_hash_table_lookup(server->buckets, req->bucket);
+            if (src && dst_bucket && req->key) {
+                copy = fake_object_new(src->data, src->etag);
+                g_tree_replace(dst_bucket->objects, g_strdup(req->key), copy);
+            }
+            g_mutex_unlock(&server->lock);
+        }
+        if (!copy) {
+            return send_error(server, out, 404, "Not Found", "NoSuchKey", "The specified key does not exist.", FALSE);
+        }
+        GString *xml = g_string_new("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<CopyObjectResult>");
+        g_autofree gchar *modified = format_iso8601(copy->mtime);
+        append_escaped(xml, "LastModified", modified);
+        g_string_append_printf(xml, "<ETag>&quot;%s&quot;</ETag></CopyObjectResult>", copy->etag);
+        return send_xml(server, out, 200, "OK", xml);
+    }
+
+    if (!req->key) {
+        g_mutex_lock(&server->lock);
+        ensure_bucket(server, req->bucket);
+        g_mutex_unlock(&server->lock);
+        return send_response(server, out, 200, "OK", NULL, NULL, 0, FALSE, G_MAXUINT64);
+    }
+
+    FakeObject *obj = fake_object_new(req->body, NULL);
+    g_ptr_array_add(headers, g_strdup_printf("ETag: \"%s\"", obj->etag));
+    g_mutex_lock(&server->lock);
+    FakeBucket *bucket = g_hash_table_lookup(server->buckets, req->bucket);
+    if (bucket) {
+        g_tree_replace(bucket->objects, g_strdup(req->key), obj);
+    }
+    g_mutex_unlock(&server->lock);
+    if (!bucket) {
+        fake_object_free(obj);
+        return send_error(server, out, 404, "Not Found", "NoSuchBucket", "The specified bucket does not exist", FALSE);
+    }
+    return send_response(server, out, 200, "OK", headers, NULL, 0, FALSE, G_MAXUINT64);
+}
+
+static gboolean concat_part(gpointer key, gpointer value, gpointer user_data) {
+    (void)key;
+    gsize len = 0;
+    const guint8 *data = g_bytes_get_data((GBytes*)value, &len);
+    g_byte_array_append((GByteArray*)user_data, data, len);
+    return FALSE;
+}
+
+static gboolean handle_post_object(FakeS3Server *server, GOutputStream *out, FakeRequest *req) {
+    if (g_hash_table_contains(req->query, "uploads")) {
+        g_mutex_lock(&server->lock);
+        gchar *upload_id = g_strdup_printf("upload-%u", ++server->next_upload_id);
+        FakeUpload *upload = g_new0(FakeUpload, 1);
+        upload->bucket = g_strdup(req->bucket);
+        upload->key = g_strdup(req->key);
+        upload->parts = g_tree_new_full(compare_part_numbers, NULL, NULL, (GDestroyNotify)g_bytes_unref);
+        g_hash_table_insert(server->uploads, upload_id, upload);
+        g_mutex_unlock(&server->lock);
+
+        GString *xml = g_string_new("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                                    "<InitiateMultipartUploadResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">");
+        append_escaped(xml, "Bucket", req->bucket);
+        append_escaped(xml, "Key", req->key);
+        append_escaped(xml, "UploadId", upload_id);
+        g_string_append(xml, "</InitiateMultipartUploadResult>");
+        return send_xml(server, out, 200, "OK", xml);
+    }
+
+    const gchar *upload_id = g_hash_table_lookup(req->query, "uploadId");
+    if (upload_id) {
+        FakeObject *obj = NULL;
+        g_mutex_lock(&server->lock);
+        FakeUpload *upload = g_hash_table_lookup(server->uploads, upload_id);
+        FakeBucket *bucket = upload ? g_hash_table_lookup(server->buckets, upload->bucket) : NULL;
+        if (upload && bucket) {
+            GByteArray *joined = g_byte_array_new();
+            g_tree_foreach(upload->parts, concat_part, joined);
+            g_autoptr(GBytes) data = g_byte_array_free_to_bytes(joined);
+            g_autofree gchar *digest = g_compute_checksum_for_bytes(G_CHECKSUM_MD5, data);
+            g_autofree gchar *etag = g_strdup_printf("%s-%d", digest, g_tree_nnodes(upload->parts));
+            obj = fake_object_new(data, etag);
+            g_tree_replace(bucket->objects, g_strdup(upload->key), obj);
+            g_hash_table_remove(server->uploads, upload_id);
+        }
+        g_mutex_unlock(&server->lock);
+        if (!obj) {
+            return send_error(server, out, 404, "Not Found", "NoSuchUpload", "The specified upload does not exist.", FALSE);
+        }
+        GString *xml = g_string_new("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                                    "<CompleteMultipartUploadResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">");
+        append_escaped(xml, "Bucket", req->bucket);
+        append_escaped(xml, "Key", req->key);
+        g_string_append_printf(xml, "<ETag>&quot;%s&quot;</ETag></CompleteMultipartUploadResult>", obj->etag);
+        return send_xml(server, out, 200, "OK", xml);
+    }
+
+    return send_error(server, out, 501, "Not Implemented", "NotImplemented", "Unsupported POST request", FALSE);
+}
+
+static gboolean handle_delete(FakeS3Server *server, GOutputStream *out, FakeRequest *req) {
+    const gchar *upload_id = g_hash_table_lookup(req->query, "uploadId");
+    g_mutex_lock(&server->lock);
+    if (upload_id) {
+        g_hash_table_remove(server->uploads, upload_id);
+    } else if (req->key) {
+        FakeBucket *bucket = g_hash_table_lookup(server->buckets, req->bucket);
+        if (bucket) g_tree_remove(bucket->objects, req->key);
+    } else {
+        g_hash_table_remove(server->buckets, req->bucket);
+    }
+    g_mutex_unlock(&server->lock);
+    return send_response(server, out, 204, "No Content", NULL, NULL, 0, FALSE, G_MAXUINT64);
+}
+
+// #############################################################################
+// # Dispatch
+// #############################################################################
+
+static FakeDecision decide_faults(FakeS3Server *server, FakeRequest *req, guint *latency_ms) {
+    FakeDecision d = {0};
+    g_mutex_lock(&server->lock);
+    guint64 n = ++server->stats.requests;
+    FakeS3Faults *f = &server->faults;
+    *latency_ms = f->latency_ms;
+    if (f->slowdown_every && n % f->slowdown_every == 0) d.slowdown = TRUE;
+    if (f->slowdown_probability > 0 && g_rand_double(server->rand) < f->slowdown_probability) d.slowdown = TRUE;
+    if (g_strcmp0(req->method, "GET") == 0 && req->key && f->disconnect_every) {
+        if (++server->get_count % f->disconnect_every == 0) d.disconnect = TRUE;
+    }
+    if (d.slowdown) server->stats.slowdowns++;
+    g_mutex_unlock(&server->lock);
+    return d;
+}
+
+static gboolean handle_request(FakeS3Server *server, GDataInputStream *in, GOutputStream *out) {
+    FakeRequest *req = read_request(server, in, out);
+    if (!req) return FALSE;
+
+    guint latency_ms = 0;
+    FakeDecision decision = decide_faults(server, req, &latency_ms);
+    if (latency_ms) g_usleep((gulong)latency_ms * 1000);
+
+    gboolean head_only = g_strcmp0(req->method, "HEAD") == 0;
+    gboolean keep_alive;
+    if (decision.slowdown) {
+        keep_alive = send_error(server, out, 503, "Slow Down", "SlowDown", "Please reduce your request rate.", head_only);
+    } else if (!req->bucket) {
+        keep_alive = g_strcmp0(req->method, "GET") == 0
+            ? handle_list_buckets(server, out)
+            : send_error(server, out, 405, "Method Not Allowed", "MethodNotAllowed", "Unsupported method", FALSE);
+    } else if (g_strcmp0(req->method, "GET") == 0 && !req->key) {
+        keep_alive = handle_list_objects(server, out, req);
+    } else if (g_strcmp0(req->method, "GET") == 0 || head_only) {
+        keep_alive = req->key ? handle_get_object(server, out, req, head_only, &decision)
+                              : send_response(server, out, 200, "OK", NULL, NULL, 0, TRUE, G_MAXUINT64);
+    } else if (g_strcmp0(req->method, "PUT") == 0) {
+        keep_alive = handle_put_object(server, out, req);
+    } else if (g_strcmp0(req->method, "POST") == 0) {
+        keep_alive = handle_post_object(server, out, req);
+    } else if (g_strcmp0(req->method, "DELETE") == 0) {
+        keep_alive = handle_delete(server, out, req);
+    } else {
+        keep_alive = send_error(server, out, 405, "Method Not Allowed", "MethodNotAllowed", "Unsupported method", head_only);
+    }
+
+    const gchar *connection = g_hash_table_lookup(req->headers, "connection");
+    if (connection && g_ascii_strcasecmp(connection, "close") == 0) keep_alive = FALSE;
+    fake_request_free(req);
+    return keep_alive;
+}
+
+static gboolean on_connection(GThreadedSocketService *service, GSocketConnection *connection,
+                              GObject *source_object, gpointer user_data) {
+    (void)service; (void)source_object;
+    FakeS3Server *server = (FakeS3Server*)user_data;
+    g_autoptr(GDataInputStream) in = g_data_input_stream_new(g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+    g_data_input_stream_set_newline_type(in, G_DATA_STREAM_NEWLINE_TYPE_LF);
+    GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+
+#ifdef G_OS_UNIX
+    g_socket_set_option(g_socket_connection_get_socket(connection), IPPROTO_TCP, TCP_NODELAY, 1, NULL);
+#endif
+    // Service threads are pooled; start this connection with a fresh pace.
+    g_private_replace(&pacing_key, NULL);
+    while (handle_request(server, in, out)) {
+    }
+    g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
+    return TRUE;
+}
+
+// #############################################################################
+// # Lifecycle
+// #############################################################################
+
+static gpointer server_thread(gpointer user_data) {
+    FakeS3Server *server = (FakeS3Server*)user_data;
+    g_main_context_push_thread_default(server->context);
+
+    server->service = g_threaded_socket_service_new(64);
+    g_autoptr(GInetAddress) loopback = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+    g_autoptr(GSocketAddress) address = g_inet_socket_address_new(loopback, server->port);
+    g_autoptr(GSocketAddress) effective = NULL;
+    if (g_socket_listener_add_address(G_SOCKET_LISTENER(server->service), address, G_SOCKET_TYPE_STREAM,
+                                      G_SOCKET_PROTOCOL_TCP, NULL, &effective, &server->start_error)) {
+        server->port = g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(effective));
+        server->endpoint = g_strdup_printf("127.0.0.1:%u", server->port);
+        g_signal_connect(server->service, "run", G_CALLBACK(on_connection), server);
+        g_socket_service_start(server->service);
+    }
+
+    g_mutex_lock(&server->ready_mutex);
+    server->ready = TRUE;
+    g_cond_signal(&server->ready_cond);
+    g_mutex_unlock(&server->ready_mutex);
+
+    if (!server->start_error) {
+        g_main_loop_run(server->loop);
+        g_socket_service_stop(server->service);
+        g_socket_listener_close(G_SOCKET_LISTENER(server->service));
+    }
+    g_clear_object(&server->service);
+    g_main_context_pop_thread_default(server->context);
+    return NULL;
+}
+
+static void fake_s3_server_free(FakeS3Server *server) {
+    g_main_loop_unref(server->loop);
+    g_main_context_unref(server->context);
+    g_hash_table_unref(server->buckets);
+    g_hash_table_unref(server->uploads);
+    g_rand_free(server->rand);
+    g_mutex_clear(&server->lock);
+    g_mutex_clear(&server->ready_mutex);
+    g_cond_clear(&server->ready_cond);
+    g_free(server->endpoint);
+    g_free(server);
+}
+
+FakeS3Server *fake_s3_server_start(guint16 port, GError **error) {
+    FakeS3Server *server = g_new0(FakeS3Server, 1);
+    server->port = port;
+    server->context = g_main_context_new();
+    server->loop = g_main_loop_new(server->context, FALSE);
+    server->buckets = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)fake_bucket_free);
+    server->uploads = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)fake_upload_free);
+    server->rand = g_rand_new_with_seed(0);
+    g_mutex_init(&server->lock);
+    g_mutex_init(&server->ready_mutex);
+    g_cond_init(&server->ready_cond);
+
+    server->thread = g_thread_new("fake-s3", server_thread, server);
+    g_mutex_lock(&server->ready_mutex);
+    while (!server->ready) {
+        g_cond_wait(&server->ready_cond, &server->ready_mutex);
+    }
+    g_mutex_unlock(&server->ready_mutex);
+
+    if (server->start_error) {
+        g_propagate_error(error, server->start_error);
+        server->start_error = NULL;
+        g_thread_join(server->thread);
+        fake_s3_server_free(server);
+        return NULL;
+    }
+    return server;
+}
+
+static gboolean quit_loop(gpointer user_data) {
+    g_main_loop_quit((GMainLoop*)user_data);
+    return G_SOURCE_REMOVE;
+}
+
+void fake_s3_server_stop(FakeS3Server *server) {
+    if (!server) return;
+    g_main_context_invoke(server->context, quit_loop, server->loop);
+    g_thread_join(server->thread);
+    fake_s3_server_free(server);
+}
+
+const gchar *fake_s3_server_get_endpoint(FakeS3Server *server) {
+    return server->endpoint;
+}
+
+guint16 fake_s3_server_get_port(FakeS3Server *server) {
+    return server->port;
+}
+
+void fake_s3_server_set_faults(FakeS3Server *server, const FakeS3Faults *faults) {
+    g_mutex_lock(&server->lock);
+    server->faults = *faults;
+    g_rand_set_seed(server->rand, faults->seed);
+    server->get_count = 0;
+    g_mutex_unlock(&server->lock);
+}
+
+void fake_s3_server_create_bucket(FakeS3Server *server, const gchar *bucket) {
+    g_mutex_lock(&server->lock);
+    ensure_bucket(server, bucket);
+    g_mutex_unlock(&server->lock);
+}
+
+void fake_s3_server_put_object(FakeS3Server *server, const gchar *bucket, const gchar *key,
+                               const void *data, gsize length) {
+    g_autoptr(GBytes) bytes = g_bytes_new(data, length);
+    FakeObject *obj = fake_object_new(bytes, NULL);
+    g_mutex_lock(&server->lock);
+    g_tree_replace(ensure_bucket(server, bucket)->objects, g_strdup(key), obj);
+    g_mutex_unlock(&server->lock);
+}
+
+void fake_s3_server_get_stats(FakeS3Server *server, FakeS3Stats *stats) {
+    g_mutex_lock(&server->lock);
+    *stats = server->stats;
+    g_mutex_unlock(&server->lock);
+}
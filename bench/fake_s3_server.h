@@ -0,0 +1,50 @@
+#ifndef MYS3_FAKE_S3_SERVER_H
+#define MYS3_FAKE_S3_SERVER_H
+
+#include <glib.h>
+
+// In-process, in-memory stand-in for an S3 endpoint. It implements the
+// operations the client uses (ListBuckets, ListObjectsV2, Put/Get/Head/
+// Copy/DeleteObject and multipart uploads, including UploadPartCopy) over
+// plain HTTP with path-style addressing, and ignores request signatures.
+
+typedef struct _FakeS3Server FakeS3Server;
+
+// Fault injection settings. All fields default to 0 (disabled). Decisions
+// are drawn from a GRand seeded with `seed` in request arrival order, so a
+// sequential workload sees the same faults on every run.
+typedef struct {
+    guint latency_ms;                 // Added before every response
+    guint64 bandwidth_bytes_per_sec;  // Cap per connection, shared by its request and response bodies
+    guint slowdown_every;             // Every Nth request answers 503 SlowDown
+    gdouble slowdown_probability;     // Or with this probability (0..1)
+    guint disconnect_every;           // Every Nth GET body is cut short ...
+    guint64 disconnect_after_bytes;   // ... after this many bytes
+    guint max_keys;                   // Caps every listing page (0 = the client's max-keys)
+    guint32 seed;
+} FakeS3Faults;
+
+typedef struct {
+    guint64 requests;
+    guint64 slowdowns;
+    guint64 disconnects;
+    guint64 bytes_in;
+    guint64 bytes_out;
+} FakeS3Stats;
+
+// Starts listening on 127.0.0.1. Pass port 0 to pick a free port.
+FakeS3Server *fake_s3_server_start(guint16 port, GError **error);
+void fake_s3_server_stop(FakeS3Server *server);
+
+// "127.0.0.1:<port>", suitable as the client's endpoint.
+const gchar *fake_s3_server_get_endpoint(FakeS3Server *server);
+guint16 fake_s3_server_get_port(FakeS3Server *server);
+
+void fake_s3_server_set_faults(FakeS3Server *server, const FakeS3Faults *faults);
+void fake_s3_server_create_bucket(FakeS3Server *server, const gchar *bucket);
+// Stores an object directly, creating the bucket if needed, without a request.
+void fake_s3_server_put_object(FakeS3Server *server, const gchar *bucket, const gchar *key,
+                               const void *data, gsize length);
+void fake_s3_server_get_stats(FakeS3Server *server, FakeS3Stats *stats);
+
+#endif // MYS3_FAKE_S3_SERVER_H
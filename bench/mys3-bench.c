@@ -0,0 +1,551 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "s3_client.h"
+#include "fake_s3_server.h"
+
+// #############################################################################
+// # Allocation Counting
+// #############################################################################
+
+// On glibc the benchmark interposes malloc and friends so every allocation in
+// the process (GLib, the AWS SDK, libcurl) is counted per scenario. The aligned
+// allocators are hooked too, since the SDK uses them; allocations made with
+// mmap directly or through other allocator entry points (valloc, C++ aligned
+// new on some libstdc++ builds) are not seen, so the numbers are a lower bound.
+#if defined(__GLIBC__) && !defined(MYS3_BENCH_NO_ALLOC_COUNT)
+#define MYS3_BENCH_COUNT_ALLOCS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static gint64 alloc_count = 0;
+static gint64 alloc_bytes = 0;
+
+void *malloc(size_t size) {
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&alloc_bytes, (gint64)size, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&alloc_bytes, (gint64)(nmemb * size), __ATOMIC_RELAXED);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&alloc_bytes, (gint64)size, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&alloc_bytes, (gint64)size, __ATOMIC_RELAXED);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0) return EINVAL;
+    void *ptr = memalign(alignment, size);
+    if (!ptr) return ENOMEM;
+    *memptr = ptr;
+    return 0;
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+#endif
+
+static void alloc_snapshot(gint64 *count, gint64 *bytes) {
+#ifdef MYS3_BENCH_COUNT_ALLOCS
+    *count = __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+    *bytes = __atomic_load_n(&alloc_bytes, __ATOMIC_RELAXED);
+#else
+    *count = -1;
+    *bytes = -1;
+#endif
+}
+
+// #############################################################################
+// # Options
+// #############################################################################
+
+static gchar *opt_endpoint = NULL;
+static gchar *opt_access_key = NULL;
+static gchar *opt_secret_key = NULL;
+static gchar *opt_bucket = NULL;
+static gchar *opt_scenarios = NULL;
+static gchar *opt_backend = NULL;
+static gchar *opt_output = NULL;
+static gboolean opt_no_ssl = FALSE;
+static gint opt_count = 200;
+static gint opt_threads = 8;
+static gint opt_small_size = 4096;
+static gint opt_large_mb = 64;
+static gint opt_list_keys = 5000;
+static gint opt_list_depth = 8;
+static gboolean opt_fake_server = FALSE;
+static gboolean opt_serve = FALSE;
+static gint opt_fake_port = 0;
+static gint opt_fake_latency_ms = 0;
+static gint64 opt_fake_bandwidth = 0;
+static gint opt_fake_slowdown_every = 0;
+static gdouble opt_fake_slowdown_probability = 0;
+static gint opt_fake_disconnect_every = 0;
+static gint64 opt_fake_disconnect_after = 0;
+static gint opt_fake_seed = 0;
+
+static GOptionEntry entries[] = {
+    { "endpoint", 'e', 0, G_OPTION_ARG_STRING, &opt_endpoint, "S3 endpoint (host:port), default $MYS3_BENCH_ENDPOINT", "HOST" },
+    { "access-key", 0, 0, G_OPTION_ARG_STRING, &opt_access_key, "Access key, default $MYS3_BENCH_ACCESS_KEY", "KEY" },
+    { "secret-key", 0, 0, G_OPTION_ARG_STRING, &opt_secret_key, "Secret key, default $MYS3_BENCH_SECRET_KEY", "KEY" },
+    { "bucket", 'b', 0, G_OPTION_ARG_STRING, &opt_bucket, "Bucket to run against, default $MYS3_BENCH_BUCKET", "BUCKET" },
+    { "no-ssl", 0, 0, G_OPTION_ARG_NONE, &opt_no_ssl, "Use plain HTTP", NULL },
+    { "scenario", 's', 0, G_OPTION_ARG_STRING, &opt_scenarios, "Comma separated scenarios (small-puts,large-put,large-get,deep-list,rename-storm)", "LIST" },
+    { "backend", 0, 0, G_OPTION_ARG_STRING, &opt_backend, "Transfer backend: classic or crt", "NAME" },
+    { "count", 'n', 0, G_OPTION_ARG_INT, &opt_count, "Operations for small-puts and rename-storm", "N" },
+    { "threads", 't', 0, G_OPTION_ARG_INT, &opt_threads, "Parallel workers for small-puts", "N" },
+    { "small-size", 0, 0, G_OPTION_ARG_INT, &opt_small_size, "Object size in bytes for small-puts", "BYTES" },
+    { "large-mb", 0, 0, G_OPTION_ARG_INT, &opt_large_mb, "Object size in MiB for large-put and large-get", "MB" },
+    { "list-keys", 0, 0, G_OPTION_ARG_INT, &opt_list_keys, "Keys created for deep-list", "N" },
+    { "list-depth", 0, 0, G_OPTION_ARG_INT, &opt_list_depth, "Prefix depth for deep-list keys", "N" },
+    { "output", 'o', 0, G_OPTION_ARG_FILENAME, &opt_output, "Write the JSON report to FILE instead of stdout", "FILE" },
+    { NULL }
+};
+
+static GOptionEntry fake_entries[] = {
+    { "fake-server", 0, 0, G_OPTION_ARG_NONE, &opt_fake_server, "Run against the bundled in-process S3 server", NULL },
+    { "serve", 0, 0, G_OPTION_ARG_NONE, &opt_serve, "Only run the fake server until interrupted", NULL },
+    { "fake-port", 0, 0, G_OPTION_ARG_INT, &opt_fake_port, "Port for the fake server (default: any free port)", "PORT" },
+    { "fake-latency-ms", 0, 0, G_OPTION_ARG_INT, &opt_fake_latency_ms, "Latency added to every request", "MS" },
+    { "fake-bandwidth", 0, 0, G_OPTION_ARG_INT64, &opt_fake_bandwidth, "Body bandwidth cap per connection", "BYTES/S" },
+    { "fake-slowdown-every", 0, 0, G_OPTION_ARG_INT, &opt_fake_slowdown_every, "Answer every Nth request with 503 SlowDown", "N" },
+    { "fake-slowdown-probability", 0, 0, G_OPTION_ARG_DOUBLE, &opt_fake_slowdown_probability, "Probability of a 503 SlowDown", "P" },
+    { "fake-disconnect-every", 0, 0, G_OPTION_ARG_INT, &opt_fake_disconnect_every, "Cut every Nth GET body short", "N" },
+    { "fake-disconnect-after", 0, 0, G_OPTION_ARG_INT64, &opt_fake_disconnect_after, "Bytes sent before a cut", "BYTES" },
+    { "fake-seed", 0, 0, G_OPTION_ARG_INT, &opt_fake_seed, "Seed for randomized faults", "N" },
+    { NULL }
+};
+
+// #############################################################################
+// # Measurement
+// #############################################################################
+
+typedef struct {
+    const gchar *name;
+    GArray *latencies_us;   // gdouble per operation
+    guint errors;
+    guint64 bytes;
+    guint64 keys;           // Keys listed, for listing scenarios
+    gint64 wall_us;
+    gint64 allocs;
+    gint64 alloc_bytes;
+    gint64 alloc_count_start;
+    gint64 alloc_bytes_start;
+    gint64 start_us;
+} ScenarioResult;
+
+typedef struct {
+    gchar *local_dir;
+    gchar *small_file;
+    gchar *large_file;
+    gchar *run_prefix;
+} BenchContext;
+
+static void scenario_begin(ScenarioResult *r, const gchar *name) {
+    memset(r, 0, sizeof(*r));
+    r->name = name;
+    r->latencies_us = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    alloc_snapshot(&r->alloc_count_start, &r->alloc_bytes_start);
+    r->start_us = g_get_monotonic_time();
+}
+
+static void scenario_end(ScenarioResult *r) {
+    gint64 count, bytes;
+    r->wall_us = g_get_monotonic_time() - r->start_us;
+    alloc_snapshot(&count, &bytes);
+    r->allocs = count < 0 ? -1 : count - r->alloc_count_start;
+    r->alloc_bytes = bytes < 0 ? -1 : bytes - r->alloc_bytes_start;
+}
+
+static gint compare_doubles(gconstpointer a, gconstpointer b) {
+    gdouble x = *(const gdouble*)a, y = *(const gdouble*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static gdouble percentile(GArray *sorted, gdouble p) {
+    if (sorted->len == 0) return 0;
+    guint idx = (guint)(p / 100.0 * (sorted->len - 1) + 0.5);
+    return g_array_index(sorted, gdouble, MIN(idx, sorted->len - 1));
+}
+
+static void scenario_to_json(ScenarioResult *r, GString *out) {
+    g_array_sort(r->latencies_us, compare_doubles);
+    gdouble seconds = r->wall_us / 1e6;
+    guint ops = r->latencies_us->len;
+
+    g_string_append_printf(out, "    {\n      \"name\": \"%s\",\n", r->name);
+    g_string_append_printf(out, "      \"operations\": %u,\n      \"errors\": %u,\n", ops, r->errors);
+    g_string_append_printf(out, "      \"bytes\": %" G_GUINT64_FORMAT ",\n", r->bytes);
+    g_string_append_printf(out, "      \"wall_seconds\": %.6f,\n", seconds);
+    g_string_append_printf(out, "      \"ops_per_sec\": %.3f,\n", seconds > 0 ? ops / seconds : 0.0);
+    g_string_append_printf(out, "      \"throughput_bytes_per_sec\": %.1f,\n", seconds > 0 ? r->bytes / seconds : 0.0);
+    g_string_append_printf(out, "      \"keys\": %" G_GUINT64_FORMAT ",\n", r->keys);
+    g_string_append_printf(out, "      \"keys_per_sec\": %.1f,\n", seconds > 0 ? r->keys / seconds : 0.0);
+    g_string_append_printf(out, "      \"latency_us\": { \"p50\": %.1f, \"p95\": %.1f, \"p99\": %.1f, \"max\": %.1f },\n",
+                           percentile(r->latencies_us, 50), percentile(r->latencies_us, 95),
+                           percentile(r->latencies_us, 99), percentile(r->latencies_us, 100));
+    if (r->allocs >= 0) {
+        g_string_append_printf(out, "      \"allocations\": %" G_GINT64_FORMAT ",\n      \"allocated_bytes\": %" G_GINT64_FORMAT "\n    }",
+                               r->allocs, r->alloc_bytes);
+    } else {
+        g_string_append(out, "      \"allocations\": null,\n      \"allocated_bytes\": null\n    }");
+    }
+}
+
+static void record(ScenarioResult *r, gint64 start_us, gboolean ok, guint64 bytes) {
+    gdouble elapsed = (gdouble)(g_get_monotonic_time() - start_us);
+    g_array_append_val(r->latencies_us, elapsed);
+    if (ok) {
+        r->bytes += bytes;
+    } else {
+        r->errors++;
+    }
+}
+
+static gboolean check(gboolean ok, GError *error, const gchar *what) {
+    if (!ok && error) {
+        g_printerr("%s: %s\n", what, error->message);
+    }
+    return ok;
+}
+
+// #############################################################################
+// # Scenarios
+// #############################################################################
+
+static gboolean write_payload(const gchar *path, gsize size) {
+    GRand *rand = g_rand_new_with_seed(0x5eed);
+    FILE *f = g_fopen(path, "wb");
+    if (!f) {
+        g_rand_free(rand);
+        return FALSE;
+    }
+    guint32 block[4096];
+    while (size > 0) {
+        for (guint i = 0; i < G_N_ELEMENTS(block); i++) block[i] = g_rand_int(rand);
+        gsize n = MIN(size, sizeof(block));
+        fwrite(block, 1, n, f);
+        size -= n;
+    }
+    fclose(f);
+    g_rand_free(rand);
+    return TRUE;
+}
+
+typedef struct {
+    BenchContext *ctx;
+    gdouble *latencies;
+    gint *failed;
+} SmallPutJob;
+
+static void small_put_worker(gpointer data, gpointer user_data) {
+    SmallPutJob *job = (SmallPutJob*)user_data;
+    guint index = GPOINTER_TO_UINT(data) - 1;
+    g_autofree gchar *key = g_strdup_printf("%s/small/%06u", job->ctx->run_prefix, index);
+    g_autoptr(GError) error = NULL;
+    gint64 start = g_get_monotonic_time();
+    gboolean ok = s3_client_upload_object(opt_endpoint, opt_access_key, opt_secret_key, opt_bucket, key, job->ctx->small_file, !opt_no_ssl, &error);
+    job->latencies[index] = (gdouble)(g_get_monotonic_time() - start);
+    if (!check(ok, error, "small put")) {
+        g_atomic_int_inc(job->failed);
+    }
+}
+
+static void delete_keys_with_prefix(const gchar *prefix) {
+    g_autoptr(GError) error = NULL;
+    g_autoptr(S3ObjectListing) listing = s3_client_list_objects_listing(opt_endpoint, opt_access_key, opt_secret_key, opt_bucket, prefix, !opt_no_ssl, &error);
+    for (guint i = 0; listing && i < listing->n_objects; i++) {
+        s3_client_delete_object(opt_endpoint, opt_access_key, opt_secret_key, opt_bucket, listing->objects[i].key, !opt_no_ssl, NULL);
+    }
+}
+
+static void run_small_puts(BenchContext *ctx, ScenarioResult *r) {
+    gdouble *latencies = g_new0(gdouble, opt_count);
+    gint failed = 0;
+    SmallPutJob job = { ctx, latencies, &failed };
+
+    scenario_begin(r, "small-puts");
+    GThreadPool *pool = g_thread_pool_new(small_put_worker, &job, MAX(opt_threads, 1), TRUE, NULL);
+    for (gint i = 0; i < opt_count; i++) {
+        g_thread_pool_push(pool, GUINT_TO_POINTER(i + 1), NULL);
+    }
+    g_thread_pool_free(pool, FALSE, TRUE);
+    scenario_end(r);
+
+    g_array_append_vals(r->latencies_us, latencies, opt_count);
+    r->errors = failed;
+    r->bytes = (guint64)(opt_count - failed) * opt_small_size;
+    g_free(latencies);
+
+    g_autofree gchar *prefix = g_strdup_printf("%s/small/", ctx->run_prefix);
+    delete_keys_with_prefix(prefix);
+}
+
+static void run_large_put(BenchContext *ctx, ScenarioResult *r) {
+    g_autofree gchar *key = g_strdup_printf("%s/large.bin", ctx->run_prefix);
+    g_autoptr(GError) error = NULL;
+
+    scenario_begin(r, "large-put");
+    gint64 start = g_get_monotonic_time();
+    gboolean ok = s3_client_upload_object(opt_endpoint, opt_access_key, opt_secret_key, opt_bucket, key, ctx->large_file, !opt_no_ssl, &error);
+    record(r, start, check(ok, error, "large put"), (guint64)opt_large_mb * 1024 * 1024);
+    scenario_end(r);
+}
+
+static void run_large_get(BenchContext *ctx, ScenarioResult *r) {
+    g_autofree gchar *key = g_strdup_printf("%s/large.bin", ctx->run_prefix);
+    g_autofree gchar *dest = g_build_filename(ctx->local_dir, "large-get.bin", NULL);
+    g_autoptr(GError) error = NULL;
+
+    // Make sure the object exists when large-get runs on its own.
+    if (!s3_client_upload_object(opt_endpoint, opt_access_key, opt_secret_key, opt_bucket, key, ctx->large_file, !opt_no_ssl, &error)) {
+        check(FALSE, error, "large get setup");
+        g_clear_error(&error);
+    }
+
+    scenario_begin(r, "large-get");
+    gint64 start = g_get_monotonic_time();
+    gboolean ok = s3_client_download_object(opt_endpoint, opt_access_key, opt_secret_key, opt_bucket, key, dest, !opt_no_ssl, (guint64)opt_large_mb * 1024 * 1024, NULL, NULL, &error);
+    record(r, start, check(ok, error, "large get"), (guint64)opt_large_mb * 1024 * 1024);
+    scenario_end(r);
+
+    g_remove(dest);
+    s3_client_delete_object(opt_endpoint, opt_access_key, opt_secret_key, opt_bucket, key, !opt_no_ssl, NULL);
+}
+
+static void run_deep_list(BenchContext *ctx, ScenarioResult *r) {
+    g_autofree gchar *prefix = g_strdup_printf("%s/deep/", ctx->run_prefix);
+    GString *dirs = g_string_new(prefix);
+    for (gint d = 0; d < opt_list_depth; d++) {
+        g_string_append_printf(dirs, "level-%02d/", d);
+    }
+
+    for (gint i = 0; i < opt_list_keys; i++) {
+        g_autofree gchar *key = g_strdup_printf("%shost-%03d/part-%06d", dirs->str, i % 100, i);
+        s3_client_create_folder(opt_endpoint, opt_access_key, opt_secret_key, opt_bucket, key, !opt_no_ssl, NULL);
+    }
+
+    scenario_begin(r, "deep-list");
+    for (gint round = 0; round < 5; round++) {
+        g_autoptr(GError) error = NULL;
+        gint64 start = g_get_monotonic_time();
+        g_autoptr(S3ObjectListing) listing = s3_client_list_objects_listing(opt_endpoint, opt_access_key, opt_secret_key, opt_bucket, prefix, !opt_no_ssl, &error);
+        // A listing moves keys, not payload: count them apart from bytes.
+        gboolean ok = check(listing != NULL, error, "deep list");
+        record(r, start, ok, 0);
+        if (ok) r->keys += listing->n_objects;
+    }
+    scenario_end(r);
+
+    delete_keys_with_prefix(prefix);
+    g_string_free(dirs, TRUE);
+}
+
+static void run_rename_storm(BenchContext *ctx, ScenarioResult *r) {
+    for (gint i = 0; i < opt_count; i++) {
+        g_autofree gchar *key = g_strdup_printf("%s/rename/src-%06d", ctx->run_prefix, i);
+        s3_client_upload_object(opt_endpoint, opt_access_key, opt_secret_key, opt_bucket, key, ctx->small_file, !opt_no_ssl, NULL);
+    }
+
+    scenario_begin(r, "rename-storm");
+    for (gint i = 0; i < opt_count; i++) {
+        g_autofree gchar *old_key = g_strdup_printf("%s/rename/src-%06d", ctx->run_prefix, i);
+        g_autofree gchar *new_key = g_strdup_printf("%s/rename/dst-%06d", ctx->run_prefix, i);
+        g_autoptr(GError) error = NULL;
+        gint64 start = g_get_monotonic_time();
+        gboolean ok = s3_client_rename_object(opt_endpoint, opt_access_key, opt_secret_key, opt_bucket, old_key, new_key, !opt_no_ssl, &error);
+        record(r, start, check(ok, error, "rename"), (guint64)opt_small_size);
+    }
+    scenario_end(r);
+
+    g_autofree gchar *prefix = g_strdup_printf("%s/rename/", ctx->run_prefix);
+    delete_keys_with_prefix(prefix);
+}
+
+// #############################################################################
+// # Entry Point
+// #############################################################################
+
+typedef void (*ScenarioFunc)(BenchContext *ctx, ScenarioResult *r);
+
+static const struct {
+    const gchar *name;
+    ScenarioFunc func;
+} scenarios[] = {
+    { "small-puts", run_small_puts },
+    { "large-put", run_large_put },
+    { "large-get", run_large_get },
+    { "deep-list", run_deep_list },
+    { "rename-storm", run_rename_storm },
+};
+
+static void take_env_default(gchar **opt, const gchar *env) {
+    if (!*opt && g_getenv(env)) {
+        *opt = g_strdup(g_getenv(env));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GOptionContext) context = g_option_context_new("- benchmark the S3 client layer");
+    g_option_context_add_main_entries(context, entries, NULL);
+    GOptionGroup *fake_group = g_option_group_new("fake", "Fake server options:", "Show fake server options", NULL, NULL);
+    g_option_group_add_entries(fake_group, fake_entries);
+    g_option_context_add_group(context, fake_group);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 2;
+    }
+    if (opt_backend && g_strcmp0(opt_backend, "classic") != 0 && g_strcmp0(opt_backend, "crt") != 0) {
+        g_printerr("Unknown backend '%s' (expected classic or crt).\n", opt_backend);
+        return 2;
+    }
+
+    FakeS3Server *fake = NULL;
+    if (opt_fake_server || opt_serve) {
+        fake = fake_s3_server_start((guint16)opt_fake_port, &error);
+        if (!fake) {
+            g_printerr("Could not start the fake server: %s\n", error->message);
+            return 1;
+        }
+        FakeS3Faults faults = {
+            .latency_ms = (guint)MAX(opt_fake_latency_ms, 0),
+            .bandwidth_bytes_per_sec = (guint64)MAX(opt_fake_bandwidth, 0),
+            .slowdown_every = (guint)MAX(opt_fake_slowdown_every, 0),
+            .slowdown_probability = opt_fake_slowdown_probability,
+            .disconnect_every = (guint)MAX(opt_fake_disconnect_every, 0),
+            .disconnect_after_bytes = (guint64)MAX(opt_fake_disconnect_after, 0),
+            .seed = (guint32)opt_fake_seed,
+        };
+        fake_s3_server_set_faults(fake, &faults);
+        g_free(opt_endpoint);
+        opt_endpoint = g_strdup(fake_s3_server_get_endpoint(fake));
+        if (!opt_access_key) opt_access_key = g_strdup("fake");
+        if (!opt_secret_key) opt_secret_key = g_strdup("fake");
+        if (!opt_bucket) opt_bucket = g_strdup("bench");
+        opt_no_ssl = TRUE;
+        fake_s3_server_create_bucket(fake, opt_bucket);
+
+        if (opt_serve) {
+            g_print("Fake S3 server listening on %s (bucket '%s')\n", opt_endpoint, opt_bucket);
+            g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+            g_main_loop_run(loop);
+        }
+    }
+
+    take_env_default(&opt_endpoint, "MYS3_BENCH_ENDPOINT");
+    take_env_default(&opt_access_key, "MYS3_BENCH_ACCESS_KEY");
+    take_env_default(&opt_secret_key, "MYS3_BENCH_SECRET_KEY");
+    take_env_default(&opt_bucket, "MYS3_BENCH_BUCKET");
+    if (!opt_endpoint || !opt_access_key || !opt_secret_key || !opt_bucket) {
+        g_printerr("An endpoint, credentials and a bucket are required (see --help).\n");
+        return 2;
+    }
+
+    s3_client_init();
+    S3TransferBackend backend = g_strcmp0(opt_backend, "crt") == 0 ? S3_TRANSFER_BACKEND_CRT : S3_TRANSFER_BACKEND_CLASSIC;
+    if (!s3_client_set_transfer_backend(backend, 8 * 1024 * 1024, 0)) {
+        g_printerr("The CRT backend is not available in this build.\n");
+        s3_client_cleanup();
+        fake_s3_server_stop(fake);
+        return 2;
+    }
+
+    BenchContext ctx = {0};
+    ctx.local_dir = g_dir_make_tmp("mys3-bench-XXXXXX", &error);
+    if (!ctx.local_dir) {
+        g_printerr("%s\n", error->message);
+        s3_client_cleanup();
+        fake_s3_server_stop(fake);
+        return 1;
+    }
+    ctx.small_file = g_build_filename(ctx.local_dir, "small.bin", NULL);
+    ctx.large_file = g_build_filename(ctx.local_dir, "large.bin", NULL);
+    ctx.run_prefix = g_strdup_printf("mys3-bench/%" G_GINT64_FORMAT, g_get_real_time());
+    write_payload(ctx.small_file, opt_small_size);
+
+    g_auto(GStrv) selected = g_strsplit(opt_scenarios ? opt_scenarios : "small-puts,large-put,large-get,deep-list,rename-storm", ",", -1);
+    GString *json = g_string_new("{\n");
+    g_string_append_printf(json, "  \"endpoint\": \"%s\",\n  \"backend\": \"%s\",\n  \"scenarios\": [\n",
+                           opt_endpoint, backend == S3_TRANSFER_BACKEND_CRT ? "crt" : "classic");
+
+    guint total_errors = 0;
+    gboolean first = TRUE;
+    for (guint i = 0; selected[i]; i++) {
+        ScenarioFunc func = NULL;
+        for (guint j = 0; j < G_N_ELEMENTS(scenarios); j++) {
+            if (g_strcmp0(selected[i], scenarios[j].name) == 0) func = scenarios[j].func;
+        }
+        if (!func) {
+            g_printerr("Unknown scenario '%s'\n", selected[i]);
+            continue;
+        }
+        if (g_strcmp0(selected[i], "large-put") == 0 || g_strcmp0(selected[i], "large-get") == 0) {
+            GStatBuf st;
+            if (g_stat(ctx.large_file, &st) != 0) {
+                write_payload(ctx.large_file, (gsize)opt_large_mb * 1024 * 1024);
+            }
+        }
+
+        ScenarioResult r;
+        func(&ctx, &r);
+        total_errors += r.errors;
+        if (!first) g_string_append(json, ",\n");
+        scenario_to_json(&r, json);
+        first = FALSE;
+        g_array_unref(r.latencies_us);
+    }
+    g_string_append(json, "\n  ]");
+    if (fake) {
+        FakeS3Stats stats;
+        fake_s3_server_get_stats(fake, &stats);
+        g_string_append_printf(json, ",\n  \"fake_server\": { \"requests\": %" G_GUINT64_FORMAT ", \"slowdowns\": %" G_GUINT64_FORMAT
+                               ", \"disconnects\": %" G_GUINT64_FORMAT ", \"bytes_in\": %" G_GUINT64_FORMAT ", \"bytes_out\": %" G_GUINT64_FORMAT " }",
+                               stats.requests, stats.slowdowns, stats.disconnects, stats.bytes_in, stats.bytes_out);
+    }
+    g_string_append(json, "\n}\n");
+
+    if (opt_output) {
+        if (!g_file_set_contents(opt_output, json->str, json->len, &error)) {
+            g_printerr("%s\n", error->message);
+        }
+    } else {
+        fputs(json->str, stdout);
+    }
+
+    g_string_free(json, TRUE);
+    g_remove(ctx.small_file);
+    g_remove(ctx.large_file);
+    g_rmdir(ctx.local_dir);
+    g_free(ctx.small_file);
+    g_free(ctx.large_file);
+    g_free(ctx.local_dir);
+    g_free(ctx.run_prefix);
+    s3_client_cleanup();
+    fake_s3_server_stop(fake);
+    return total_errors > 0 ? 1 : 0;
+}
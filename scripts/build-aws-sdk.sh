@@ -30,7 +30,7 @@ cmake .. \
   -DMINIMIZE_SIZE=ON \
   -DENABLE_TESTING=OFF \
   -DAUTORUN_UNIT_TESTS=OFF \
-  -DBUILD_ONLY="s3;core" \
+  -DBUILD_ONLY="s3;s3-crt;core" \
   -DUSE_OPENSSL=ON \
   -DCMAKE_CXX_FLAGS="-Wno-error=deprecated-declarations" \
   -DCMAKE_POLICY_VERSION_MINIMUM=3.5
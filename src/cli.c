@@ -0,0 +1,800 @@
+#include "cli.h"
+#include "settings.h"
+#include "s3_client.h"
+#include "s3_stream_copy.h"
+#include "credential_storage.h"
+#include "trace.h"
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+// #############################################################################
+// # Connection & Output
+// #############################################################################
+
+typedef struct {
+    gchar *endpoint;
+    gchar *access_key;
+    gchar *secret_key;
+    gboolean use_ssl;
+} CliConnection;
+
+static CliConnection conn;
+// Where cp/mv write s3:// destinations with --to-destination; unset
+// otherwise.
+static CliConnection dest;
+static gboolean opt_recursive = FALSE;
+static gboolean opt_delete = FALSE;
+static gboolean opt_dry_run = FALSE;
+static gboolean opt_quiet = FALSE;
+static gboolean opt_no_ssl = FALSE;
+static gint opt_jobs = 8;
+static gchar *opt_endpoint = NULL;
+static gboolean opt_to_destination = FALSE;
+static gchar *opt_dest_endpoint = NULL;
+
+static GMutex output_lock;
+static gint jobs_ok = 0;
+static gint jobs_failed = 0;
+static guint64 bytes_transferred = 0;
+
+static void json_append_field(GString *out, const gchar *name, const gchar *value) {
+    g_string_append_printf(out, ",\"%s\":", name);
+    trace_append_json_string(out, value);
+}
+
+// Prints one NDJSON line. Lines from worker threads never interleave.
+static void emit_line(GString *line) {
+    g_string_append(line, "}\n");
+    g_mutex_lock(&output_lock);
+    fputs(line->str, stdout);
+    fflush(stdout);
+    g_mutex_unlock(&output_lock);
+    g_string_free(line, TRUE);
+}
+
+static GString *begin_event(const gchar *event) {
+    GString *line = g_string_new("{\"event\":");
+    trace_append_json_string(line, event);
+    return line;
+}
+
+static void emit_error(const gchar *message) {
+    GString *line = begin_event("error");
+    json_append_field(line, "message", message);
+    emit_line(line);
+}
+
+static gchar *format_time_ms(gint64 ms) {
+    GDateTime *dt = g_date_time_new_from_unix_utc(ms / 1000);
+    gchar *text = dt ? g_date_time_format_iso8601(dt) : g_strdup("");
+    if (dt) g_date_time_unref(dt);
+    return text;
+}
+
+// #############################################################################
+// # Paths
+// #############################################################################
+
+typedef struct {
+    gchar *bucket;
+    gchar *key;
+} S3Path;
+
+static gboolean parse_s3_path(const gchar *arg, S3Path *path) {
+    if (!g_str_has_prefix(arg, "s3://")) return FALSE;
+    const gchar *rest = arg + strlen("s3://");
+    const gchar *slash = strchr(rest, '/');
+    path->bucket = slash ? g_strndup(rest, slash - rest) : g_strdup(rest);
+    path->key = g_strdup(slash ? slash + 1 : "");
+    return TRUE;
+}
+
+static void s3_path_clear(S3Path *path) {
+    g_free(path->bucket);
+    g_free(path->key);
+}
+
+// Recursive operations treat the key as a folder.
+static gchar *folder_prefix(const gchar *key) {
+    if (!*key || g_str_has_suffix(key, "/")) return g_strdup(key);
+    return g_strconcat(key, "/", NULL);
+}
+
+static const gchar *key_basename(const gchar *key) {
+    const gchar *slash = strrchr(key, '/');
+    return slash ? slash + 1 : key;
+}
+
+typedef struct {
+    guint64 size;
+    gint64 mtime_ms;
+} LocalFile;
+
+// Collects regular files below `dir`, keyed by their path relative to `root`
+// with '/' separators.
+static void walk_local_dir(const gchar *root, const gchar *relative, GHashTable *files) {
+    gchar *dir_path = relative ? g_build_filename(root, relative, NULL) : g_strdup(root);
+    GDir *dir = g_dir_open(dir_path, 0, NULL);
+    if (!dir) {
+        g_free(dir_path);
+        return;
+    }
+    const gchar *name;
+    while ((name = g_dir_read_name(dir))) {
+        gchar *child_rel = relative ? g_strconcat(relative, "/", name, NULL) : g_strdup(name);
+        gchar *child_path = g_build_filename(dir_path, name, NULL);
+        GStatBuf st;
+        // Symlinks are skipped: following a link to a parent directory
+        // would never finish.
+        if (g_file_test(child_path, G_FILE_TEST_IS_SYMLINK)) {
+            g_free(child_rel);
+        } else if (g_file_test(child_path, G_FILE_TEST_IS_DIR)) {
+            walk_local_dir(root, child_rel, files);
+            g_free(child_rel);
+        } else if (g_stat(child_path, &st) == 0) {
+            LocalFile *file = g_new0(LocalFile, 1);
+            file->size = (guint64)st.st_size;
+            file->mtime_ms = (gint64)st.st_mtime * 1000;
+            g_hash_table_insert(files, child_rel, file);
+        } else {
+            g_free(child_rel);
+        }
+        g_free(child_path);
+    }
+    g_dir_close(dir);
+    g_free(dir_path);
+}
+
+static gchar *local_path_for(const gchar *root, const gchar *relative) {
+    gchar **parts = g_strsplit(relative, "/", -1);
+    gchar *rel = g_build_filenamev(parts);
+    gchar *path = g_build_filename(root, rel, NULL);
+    g_strfreev(parts);
+    g_free(rel);
+    return path;
+}
+
+// Lists the objects below prefix into a table keyed by the key relative to it.
+// Folder marker objects (keys ending in '/') are skipped.
+static GHashTable *list_remote(const gchar *bucket, const gchar *prefix, S3ObjectListing **listing_out, GError **error) {
+    S3ObjectListing *listing = s3_client_list_objects_listing(conn.endpoint, conn.access_key, conn.secret_key, bucket, prefix, conn.use_ssl, error);
+    if (!listing) return NULL;
+    GHashTable *table = g_hash_table_new(g_str_hash, g_str_equal);
+    for (guint i = 0; i < listing->n_objects; i++) {
+        S3Object *obj = &listing->objects[i];
+        if (g_str_has_suffix(obj->key, "/")) continue;
+        g_hash_table_insert(table, obj->key + strlen(prefix), obj);
+    }
+    *listing_out = listing;
+    return table;
+}
+
+// #############################################################################
+// # Jobs
+// #############################################################################
+
+typedef enum {
+    JOB_UPLOAD,
+    JOB_DOWNLOAD,
+    JOB_COPY,
+    JOB_DELETE,
+    JOB_DELETE_LOCAL
+} CliJobKind;
+
+typedef struct {
+    CliJobKind kind;
+    gboolean move;
+    gchar *local;
+    gchar *src_bucket;
+    gchar *src_key;
+    gchar *dst_bucket;
+    gchar *dst_key;
+    guint64 size;
+    // Guarded by progress_lock: CRT downloads report from several threads.
+    gint64 last_progress;
+} CliJob;
+
+static const gchar *job_kind_names[] = { "upload", "download", "copy", "delete", "delete_local" };
+
+static CliJob *job_new(CliJobKind kind, gboolean move, const gchar *local, const gchar *src_bucket, const gchar *src_key, const gchar *dst_bucket, const gchar *dst_key) {
+    CliJob *job = g_new0(CliJob, 1);
+    job->kind = kind;
+    job->move = move;
+    job->local = g_strdup(local);
+    job->src_bucket = g_strdup(src_bucket);
+    job->src_key = g_strdup(src_key);
+    job->dst_bucket = g_strdup(dst_bucket);
+    job->dst_key = g_strdup(dst_key);
+    return job;
+}
+
+static void job_free(CliJob *job) {
+    g_free(job->local);
+    g_free(job->src_bucket);
+    g_free(job->src_key);
+    g_free(job->dst_bucket);
+    g_free(job->dst_key);
+    g_free(job);
+}
+
+static gchar *job_uri(const gchar *bucket, const gchar *key) {
+    return g_strdup_printf("s3://%s/%s", bucket, key);
+}
+
+static GString *begin_job_event(const gchar *event, CliJob *job) {
+    GString *line = begin_event(event);
+    json_append_field(line, "op", job->move && job->kind != JOB_DELETE && job->kind != JOB_DELETE_LOCAL ? "move" : job_kind_names[job->kind]);
+    g_autofree gchar *src = job->src_bucket ? job_uri(job->src_bucket, job->src_key) : NULL;
+    g_autofree gchar *dst = job->dst_bucket ? job_uri(job->dst_bucket, job->dst_key) : NULL;
+    switch (job->kind) {
+        case JOB_UPLOAD:
+            json_append_field(line, "src", job->local);
+            json_append_field(line, "dst", dst);
+            break;
+        case JOB_DOWNLOAD:
+            json_append_field(line, "src", src);
+            json_append_field(line, "dst", job->local);
+            break;
+        case JOB_COPY:
+            json_append_field(line, "src", src);
+            json_append_field(line, "dst", dst);
+            break;
+        case JOB_DELETE:
+            json_append_field(line, "target", src);
+            break;
+        case JOB_DELETE_LOCAL:
+            json_append_field(line, "target", job->local);
+            break;
+    }
+    return line;
+}
+
+static GMutex progress_lock;
+
+static gboolean on_download_progress(guint64 downloaded, guint64 total, gpointer user_data) {
+    CliJob *job = user_data;
+    if (opt_quiet) return TRUE;
+    gint64 now = g_get_monotonic_time();
+    g_mutex_lock(&progress_lock);
+    gboolean due = now - job->last_progress >= G_USEC_PER_SEC / 2;
+    if (due) job->last_progress = now;
+    g_mutex_unlock(&progress_lock);
+    if (!due) return TRUE;
+    GString *line = begin_job_event("progress", job);
+    g_string_append_printf(line, ",\"bytes\":%" G_GUINT64_FORMAT ",\"total\":%" G_GUINT64_FORMAT, downloaded, total);
+    emit_line(line);
+    return TRUE;
+}
+
+static void on_stream_copy_progress(const S3StreamCopyStats *stats, gpointer user_data) {
+    on_download_progress(stats->bytes_written, stats->bytes_total, user_data);
+}
+
+// Copies to the destination connection through memory: the server-side
+// CopyObject cannot reach another endpoint.
+static gboolean run_stream_copy(CliJob *job, GError **error) {
+    S3StreamCopyOptions options = {
+        .src_endpoint = conn.endpoint, .src_access_key = conn.access_key, .src_secret_key = conn.secret_key,
+        .src_use_ssl = conn.use_ssl, .src_bucket = job->src_bucket, .src_key = job->src_key,
+        .dst_endpoint = dest.endpoint, .dst_access_key = dest.access_key, .dst_secret_key = dest.secret_key,
+        .dst_use_ssl = dest.use_ssl, .dst_bucket = job->dst_bucket, .dst_key = job->dst_key,
+        .progress_callback = on_stream_copy_progress, .user_data = job,
+    };
+    S3StreamCopyStats stats = { 0 };
+    gboolean ok = s3_stream_copy_run(&options, NULL, &stats, error);
+    job->size = stats.bytes_written;
+    if (ok && job->move) {
+        return s3_client_delete_object(conn.endpoint, conn.access_key, conn.secret_key, job->src_bucket, job->src_key, conn.use_ssl, error);
+    }
+    return ok;
+}
+
+static gboolean run_transfer(CliJob *job, GError **error) {
+    switch (job->kind) {
+        case JOB_UPLOAD: {
+            GStatBuf st;
+            if (g_stat(job->local, &st) == 0) job->size = (guint64)st.st_size;
+            if (!s3_client_upload_object(conn.endpoint, conn.access_key, conn.secret_key, job->dst_bucket, job->dst_key, job->local, conn.use_ssl, error)) return FALSE;
+            if (job->move && g_remove(job->local) != 0) {
+                g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "Uploaded but could not remove %s", job->local);
+                return FALSE;
+            }
+            return TRUE;
+        }
+        case JOB_DOWNLOAD: {
+            gchar *dir = g_path_get_dirname(job->local);
+            g_mkdir_with_parents(dir, 0755);
+            g_free(dir);
+            if (!s3_client_download_object(conn.endpoint, conn.access_key, conn.secret_key, job->src_bucket, job->src_key, job->local, conn.use_ssl, job->size, on_download_progress, job, error)) return FALSE;
+            GStatBuf st;
+            if (g_stat(job->local, &st) == 0) job->size = (guint64)st.st_size;
+            if (job->move) {
+                return s3_client_delete_object(conn.endpoint, conn.access_key, conn.secret_key, job->src_bucket, job->src_key, conn.use_ssl, error);
+            }
+            return TRUE;
+        }
+        case JOB_COPY:
+            if (dest.endpoint) return run_stream_copy(job, error);
+            if (job->move && g_strcmp0(job->src_bucket, job->dst_bucket) == 0) {
+                return s3_client_rename_object(conn.endpoint, conn.access_key, conn.secret_key, job->src_bucket, job->src_key, job->dst_key, conn.use_ssl, error);
+            }
+            if (!s3_client_copy_object(conn.endpoint, conn.access_key, conn.secret_key, job->src_bucket, job->src_key, job->dst_bucket, job->dst_key, conn.use_ssl, error)) return FALSE;
+            if (job->move) {
+                return s3_client_delete_object(conn.endpoint, conn.access_key, conn.secret_key, job->src_bucket, job->src_key, conn.use_ssl, error);
+            }
+            return TRUE;
+        case JOB_DELETE:
+            return s3_client_delete_object(conn.endpoint, conn.access_key, conn.secret_key, job->src_bucket, job->src_key, conn.use_ssl, error);
+        case JOB_DELETE_LOCAL:
+            if (g_remove(job->local) != 0) {
+                g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "Could not remove %s: %s", job->local, g_strerror(errno));
+                return FALSE;
+            }
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static void run_job(gpointer data, gpointer user_data) {
+    (void)user_data;
+    CliJob *job = data;
+    gint64 start = g_get_monotonic_time();
+
+    if (!opt_quiet) emit_line(begin_job_event("start", job));
+
+    g_autoptr(GError) error = NULL;
+    gboolean ok = run_transfer(job, &error);
+    gdouble seconds = (g_get_monotonic_time() - start) / (gdouble)G_USEC_PER_SEC;
+
+    GString *line = begin_job_event(ok ? "done" : "failed", job);
+    if (ok) {
+        g_string_append_printf(line, ",\"bytes\":%" G_GUINT64_FORMAT ",\"seconds\":%.3f", job->size, seconds);
+    } else {
+        json_append_field(line, "message", error ? error->message : "unknown error");
+    }
+    emit_line(line);
+
+    g_mutex_lock(&output_lock);
+    if (ok) {
+        jobs_ok++;
+        bytes_transferred += job->size;
+    } else {
+        jobs_failed++;
+    }
+    g_mutex_unlock(&output_lock);
+    job_free(job);
+}
+
+// Runs (or with --dry-run, only prints) the planned jobs on a thread pool.
+static void run_jobs(GPtrArray *jobs) {
+    if (opt_dry_run) {
+        for (guint i = 0; i < jobs->len; i++) {
+            CliJob *job = g_ptr_array_index(jobs, i);
+            emit_line(begin_job_event("plan", job));
+            job_free(job);
+        }
+        g_ptr_array_set_size(jobs, 0);
+        return;
+    }
+
+    GThreadPool *pool = g_thread_pool_new(run_job, NULL, MAX(opt_jobs, 1), FALSE, NULL);
+    for (guint i = 0; i < jobs->len; i++) {
+        g_thread_pool_push(pool, g_ptr_array_index(jobs, i), NULL);
+    }
+    g_ptr_array_set_size(jobs, 0);
+    g_thread_pool_free(pool, FALSE, TRUE);
+}
+
+// #############################################################################
+// # Commands
+// #############################################################################
+
+static gboolean on_ls_page(const S3Object *objects, guint n_objects, gpointer user_data) {
+    (void)user_data;
+    for (guint i = 0; i < n_objects; i++) {
+        g_autofree gchar *modified = format_time_ms(objects[i].last_modified);
+        GString *line = begin_event("object");
+        json_append_field(line, "key", objects[i].key);
+        g_string_append_printf(line, ",\"size\":%" G_GUINT64_FORMAT, objects[i].size);
+        json_append_field(line, "last_modified", modified);
+        emit_line(line);
+    }
+    return TRUE;
+}
+
+static gboolean on_ls_prefixes(const gchar * const *prefixes, guint n_prefixes, gpointer user_data) {
+    (void)user_data;
+    for (guint i = 0; i < n_prefixes; i++) {
+        GString *line = begin_event("prefix");
+        json_append_field(line, "key", prefixes[i]);
+        emit_line(line);
+    }
+    return TRUE;
+}
+
+static int cmd_ls(gchar **args, guint n_args) {
+    g_autoptr(GError) error = NULL;
+    if (n_args == 0) {
+        GList *buckets = s3_client_list_buckets(conn.endpoint, conn.access_key, conn.secret_key, conn.use_ssl, &error);
+        if (error) {
+            emit_error(error->message);
+            return CLI_EXIT_FAILED;
+        }
+        for (GList *l = buckets; l != NULL; l = l->next) {
+            S3Bucket *bucket = l->data;
+            g_autofree gchar *created = format_time_ms(bucket->creation_date);
+            GString *line = begin_event("bucket");
+            json_append_field(line, "name", bucket->name);
+            json_append_field(line, "created", created);
+            emit_line(line);
+        }
+        s3_client_free_bucket_list(buckets);
+        return CLI_EXIT_OK;
+    }
+
+    S3Path path;
+    if (!parse_s3_path(args[0], &path)) {
+        g_printerr("ls: expected an s3://bucket/prefix argument\n");
+        return CLI_EXIT_USAGE;
+    }
+
+    gboolean ok;
+    if (opt_recursive) {
+        ok = s3_client_list_objects_paged(conn.endpoint, conn.access_key, conn.secret_key, path.bucket, path.key, conn.use_ssl, on_ls_page, NULL, &error);
+    } else {
+        // One level only: the server folds deeper keys into common prefixes.
+        ok = s3_client_list_objects_delimited(conn.endpoint, conn.access_key, conn.secret_key, path.bucket, path.key, conn.use_ssl, on_ls_page, on_ls_prefixes, NULL, &error);
+    }
+    s3_path_clear(&path);
+    if (!ok) {
+        emit_error(error->message);
+        return CLI_EXIT_FAILED;
+    }
+    return CLI_EXIT_OK;
+}
+
+static int plan_copy(const gchar *src_arg, const gchar *dst_arg, gboolean move, GPtrArray *jobs) {
+    S3Path src, dst;
+    gboolean src_remote = parse_s3_path(src_arg, &src);
+    gboolean dst_remote = parse_s3_path(dst_arg, &dst);
+    int status = CLI_EXIT_OK;
+    g_autoptr(GError) error = NULL;
+
+    if (!src_remote && !dst_remote) {
+        g_printerr("%s: one of the paths must be an s3:// URI\n", move ? "mv" : "cp");
+        return CLI_EXIT_USAGE;
+    }
+
+    if (!src_remote) {
+        // Local to S3
+        if (g_file_test(src_arg, G_FILE_TEST_IS_DIR)) {
+            if (!opt_recursive) {
+                g_printerr("%s: %s is a directory (use -r)\n", move ? "mv" : "cp", src_arg);
+                status = CLI_EXIT_USAGE;
+            } else {
+                g_autofree gchar *prefix = folder_prefix(dst.key);
+                GHashTable *files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+                walk_local_dir(src_arg, NULL, files);
+                GHashTableIter iter;
+                gpointer rel;
+                g_hash_table_iter_init(&iter, files);
+                while (g_hash_table_iter_next(&iter, &rel, NULL)) {
+                    g_autofree gchar *local = local_path_for(src_arg, rel);
+                    g_autofree gchar *key = g_strconcat(prefix, rel, NULL);
+                    g_ptr_array_add(jobs, job_new(JOB_UPLOAD, move, local, NULL, NULL, dst.bucket, key));
+                }
+                g_hash_table_unref(files);
+            }
+        } else {
+            g_autofree gchar *basename = g_path_get_basename(src_arg);
+            g_autofree gchar *key = (!*dst.key || g_str_has_suffix(dst.key, "/")) ? g_strconcat(dst.key, basename, NULL) : g_strdup(dst.key);
+            g_ptr_array_add(jobs, job_new(JOB_UPLOAD, move, src_arg, NULL, NULL, dst.bucket, key));
+        }
+        s3_path_clear(&dst);
+        return status;
+    }
+
+    if (opt_recursive) {
+        g_autofree gchar *prefix = folder_prefix(src.key);
+        S3ObjectListing *listing = NULL;
+        GHashTable *remote = list_remote(src.bucket, prefix, &listing, &error);
+        if (!remote) {
+            emit_error(error->message);
+            status = CLI_EXIT_FAILED;
+        } else {
+            g_autofree gchar *dst_prefix = dst_remote ? folder_prefix(dst.key) : NULL;
+            GHashTableIter iter;
+            gpointer rel, value;
+            g_hash_table_iter_init(&iter, remote);
+            while (g_hash_table_iter_next(&iter, &rel, &value)) {
+                S3Object *obj = value;
+                if (dst_remote) {
+                    g_autofree gchar *key = g_strconcat(dst_prefix, rel, NULL);
+                    g_ptr_array_add(jobs, job_new(JOB_COPY, move, NULL, src.bucket, obj->key, dst.bucket, key));
+                } else {
+                    g_autofree gchar *local = local_path_for(dst_arg, rel);
+                    CliJob *job = job_new(JOB_DOWNLOAD, move, local, src.bucket, obj->key, NULL, NULL);
+                    job->size = obj->size;
+                    g_ptr_array_add(jobs, job);
+                }
+            }
+            g_hash_table_unref(remote);
+            s3_object_listing_unref(listing);
+        }
+    } else if (dst_remote) {
+        g_autofree gchar *key = (!*dst.key || g_str_has_suffix(dst.key, "/")) ? g_strconcat(dst.key, key_basename(src.key), NULL) : g_strdup(dst.key);
+        g_ptr_array_add(jobs, job_new(JOB_COPY, move, NULL, src.bucket, src.key, dst.bucket, key));
+    } else {
+        g_autofree gchar *local = g_file_test(dst_arg, G_FILE_TEST_IS_DIR) ? g_build_filename(dst_arg, key_basename(src.key), NULL) : g_strdup(dst_arg);
+        g_ptr_array_add(jobs, job_new(JOB_DOWNLOAD, move, local, src.bucket, src.key, NULL, NULL));
+    }
+
+    s3_path_clear(&src);
+    if (dst_remote) s3_path_clear(&dst);
+    return status;
+}
+
+static int plan_rm(const gchar *arg, GPtrArray *jobs) {
+    S3Path path;
+    if (!parse_s3_path(arg, &path)) {
+        g_printerr("rm: expected an s3://bucket/key argument\n");
+        return CLI_EXIT_USAGE;
+    }
+    int status = CLI_EXIT_OK;
+    if (opt_recursive) {
+        g_autoptr(GError) error = NULL;
+        g_autofree gchar *prefix = folder_prefix(path.key);
+        g_autoptr(S3ObjectListing) listing = s3_client_list_objects_listing(conn.endpoint, conn.access_key, conn.secret_key, path.bucket, prefix, conn.use_ssl, &error);
+        if (!listing) {
+            emit_error(error->message);
+            status = CLI_EXIT_FAILED;
+        }
+        for (guint i = 0; listing && i < listing->n_objects; i++) {
+            g_ptr_array_add(jobs, job_new(JOB_DELETE, FALSE, NULL, path.bucket, listing->objects[i].key, NULL, NULL));
+        }
+    } else {
+        g_ptr_array_add(jobs, job_new(JOB_DELETE, FALSE, NULL, path.bucket, path.key, NULL, NULL));
+    }
+    s3_path_clear(&path);
+    return status;
+}
+
+// Transfers files that are missing, differ in size, or are newer on the
+// source side. With --delete, extra files on the destination are removed.
+static int plan_sync(const gchar *src_arg, const gchar *dst_arg, GPtrArray *jobs) {
+    gboolean upload = g_str_has_prefix(dst_arg, "s3://");
+    if (upload == g_str_has_prefix(src_arg, "s3://")) {
+        g_printerr("sync: expected a local directory and an s3:// URI\n");
+        return CLI_EXIT_USAGE;
+    }
+    S3Path remote_path;
+    parse_s3_path(upload ? dst_arg : src_arg, &remote_path);
+    const gchar *local_root = upload ? src_arg : dst_arg;
+
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *prefix = folder_prefix(remote_path.key);
+    S3ObjectListing *listing = NULL;
+    GHashTable *remote = list_remote(remote_path.bucket, prefix, &listing, &error);
+    if (!remote) {
+        emit_error(error->message);
+        s3_path_clear(&remote_path);
+        return CLI_EXIT_FAILED;
+    }
+    GHashTable *local = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    walk_local_dir(local_root, NULL, local);
+
+    GHashTableIter iter;
+    gpointer rel, value;
+    if (upload) {
+        g_hash_table_iter_init(&iter, local);
+        while (g_hash_table_iter_next(&iter, &rel, &value)) {
+            LocalFile *file = value;
+            S3Object *obj = g_hash_table_lookup(remote, rel);
+            if (obj && obj->size == file->size && obj->last_modified >= file->mtime_ms) continue;
+            g_autofree gchar *local_path = local_path_for(local_root, rel);
+            g_autofree gchar *key = g_strconcat(prefix, rel, NULL);
+            g_ptr_array_add(jobs, job_new(JOB_UPLOAD, FALSE, local_path, NULL, NULL, remote_path.bucket, key));
+        }
+        if (opt_delete) {
+            g_hash_table_iter_init(&iter, remote);
+            while (g_hash_table_iter_next(&iter, &rel, &value)) {
+                if (g_hash_table_contains(local, rel)) continue;
+                g_ptr_array_add(jobs, job_new(JOB_DELETE, FALSE, NULL, remote_path.bucket, ((S3Object *)value)->key, NULL, NULL));
+            }
+        }
+    } else {
+        g_hash_table_iter_init(&iter, remote);
+        while (g_hash_table_iter_next(&iter, &rel, &value)) {
+            S3Object *obj = value;
+            LocalFile *file = g_hash_table_lookup(local, rel);
+            if (file && obj->size == file->size && file->mtime_ms >= obj->last_modified) continue;
+            g_autofree gchar *local_path = local_path_for(local_root, rel);
+            CliJob *job = job_new(JOB_DOWNLOAD, FALSE, local_path, remote_path.bucket, obj->key, NULL, NULL);
+            job->size = obj->size;
+            g_ptr_array_add(jobs, job);
+        }
+        if (opt_delete) {
+            g_hash_table_iter_init(&iter, local);
+            while (g_hash_table_iter_next(&iter, &rel, NULL)) {
+                if (g_hash_table_contains(remote, rel)) continue;
+                g_autofree gchar *local_path = local_path_for(local_root, rel);
+                g_ptr_array_add(jobs, job_new(JOB_DELETE_LOCAL, FALSE, local_path, NULL, NULL, NULL, NULL));
+            }
+        }
+    }
+
+    g_hash_table_unref(local);
+    g_hash_table_unref(remote);
+    s3_object_listing_unref(listing);
+    s3_path_clear(&remote_path);
+    return CLI_EXIT_OK;
+}
+
+// #############################################################################
+// # Entry Point
+// #############################################################################
+
+static gboolean load_connection(void) {
+    MyS3Settings *settings = settings_load();
+    const gchar *env_endpoint = g_getenv("MYS3_ENDPOINT");
+    conn.endpoint = g_strdup(opt_endpoint ? opt_endpoint : env_endpoint ? env_endpoint : settings->endpoint);
+    conn.use_ssl = settings->use_ssl && !opt_no_ssl;
+    settings_apply_transfer_backend(settings);
+    settings_free(settings);
+
+    if (!conn.endpoint || !*conn.endpoint) {
+        g_printerr("No endpoint configured. Use --endpoint, MYS3_ENDPOINT or the settings dialog.\n");
+        return FALSE;
+    }
+
+    // Environment variables take precedence so servers without a keychain
+    // can run jobs.
+    const gchar *env_access = g_getenv("MYS3_ACCESS_KEY");
+    const gchar *env_secret = g_getenv("MYS3_SECRET_KEY");
+    if (env_access && env_secret) {
+        conn.access_key = g_strdup(env_access);
+        conn.secret_key = g_strdup(env_secret);
+    } else if (!credential_storage_load("mys3-client", &conn.access_key, &conn.secret_key)) {
+        g_printerr("No credentials found. Set MYS3_ACCESS_KEY and MYS3_SECRET_KEY or save them in the settings dialog.\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean load_destination(void) {
+    MyS3Settings *settings = settings_load();
+    const gchar *env_endpoint = g_getenv("MYS3_DEST_ENDPOINT");
+    dest.endpoint = g_strdup(opt_dest_endpoint ? opt_dest_endpoint : env_endpoint ? env_endpoint : settings->dest_endpoint);
+    dest.use_ssl = settings->dest_use_ssl && !opt_no_ssl;
+    settings_free(settings);
+
+    if (!dest.endpoint || !*dest.endpoint) {
+        g_printerr("No destination configured. Use --dest-endpoint, MYS3_DEST_ENDPOINT or the settings dialog.\n");
+        return FALSE;
+    }
+
+    const gchar *env_access = g_getenv("MYS3_DEST_ACCESS_KEY");
+    const gchar *env_secret = g_getenv("MYS3_DEST_SECRET_KEY");
+    if (env_access && env_secret) {
+        dest.access_key = g_strdup(env_access);
+        dest.secret_key = g_strdup(env_secret);
+    } else if (!credential_storage_load(SETTINGS_DESTINATION_CREDENTIALS, &dest.access_key, &dest.secret_key)) {
+        g_printerr("No destination credentials found. Set MYS3_DEST_ACCESS_KEY and MYS3_DEST_SECRET_KEY or save them in the settings dialog.\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void clear_connection(void) {
+    g_free(conn.endpoint);
+    g_free(conn.access_key);
+    g_free(conn.secret_key);
+    memset(&conn, 0, sizeof(conn));
+    g_free(dest.endpoint);
+    g_free(dest.access_key);
+    g_free(dest.secret_key);
+    memset(&dest, 0, sizeof(dest));
+}
+
+int cli_run(int argc, char **argv) {
+    GOptionEntry entries[] = {
+        { "endpoint", 'e', 0, G_OPTION_ARG_STRING, &opt_endpoint, "S3 endpoint (default: from settings)", "HOST[:PORT]" },
+        { "no-ssl", 0, 0, G_OPTION_ARG_NONE, &opt_no_ssl, "Use plain HTTP", NULL },
+        { "recursive", 'r', 0, G_OPTION_ARG_NONE, &opt_recursive, "Operate on all keys below a prefix", NULL },
+        { "delete", 0, 0, G_OPTION_ARG_NONE, &opt_delete, "sync: remove files missing from the source", NULL },
+        { "dry-run", 'n', 0, G_OPTION_ARG_NONE, &opt_dry_run, "Print the planned operations without running them", NULL },
+        { "jobs", 'j', 0, G_OPTION_ARG_INT, &opt_jobs, "Parallel transfers (default: 8)", "N" },
+        { "quiet", 'q', 0, G_OPTION_ARG_NONE, &opt_quiet, "Only print results, no start/progress events", NULL },
+        { "to-destination", 'd', 0, G_OPTION_ARG_NONE, &opt_to_destination, "cp/mv: write s3:// destinations to the destination connection", NULL },
+        { "dest-endpoint", 0, 0, G_OPTION_ARG_STRING, &opt_dest_endpoint, "Destination endpoint (implies --to-destination)", "HOST[:PORT]" },
+        { NULL }
+    };
+
+    g_autoptr(GOptionContext) context = g_option_context_new("COMMAND [ARGS...]");
+    g_option_context_set_summary(context,
+        "Commands:\n"
+        "  ls [s3://BUCKET[/PREFIX]]     List buckets, or objects below a prefix\n"
+        "  cp SRC DST                    Copy between local paths and s3:// URIs\n"
+        "  mv SRC DST                    Like cp, then remove the source\n"
+        "  rm s3://BUCKET/KEY            Delete an object (or a prefix with -r)\n"
+        "  sync SRC DST                  Mirror a directory to a prefix or back\n"
+        "\n"
+        "With --to-destination, cp and mv between s3:// URIs write to the\n"
+        "destination connection, streaming each object through memory.\n"
+        "\n"
+        "Events are printed as one JSON object per line. Exit status is 0 on\n"
+        "success, 1 if any operation failed, 2 on usage errors and 3 when no\n"
+        "endpoint or credentials are configured.");
+    g_option_context_add_main_entries(context, entries, NULL);
+
+    g_autoptr(GError) error = NULL;
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return CLI_EXIT_USAGE;
+    }
+    if (argc < 2) {
+        g_autofree gchar *help = g_option_context_get_help(context, TRUE, NULL);
+        g_printerr("%s", help);
+        return CLI_EXIT_USAGE;
+    }
+
+    const gchar *command = argv[1];
+    gchar **args = argv + 2;
+    guint n_args = (guint)(argc - 2);
+    gboolean known = g_str_equal(command, "ls") || g_str_equal(command, "cp") || g_str_equal(command, "mv") ||
+                     g_str_equal(command, "rm") || g_str_equal(command, "sync");
+    if (!known) {
+        g_printerr("Unknown command: %s\n", command);
+        return CLI_EXIT_USAGE;
+    }
+    if ((g_str_equal(command, "cp") || g_str_equal(command, "mv") || g_str_equal(command, "sync")) && n_args != 2) {
+        g_printerr("%s: expected SRC and DST\n", command);
+        return CLI_EXIT_USAGE;
+    }
+    gboolean to_destination = opt_to_destination || opt_dest_endpoint != NULL;
+    if (to_destination && (!(g_str_equal(command, "cp") || g_str_equal(command, "mv")) ||
+                           !g_str_has_prefix(args[0], "s3://") || !g_str_has_prefix(args[1], "s3://"))) {
+        g_printerr("%s: --to-destination needs cp or mv between two s3:// URIs\n", command);
+        return CLI_EXIT_USAGE;
+    }
+    if (g_str_equal(command, "rm") && n_args != 1) {
+        g_printerr("rm: expected one s3:// URI\n");
+        return CLI_EXIT_USAGE;
+    }
+
+    if (!load_connection() || (to_destination && !load_destination())) {
+        clear_connection();
+        return CLI_EXIT_CONFIG;
+    }
+
+    int status;
+    GPtrArray *jobs = g_ptr_array_new();
+    gint64 start = g_get_monotonic_time();
+    if (g_str_equal(command, "ls")) {
+        status = cmd_ls(args, n_args);
+    } else if (g_str_equal(command, "rm")) {
+        status = plan_rm(args[0], jobs);
+    } else if (g_str_equal(command, "sync")) {
+        status = plan_sync(args[0], args[1], jobs);
+    } else {
+        status = plan_copy(args[0], args[1], g_str_equal(command, "mv"), jobs);
+    }
+
+    if (status == CLI_EXIT_OK && !g_str_equal(command, "ls")) {
+        run_jobs(jobs);
+        GString *line = begin_event("summary");
+        g_string_append_printf(line, ",\"ok\":%d,\"failed\":%d,\"bytes\":%" G_GUINT64_FORMAT ",\"seconds\":%.3f",
+                               jobs_ok, jobs_failed, bytes_transferred,
+                               (g_get_monotonic_time() - start) / (gdouble)G_USEC_PER_SEC);
+        emit_line(line);
+        if (jobs_failed > 0) status = CLI_EXIT_FAILED;
+    }
+    // Left over when planning failed part way.
+    g_ptr_array_foreach(jobs, (GFunc)job_free, NULL);
+    g_ptr_array_free(jobs, TRUE);
+
+    clear_connection();
+    return status;
+}
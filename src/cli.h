@@ -0,0 +1,19 @@
+#ifndef MYS3_CLI_H
+#define MYS3_CLI_H
+
+#include <glib.h>
+
+// Exit codes of the headless mode.
+typedef enum {
+    CLI_EXIT_OK = 0,       // Every operation succeeded
+    CLI_EXIT_FAILED = 1,   // At least one operation failed
+    CLI_EXIT_USAGE = 2,    // Bad command line
+    CLI_EXIT_CONFIG = 3    // No endpoint or credentials configured
+} CliExitCode;
+
+// Runs one ls/cp/mv/rm/sync command without a display server, printing
+// NDJSON events on stdout. argv[0] is the program name. Expects
+// s3_client_init() to have been called.
+int cli_run(int argc, char **argv);
+
+#endif // MYS3_CLI_H
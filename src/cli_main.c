@@ -0,0 +1,15 @@
+#include <locale.h>
+#include "cli.h"
+#include "logging.h"
+#include "s3_client.h"
+
+// Entry point of mys3-cli, the headless counterpart of `mys3-client --batch`.
+int main(int argc, char *argv[]) {
+    setlocale(LC_ALL, "");
+    logging_init();
+    s3_client_init();
+    int status = cli_run(argc, argv);
+    s3_client_cleanup();
+    logging_cleanup();
+    return status;
+}
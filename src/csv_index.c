@@ -0,0 +1,163 @@
+#include "csv_index.h"
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+struct _CsvIndex {
+    // Feeding thread only.
+    gboolean in_quotes;
+    guint64 n_fed;          // Bytes fed
+    guint64 scan_records;   // Records ended so far
+    guint64 record_start;   // Offset of the record being scanned
+    GArray *new_checkpoints;
+    // Published at the end of each feed, under the lock.
+    GMutex lock;
+    GArray *checkpoints;    // guint64 offset of record k * CSV_INDEX_STRIDE
+    guint64 n_records;
+    guint64 n_bytes;
+};
+
+CsvIndex *csv_index_new(void) {
+    CsvIndex *index = g_new0(CsvIndex, 1);
+    g_mutex_init(&index->lock);
+    index->checkpoints = g_array_new(FALSE, FALSE, sizeof(guint64));
+    index->new_checkpoints = g_array_new(FALSE, FALSE, sizeof(guint64));
+    guint64 first = 0;
+    g_array_append_val(index->checkpoints, first);
+    return index;
+}
+
+void csv_index_free(CsvIndex *index) {
+    if (!index) return;
+    g_array_unref(index->checkpoints);
+    g_array_unref(index->new_checkpoints);
+    g_mutex_clear(&index->lock);
+    g_free(index);
+}
+
+static inline void end_record(CsvIndex *index, guint64 next_start) {
+    index->scan_records++;
+    index->record_start = next_start;
+    if (index->scan_records % CSV_INDEX_STRIDE == 0) g_array_append_val(index->new_checkpoints, next_start);
+}
+
+#ifdef __SSE2__
+// Bit i of the result is the parity of bits 0..i of x: which bytes of a
+// 16-byte block sit after an odd number of quotes.
+static inline guint32 prefix_xor16(guint32 x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    return x & 0xffff;
+}
+#endif
+
+void csv_index_feed(CsvIndex *index, const gchar *data, gsize length) {
+    const guint8 *bytes = (const guint8 *)data;
+    guint64 base = index->n_fed;
+    gsize i = 0;
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(bytes + i));
+        guint32 quotes = (guint32)_mm_movemask_epi8(_mm_cmpeq_epi8(block, quote));
+        guint32 newlines = (guint32)_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        if (quotes) {
+            // Doubled quotes toggle twice, so escaped quotes need no special case.
+            guint32 quoted = prefix_xor16(quotes) ^ (index->in_quotes ? 0xffff : 0);
+            index->in_quotes = (quoted >> 15) & 1;
+            newlines &= ~quoted;
+        } else if (index->in_quotes) {
+            continue;
+        }
+        while (newlines) {
+            gint bit = g_bit_nth_lsf(newlines, -1);
+            end_record(index, base + i + bit + 1);
+            newlines &= newlines - 1;
+        }
+    }
+#endif
+    for (; i < length; i++) {
+        if (bytes[i] == '"') index->in_quotes = !index->in_quotes;
+        else if (bytes[i] == '\n' && !index->in_quotes) end_record(index, base + i + 1);
+    }
+    index->n_fed += length;
+
+    g_mutex_lock(&index->lock);
+    g_array_append_vals(index->checkpoints, index->new_checkpoints->data, index->new_checkpoints->len);
+    index->n_records = index->scan_records;
+    index->n_bytes = index->record_start;
+    g_mutex_unlock(&index->lock);
+    g_array_set_size(index->new_checkpoints, 0);
+}
+
+void csv_index_finish(CsvIndex *index) {
+    if (index->record_start < index->n_fed) end_record(index, index->n_fed);
+    g_mutex_lock(&index->lock);
+    g_array_append_vals(index->checkpoints, index->new_checkpoints->data, index->new_checkpoints->len);
+    index->n_records = index->scan_records;
+    index->n_bytes = index->n_fed;
+    g_mutex_unlock(&index->lock);
+    g_array_set_size(index->new_checkpoints, 0);
+}
+
+guint64 csv_index_get_n_records(CsvIndex *index, guint64 *n_bytes) {
+    g_mutex_lock(&index->lock);
+    guint64 n = index->n_records;
+    if (n_bytes) *n_bytes = index->n_bytes;
+    g_mutex_unlock(&index->lock);
+    return n;
+}
+
+guint64 csv_index_locate(CsvIndex *index, guint64 record, guint *skip) {
+    g_mutex_lock(&index->lock);
+    guint64 checkpoint = MIN(record / CSV_INDEX_STRIDE, (guint64)index->checkpoints->len - 1);
+    guint64 offset = g_array_index(index->checkpoints, guint64, checkpoint);
+    g_mutex_unlock(&index->lock);
+    *skip = (guint)(record - checkpoint * CSV_INDEX_STRIDE);
+    return offset;
+}
+
+gsize csv_split_record(const gchar *data, gsize length, gchar delimiter, gboolean at_end, GPtrArray *fields) {
+    guint first_field = fields->len;
+    GString *field = g_string_new(NULL);
+    gboolean in_quotes = FALSE;
+    gsize i = 0;
+    for (; i < length; i++) {
+        gchar c = data[i];
+        if (in_quotes) {
+            if (c != '"') {
+                g_string_append_c(field, c);
+            } else if (i + 1 < length && data[i + 1] == '"') {
+                g_string_append_c(field, '"');
+                i++;
+            } else if (i + 1 == length && !at_end) {
+                break;  // Cannot tell a closing quote from an escaped one yet
+            } else {
+                in_quotes = FALSE;
+            }
+        } else if (c == '"') {
+            in_quotes = TRUE;
+        } else if (c == delimiter) {
+            g_ptr_array_add(fields, g_string_free(field, FALSE));
+            field = g_string_new(NULL);
+        } else if (c == '\n') {
+            if (field->len > 0 && field->str[field->len - 1] == '\r') g_string_truncate(field, field->len - 1);
+            g_ptr_array_add(fields, g_string_free(field, FALSE));
+            return i + 1;
+        } else {
+            g_string_append_c(field, c);
+        }
+    }
+    if (!at_end || length == 0) {
+        g_ptr_array_set_size(fields, first_field);
+        g_string_free(field, TRUE);
+        return 0;
+    }
+    if (field->len > 0 && field->str[field->len - 1] == '\r') g_string_truncate(field, field->len - 1);
+    g_ptr_array_add(fields, g_string_free(field, FALSE));
+    return length;
+}
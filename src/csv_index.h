@@ -0,0 +1,39 @@
+#ifndef MYS3_CSV_INDEX_H
+#define MYS3_CSV_INDEX_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Records between two checkpoints of a CsvIndex.
+#define CSV_INDEX_STRIDE 64
+
+// Sparse index of record starts in a CSV byte stream. Bytes are fed in order
+// by one thread, which finds record boundaries (newlines outside quotes) 16
+// bytes at a time with SSE2 where available. The start offset of every
+// CSV_INDEX_STRIDE-th record is kept, so other threads can seek to any record
+// while the stream is still being fed.
+typedef struct _CsvIndex CsvIndex;
+
+CsvIndex *csv_index_new(void);
+void csv_index_free(CsvIndex *index);
+
+void csv_index_feed(CsvIndex *index, const gchar *data, gsize length);
+// Counts a last record that has no trailing newline.
+void csv_index_finish(CsvIndex *index);
+
+// Complete records fed so far, and the bytes they span from the start.
+guint64 csv_index_get_n_records(CsvIndex *index, guint64 *n_bytes);
+// Offset of the checkpoint at or before `record`; `skip` receives how many
+// records follow it before `record`.
+guint64 csv_index_locate(CsvIndex *index, guint64 record, guint *skip);
+
+// Splits the record at the start of `data` into unquoted fields appended to
+// `fields` (which should free with g_free). Returns the bytes consumed,
+// including the line end, or 0 if the record continues past `length` and
+// `at_end` is FALSE.
+gsize csv_split_record(const gchar *data, gsize length, gchar delimiter, gboolean at_end, GPtrArray *fields);
+
+G_END_DECLS
+
+#endif // MYS3_CSV_INDEX_H
@@ -0,0 +1,423 @@
+#include "csv_table.h"
+#include "csv_index.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Decoded blocks of CSV_INDEX_STRIDE records kept while scrolling.
+#define CSV_TABLE_CACHED_BLOCKS 16
+#define CSV_TABLE_READ_SIZE (64 * 1024)
+#define CSV_SORT_READ_SIZE (1024 * 1024)
+
+// #############################################################################
+// # CsvRow
+// #############################################################################
+
+struct _CsvRow {
+    GObject parent_instance;
+    GStrv fields;
+    guint n_fields;
+};
+
+G_DEFINE_TYPE(CsvRow, csv_row, G_TYPE_OBJECT)
+
+static void csv_row_finalize(GObject *object) {
+    g_strfreev(CSV_ROW(object)->fields);
+    G_OBJECT_CLASS(csv_row_parent_class)->finalize(object);
+}
+
+static void csv_row_class_init(CsvRowClass *klass) {
+    G_OBJECT_CLASS(klass)->finalize = csv_row_finalize;
+}
+
+static void csv_row_init(CsvRow *row) {
+    (void)row;
+}
+
+static CsvRow *csv_row_new(const gchar * const *fields) {
+    CsvRow *row = g_object_new(CSV_TYPE_ROW, NULL);
+    row->fields = g_strdupv((gchar **)fields);
+    row->n_fields = row->fields ? g_strv_length(row->fields) : 0;
+    return row;
+}
+
+guint csv_row_get_n_fields(CsvRow *row) {
+    g_return_val_if_fail(CSV_IS_ROW(row), 0);
+    return row->n_fields;
+}
+
+const gchar *csv_row_get_field(CsvRow *row, guint column) {
+    g_return_val_if_fail(CSV_IS_ROW(row), NULL);
+    return column < row->n_fields ? row->fields[column] : "";
+}
+
+// #############################################################################
+// # CsvTable
+// #############################################################################
+
+struct _CsvTable {
+    GObject parent_instance;
+    gchar delimiter;
+    gboolean has_header;
+    GFile *spool;
+    GFileIOStream *spool_stream;    // Appended to by the writing thread
+    GFileInputStream *reader;       // Main thread reads of decoded blocks
+    CsvIndex *index;
+    gint write_done;
+    gboolean complete;
+    guint n_rows;                   // Rows exposed through the model
+    GStrv header;
+    guint n_columns;
+    GHashTable *blocks;             // Block number -> GPtrArray of GStrv records
+    GQueue block_lru;               // Block numbers, most recently used first
+    GArray *order;                  // guint32 row shown at each position, NULL for file order
+    guint sort_generation;
+};
+
+static void csv_table_model_init(GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(CsvTable, csv_table, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL, csv_table_model_init))
+
+static inline guint csv_table_header_records(CsvTable *table) {
+    return table->has_header ? 1 : 0;
+}
+
+// Decodes the records of one block from the spool, or returns them from the
+// cache. Blocks past the indexed records come back short or empty.
+static GPtrArray *csv_table_load_block(CsvTable *table, guint64 block) {
+    GPtrArray *rows = g_hash_table_lookup(table->blocks, GUINT_TO_POINTER((guint)block));
+    if (rows) {
+        g_queue_remove(&table->block_lru, GUINT_TO_POINTER((guint)block));
+        g_queue_push_head(&table->block_lru, GUINT_TO_POINTER((guint)block));
+        return rows;
+    }
+
+    rows = g_ptr_array_new_with_free_func((GDestroyNotify)g_strfreev);
+    guint64 n_bytes = 0;
+    guint64 n_records = csv_index_get_n_records(table->index, &n_bytes);
+    guint skip = 0;
+    guint64 offset = csv_index_locate(table->index, block * CSV_INDEX_STRIDE, &skip);
+    guint64 wanted = block * CSV_INDEX_STRIDE < n_records ? MIN(CSV_INDEX_STRIDE, n_records - block * CSV_INDEX_STRIDE) : 0;
+
+    GByteArray *buffer = g_byte_array_new();
+    gsize parsed = 0;
+    guint64 read_end = offset;
+    if (wanted > 0 && g_seekable_seek(G_SEEKABLE(table->reader), offset, G_SEEK_SET, NULL, NULL)) {
+        while (rows->len < wanted) {
+            GPtrArray *fields = g_ptr_array_new_with_free_func(g_free);
+            gboolean at_end = read_end >= n_bytes;
+            gsize used = csv_split_record((const gchar *)buffer->data + parsed, buffer->len - parsed, table->delimiter, at_end, fields);
+            if (used > 0) {
+                parsed += used;
+                if (skip > 0) {
+                    // Records between the checkpoint and the block start.
+                    skip--;
+                    g_ptr_array_unref(fields);
+                    continue;
+                }
+                g_ptr_array_add(fields, NULL);
+                g_ptr_array_add(rows, g_ptr_array_free(fields, FALSE));
+                continue;
+            }
+            g_ptr_array_unref(fields);
+            if (at_end) break;
+            gsize chunk = (gsize)MIN((guint64)CSV_TABLE_READ_SIZE, n_bytes - read_end);
+            guint old_len = buffer->len;
+            g_byte_array_set_size(buffer, old_len + chunk);
+            gsize got = 0;
+            if (!g_input_stream_read_all(G_INPUT_STREAM(table->reader), buffer->data + old_len, chunk, &got, NULL, NULL) || got == 0) break;
+            g_byte_array_set_size(buffer, old_len + got);
+            read_end += got;
+        }
+    }
+    g_byte_array_unref(buffer);
+
+    g_hash_table_insert(table->blocks, GUINT_TO_POINTER((guint)block), rows);
+    g_queue_push_head(&table->block_lru, GUINT_TO_POINTER((guint)block));
+    while (g_queue_get_length(&table->block_lru) > CSV_TABLE_CACHED_BLOCKS) {
+        g_hash_table_remove(table->blocks, g_queue_pop_tail(&table->block_lru));
+    }
+    return rows;
+}
+
+static const gchar * const *csv_table_get_record(CsvTable *table, guint64 record) {
+    GPtrArray *rows = csv_table_load_block(table, record / CSV_INDEX_STRIDE);
+    guint i = record % CSV_INDEX_STRIDE;
+    return i < rows->len ? g_ptr_array_index(rows, i) : NULL;
+}
+
+static GType csv_table_get_item_type(GListModel *model) {
+    (void)model;
+    return CSV_TYPE_ROW;
+}
+
+static guint csv_table_get_n_items(GListModel *model) {
+    return CSV_TABLE(model)->n_rows;
+}
+
+static gpointer csv_table_get_item(GListModel *model, guint position) {
+    CsvTable *table = CSV_TABLE(model);
+    if (position >= table->n_rows) return NULL;
+    guint row = table->order ? g_array_index(table->order, guint32, position) : position;
+    const gchar * const *fields = csv_table_get_record(table, (guint64)row + csv_table_header_records(table));
+    static const gchar *empty[] = { NULL };
+    return csv_row_new(fields ? fields : empty);
+}
+
+static void csv_table_model_init(GListModelInterface *iface) {
+    iface->get_item_type = csv_table_get_item_type;
+    iface->get_n_items = csv_table_get_n_items;
+    iface->get_item = csv_table_get_item;
+}
+
+static void csv_table_finalize(GObject *object) {
+    CsvTable *table = CSV_TABLE(object);
+    g_clear_object(&table->reader);
+    if (table->spool_stream) g_io_stream_close(G_IO_STREAM(table->spool_stream), NULL, NULL);
+    g_clear_object(&table->spool_stream);
+    if (table->spool) g_file_delete(table->spool, NULL, NULL);
+    g_clear_object(&table->spool);
+    csv_index_free(table->index);
+    g_strfreev(table->header);
+    g_hash_table_unref(table->blocks);
+    g_queue_clear(&table->block_lru);
+    g_clear_pointer(&table->order, g_array_unref);
+    G_OBJECT_CLASS(csv_table_parent_class)->finalize(object);
+}
+
+static void csv_table_class_init(CsvTableClass *klass) {
+    G_OBJECT_CLASS(klass)->finalize = csv_table_finalize;
+}
+
+static void csv_table_init(CsvTable *table) {
+    table->index = csv_index_new();
+    table->blocks = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_ptr_array_unref);
+    g_queue_init(&table->block_lru);
+}
+
+CsvTable *csv_table_new(gchar delimiter, gboolean has_header, GError **error) {
+    GFileIOStream *stream = NULL;
+    GFile *spool = g_file_new_tmp("mys3-csv-XXXXXX", &stream, error);
+    if (!spool) return NULL;
+    GFileInputStream *reader = g_file_read(spool, NULL, error);
+    if (!reader) {
+        g_object_unref(stream);
+        g_file_delete(spool, NULL, NULL);
+        g_object_unref(spool);
+        return NULL;
+    }
+    CsvTable *table = g_object_new(CSV_TYPE_TABLE, NULL);
+    table->delimiter = delimiter;
+    table->has_header = has_header;
+    table->spool = spool;
+    table->spool_stream = stream;
+    table->reader = reader;
+    return table;
+}
+
+gboolean csv_table_write(CsvTable *table, const gchar *data, gsize length, GError **error) {
+    // Bytes reach the spool before the index, so every indexed record is readable.
+    GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(table->spool_stream));
+    if (!g_output_stream_write_all(out, data, length, NULL, NULL, error)) return FALSE;
+    csv_index_feed(table->index, data, length);
+    return TRUE;
+}
+
+void csv_table_write_finish(CsvTable *table) {
+    csv_index_finish(table->index);
+    g_atomic_int_set(&table->write_done, TRUE);
+}
+
+gboolean csv_table_update(CsvTable *table) {
+    gboolean done = g_atomic_int_get(&table->write_done);
+    guint64 n_records = csv_index_get_n_records(table->index, NULL);
+    guint header_records = csv_table_header_records(table);
+
+    if (table->has_header && !table->header && n_records >= 1) {
+        const gchar * const *header = csv_table_get_record(table, 0);
+        if (header) table->header = g_strdupv((gchar **)header);
+    }
+    if (table->n_columns == 0 && n_records > header_records) {
+        const gchar * const *first = csv_table_get_record(table, header_records);
+        guint n_first = first ? g_strv_length((gchar **)first) : 0;
+        table->n_columns = MAX(n_first, table->header ? g_strv_length(table->header) : 0);
+    } else if (table->n_columns == 0 && done && table->header) {
+        table->n_columns = g_strv_length(table->header);
+    }
+
+    guint64 n_data = n_records > header_records ? MIN(n_records - header_records, (guint64)G_MAXUINT32) : 0;
+    if (!table->order && n_data > table->n_rows) {
+        // The last cached block may have been decoded before it filled up.
+        guint64 last_block = ((guint64)table->n_rows + header_records) / CSV_INDEX_STRIDE;
+        g_queue_remove(&table->block_lru, GUINT_TO_POINTER((guint)last_block));
+        g_hash_table_remove(table->blocks, GUINT_TO_POINTER((guint)last_block));
+        guint position = table->n_rows;
+        table->n_rows = (guint)n_data;
+        g_list_model_items_changed(G_LIST_MODEL(table), position, 0, table->n_rows - position);
+    }
+    table->complete = done;
+    return done;
+}
+
+guint csv_table_get_n_columns(CsvTable *table) {
+    g_return_val_if_fail(CSV_IS_TABLE(table), 0);
+    return table->n_columns;
+}
+
+const gchar *csv_table_get_column_title(CsvTable *table, guint column) {
+    g_return_val_if_fail(CSV_IS_TABLE(table), NULL);
+    if (!table->header || column >= g_strv_length(table->header)) return NULL;
+    return table->header[column];
+}
+
+// #############################################################################
+// # Sorting
+// #############################################################################
+
+typedef struct {
+    GFile *spool;
+    gchar delimiter;
+    guint header_records;
+    guint n_rows;
+    guint column;
+    gboolean descending;
+    guint generation;
+    GStringChunk *strings;
+    GPtrArray *values;      // const gchar * per row, into strings
+    GArray *numbers;        // gdouble per row while every value parses
+} CsvSortJob;
+
+static void csv_sort_job_free(CsvSortJob *job) {
+    g_object_unref(job->spool);
+    if (job->strings) g_string_chunk_free(job->strings);
+    if (job->values) g_ptr_array_unref(job->values);
+    if (job->numbers) g_array_unref(job->numbers);
+    g_free(job);
+}
+
+static void csv_sort_add_value(CsvSortJob *job, const gchar *value) {
+    g_ptr_array_add(job->values, g_string_chunk_insert_const(job->strings, value));
+    if (!job->numbers) return;
+    gchar *end = NULL;
+    gdouble number = *value ? g_ascii_strtod(value, &end) : NAN;
+    if (*value && (end == value || *end != '\0')) {
+        // One non-numeric value makes the whole column text.
+        g_clear_pointer(&job->numbers, g_array_unref);
+        return;
+    }
+    g_array_append_val(job->numbers, number);
+}
+
+static gint csv_sort_compare(gconstpointer a, gconstpointer b, gpointer user_data) {
+    CsvSortJob *job = (CsvSortJob *)user_data;
+    guint32 ra = *(const guint32 *)a, rb = *(const guint32 *)b;
+    gint result;
+    if (job->numbers) {
+        gdouble na = g_array_index(job->numbers, gdouble, ra), nb = g_array_index(job->numbers, gdouble, rb);
+        // Empty cells (NaN) sort first.
+        if (isnan(na) || isnan(nb)) result = isnan(na) ? (isnan(nb) ? 0 : -1) : 1;
+        else result = na < nb ? -1 : na > nb ? 1 : 0;
+    } else {
+        result = strcmp(g_ptr_array_index(job->values, ra), g_ptr_array_index(job->values, rb));
+    }
+    if (job->descending) result = -result;
+    // Equal keys keep file order.
+    return result ? result : (ra < rb ? -1 : ra > rb ? 1 : 0);
+}
+
+static void csv_sort_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    (void)source;
+    CsvSortJob *job = (CsvSortJob *)task_data;
+    GError *error = NULL;
+    g_autoptr(GFileInputStream) in = g_file_read(job->spool, cancellable, &error);
+    if (!in) {
+        g_task_return_error(task, error);
+        return;
+    }
+    job->strings = g_string_chunk_new(1024 * 1024);
+    job->values = g_ptr_array_sized_new(job->n_rows);
+    job->numbers = g_array_sized_new(FALSE, FALSE, sizeof(gdouble), job->n_rows);
+
+    // Reads the spool once, keeping only the sort column of each record.
+    GByteArray *buffer = g_byte_array_new();
+    GPtrArray *fields = g_ptr_array_new_with_free_func(g_free);
+    gsize parsed = 0;
+    guint64 record = 0;
+    gboolean at_end = FALSE;
+    while (job->values->len < job->n_rows) {
+        g_ptr_array_set_size(fields, 0);
+        gsize used = csv_split_record((const gchar *)buffer->data + parsed, buffer->len - parsed, job->delimiter, at_end, fields);
+        if (used > 0) {
+            parsed += used;
+            if (record++ >= job->header_records) csv_sort_add_value(job, job->column < fields->len ? g_ptr_array_index(fields, job->column) : "");
+            continue;
+        }
+        if (at_end) break;
+        if (g_cancellable_set_error_if_cancelled(cancellable, &error)) break;
+        g_byte_array_remove_range(buffer, 0, parsed);
+        parsed = 0;
+        guint old_len = buffer->len;
+        g_byte_array_set_size(buffer, old_len + CSV_SORT_READ_SIZE);
+        gssize got = g_input_stream_read(G_INPUT_STREAM(in), buffer->data + old_len, CSV_SORT_READ_SIZE, cancellable, &error);
+        if (got < 0) break;
+        g_byte_array_set_size(buffer, old_len + got);
+        if (got == 0) at_end = TRUE;
+    }
+    g_ptr_array_unref(fields);
+    g_byte_array_unref(buffer);
+    if (error) {
+        g_task_return_error(task, error);
+        return;
+    }
+
+    // Rows the spool ran out for sort as empty values.
+    while (job->values->len < job->n_rows) csv_sort_add_value(job, "");
+    GArray *order = g_array_sized_new(FALSE, FALSE, sizeof(guint32), job->n_rows);
+    for (guint32 i = 0; i < job->n_rows; i++) g_array_append_val(order, i);
+    g_qsort_with_data(order->data, order->len, sizeof(guint32), csv_sort_compare, job);
+    g_task_return_pointer(task, order, (GDestroyNotify)g_array_unref);
+}
+
+void csv_table_sort_async(CsvTable *table, gint column, gboolean descending, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data) {
+    g_return_if_fail(CSV_IS_TABLE(table));
+    GTask *task = g_task_new(table, cancellable, callback, user_data);
+    g_task_set_source_tag(task, csv_table_sort_async);
+    table->sort_generation++;
+    if (!table->complete) {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_PENDING, "The file is still loading");
+    } else if (column < 0) {
+        g_task_return_pointer(task, NULL, NULL);
+    } else {
+        CsvSortJob *job = g_new0(CsvSortJob, 1);
+        job->spool = g_object_ref(table->spool);
+        job->delimiter = table->delimiter;
+        job->header_records = csv_table_header_records(table);
+        job->n_rows = table->n_rows;
+        job->column = (guint)column;
+        job->descending = descending;
+        g_task_set_task_data(task, job, (GDestroyNotify)csv_sort_job_free);
+        g_task_run_in_thread(task, csv_sort_thread);
+    }
+    g_object_set_data(G_OBJECT(task), "generation", GUINT_TO_POINTER(table->sort_generation));
+    g_object_unref(task);
+}
+
+gboolean csv_table_sort_finish(CsvTable *table, GAsyncResult *result, GError **error) {
+    g_return_val_if_fail(g_task_is_valid(result, table), FALSE);
+    GError *sort_error = NULL;
+    GArray *order = g_task_propagate_pointer(G_TASK(result), &sort_error);
+    if (sort_error) {
+        g_propagate_error(error, sort_error);
+        return FALSE;
+    }
+    if (GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(result), "generation")) != table->sort_generation) {
+        if (order) g_array_unref(order);
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Superseded by a newer sort");
+        return FALSE;
+    }
+    g_clear_pointer(&table->order, g_array_unref);
+    table->order = order;
+    g_list_model_items_changed(G_LIST_MODEL(table), 0, table->n_rows, table->n_rows);
+    return TRUE;
+}
@@ -0,0 +1,48 @@
+#ifndef MYS3_CSV_TABLE_H
+#define MYS3_CSV_TABLE_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+// One record of a CsvTable, parsed when a view binds it.
+#define CSV_TYPE_ROW (csv_row_get_type())
+G_DECLARE_FINAL_TYPE(CsvRow, csv_row, CSV, ROW, GObject)
+
+guint csv_row_get_n_fields(CsvRow *row);
+// Returns "" past the last field.
+const gchar *csv_row_get_field(CsvRow *row, guint column);
+
+// GListModel of CsvRow over a CSV file that is still arriving. Bytes are
+// spooled to a temporary file and indexed with a CsvIndex as they come in;
+// the model itself keeps only the sparse index and a few decoded blocks of
+// rows, so memory does not grow with the file.
+#define CSV_TYPE_TABLE (csv_table_get_type())
+G_DECLARE_FINAL_TYPE(CsvTable, csv_table, CSV, TABLE, GObject)
+
+// With `has_header`, the first record names the columns and is not a row.
+CsvTable *csv_table_new(gchar delimiter, gboolean has_header, GError **error);
+
+// Appends downloaded bytes. Called from one worker thread.
+gboolean csv_table_write(CsvTable *table, const gchar *data, gsize length, GError **error);
+void csv_table_write_finish(CsvTable *table);
+
+// Main thread: exposes the rows indexed since the last call with one
+// items-changed. Returns TRUE once every byte has been written and indexed.
+gboolean csv_table_update(CsvTable *table);
+
+// Known once the first record is indexed; 0 before.
+guint csv_table_get_n_columns(CsvTable *table);
+// Header name of a column, or NULL without a header.
+const gchar *csv_table_get_column_title(CsvTable *table, guint column);
+
+// Sorts all rows by one column on a worker thread, numerically when every
+// value in it is a number and byte-wise otherwise. Needs the whole file:
+// fails with G_IO_ERROR_PENDING before csv_table_update() returned TRUE.
+// column -1 restores file order.
+void csv_table_sort_async(CsvTable *table, gint column, gboolean descending, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+gboolean csv_table_sort_finish(CsvTable *table, GAsyncResult *result, GError **error);
+
+G_END_DECLS
+
+#endif // MYS3_CSV_TABLE_H
@@ -1,13 +1,46 @@
 #include "logging.h"
 #include <glib/gstdio.h>
 #include <glib.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
+// Log lines are formatted on the calling thread into a bounded lock-free
+// MPSC ring (Vyukov's sequence-numbered slots) and written to the file in
+// batches by a background thread. When the ring is full the line is dropped
+// and counted instead of blocking the caller. A slot is fixed-size, so a
+// line longer than LOG_SLOT_SIZE bytes, header included, is cut short and
+// ends in "...".
+#define LOG_RING_SLOTS 2048
+#define LOG_SLOT_SIZE 1024
+#define LOG_MAX_FILE_SIZE (10 * 1024 * 1024)
+#define LOG_MAX_FILES 5
+#define LOG_FLUSH_INTERVAL_US (100 * 1000)
+
+typedef struct {
+    atomic_size_t sequence;
+    gsize length;
+    gchar text[LOG_SLOT_SIZE];
+} LogSlot;
+
+static LogSlot *ring = NULL;
+static atomic_size_t enqueue_pos;
+static gsize dequeue_pos = 0;
+static atomic_size_t flushed_pos;
+static atomic_uint_fast64_t dropped_messages;
+
 static FILE* log_file = NULL;
-static LogLevel current_log_level = LOG_LEVEL_DISABLED;
+static gsize log_file_size = 0;
+static atomic_int current_log_level = LOG_LEVEL_DISABLED;
 static gchar* log_dir = NULL;
 
+static GThread *flush_thread = NULL;
+static GMutex flush_mutex;
+static GCond flush_cond;
+static gboolean flush_stop = FALSE;
+static gboolean flush_requested = FALSE;
+
 // Forward declaration
 static GLogWriterOutput log_writer(GLogLevelFlags log_level, const GLogField *fields, gsize n_fields, gpointer user_data);
 
@@ -49,11 +82,12 @@ static void cleanup_old_logs() {
     }
     g_dir_close(dir);
 
+    // Oldest first: the names sort in creation order (see open_log_file()).
     files = g_list_sort(files, (GCompareFunc)g_strcmp0);
 
     guint file_count = g_list_length(files);
-    if (file_count > 5) {
-        guint files_to_delete = file_count - 5;
+    if (file_count > LOG_MAX_FILES) {
+        guint files_to_delete = file_count - LOG_MAX_FILES;
         for (guint i = 0; i < files_to_delete; i++) {
             gchar *file_to_delete = (gchar*)g_list_nth_data(files, i);
             g_remove(file_to_delete);
@@ -63,48 +97,157 @@ static void cleanup_old_logs() {
     g_list_free_full(files, g_free);
 }
 
-void logging_init() {
-    log_dir = get_log_directory();
-    g_mkdir_with_parents(log_dir, 0755);
-
-    cleanup_old_logs();
-
+static FILE *open_log_file(void) {
+    static gchar last_stamp[64];
+    static guint rotation = 0;
     time_t t = time(NULL);
     struct tm *tm = localtime(&t);
-    gchar filename[256];
-    strftime(filename, sizeof(filename), "mys3-client-%Y-%m-%d-%H-%M-%S.log", tm);
+    gchar stamp[64];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d-%H-%M-%S", tm);
 
+    // cleanup_old_logs() deletes by name order, so names must sort in
+    // creation order: files opened within the same second are told apart
+    // by a zero-padded counter.
+    if (strcmp(stamp, last_stamp) != 0) {
+        g_strlcpy(last_stamp, stamp, sizeof(last_stamp));
+        rotation = 0;
+    }
+    gchar *filename = g_strdup_printf("mys3-client-%s-%03u.log", stamp, rotation);
+    rotation++;
     gchar* log_file_path = g_build_filename(log_dir, filename, NULL);
-
-    log_file = g_fopen(log_file_path, "a");
+    FILE *file = g_fopen(log_file_path, "a");
     g_free(log_file_path);
+    g_free(filename);
+    return file;
+}
+
+// Called on the flush thread only.
+static void write_to_log_file(const gchar *text, gsize length) {
+    if (!log_file) return;
+    fwrite(text, 1, length, log_file);
+    log_file_size += length;
+    if (log_file_size >= LOG_MAX_FILE_SIZE) {
+        FILE *next = open_log_file();
+        if (next) {
+            fclose(log_file);
+            log_file = next;
+            log_file_size = 0;
+            cleanup_old_logs();
+        }
+    }
+}
+
+// Drains every committed slot. Returns the number of lines written.
+static guint drain_ring(void) {
+    guint written = 0;
+    for (;;) {
+        LogSlot *slot = &ring[dequeue_pos % LOG_RING_SLOTS];
+        gsize sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (sequence != dequeue_pos + 1) break;
+
+        write_to_log_file(slot->text, slot->length);
+        atomic_store_explicit(&slot->sequence, dequeue_pos + LOG_RING_SLOTS, memory_order_release);
+        dequeue_pos++;
+        written++;
+    }
+
+    guint64 dropped = atomic_exchange_explicit(&dropped_messages, 0, memory_order_relaxed);
+    if (dropped > 0) {
+        gchar notice[128];
+        gint length = g_snprintf(notice, sizeof(notice), "[logging] %" G_GUINT64_FORMAT " messages dropped, log buffer was full\n", dropped);
+        write_to_log_file(notice, MIN((gsize)length, sizeof(notice) - 1));
+        written++;
+    }
+    return written;
+}
+
+static gpointer flush_thread_func(gpointer user_data) {
+    (void)user_data;
+    g_mutex_lock(&flush_mutex);
+    while (!flush_stop) {
+        if (!flush_requested) {
+            g_cond_wait_until(&flush_cond, &flush_mutex, g_get_monotonic_time() + LOG_FLUSH_INTERVAL_US);
+        }
+        flush_requested = FALSE;
+        g_mutex_unlock(&flush_mutex);
+
+        if (drain_ring() > 0 && log_file) {
+            fflush(log_file);
+        }
+        atomic_store_explicit(&flushed_pos, dequeue_pos, memory_order_release);
 
+        g_mutex_lock(&flush_mutex);
+    }
+    g_mutex_unlock(&flush_mutex);
+
+    drain_ring();
+    return NULL;
+}
+
+// Debug lines wait for the next periodic flush; warnings and errors wake the
+// flush thread so they reach the disk promptly.
+static void request_flush(void) {
+    g_mutex_lock(&flush_mutex);
+    flush_requested = TRUE;
+    g_cond_signal(&flush_cond);
+    g_mutex_unlock(&flush_mutex);
+}
+
+void logging_init() {
+    log_dir = get_log_directory();
+    g_mkdir_with_parents(log_dir, 0755);
+
+    cleanup_old_logs();
+
+    log_file = open_log_file();
     if (!log_file) {
         g_warning("Could not open log file.");
         g_free(log_dir);
         log_dir = NULL;
         return;
     }
+    log_file_size = 0;
+
+    ring = g_new(LogSlot, LOG_RING_SLOTS);
+    for (gsize i = 0; i < LOG_RING_SLOTS; i++) {
+        atomic_init(&ring[i].sequence, i);
+    }
+    atomic_init(&enqueue_pos, 0);
+    dequeue_pos = 0;
+    atomic_init(&flushed_pos, 0);
+    atomic_init(&dropped_messages, 0);
+
+    flush_stop = FALSE;
+    flush_thread = g_thread_new("log-flush", flush_thread_func, NULL);
 
     g_log_set_writer_func(log_writer, NULL, NULL);
 }
 
+// GLib only allows the writer function to be set once, so it stays
+// installed; once the flush thread is gone lines simply stay in the ring.
 void logging_cleanup() {
+    if (flush_thread) {
+        g_mutex_lock(&flush_mutex);
+        flush_stop = TRUE;
+        g_cond_signal(&flush_cond);
+        g_mutex_unlock(&flush_mutex);
+        g_thread_join(flush_thread);
+        flush_thread = NULL;
+    }
     if (log_file) {
         fclose(log_file);
         log_file = NULL;
     }
-    g_log_set_writer_func(g_log_writer_default, NULL, NULL);
     g_free(log_dir);
     log_dir = NULL;
 }
 
 void logging_set_level(LogLevel level) {
-    current_log_level = level;
+    atomic_store_explicit(&current_log_level, level, memory_order_relaxed);
 }
 
 LogLevel logging_get_level() {
-    return current_log_level;
+    return (LogLevel)atomic_load_explicit(&current_log_level, memory_order_relaxed);
 }
 
 static const gchar* level_to_string(GLogLevelFlags level) {
@@ -117,50 +260,122 @@ static const gchar* level_to_string(GLogLevelFlags level) {
     return "LOG";
 }
 
+// The ISO-8601 date and time are only reformatted when the second changes;
+// each thread keeps its own copy so no locking is needed.
+static const gchar *format_timestamp(gchar *out, gsize out_size) {
+    static _Thread_local gint64 cached_second = -1;
+    static _Thread_local gchar cached_date[32];
+    static _Thread_local gchar cached_offset[8];
+
+    gint64 now = g_get_real_time();
+    gint64 second = now / G_USEC_PER_SEC;
+    if (second != cached_second) {
+        GDateTime *dt = g_date_time_new_from_unix_local(second);
+        gchar *date = g_date_time_format(dt, "%Y-%m-%dT%H:%M:%S");
+        gchar *offset = g_date_time_format(dt, "%:z");
+        g_strlcpy(cached_date, date ? date : "", sizeof(cached_date));
+        g_strlcpy(cached_offset, offset ? offset : "", sizeof(cached_offset));
+        g_free(date);
+        g_free(offset);
+        g_date_time_unref(dt);
+        cached_second = second;
+    }
+    g_snprintf(out, out_size, "%s.%06d%s", cached_date, (gint)(now % G_USEC_PER_SEC), cached_offset);
+    return out;
+}
+
+// Returns the ring position of the line, or G_MAXSIZE if it was dropped.
+static gsize enqueue_line(const gchar *level, const gchar *code_file, const gchar *code_line, const gchar *code_func, const gchar *log_domain, const gchar *message) {
+    gsize pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    LogSlot *slot;
+    for (;;) {
+        slot = &ring[pos % LOG_RING_SLOTS];
+        gsize sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        gintptr diff = (gintptr)sequence - (gintptr)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&dropped_messages, 1, memory_order_relaxed);
+            return G_MAXSIZE;
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    gchar timestamp[64];
+    gint length = g_snprintf(slot->text, LOG_SLOT_SIZE, "[%s] [%s] [%s:%s:%s] %s: %s\n",
+                             format_timestamp(timestamp, sizeof(timestamp)),
+                             level,
+                             code_file ? code_file : "unknown",
+                             code_line ? code_line : "0",
+                             code_func ? code_func : "unknown",
+                             log_domain ? log_domain : "default",
+                             message ? message : "");
+    if (length >= LOG_SLOT_SIZE) {
+        // Truncated; keep the line terminated.
+        memcpy(slot->text + LOG_SLOT_SIZE - 5, "...\n", 5);
+        length = LOG_SLOT_SIZE - 1;
+    }
+    slot->length = (gsize)MAX(length, 0);
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    return pos;
+}
+
 static GLogWriterOutput log_writer(GLogLevelFlags log_level, const GLogField *fields, gsize n_fields, gpointer user_data) {
     (void)user_data;
-    if (current_log_level == LOG_LEVEL_DISABLED) {
+    LogLevel level = logging_get_level();
+    if (level == LOG_LEVEL_DISABLED) {
         return g_log_writer_default(log_level, fields, n_fields, user_data);
     }
 
     gboolean should_log = FALSE;
-    switch (current_log_level) {
+    switch (level) {
         case LOG_LEVEL_DEBUG: should_log = TRUE; break;
         case LOG_LEVEL_WARNING: should_log = (log_level & (G_LOG_LEVEL_WARNING | G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_ERROR)); break;
         case LOG_LEVEL_ERROR: should_log = (log_level & (G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_ERROR)); break;
         case LOG_LEVEL_DISABLED: break;
     }
 
-    if (should_log && log_file) {
+    if (should_log && ring) {
         const gchar *message = NULL;
         const gchar *log_domain = NULL;
         const gchar *code_file = NULL;
         const gchar *code_line = NULL;
         const gchar *code_func = NULL;
 
+        // All the keys we want start with 'M', 'G' or 'C', so most fields are
+        // rejected on the first byte.
         for (gsize i = 0; i < n_fields; i++) {
-            if (g_strcmp0(fields[i].key, "MESSAGE") == 0) message = fields[i].value;
-            else if (g_strcmp0(fields[i].key, "GLIB_DOMAIN") == 0) log_domain = fields[i].value;
-            else if (g_strcmp0(fields[i].key, "CODE_FILE") == 0) code_file = fields[i].value;
-            else if (g_strcmp0(fields[i].key, "CODE_LINE") == 0) code_line = fields[i].value;
-            else if (g_strcmp0(fields[i].key, "CODE_FUNC") == 0) code_func = fields[i].value;
+            const gchar *key = fields[i].key;
+            switch (key[0]) {
+                case 'M':
+                    if (strcmp(key, "MESSAGE") == 0) message = fields[i].value;
+                    break;
+                case 'G':
+                    if (strcmp(key, "GLIB_DOMAIN") == 0) log_domain = fields[i].value;
+                    break;
+                case 'C':
+                    if (strcmp(key, "CODE_FILE") == 0) code_file = fields[i].value;
+                    else if (strcmp(key, "CODE_LINE") == 0) code_line = fields[i].value;
+                    else if (strcmp(key, "CODE_FUNC") == 0) code_func = fields[i].value;
+                    break;
+            }
         }
 
-        GDateTime *now = g_date_time_new_now_local();
-        gchar *iso8601_time = g_date_time_format_iso8601(now);
-
-        fprintf(log_file, "[%s] [%s] [%s:%s:%s] %s: %s\n",
-                iso8601_time,
-                level_to_string(log_level),
-                code_file ? code_file : "unknown",
-                code_line ? code_line : "0",
-                code_func ? code_func : "unknown",
-                log_domain ? log_domain : "default",
-                message ? message : "");
-        fflush(log_file);
-
-        g_free(iso8601_time);
-        g_date_time_unref(now);
+        gsize pos = enqueue_line(level_to_string(log_level), code_file, code_line, code_func, log_domain, message);
+        if (log_level & (G_LOG_LEVEL_WARNING | G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_ERROR)) {
+            request_flush();
+        }
+        if ((log_level & (G_LOG_FLAG_FATAL | G_LOG_LEVEL_ERROR)) && pos != G_MAXSIZE) {
+            // The process is about to abort; give the flush thread up to a
+            // second to get this line onto the disk.
+            gint64 deadline = g_get_monotonic_time() + G_USEC_PER_SEC;
+            while (atomic_load_explicit(&flushed_pos, memory_order_acquire) <= pos && g_get_monotonic_time() < deadline) {
+                g_usleep(1000);
+            }
+        }
     }
 
     return g_log_writer_default(log_level, fields, n_fields, user_data);
@@ -8,16 +8,24 @@
 #include <glib/gstdio.h>
 #include "settings.h"
 #include "s3_client.h"
+#include "s3_object_list.h"
+#include "s3_key_index.h"
+#include "text_search.h"
+#include "s3_grep.h"
+#include "s3_du.h"
+#include "csv_table.h"
+#include "parquet_table.h"
+#include "session.h"
 #include "credential_storage.h"
+#include "cli.h"
+#include "s3_metrics.h"
+#include "trace.h"
 #include <gtksourceview/gtksource.h>
 
 // #############################################################################
 // # Type Definitions & Globals
 // #############################################################################
 
-static S3Object* s3_object_copy(const S3Object* src) { if (!src) return NULL; S3Object* dest = g_new0(S3Object, 1); dest->key = g_strdup(src->key); dest->size = src->size; dest->last_modified = src->last_modified; return dest; }
-static void s3_object_free(S3Object *obj) { if (obj) { g_free(obj->key); g_free(obj); } }
-G_DEFINE_BOXED_TYPE(S3Object, s3_object, (GBoxedCopyFunc)s3_object_copy, (GBoxedFreeFunc)s3_object_free);
 
 typedef struct _FolderItem {
     gchar *name;
@@ -26,21 +34,23 @@ typedef struct _FolderItem {
     GListStore *children;
 } FolderItem;
 
-typedef struct { GtkApplicationWindow *window; GtkListView *folder_tree_view; GtkTreeListModel *folder_tree_model; GtkListView *file_list_view; GListStore *file_list_store; GtkNotebook *notebook; GtkStatusbar *statusbar; GtkButton *find_button; GtkWidget *find_dialog; GtkEntry *find_entry; GtkEntry *replace_entry; MyS3Settings *settings; gchar *access_key; gchar *secret_key; } MainWindow;
-typedef struct { GtkDialog *dialog; GtkEntry *endpoint_entry; GtkEntry *region_entry; GtkEntry *bucket_entry; GtkEntry *access_key_entry; GtkPasswordEntry *secret_key_entry; GtkCheckButton *path_style_check; GtkCheckButton *ssl_check; GtkLabel *connection_status_label; GtkButton *save_button; GtkButton *cancel_button; GtkButton *test_connection_button; gboolean connection_test_successful; GtkCheckButton *logging_enabled_check; GtkDropDown *log_level_dropdown; GtkButton *open_log_folder_button;} SettingsDialog;
+typedef struct { GtkApplicationWindow *window; GtkListView *folder_tree_view; GtkTreeListModel *folder_tree_model; GtkListView *file_list_view; S3ObjectList *file_list; S3ObjectList *file_list_staging; GtkSearchEntry *file_filter_entry; GtkToggleButton *sort_buttons[3]; S3ObjectSortColumn sort_column; gboolean sort_descending; S3KeyIndex *key_index; GtkNotebook *notebook; GtkStatusbar *statusbar; GtkButton *find_button; GtkWidget *find_dialog; GtkEntry *find_entry; GtkEntry *replace_entry; GtkCheckButton *find_regex_check; GtkCheckButton *find_case_check; MyS3Settings *settings; gchar *access_key; gchar *secret_key; gchar *current_folder; guint listing_generation; GHashTable *folder_size_labels; GtkToggleButton *watch_button; guint watch_timeout_id; guint watch_interval_ms; gboolean watch_busy; } MainWindow;
+typedef struct { GtkDialog *dialog; GtkEntry *endpoint_entry; GtkEntry *region_entry; GtkEntry *bucket_entry; GtkEntry *access_key_entry; GtkPasswordEntry *secret_key_entry; GtkCheckButton *path_style_check; GtkCheckButton *ssl_check; GtkLabel *connection_status_label; GtkButton *save_button; GtkButton *cancel_button; GtkButton *test_connection_button; gboolean connection_test_successful; GtkCheckButton *logging_enabled_check; GtkDropDown *log_level_dropdown; GtkButton *open_log_folder_button; GtkDropDown *transfer_backend_dropdown; GtkEntry *dest_endpoint_entry; GtkEntry *dest_access_key_entry; GtkPasswordEntry *dest_secret_key_entry; GtkCheckButton *dest_ssl_check;} SettingsDialog;
 typedef struct { MainWindow *mw; gchar *current_bucket; } NewFolderDialogData;
-typedef struct { MainWindow *mw; S3Object *obj; GtkDialog *dialog; } DeleteConfirmationData;
-typedef struct { MainWindow *mw; S3Object *obj; GtkDialog *dialog; } RenameDialogData;
-typedef struct { MainWindow *mw; S3Object *obj; GtkFileChooserNative *dialog; } DownloadDialogData;
+typedef struct { MainWindow *mw; S3ObjectItem *obj; GtkDialog *dialog; } DeleteConfirmationData;
+typedef struct { MainWindow *mw; S3ObjectItem *obj; GtkDialog *dialog; } RenameDialogData;
+typedef struct { MainWindow *mw; S3ObjectItem *obj; GtkFileChooserNative *dialog; } DownloadDialogData;
 typedef struct { GtkDialog *dialog; GtkProgressBar *progress_bar; GtkLabel *label; gboolean cancelled; } DownloadProgressData;
-typedef struct { gchar *key; GtkSourceView *source_view; MainWindow *mw; gboolean unsaved; GtkWidget *tab_label; } EditorSaveData;
+typedef struct EditorLoad EditorLoad;
+typedef struct { gchar *key; guint64 size; GtkSourceView *source_view; MainWindow *mw; gboolean unsaved; GtkWidget *tab_label; GtkWidget *save_button; EditorLoad *load; } EditorSaveData;
 
 static void on_buffer_changed(GtkTextBuffer *buffer, gpointer user_data);
 static void open_settings_dialog(GtkWindow *parent);
 static void on_connect_button_clicked(GtkButton* button, gpointer user_data);
 static GListModel* folder_model_get_children(gpointer item, gpointer user_data);
 static void setup_folder_list_item_cb(GtkListItemFactory *factory, GtkListItem *list_item);
-static void bind_folder_list_item_cb(GtkListItemFactory *factory, GtkListItem *list_item);
+static void bind_folder_list_item_cb(GtkListItemFactory *factory, GtkListItem *list_item, gpointer user_data);
+static void unbind_folder_list_item_cb(GtkListItemFactory *factory, GtkListItem *list_item, gpointer user_data);
 static void on_settings_button_clicked(GtkButton* button, gpointer user_data);
 static void on_new_folder_button_clicked(GtkButton *b, gpointer user_data);
 static void on_new_folder_dialog_response(GtkButton *button, gpointer user_data);
@@ -56,9 +66,20 @@ static void refresh_current_folder(MainWindow *mw);
 static void app_activate (GApplication *application);
 static void on_editor_save_button_clicked(GtkButton *button, gpointer user_data);
 static void on_find_button_clicked(GtkButton *button, gpointer user_data);
+static void on_diagnostics_button_clicked(GtkButton *button, gpointer user_data);
+static void on_find_object_button_clicked(GtkButton *button, gpointer user_data);
+static void on_search_contents_button_clicked(GtkButton *button, gpointer user_data);
+static void on_folder_sizes_button_clicked(GtkButton *button, gpointer user_data);
+static void on_query_button_clicked(GtkButton *b, gpointer user_data);
+static void open_range_viewer(MainWindow *mw, const gchar *key, guint64 size, gboolean hex, gboolean tail);
+static void open_csv_viewer(MainWindow *mw, const gchar *key, gchar delimiter);
+static void open_parquet_viewer(MainWindow *mw, const gchar *key, guint64 size);
 static void on_close_button_clicked(GtkButton *button, gpointer user_data);
 static gboolean on_window_close_request(GtkApplicationWindow *window, gpointer user_data);
 static MainWindow* main_window_new(GtkApplication *app);
+static void restore_session(MainWindow *mw);
+static void save_session(MainWindow *mw);
+static void revalidate_session(MainWindow *mw);
 static gboolean on_files_dropped(GtkDropTarget *target, const GValue *value, double x, double y, gpointer user_data);
 static void show_confirmation_popup(GtkWindow *parent);
 static void show_error_dialog(GtkWindow *parent, const gchar *message);
@@ -86,14 +107,33 @@ static void on_save_settings_clicked(GtkButton *button, gpointer user_data) {
     s.use_path_style = gtk_check_button_get_active(sd->path_style_check);
     s.logging_enabled = gtk_check_button_get_active(sd->logging_enabled_check);
     s.log_level = gtk_drop_down_get_selected(sd->log_level_dropdown);
+    s.transfer_backend = (S3TransferBackend)gtk_drop_down_get_selected(sd->transfer_backend_dropdown);
+    MyS3Settings *current = settings_load();
+    s.crt_threshold_mb = current->crt_threshold_mb;
+    s.crt_target_gbps = current->crt_target_gbps;
+    s.prometheus_file = g_steal_pointer(&current->prometheus_file);
+    s.prometheus_interval_seconds = current->prometheus_interval_seconds;
+    settings_free(current);
+    s.dest_endpoint = g_strdup(gtk_editable_get_text(GTK_EDITABLE(sd->dest_endpoint_entry)));
+    s.dest_use_ssl = gtk_check_button_get_active(sd->dest_ssl_check);
     settings_save(&s);
 
+    // Left empty, the stored destination keys are kept.
+    const gchar *dest_access_key = gtk_editable_get_text(GTK_EDITABLE(sd->dest_access_key_entry));
+    const gchar *dest_secret_key = gtk_editable_get_text(GTK_EDITABLE(sd->dest_secret_key_entry));
+    if (*dest_access_key && *dest_secret_key && !credential_storage_save(SETTINGS_DESTINATION_CREDENTIALS, dest_access_key, dest_secret_key)) {
+        g_warning("Failed to store the destination credentials");
+    }
+
     logging_set_level(s.logging_enabled ? (LogLevel)s.log_level : LOG_LEVEL_DISABLED);
+    settings_apply_transfer_backend(&s);
 
     gtk_window_destroy(GTK_WINDOW(sd->dialog));
     g_free(s.endpoint);
     g_free(s.region);
     g_free(s.bucket);
+    g_free(s.prometheus_file);
+    g_free(s.dest_endpoint);
 }
 
 static void populate_settings_dialog(SettingsDialog *sd, MyS3Settings *s) {
@@ -104,6 +144,9 @@ static void populate_settings_dialog(SettingsDialog *sd, MyS3Settings *s) {
     gtk_check_button_set_active(sd->path_style_check, s->use_path_style);
     gtk_check_button_set_active(sd->logging_enabled_check, s->logging_enabled);
     gtk_drop_down_set_selected(sd->log_level_dropdown, s->log_level);
+    gtk_drop_down_set_selected(sd->transfer_backend_dropdown, s->transfer_backend);
+    gtk_editable_set_text(GTK_EDITABLE(sd->dest_endpoint_entry), s->dest_endpoint ? s->dest_endpoint : "");
+    gtk_check_button_set_active(sd->dest_ssl_check, s->dest_use_ssl);
 }
 
 static SettingsDialog* settings_dialog_new(GtkWindow *p) {
@@ -152,28 +195,53 @@ static SettingsDialog* settings_dialog_new(GtkWindow *p) {
     sd->path_style_check = GTK_CHECK_BUTTON(gtk_check_button_new_with_label(_("Use _Path Style")));
     gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sd->path_style_check), 0, 6, 3, 1);
 
+    const char *backends[] = {_("Classic"), _("CRT (high throughput)"), NULL};
+    sd->transfer_backend_dropdown = GTK_DROP_DOWN(gtk_drop_down_new_from_strings(backends));
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new_with_mnemonic(_("_Transfers:")), 0, 7, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sd->transfer_backend_dropdown), 1, 7, 2, 1);
+
     GtkWidget *separator = gtk_separator_new(GTK_ORIENTATION_HORIZONTAL);
     gtk_grid_attach(GTK_GRID(grid), separator, 0, 8, 3, 1);
 
+    sd->dest_endpoint_entry = GTK_ENTRY(gtk_entry_new());
+    gtk_entry_set_placeholder_text(sd->dest_endpoint_entry, _("Second connection for streaming copies"));
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new_with_mnemonic(_("_Destination:")), 0, 9, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sd->dest_endpoint_entry), 1, 9, 2, 1);
+
+    sd->dest_access_key_entry = GTK_ENTRY(gtk_entry_new());
+    gtk_entry_set_placeholder_text(sd->dest_access_key_entry, _("Unchanged"));
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new(_("Access Key:")), 0, 10, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sd->dest_access_key_entry), 1, 10, 2, 1);
+
+    sd->dest_secret_key_entry = GTK_PASSWORD_ENTRY(gtk_password_entry_new());
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new(_("Secret Key:")), 0, 11, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sd->dest_secret_key_entry), 1, 11, 2, 1);
+
+    sd->dest_ssl_check = GTK_CHECK_BUTTON(gtk_check_button_new_with_label(_("Use SSL for the destination")));
+    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sd->dest_ssl_check), 0, 12, 3, 1);
+
+    GtkWidget *logging_separator = gtk_separator_new(GTK_ORIENTATION_HORIZONTAL);
+    gtk_grid_attach(GTK_GRID(grid), logging_separator, 0, 13, 3, 1);
+
     GtkWidget *logging_label = gtk_label_new_with_mnemonic(_("_Logging"));
-    gtk_grid_attach(GTK_GRID(grid), logging_label, 0, 9, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), logging_label, 0, 14, 1, 1);
 
     sd->logging_enabled_check = GTK_CHECK_BUTTON(gtk_check_button_new_with_label(_("Enable Logging")));
-    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sd->logging_enabled_check), 1, 9, 2, 1);
+    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sd->logging_enabled_check), 1, 14, 2, 1);
 
     GtkWidget *log_level_label = gtk_label_new_with_mnemonic(_("Log _Level:"));
-    gtk_grid_attach(GTK_GRID(grid), log_level_label, 0, 10, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), log_level_label, 0, 15, 1, 1);
 
     const char *levels[] = {"Debug", "Warning", "Error", NULL};
     sd->log_level_dropdown = GTK_DROP_DOWN(gtk_drop_down_new_from_strings(levels));
-    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sd->log_level_dropdown), 1, 10, 2, 1);
+    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sd->log_level_dropdown), 1, 15, 2, 1);
 
     sd->open_log_folder_button = GTK_BUTTON(gtk_button_new_with_label(_("Open Log Folder")));
     g_signal_connect(sd->open_log_folder_button, "clicked", G_CALLBACK(on_open_log_folder_button_clicked), NULL);
-    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sd->open_log_folder_button), 1, 11, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sd->open_log_folder_button), 1, 16, 1, 1);
 
     GtkWidget *log_retention_label = gtk_label_new(_("Keeps the last 5 runs."));
-    gtk_grid_attach(GTK_GRID(grid), log_retention_label, 2, 11, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), log_retention_label, 2, 16, 1, 1);
 
     GtkWidget *button_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
     gtk_widget_set_halign(button_box, GTK_ALIGN_END);
@@ -201,35 +269,332 @@ static void open_settings_dialog(GtkWindow *parent) {
 // #############################################################################
 // # Main Window Implementation
 // #############################################################################
+typedef struct { gchar *endpoint; gchar *access_key; gchar *secret_key; gchar *bucket; gboolean use_ssl; } ObjectMetadataSource;
+
+static void object_metadata_source_free(gpointer data) {
+    ObjectMetadataSource *source = (ObjectMetadataSource*)data;
+    g_free(source->endpoint); g_free(source->access_key); g_free(source->secret_key); g_free(source->bucket);
+    g_free(source);
+}
+
+static S3ObjectMetadata *fetch_object_metadata(const gchar *key, gpointer user_data, GError **error) {
+    ObjectMetadataSource *source = (ObjectMetadataSource*)user_data;
+    return s3_client_head_object_metadata(source->endpoint, source->access_key, source->secret_key, source->bucket, key, source->use_ssl, error);
+}
+
+// Rows fetch their extended metadata from the bucket being shown, and only
+// once a view binds them.
+static void set_file_list_metadata_source(MainWindow *mw) {
+    if (mw->access_key && mw->current_folder) {
+        ObjectMetadataSource *source = g_new0(ObjectMetadataSource, 1);
+        source->endpoint = g_strdup(mw->settings->endpoint); source->access_key = g_strdup(mw->access_key); source->secret_key = g_strdup(mw->secret_key);
+        source->bucket = g_strdup(mw->current_folder); source->use_ssl = mw->settings->use_ssl;
+        s3_object_list_set_metadata_func(mw->file_list, fetch_object_metadata, source, object_metadata_source_free);
+    } else {
+        s3_object_list_set_metadata_func(mw->file_list, NULL, NULL, NULL);
+    }
+}
+
+static void show_file_list_staging(MainWindow *mw) {
+    gint64 span = trace_begin();
+    set_file_list_metadata_source(mw);
+    s3_object_list_take_contents(mw->file_list, mw->file_list_staging);
+    trace_end(span, "ui", "fill_file_list");
+    g_clear_object(&mw->file_list_staging);
+}
+
+static void on_file_list_staging_sorted(GObject *source, GAsyncResult *result, gpointer user_data) {
+    MainWindow *mw = (MainWindow*)user_data;
+    g_autoptr(GError) error = NULL;
+    // Superseded sorts and listings replaced by a newer one are dropped.
+    if (!s3_object_list_sort_finish(S3_OBJECT_LIST(source), result, &error)) return;
+    if (S3_OBJECT_LIST(source) != mw->file_list_staging) return;
+    show_file_list_staging(mw);
+}
+
+static void on_file_list_sorted(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)user_data;
+    g_autoptr(GError) error = NULL;
+    s3_object_list_sort_finish(S3_OBJECT_LIST(source), result, &error);
+}
+
+// Re-sorts and re-filters the file list off the main thread. A listing that
+// is still being sorted is re-sorted instead, and shown once that finishes.
+static void sort_file_list(MainWindow *mw) {
+    const gchar *filter = gtk_editable_get_text(GTK_EDITABLE(mw->file_filter_entry));
+    if (mw->file_list_staging) {
+        s3_object_list_sort_async(mw->file_list_staging, mw->sort_column, mw->sort_descending, filter, on_file_list_staging_sorted, mw);
+    } else {
+        s3_object_list_sort_async(mw->file_list, mw->sort_column, mw->sort_descending, filter, on_file_list_sorted, mw);
+    }
+}
+
+// Sorted or filtered views take added rows at the end, and rows whose size
+// or date changed may belong elsewhere, so those are sorted again.
+static void resort_after_changes(MainWindow *mw, const S3ObjectListChanges *changes) {
+    gboolean ordered = mw->sort_column != S3_OBJECT_SORT_NONE || *gtk_editable_get_text(GTK_EDITABLE(mw->file_filter_entry)) != '\0';
+    gboolean moved = changes->modified && (mw->sort_column == S3_OBJECT_SORT_SIZE || mw->sort_column == S3_OBJECT_SORT_MODIFIED);
+    if (ordered && (changes->added || moved)) sort_file_list(mw);
+}
+
+typedef struct { S3ObjectList *list; S3KeyIndex *index; } ListingSinks;
+
+static gboolean on_listing_page(const S3Object *objects, guint n_objects, gpointer user_data) {
+    ListingSinks *sinks = (ListingSinks*)user_data;
+    s3_object_list_append(sinks->list, objects, n_objects);
+    s3_key_index_add(sinks->index, objects, n_objects);
+    return TRUE;
+}
+
+// Replaces the file list with the listing of `folder` once it is sorted and
+// filtered, and the key index with `index`.
+static void install_listing(MainWindow *mw, const gchar *folder, S3ObjectList *staging, S3KeyIndex *index) {
+    if (folder != mw->current_folder) {
+        g_free(mw->current_folder);
+        mw->current_folder = g_strdup(folder);
+    }
+    g_clear_pointer(&mw->key_index, s3_key_index_unref);
+    mw->key_index = s3_key_index_ref(index);
+    g_set_object(&mw->file_list_staging, staging);
+    if (mw->sort_column == S3_OBJECT_SORT_NONE && *gtk_editable_get_text(GTK_EDITABLE(mw->file_filter_entry)) == '\0') {
+        show_file_list_staging(mw);
+    } else {
+        sort_file_list(mw);
+    }
+}
+
+// Brings the file list up to date with a newer listing of the folder it
+// already shows. Only the rows that changed are emitted, so the selection,
+// the scroll position and the bound rows of everything else stay put.
+// Returns FALSE, leaving everything alone, for a listing of another folder
+// or while the shown one is still waiting for its sort.
+static gboolean update_listing(MainWindow *mw, const gchar *folder, S3ObjectList *fresh, S3KeyIndex *index, S3ObjectListChanges *changes) {
+    if (mw->file_list_staging || !folder || g_strcmp0(folder, mw->current_folder) != 0) return FALSE;
+    gint64 span = trace_begin();
+    S3ObjectListChanges c;
+    set_file_list_metadata_source(mw);
+    if (s3_object_list_reconcile(mw->file_list, fresh, &c)) resort_after_changes(mw, &c);
+    g_clear_pointer(&mw->key_index, s3_key_index_unref);
+    mw->key_index = s3_key_index_ref(index);
+    if (changes) *changes = c;
+    trace_end(span, "ui", "update_file_list");
+    return TRUE;
+}
+
+// Lists `bucket` page by page into a staging model. For the folder already
+// shown it is reconciled with the file list; otherwise it replaces the file
+// list with a single items-changed once it is sorted and filtered. The same
+// pages feed the key index behind the find object window.
+static gboolean load_file_list(MainWindow *mw, const gchar *bucket, GError **error) {
+    g_autoptr(S3ObjectList) staging = s3_object_list_new();
+    g_autoptr(S3KeyIndex) index = s3_key_index_new();
+    ListingSinks sinks = { staging, index };
+    if (!s3_client_list_objects_paged(mw->settings->endpoint, mw->access_key, mw->secret_key, bucket, NULL, mw->settings->use_ssl, on_listing_page, &sinks, error)) {
+        return FALSE;
+    }
+    // Listings still being restored or revalidated in the background are
+    // stale from here on.
+    mw->listing_generation++;
+    if (!update_listing(mw, bucket, staging, index, NULL)) install_listing(mw, bucket, staging, index);
+    return TRUE;
+}
+
 static void refresh_current_folder(MainWindow *mw) {
+    // The tree's rows are GtkTreeListRows wrapping the FolderItems.
     GtkSingleSelection *selection = GTK_SINGLE_SELECTION(gtk_list_view_get_model(mw->folder_tree_view));
-    FolderItem *item = g_list_model_get_item(G_LIST_MODEL(selection), gtk_single_selection_get_selected(selection));
+    GtkTreeListRow *row = gtk_single_selection_get_selected_item(selection);
+    FolderItem *item = row ? gtk_tree_list_row_get_item(row) : NULL;
 
     if (item) {
         g_autofree gchar *status_msg = g_strdup_printf(_("Refreshing %s..."), item->full_path);
         gtk_statusbar_push(mw->statusbar, 0, status_msg);
 
         g_autoptr(GError) error = NULL;
-        GList *objects = s3_client_list_objects(mw->settings->endpoint, mw->access_key, mw->secret_key, item->full_path, NULL, mw->settings->use_ssl, &error);
-
-        if (error) {
+        if (!load_file_list(mw, item->full_path, &error)) {
             gchar *msg = g_strdup_printf(_("Failed to refresh: %s"), error->message);
             gtk_statusbar_push(mw->statusbar, 0, msg);
             g_free(msg);
         } else {
-            g_list_store_remove_all(mw->file_list_store);
-            for (GList *l = objects; l != NULL; l = l->next) {
-                g_list_store_append(mw->file_list_store, l->data);
-            }
             gtk_statusbar_push(mw->statusbar, 0, _("Folder refreshed."));
         }
-        s3_client_free_object_list(objects);
         g_object_unref(item);
     } else {
         gtk_statusbar_push(mw->statusbar, 0, _("Please select a folder to refresh."));
     }
 }
 
+// #############################################################################
+// # Watch Mode
+// #############################################################################
+// While the Watch button is down the current folder is listed again on a
+// worker every few seconds and only the rows that changed are applied. The
+// interval halves while changes keep coming and stretches while the folder
+// is quiet, so polling follows the rate of change.
+#define WATCH_MIN_INTERVAL_MS 2000
+#define WATCH_MAX_INTERVAL_MS 60000
+
+typedef struct {
+    MainWindow *mw;
+    guint generation;           // mw->listing_generation when started
+    gchar *folder;
+    gchar *endpoint, *access_key, *secret_key;
+    gboolean use_ssl;
+    S3ObjectList *list;
+    S3KeyIndex *index;
+    gint64 elapsed_us;          // Time the listing took
+    gboolean revalidation;      // A one-off after a local update, not a watch tick
+} WatchJob;
+
+static void watch_job_free(gpointer data) {
+    WatchJob *job = (WatchJob *)data;
+    g_free(job->folder);
+    g_free(job->endpoint); g_free(job->access_key); g_free(job->secret_key);
+    g_clear_object(&job->list);
+    g_clear_pointer(&job->index, s3_key_index_unref);
+    g_free(job);
+}
+
+static void watch_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    (void)source_object; (void)cancellable;
+    WatchJob *job = (WatchJob *)task_data;
+    gint64 start = g_get_monotonic_time();
+    job->list = s3_object_list_new();
+    job->index = s3_key_index_new();
+    ListingSinks sinks = { job->list, job->index };
+    GError *error = NULL;
+    if (!s3_client_list_objects_paged(job->endpoint, job->access_key, job->secret_key, job->folder, NULL, job->use_ssl, on_listing_page, &sinks, &error)) {
+        g_task_return_error(task, error);
+        return;
+    }
+    job->elapsed_us = g_get_monotonic_time() - start;
+    g_task_return_boolean(task, TRUE);
+}
+
+static void schedule_watch(MainWindow *mw);
+
+static void on_watch_job_done(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source; (void)user_data;
+    WatchJob *job = g_task_get_task_data(G_TASK(result));
+    MainWindow *mw = job->mw;
+    if (!job->revalidation) {
+        mw->watch_busy = FALSE;
+        if (!gtk_toggle_button_get_active(mw->watch_button)) return;
+    }
+
+    g_autoptr(GError) error = NULL;
+    gboolean changed = FALSE;
+    if (!g_task_propagate_boolean(G_TASK(result), &error)) {
+        g_autofree gchar *msg = g_strdup_printf(job->revalidation ? _("Failed to revalidate: %s") : _("Watch failed: %s"), error->message);
+        gtk_statusbar_push(mw->statusbar, 0, msg);
+    } else if (job->generation == mw->listing_generation && !mw->file_list_staging && g_strcmp0(job->folder, mw->current_folder) == 0) {
+        // Otherwise another listing was installed, a local update applied,
+        // or the shown one is being sorted, since the job started, and this
+        // one is dropped.
+        S3ObjectListChanges changes = { 0 };
+        update_listing(mw, job->folder, job->list, job->index, &changes);
+        mw->listing_generation++;
+        changed = changes.added || changes.removed || changes.modified;
+        if (changed) {
+            g_autofree gchar *msg = g_strdup_printf(job->revalidation ? _("Revalidated %s: %u added, %u removed, %u modified.") : _("Watching %s: %u added, %u removed, %u modified."),
+                                                    job->folder, changes.added, changes.removed, changes.modified);
+            gtk_statusbar_push(mw->statusbar, 0, msg);
+        }
+    }
+    if (job->revalidation) return;
+
+    if (error) {
+        mw->watch_interval_ms = MIN(mw->watch_interval_ms * 2, WATCH_MAX_INTERVAL_MS);
+    } else if (changed) {
+        mw->watch_interval_ms = MAX(mw->watch_interval_ms / 2, WATCH_MIN_INTERVAL_MS);
+    } else {
+        mw->watch_interval_ms = MIN(mw->watch_interval_ms * 3 / 2, WATCH_MAX_INTERVAL_MS);
+    }
+    // Never list more often than a listing takes, so a large folder is not
+    // listed back to back.
+    mw->watch_interval_ms = MAX(mw->watch_interval_ms, (guint)MIN(job->elapsed_us / 1000 * 2, WATCH_MAX_INTERVAL_MS));
+    schedule_watch(mw);
+}
+
+static void start_watch_job(MainWindow *mw, gboolean revalidation) {
+    WatchJob *job = g_new0(WatchJob, 1);
+    job->mw = mw;
+    job->generation = mw->listing_generation;
+    job->folder = g_strdup(mw->current_folder);
+    job->endpoint = g_strdup(mw->settings->endpoint);
+    job->access_key = g_strdup(mw->access_key);
+    job->secret_key = g_strdup(mw->secret_key);
+    job->use_ssl = mw->settings->use_ssl;
+    job->revalidation = revalidation;
+    if (!revalidation) mw->watch_busy = TRUE;
+    g_autoptr(GTask) task = g_task_new(NULL, NULL, on_watch_job_done, NULL);
+    g_task_set_task_data(task, job, watch_job_free);
+    g_task_run_in_thread(task, watch_thread);
+}
+
+static gboolean on_watch_timeout(gpointer user_data) {
+    MainWindow *mw = (MainWindow*)user_data;
+    mw->watch_timeout_id = 0;
+    if (!mw->current_folder || !mw->access_key || !mw->secret_key) {
+        schedule_watch(mw);
+        return G_SOURCE_REMOVE;
+    }
+    start_watch_job(mw, FALSE);
+    return G_SOURCE_REMOVE;
+}
+
+static void schedule_watch(MainWindow *mw) {
+    g_clear_handle_id(&mw->watch_timeout_id, g_source_remove);
+    mw->watch_timeout_id = g_timeout_add(mw->watch_interval_ms, on_watch_timeout, mw);
+}
+
+static void on_watch_button_toggled(GtkToggleButton *button, gpointer user_data) {
+    MainWindow *mw = (MainWindow*)user_data;
+    if (gtk_toggle_button_get_active(button)) {
+        mw->watch_interval_ms = WATCH_MIN_INTERVAL_MS;
+        // A tick still running schedules the next one when it ends.
+        if (!mw->watch_busy) schedule_watch(mw);
+        gtk_statusbar_push(mw->statusbar, 0, _("Watching the current folder for changes..."));
+    } else {
+        g_clear_handle_id(&mw->watch_timeout_id, g_source_remove);
+        gtk_statusbar_push(mw->statusbar, 0, _("Stopped watching."));
+    }
+}
+
+// #############################################################################
+// # Local Updates
+// #############################################################################
+// Our own successful changes are applied to the file list straight away, the
+// rows found through its key index, instead of listing the whole folder
+// again. A single listing in the background then catches anything else that
+// changed in the meantime.
+
+// Applies `objects` (added or replaced) and `removed_keys` to the file list
+// if `bucket` is the folder shown.
+static void apply_local_changes(MainWindow *mw, const gchar *bucket, const S3Object *objects, guint n_objects, const gchar * const *removed_keys) {
+    if (!bucket || g_strcmp0(bucket, mw->current_folder) != 0) return;
+    if (n_objects == 0 && (!removed_keys || !*removed_keys)) return;
+    // A listing waiting for its sort would overwrite the change.
+    if (mw->file_list_staging) {
+        refresh_current_folder(mw);
+        return;
+    }
+    S3ObjectListChanges changes;
+    if (s3_object_list_apply_changes(mw->file_list, objects, n_objects, removed_keys, &changes)) resort_after_changes(mw, &changes);
+    // Listings started before the change would undo it.
+    mw->listing_generation++;
+    if (mw->access_key && mw->secret_key) start_watch_job(mw, TRUE);
+}
+
+// The object as it is right after we wrote it; the revalidation brings in
+// the server's timestamp and ETag.
+static S3Object local_object(const gchar *key, guint64 size) {
+    S3Object object = { 0 };
+    object.key = (gchar *)key;
+    object.size = size;
+    object.last_modified = g_get_real_time() / 1000;
+    return object;
+}
+
 static void on_new_folder_dialog_response(GtkButton *button, gpointer user_data) {
     (void)button;
     NewFolderDialogData *data = (NewFolderDialogData*)user_data;
@@ -242,7 +607,8 @@ static void on_new_folder_dialog_response(GtkButton *button, gpointer user_data)
         g_autofree gchar *folder_path = g_str_has_suffix(folder_name, "/") ? g_strdup(folder_name) : g_strdup_printf("%s/", folder_name);
         g_autoptr(GError) error = NULL;
         if (s3_client_create_folder(data->mw->settings->endpoint, data->mw->access_key, data->mw->secret_key, data->current_bucket, folder_path, data->mw->settings->use_ssl, &error)) {
-            refresh_current_folder(data->mw);
+            S3Object folder = local_object(folder_path, 0);
+            apply_local_changes(data->mw, data->current_bucket, &folder, 1, NULL);
         } else {
              g_warning("Failed to create folder: %s", error->message);
         }
@@ -301,16 +667,53 @@ static void on_new_folder_button_clicked(GtkButton *button, gpointer user_data)
 
 static void setup_folder_list_item_cb(GtkListItemFactory *factory, GtkListItem *list_item) {
     (void)factory;
+    GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
     GtkWidget *label = gtk_label_new(NULL);
-    gtk_list_item_set_child(list_item, label);
+    gtk_widget_set_hexpand(label, TRUE); gtk_label_set_xalign(GTK_LABEL(label), 0);
+    GtkWidget *objects = gtk_label_new(NULL);
+    gtk_label_set_width_chars(GTK_LABEL(objects), 8); gtk_label_set_xalign(GTK_LABEL(objects), 1); gtk_widget_add_css_class(objects, "dim-label");
+    GtkWidget *size = gtk_label_new(NULL);
+    gtk_label_set_width_chars(GTK_LABEL(size), 9); gtk_label_set_xalign(GTK_LABEL(size), 1); gtk_widget_add_css_class(size, "dim-label");
+    gtk_box_append(GTK_BOX(row), label); gtk_box_append(GTK_BOX(row), objects); gtk_box_append(GTK_BOX(row), size);
+    gtk_list_item_set_child(list_item, row);
 }
 
-static void bind_folder_list_item_cb(GtkListItemFactory *factory, GtkListItem *list_item) {
+// Fills the object count and size columns of a bucket row from the folder
+// size cache, or blanks them.
+static void set_folder_size_labels(MainWindow *mw, GtkWidget *objects, const gchar *bucket) {
+    GtkWidget *size = gtk_widget_get_next_sibling(objects);
+    g_autoptr(S3DuResult) du = bucket ? s3_du_cache_lookup(mw->settings->endpoint, bucket, "") : NULL;
+    g_autofree gchar *objects_text = du ? g_strdup_printf("%" G_GUINT64_FORMAT, du->objects) : NULL;
+    g_autofree gchar *size_text = du ? g_format_size(du->bytes) : NULL;
+    g_autoptr(GDateTime) dt = du ? g_date_time_new_from_unix_local(du->computed_at) : NULL;
+    g_autofree gchar *computed = dt ? g_date_time_format(dt, _("Computed %Y-%m-%d %H:%M")) : NULL;
+    gtk_label_set_text(GTK_LABEL(objects), objects_text ? objects_text : "");
+    gtk_label_set_text(GTK_LABEL(size), size_text ? size_text : "");
+    gtk_widget_set_tooltip_text(size, computed);
+}
+
+static void bind_folder_list_item_cb(GtkListItemFactory *factory, GtkListItem *list_item, gpointer user_data) {
     (void)factory;
-    GtkWidget *label = gtk_list_item_get_child(list_item);
-    FolderItem *item = g_list_model_get_item(gtk_list_view_get_model(GTK_LIST_VIEW(gtk_widget_get_parent(GTK_WIDGET(list_item)))), gtk_list_item_get_position(list_item));
+    MainWindow *mw = (MainWindow*)user_data;
+    GtkWidget *label = gtk_widget_get_first_child(gtk_list_item_get_child(list_item));
+    GtkWidget *objects = gtk_widget_get_next_sibling(label);
+    FolderItem *item = gtk_tree_list_row_get_item(GTK_TREE_LIST_ROW(gtk_list_item_get_item(list_item)));
     if (item) {
         gtk_label_set_text(GTK_LABEL(label), item->name);
+        set_folder_size_labels(mw, objects, item->is_bucket ? item->full_path : NULL);
+        if (item->is_bucket) g_hash_table_replace(mw->folder_size_labels, g_strdup(item->full_path), objects);
+        g_object_unref(item);
+    }
+}
+
+static void unbind_folder_list_item_cb(GtkListItemFactory *factory, GtkListItem *list_item, gpointer user_data) {
+    (void)factory;
+    MainWindow *mw = (MainWindow*)user_data;
+    GtkWidget *objects = gtk_widget_get_next_sibling(gtk_widget_get_first_child(gtk_list_item_get_child(list_item)));
+    FolderItem *item = gtk_tree_list_row_get_item(GTK_TREE_LIST_ROW(gtk_list_item_get_item(list_item)));
+    if (item) {
+        // The row may already have been bound to the same bucket elsewhere.
+        if (g_hash_table_lookup(mw->folder_size_labels, item->full_path) == objects) g_hash_table_remove(mw->folder_size_labels, item->full_path);
         g_object_unref(item);
     }
 }
@@ -335,32 +738,9 @@ static void on_connect_button_clicked(GtkButton* button, gpointer user_data) {
         return;
     }
 
+    // The tree keeps what it shows until the new bucket list arrives.
     gtk_statusbar_push(mw->statusbar, 0, _("Listing buckets..."));
-
-    g_autoptr(GError) error = NULL;
-    GList *buckets = s3_client_list_buckets(mw->settings->endpoint, mw->access_key, mw->secret_key, mw->settings->use_ssl, &error);
-
-    if (error) {
-        gchar *msg = g_strdup_printf(_("Failed to list buckets: %s"), error->message);
-        gtk_statusbar_push(mw->statusbar, 0, msg);
-        g_free(msg);
-        s3_client_free_bucket_list(buckets);
-        return;
-    }
-
-    GListStore *folder_store = G_LIST_STORE(gtk_tree_list_model_get_model(mw->folder_tree_model));
-    g_list_store_remove_all(folder_store);
-    for (GList *l = buckets; l != NULL; l = l->next) {
-        S3Bucket *bucket = (S3Bucket*)l->data;
-        FolderItem *item = g_new0(FolderItem, 1);
-        item->name = g_strdup(bucket->name);
-        item->is_bucket = TRUE;
-        item->full_path = g_strdup(bucket->name);
-        item->children = g_list_store_new(G_TYPE_POINTER);
-        g_list_store_append(folder_store, item);
-    }
-    s3_client_free_bucket_list(buckets);
-    gtk_statusbar_push(mw->statusbar, 0, _("Ready."));
+    revalidate_session(mw);
 }
 
 static void on_folder_tree_row_activated(GtkTreeView *tree_view, GtkTreePath *path, GtkTreeViewColumn *column, gpointer user_data) {
@@ -377,20 +757,13 @@ static void on_folder_tree_row_activated(GtkTreeView *tree_view, GtkTreePath *pa
         gtk_statusbar_push(mw->statusbar, 0, status_msg);
 
         g_autoptr(GError) error = NULL;
-        GList *objects = s3_client_list_objects(mw->settings->endpoint, mw->access_key, mw->secret_key, full_path, NULL, mw->settings->use_ssl, &error);
-
-        if (error) {
+        if (!load_file_list(mw, full_path, &error)) {
             gchar *msg = g_strdup_printf(_("Failed: %s"), error->message);
             gtk_statusbar_push(mw->statusbar, 0, msg);
             g_free(msg);
         } else {
-            g_list_store_remove_all(mw->file_list_store);
-            for (GList *l = objects; l != NULL; l = l->next) {
-                g_list_store_append(mw->file_list_store, l->data);
-            }
             gtk_statusbar_push(mw->statusbar, 0, _("Objects loaded."));
         }
-        s3_client_free_object_list(objects);
         g_free(full_path);
     }
 }
@@ -398,6 +771,7 @@ static void on_folder_tree_row_activated(GtkTreeView *tree_view, GtkTreePath *pa
 static void on_settings_button_clicked(GtkButton* b, gpointer d) { open_settings_dialog(GTK_WINDOW(((MainWindow*)d)->window)); }
 
 static void do_language_change(MainWindow *mw) {
+    save_session(mw);
     gtk_window_destroy(GTK_WINDOW(mw->window));
     app_activate(G_APPLICATION(gtk_window_get_application(GTK_WINDOW(mw->window))));
 }
@@ -458,8 +832,92 @@ static void on_language_changed(GSimpleAction *action, GVariant *parameter, gpoi
     }
 }
 
-static void setup_list_item_cb(GtkListItemFactory *f, GtkListItem *i) { (void)f; gtk_list_item_set_child(i, gtk_label_new(NULL)); }
-static void bind_list_item_cb(GtkListItemFactory *f, GtkListItem *i) { (void)f; GtkWidget *l = gtk_list_item_get_child(i); S3Object *o = gtk_list_item_get_item(i); if (o) { gtk_label_set_text(GTK_LABEL(l), o->key); } }
+static void setup_list_item_cb(GtkListItemFactory *f, GtkListItem *i) {
+    (void)f;
+    GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+    GtkWidget *name = gtk_label_new(NULL);
+    gtk_widget_set_hexpand(name, TRUE); gtk_label_set_xalign(GTK_LABEL(name), 0); gtk_label_set_ellipsize(GTK_LABEL(name), PANGO_ELLIPSIZE_MIDDLE);
+    GtkWidget *type = gtk_label_new(NULL);
+    gtk_label_set_width_chars(GTK_LABEL(type), 16); gtk_label_set_max_width_chars(GTK_LABEL(type), 16); gtk_label_set_xalign(GTK_LABEL(type), 0); gtk_label_set_ellipsize(GTK_LABEL(type), PANGO_ELLIPSIZE_END);
+    gtk_widget_add_css_class(type, "dim-label");
+    GtkWidget *size = gtk_label_new(NULL);
+    gtk_label_set_width_chars(GTK_LABEL(size), 10); gtk_label_set_xalign(GTK_LABEL(size), 1);
+    GtkWidget *modified = gtk_label_new(NULL);
+    gtk_label_set_width_chars(GTK_LABEL(modified), 16); gtk_label_set_xalign(GTK_LABEL(modified), 0);
+    gtk_box_append(GTK_BOX(row), name); gtk_box_append(GTK_BOX(row), type); gtk_box_append(GTK_BOX(row), size); gtk_box_append(GTK_BOX(row), modified);
+    gtk_list_item_set_child(i, row);
+}
+// Shows the content type in the row and the rest of the HEAD metadata in its
+// tooltip, or nothing while it is still unknown.
+static void show_file_item_metadata(GtkWidget *row, S3ObjectItem *o) {
+    const S3ObjectMetadata *md = s3_object_item_get_metadata(o);
+    GtkWidget *type = gtk_widget_get_next_sibling(gtk_widget_get_first_child(row));
+    gtk_label_set_text(GTK_LABEL(type), md && md->content_type ? md->content_type : "");
+    if (!md) { gtk_widget_set_tooltip_text(row, NULL); return; }
+    GString *tip = g_string_new(NULL);
+    g_string_append_printf(tip, _("Content type: %s\nStorage class: %s\nETag: %s"), md->content_type ? md->content_type : "", md->storage_class ? md->storage_class : "", md->etag ? md->etag : "");
+    for (guint k = 0; md->user_metadata && md->user_metadata[k] && md->user_metadata[k + 1]; k += 2) g_string_append_printf(tip, "\n%s: %s", md->user_metadata[k], md->user_metadata[k + 1]);
+    gtk_widget_set_tooltip_text(row, tip->str);
+    g_string_free(tip, TRUE);
+}
+static void on_file_item_metadata_notify(GObject *o, GParamSpec *pspec, gpointer user_data) { (void)pspec; show_file_item_metadata(GTK_WIDGET(user_data), S3_OBJECT_ITEM(o)); }
+static void bind_list_item_cb(GtkListItemFactory *f, GtkListItem *i, gpointer user_data) {
+    (void)f;
+    MainWindow *mw = (MainWindow*)user_data;
+    S3ObjectItem *o = gtk_list_item_get_item(i);
+    if (!o) return;
+    const S3Object *obj = s3_object_item_get_object(o);
+    GtkWidget *row = gtk_list_item_get_child(i);
+    GtkWidget *name = gtk_widget_get_first_child(row);
+    GtkWidget *size = gtk_widget_get_next_sibling(gtk_widget_get_next_sibling(name));
+    GtkWidget *modified = gtk_widget_get_next_sibling(size);
+    gtk_label_set_text(GTK_LABEL(name), obj->key);
+    g_autofree gchar *size_text = g_format_size(obj->size);
+    gtk_label_set_text(GTK_LABEL(size), size_text);
+    g_autoptr(GDateTime) dt = g_date_time_new_from_unix_local(obj->last_modified / 1000);
+    g_autofree gchar *date_text = dt ? g_date_time_format(dt, "%Y-%m-%d %H:%M") : NULL;
+    gtk_label_set_text(GTK_LABEL(modified), date_text ? date_text : "");
+    // Metadata costs a HEAD per object, so it is only asked for rows that
+    // are on screen; the request is withdrawn if the row scrolls away first.
+    show_file_item_metadata(row, o);
+    g_signal_connect(o, "notify::metadata", G_CALLBACK(on_file_item_metadata_notify), row);
+    s3_object_list_request_metadata(mw->file_list, o);
+}
+static void unbind_list_item_cb(GtkListItemFactory *f, GtkListItem *i, gpointer user_data) {
+    (void)f;
+    MainWindow *mw = (MainWindow*)user_data;
+    S3ObjectItem *o = gtk_list_item_get_item(i);
+    if (!o) return;
+    g_signal_handlers_disconnect_by_func(o, on_file_item_metadata_notify, gtk_list_item_get_child(i));
+    s3_object_list_cancel_metadata(mw->file_list, o);
+}
+
+static void update_sort_buttons(MainWindow *mw) {
+    const gchar *labels[] = { _("Name"), _("Size"), _("Modified") };
+    for (guint k = 0; k < G_N_ELEMENTS(mw->sort_buttons); k++) {
+        gboolean active = mw->sort_column == (S3ObjectSortColumn)(S3_OBJECT_SORT_NAME + k);
+        g_autofree gchar *label = active ? g_strdup_printf("%s %s", labels[k], mw->sort_descending ? "▼" : "▲") : g_strdup(labels[k]);
+        gtk_button_set_label(GTK_BUTTON(mw->sort_buttons[k]), label);
+    }
+}
+
+// Clicking a column sorts ascending, then descending, then back to server order.
+static void on_sort_button_clicked(GtkButton *button, gpointer user_data) {
+    MainWindow *mw = (MainWindow*)user_data;
+    S3ObjectSortColumn column = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(button), "sort-column"));
+    if (column != mw->sort_column) {
+        mw->sort_column = column; mw->sort_descending = FALSE;
+    } else if (!mw->sort_descending) {
+        mw->sort_descending = TRUE;
+    } else {
+        mw->sort_column = S3_OBJECT_SORT_NONE; mw->sort_descending = FALSE;
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), FALSE);
+    }
+    update_sort_buttons(mw);
+    sort_file_list(mw);
+}
+
+static void on_file_filter_changed(GtkSearchEntry *entry, gpointer user_data) { (void)entry; sort_file_list((MainWindow*)user_data); }
 static void on_upload_response(GtkDialog *dialog, gint response_id, gpointer user_data) {
     (void)response_id; (void)user_data;
     gtk_window_destroy(GTK_WINDOW(dialog));
@@ -487,7 +945,7 @@ static void on_rename_button_clicked(GtkButton *b, gpointer user_data) {
     guint position = gtk_single_selection_get_selected(selection);
 
     if (position != GTK_INVALID_LIST_POSITION) {
-        S3Object *obj = g_list_model_get_item(G_LIST_MODEL(selection_model), position);
+        S3ObjectItem *obj = g_list_model_get_item(G_LIST_MODEL(selection_model), position);
         if (obj) {
             GtkWidget *dialog = gtk_window_new();
             gtk_window_set_transient_for(GTK_WINDOW(dialog), GTK_WINDOW(mw->window));
@@ -503,7 +961,7 @@ static void on_rename_button_clicked(GtkButton *b, gpointer user_data) {
             gtk_window_set_child(GTK_WINDOW(dialog), content_area);
 
             GtkWidget *entry = gtk_entry_new();
-            gtk_editable_set_text(GTK_EDITABLE(entry), obj->key);
+            gtk_editable_set_text(GTK_EDITABLE(entry), s3_object_item_get_key(obj));
             gtk_box_append(GTK_BOX(content_area), entry);
 
             GtkWidget *button_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
@@ -535,14 +993,16 @@ static void on_rename_dialog_response(GtkButton *button, gpointer user_data) {
     GtkEntry *entry = GTK_ENTRY(gtk_widget_get_first_child(content_area));
     const gchar *new_key = gtk_editable_get_text(GTK_EDITABLE(entry));
 
-    if (new_key && *new_key && g_strcmp0(new_key, data->obj->key) != 0) {
+    if (new_key && *new_key && g_strcmp0(new_key, s3_object_item_get_key(data->obj)) != 0) {
         g_autoptr(GError) error = NULL;
-        if (s3_client_rename_object(data->mw->settings->endpoint, data->mw->access_key, data->mw->secret_key, data->mw->settings->bucket, data->obj->key, new_key, data->mw->settings->use_ssl, &error)) {
-            g_autofree gchar *msg = g_strdup_printf(_("'%s' renamed to '%s' successfully."), data->obj->key, new_key);
+        if (s3_client_rename_object(data->mw->settings->endpoint, data->mw->access_key, data->mw->secret_key, data->mw->settings->bucket, s3_object_item_get_key(data->obj), new_key, data->mw->settings->use_ssl, &error)) {
+            g_autofree gchar *msg = g_strdup_printf(_("'%s' renamed to '%s' successfully."), s3_object_item_get_key(data->obj), new_key);
             gtk_statusbar_push(data->mw->statusbar, 0, msg);
-            refresh_current_folder(data->mw);
+            S3Object renamed = local_object(new_key, s3_object_item_get_object(data->obj)->size);
+            const gchar *removed[] = { s3_object_item_get_key(data->obj), NULL };
+            apply_local_changes(data->mw, data->mw->settings->bucket, &renamed, 1, removed);
         } else {
-            g_autofree gchar *msg = g_strdup_printf(_("Failed to rename '%s': %s"), data->obj->key, error->message);
+            g_autofree gchar *msg = g_strdup_printf(_("Failed to rename '%s': %s"), s3_object_item_get_key(data->obj), error->message);
             gtk_statusbar_push(data->mw->statusbar, 0, msg);
         }
     }
@@ -560,9 +1020,9 @@ static void on_delete_button_clicked(GtkButton *b, gpointer user_data) {
     guint position = gtk_single_selection_get_selected(selection);
 
     if (position != GTK_INVALID_LIST_POSITION) {
-        S3Object *obj = g_list_model_get_item(G_LIST_MODEL(selection_model), position);
+        S3ObjectItem *obj = g_list_model_get_item(G_LIST_MODEL(selection_model), position);
         if (obj) {
-            g_autofree gchar *message = g_strdup_printf(_("Are you sure you want to delete '%s'?"), obj->key);
+            g_autofree gchar *message = g_strdup_printf(_("Are you sure you want to delete '%s'?"), s3_object_item_get_key(obj));
             GtkWidget *dialog = gtk_window_new();
             gtk_window_set_transient_for(GTK_WINDOW(dialog), GTK_WINDOW(mw->window));
             gtk_window_set_modal(GTK_WINDOW(dialog), TRUE);
@@ -606,12 +1066,13 @@ static void on_delete_confirm_response(GtkButton *button, gpointer user_data) {
     GtkWidget *dialog = gtk_widget_get_ancestor(GTK_WIDGET(button), GTK_TYPE_WINDOW);
 
     g_autoptr(GError) error = NULL;
-    if (s3_client_delete_object(data->mw->settings->endpoint, data->mw->access_key, data->mw->secret_key, data->mw->settings->bucket, data->obj->key, data->mw->settings->use_ssl, &error)) {
-        g_autofree gchar *msg = g_strdup_printf(_("'%s' deleted successfully."), data->obj->key);
+    if (s3_client_delete_object(data->mw->settings->endpoint, data->mw->access_key, data->mw->secret_key, data->mw->settings->bucket, s3_object_item_get_key(data->obj), data->mw->settings->use_ssl, &error)) {
+        g_autofree gchar *msg = g_strdup_printf(_("'%s' deleted successfully."), s3_object_item_get_key(data->obj));
         gtk_statusbar_push(data->mw->statusbar, 0, msg);
-        refresh_current_folder(data->mw);
+        const gchar *removed[] = { s3_object_item_get_key(data->obj), NULL };
+        apply_local_changes(data->mw, data->mw->settings->bucket, NULL, 0, removed);
     } else {
-        g_autofree gchar *msg = g_strdup_printf(_("Failed to delete '%s': %s"), data->obj->key, error->message);
+        g_autofree gchar *msg = g_strdup_printf(_("Failed to delete '%s': %s"), s3_object_item_get_key(data->obj), error->message);
         gtk_statusbar_push(data->mw->statusbar, 0, msg);
     }
 
@@ -628,7 +1089,7 @@ static void on_download_button_clicked(GtkButton *b, gpointer user_data) {
     guint position = gtk_single_selection_get_selected(selection);
 
     if (position != GTK_INVALID_LIST_POSITION) {
-        S3Object *obj = g_list_model_get_item(G_LIST_MODEL(selection_model), position);
+        S3ObjectItem *obj = g_list_model_get_item(G_LIST_MODEL(selection_model), position);
         if (obj) {
             GtkFileChooserNative *native = gtk_file_chooser_native_new(_("Save File"),
                                                                        GTK_WINDOW(mw->window),
@@ -636,7 +1097,7 @@ static void on_download_button_clicked(GtkButton *b, gpointer user_data) {
                                                                        _("_Save"),
                                                                        _("_Cancel"));
             gtk_native_dialog_set_modal(GTK_NATIVE_DIALOG(native), TRUE);
-            gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(native), obj->key);
+            gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(native), s3_object_item_get_key(obj));
 
             DownloadDialogData *data = g_new0(DownloadDialogData, 1);
             data->mw = mw;
@@ -671,15 +1132,209 @@ static void set_sourceview_language_from_filename(GtkSourceBuffer *buffer, const
 }
 
 
-static void open_editor_tab(MainWindow *mw, const gchar *key, const gchar *content) {
+// Objects at least this large open in large-file mode: no highlighting, no
+// line numbers and no undo history.
+#define EDITOR_LARGE_FILE_BYTES (8 * 1024 * 1024)
+// Larger objects open in the read-only range viewer instead. Loads stream in
+// idle-time chunks and large-file mode drops highlighting and undo, so text
+// objects of a few hundred MiB stay editable.
+#define EDITOR_MAX_FILE_BYTES (256 * 1024 * 1024)
+// Main loop time spent inserting text per idle iteration.
+#define EDITOR_LOAD_SLICE_US 8000
+// The download pauses while this much text waits to be inserted.
+#define EDITOR_LOAD_MAX_QUEUED (32 * 1024 * 1024)
+
+// Streams an object into an editor tab. The download thread queues UTF-8
+// chunks; an idle handler inserts them a time slice at a time so the window
+// stays responsive.
+struct EditorLoad {
+    gint ref_count;
+    gint cancelled;         // Set when the tab is closed mid-load
+    gint idle_scheduled;
+    gint queued_bytes;
+    GAsyncQueue *chunks;    // GBytes of valid UTF-8, then editor_load_end
+    GString *carry;         // Incomplete UTF-8 sequence left by the last chunk (download thread only)
+    GMutex lock;            // Guards total_bytes and the wait on `drained`
+    GCond drained;          // Signalled as queued text is inserted, and on cancel
+    guint64 total_bytes;
+    guint64 inserted_bytes;
+    gint last_percent;
+    gboolean large;
+    GError *error;          // Set by the download thread before it queues editor_load_end
+    EditorSaveData *editor; // NULL once the tab is closed
+    gchar *endpoint, *access_key, *secret_key, *bucket, *key;
+    gboolean use_ssl;
+};
+
+static const gchar editor_load_end = 0;
+
+static void editor_load_item_free(gpointer item) { if (item != &editor_load_end) g_bytes_unref(item); }
+
+static EditorLoad *editor_load_ref(EditorLoad *load) { g_atomic_int_inc(&load->ref_count); return load; }
+
+static void editor_load_unref(EditorLoad *load) {
+    if (!g_atomic_int_dec_and_test(&load->ref_count)) return;
+    g_async_queue_unref(load->chunks);
+    g_mutex_clear(&load->lock);
+    g_cond_clear(&load->drained);
+    g_string_free(load->carry, TRUE);
+    g_clear_error(&load->error);
+    g_free(load->endpoint); g_free(load->access_key); g_free(load->secret_key); g_free(load->bucket); g_free(load->key);
+    g_free(load);
+}
+
+// Length of the prefix of `data` that does not end in a truncated UTF-8 sequence.
+static gsize utf8_complete_length(const gchar *data, gsize length) {
+    for (gsize back = 1; back <= 4 && back <= length; back++) {
+        guchar c = data[length - back];
+        if ((c & 0xC0) == 0x80) continue;
+        gsize needed = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 1;
+        return needed > back ? length - back : length;
+    }
+    return length;
+}
+
+static gboolean editor_load_idle(gpointer user_data);
+
+static void editor_load_push(EditorLoad *load, gpointer item) {
+    if (item != &editor_load_end) g_atomic_int_add(&load->queued_bytes, (gint)g_bytes_get_size(item));
+    g_async_queue_push(load->chunks, item);
+    if (g_atomic_int_compare_and_exchange(&load->idle_scheduled, FALSE, TRUE)) {
+        g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, editor_load_idle, editor_load_ref(load), (GDestroyNotify)editor_load_unref);
+    }
+}
+
+static void editor_load_push_text(EditorLoad *load, const gchar *text, gsize length) {
+    gchar *valid = g_utf8_make_valid(text, length);
+    editor_load_push(load, g_bytes_new_take(valid, strlen(valid)));
+}
+
+static gboolean on_editor_load_chunk(const gchar *data, gsize length, guint64 total_bytes, gpointer user_data) {
+    EditorLoad *load = (EditorLoad*)user_data;
+    g_mutex_lock(&load->lock);
+    load->total_bytes = total_bytes;
+    g_mutex_unlock(&load->lock);
+    g_string_append_len(load->carry, data, length);
+    gsize complete = utf8_complete_length(load->carry->str, load->carry->len);
+    if (complete > 0) {
+        // Back off while the main loop still has plenty to insert.
+        g_mutex_lock(&load->lock);
+        while (g_atomic_int_get(&load->queued_bytes) > EDITOR_LOAD_MAX_QUEUED && !g_atomic_int_get(&load->cancelled)) g_cond_wait(&load->drained, &load->lock);
+        g_mutex_unlock(&load->lock);
+        editor_load_push_text(load, load->carry->str, complete);
+        g_string_erase(load->carry, 0, complete);
+    }
+    return !g_atomic_int_get(&load->cancelled);
+}
+
+static gpointer editor_load_thread(gpointer user_data) {
+    EditorLoad *load = (EditorLoad*)user_data;
+    GError *error = NULL;
+    s3_client_download_object_streaming(load->endpoint, load->access_key, load->secret_key, load->bucket, load->key, load->use_ssl, on_editor_load_chunk, load, &error);
+    if (load->carry->len > 0) editor_load_push_text(load, load->carry->str, load->carry->len);
+    load->error = error;
+    editor_load_push(load, (gpointer)&editor_load_end);
+    editor_load_unref(load);
+    return NULL;
+}
+
+static void editor_load_set_status(EditorLoad *load, const gchar *message) {
+    GtkStatusbar *statusbar = load->editor->mw->statusbar;
+    guint context = gtk_statusbar_get_context_id(statusbar, "editor-load");
+    gtk_statusbar_remove_all(statusbar, context);
+    gtk_statusbar_push(statusbar, context, message);
+}
+
+static void editor_load_finish(EditorLoad *load) {
+    EditorSaveData *editor = load->editor;
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor->source_view));
+    if (!load->large) gtk_text_buffer_end_irreversible_action(buffer);
+    GtkTextIter start;
+    gtk_text_buffer_get_start_iter(buffer, &start);
+    gtk_text_buffer_place_cursor(buffer, &start);
+    if (load->error) {
+        g_autofree gchar *msg = g_strdup_printf(_("Failed to load %s: %s"), load->key, load->error->message);
+        editor_load_set_status(load, msg);
+    } else {
+        gtk_text_view_set_editable(GTK_TEXT_VIEW(editor->source_view), TRUE);
+        gtk_widget_set_sensitive(editor->save_button, TRUE);
+        g_signal_connect(buffer, "changed", G_CALLBACK(on_buffer_changed), editor);
+        g_autofree gchar *msg = g_strdup_printf(load->large ? _("Loaded %s (large file mode).") : _("Loaded %s."), load->key);
+        editor_load_set_status(load, msg);
+    }
+    editor->load = NULL;
+    editor_load_unref(load);
+}
+
+static gboolean editor_load_idle(gpointer user_data) {
+    EditorLoad *load = (EditorLoad*)user_data;
+    gint64 span = trace_begin();
+    gint64 deadline = g_get_monotonic_time() + EDITOR_LOAD_SLICE_US;
+    gboolean keep_going = G_SOURCE_CONTINUE;
+    while (g_get_monotonic_time() < deadline) {
+        gpointer item = g_async_queue_try_pop(load->chunks);
+        if (!item) {
+            g_atomic_int_set(&load->idle_scheduled, FALSE);
+            // A chunk queued between the pop and the reset did not schedule us.
+            if (g_async_queue_length(load->chunks) > 0 && g_atomic_int_compare_and_exchange(&load->idle_scheduled, FALSE, TRUE)) continue;
+            keep_going = G_SOURCE_REMOVE;
+            break;
+        }
+        if (item == &editor_load_end) {
+            if (load->editor) editor_load_finish(load);
+            keep_going = G_SOURCE_REMOVE;
+            break;
+        }
+        gsize size = 0;
+        const gchar *text = g_bytes_get_data(item, &size);
+        if (load->editor) {
+            GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(load->editor->source_view));
+            GtkTextIter end;
+            gtk_text_buffer_get_end_iter(buffer, &end);
+            gtk_text_buffer_insert(buffer, &end, text, size);
+        }
+        g_mutex_lock(&load->lock);
+        g_atomic_int_add(&load->queued_bytes, -(gint)size);
+        g_cond_signal(&load->drained);
+        g_mutex_unlock(&load->lock);
+        load->inserted_bytes += size;
+        g_bytes_unref(item);
+    }
+    g_mutex_lock(&load->lock);
+    guint64 total_bytes = load->total_bytes;
+    g_mutex_unlock(&load->lock);
+    if (keep_going == G_SOURCE_CONTINUE && load->editor && total_bytes > 0) {
+        gint percent = (gint)MIN(100, load->inserted_bytes * 100 / total_bytes);
+        if (percent != load->last_percent) {
+            load->last_percent = percent;
+            g_autofree gchar *msg = g_strdup_printf(_("Loading %s... %d%%"), load->key, percent);
+            editor_load_set_status(load, msg);
+        }
+    }
+    trace_end(span, "ui", "editor_load_slice");
+    return keep_going;
+}
+
+// Opens `key` in a new editor tab and streams its content in. `size` picks
+// large-file mode before the first byte arrives.
+static void open_editor_tab(MainWindow *mw, const gchar *key, guint64 size) {
+    gint64 span = trace_begin();
+    gboolean large = size >= EDITOR_LARGE_FILE_BYTES;
     GtkSourceBuffer *buffer = gtk_source_buffer_new(NULL);
-    set_sourceview_language_from_filename(buffer, key);
-    gtk_text_buffer_set_text(GTK_TEXT_BUFFER(buffer), content, -1);
+    if (large) {
+        gtk_source_buffer_set_highlight_syntax(buffer, FALSE);
+        gtk_source_buffer_set_highlight_matching_brackets(buffer, FALSE);
+        gtk_text_buffer_set_enable_undo(GTK_TEXT_BUFFER(buffer), FALSE);
+    } else {
+        set_sourceview_language_from_filename(buffer, key);
+        gtk_text_buffer_begin_irreversible_action(GTK_TEXT_BUFFER(buffer));
+    }
 
     GtkWidget *source_view = gtk_source_view_new_with_buffer(buffer);
-    gtk_source_view_set_show_line_numbers(GTK_SOURCE_VIEW(source_view), TRUE);
+    gtk_source_view_set_show_line_numbers(GTK_SOURCE_VIEW(source_view), !large);
     gtk_source_view_set_auto_indent(GTK_SOURCE_VIEW(source_view), TRUE);
     gtk_source_view_set_smart_home_end(GTK_SOURCE_VIEW(source_view), GTK_SOURCE_SMART_HOME_END_ALWAYS);
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(source_view), FALSE);
 
     GtkWidget *scrolled_window = gtk_scrolled_window_new();
     gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled_window), source_view);
@@ -688,6 +1343,8 @@ static void open_editor_tab(MainWindow *mw, const gchar *key, const gchar *conte
 
     GtkWidget *tab_label = gtk_label_new(g_path_get_basename(key));
     GtkWidget *save_button = gtk_button_new_with_label(_("Save"));
+    // Saving a partly loaded buffer would overwrite the object with it.
+    gtk_widget_set_sensitive(save_button, FALSE);
     GtkWidget *close_button = gtk_button_new_from_icon_name("window-close-symbolic");
     GtkWidget *tab_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
     gtk_box_append(GTK_BOX(tab_box), tab_label);
@@ -698,16 +1355,40 @@ static void open_editor_tab(MainWindow *mw, const gchar *key, const gchar *conte
 
     EditorSaveData *save_data = g_new0(EditorSaveData, 1);
     save_data->key = g_strdup(key);
+    save_data->size = size;
     save_data->source_view = GTK_SOURCE_VIEW(source_view);
     save_data->mw = mw;
     save_data->unsaved = FALSE;
     save_data->tab_label = tab_label;
+    save_data->save_button = save_button;
     g_signal_connect(save_button, "clicked", G_CALLBACK(on_editor_save_button_clicked), save_data);
-    g_signal_connect(buffer, "changed", G_CALLBACK(on_buffer_changed), save_data);
     g_signal_connect(close_button, "clicked", G_CALLBACK(on_close_button_clicked), save_data);
 
+    // One reference for the tab, one for the download thread.
+    EditorLoad *load = g_new0(EditorLoad, 1);
+    load->ref_count = 2;
+    load->chunks = g_async_queue_new_full(editor_load_item_free);
+    load->carry = g_string_new(NULL);
+    g_mutex_init(&load->lock);
+    g_cond_init(&load->drained);
+    load->total_bytes = size;
+    load->last_percent = -1;
+    load->large = large;
+    load->editor = save_data;
+    load->endpoint = g_strdup(mw->settings->endpoint);
+    load->access_key = g_strdup(mw->access_key);
+    load->secret_key = g_strdup(mw->secret_key);
+    load->bucket = g_strdup(mw->settings->bucket);
+    load->key = g_strdup(key);
+    load->use_ssl = mw->settings->use_ssl;
+    save_data->load = load;
+    g_thread_unref(g_thread_new("editor-load", editor_load_thread, load));
+
+    g_object_set_data(G_OBJECT(scrolled_window), "editor", save_data);
     gtk_notebook_append_page(GTK_NOTEBOOK(mw->notebook), scrolled_window, tab_box);
     gtk_notebook_set_current_page(GTK_NOTEBOOK(mw->notebook), gtk_notebook_get_n_pages(GTK_NOTEBOOK(mw->notebook)) - 1);
+    g_object_unref(buffer);
+    trace_end_detail(span, "ui", "open_editor_tab", key);
 }
 
 static void on_buffer_changed(GtkTextBuffer *buffer, gpointer user_data) {
@@ -726,6 +1407,9 @@ static void on_buffer_changed(GtkTextBuffer *buffer, gpointer user_data) {
 static void on_editor_save_button_clicked(GtkButton *button, gpointer user_data) {
     (void)button;
     EditorSaveData *data = (EditorSaveData *)user_data;
+    // Only a fully loaded tab is saved: the button stays insensitive while
+    // the object streams in and after the load failed.
+    if (!gtk_widget_get_sensitive(data->save_button)) return;
 
     GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(data->source_view));
     GtkTextIter start, end;
@@ -747,6 +1431,8 @@ static void on_editor_save_button_clicked(GtkButton *button, gpointer user_data)
             current_label[strlen(current_label) - 1] = '\0';
             gtk_label_set_text(GTK_LABEL(data->tab_label), current_label);
             g_free(current_label);
+            S3Object saved = local_object(data->key, strlen(content));
+            apply_local_changes(data->mw, data->mw->settings->bucket, &saved, 1, NULL);
         } else {
             g_autofree gchar *msg = g_strdup_printf(_("Failed to save '%s': %s"), data->key, error->message);
             gtk_statusbar_push(data->mw->statusbar, 0, msg);
@@ -759,6 +1445,15 @@ static void on_editor_save_button_clicked(GtkButton *button, gpointer user_data)
 }
 
 static void close_tab(EditorSaveData *data) {
+    if (data->load) {
+        // The download thread and idle handler drop their references once they notice.
+        g_mutex_lock(&data->load->lock);
+        g_atomic_int_set(&data->load->cancelled, TRUE);
+        g_cond_broadcast(&data->load->drained);
+        g_mutex_unlock(&data->load->lock);
+        data->load->editor = NULL;
+        editor_load_unref(data->load);
+    }
     GtkWidget *scrolled_window = gtk_widget_get_parent(GTK_WIDGET(data->source_view));
     gint page_num = gtk_notebook_page_num(data->mw->notebook, scrolled_window);
 
@@ -827,73 +1522,227 @@ static void on_close_button_clicked(GtkButton *button, gpointer user_data) {
     }
 }
 
+// Matches highlighted after a search; the status line still counts them all.
+#define EDITOR_MAX_HIGHLIGHTS 100000
+
+// The editor view of the current notebook page, or NULL on the Files tab.
+static GtkSourceView *current_source_view(MainWindow *mw) {
+    GtkWidget *page = gtk_notebook_get_nth_page(mw->notebook, gtk_notebook_get_current_page(mw->notebook));
+    if (!GTK_IS_SCROLLED_WINDOW(page)) return NULL;
+    GtkWidget *child = gtk_scrolled_window_get_child(GTK_SCROLLED_WINDOW(page));
+    return GTK_SOURCE_IS_VIEW(child) ? GTK_SOURCE_VIEW(child) : NULL;
+}
+
+static void set_find_status(MainWindow *mw, const gchar *message) {
+    guint context = gtk_statusbar_get_context_id(mw->statusbar, "find");
+    gtk_statusbar_remove_all(mw->statusbar, context);
+    gtk_statusbar_push(mw->statusbar, context, message);
+}
+
+// Compiles the find dialog's pattern and options. Reports a bad regex on the
+// status bar and returns NULL.
+static TextMatcher *find_dialog_matcher(MainWindow *mw) {
+    const gchar *pattern = gtk_editable_get_text(GTK_EDITABLE(mw->find_entry));
+    if (!pattern || !*pattern) return NULL;
+    TextSearchFlags flags = 0;
+    if (gtk_check_button_get_active(mw->find_regex_check)) flags |= TEXT_SEARCH_REGEX;
+    if (!gtk_check_button_get_active(mw->find_case_check)) flags |= TEXT_SEARCH_CASE_INSENSITIVE;
+    g_autoptr(GError) error = NULL;
+    TextMatcher *matcher = text_matcher_new(pattern, flags, &error);
+    if (!matcher) set_find_status(mw, error->message);
+    return matcher;
+}
+
+static GtkTextTag *search_match_tag(GtkTextBuffer *buffer) {
+    GtkTextTag *tag = gtk_text_tag_table_lookup(gtk_text_buffer_get_tag_table(buffer), "search-match");
+    return tag ? tag : gtk_text_buffer_create_tag(buffer, "search-match", "background", "#fce94f", NULL);
+}
+
 static void on_find_next_button_clicked(GtkButton *button, gpointer user_data) {
     (void)button;
     MainWindow *mw = (MainWindow *)user_data;
-    const gchar *search_text = gtk_editable_get_text(GTK_EDITABLE(mw->find_entry));
-    if (!search_text || !*search_text) {
-        return;
-    }
+    GtkSourceView *source_view = current_source_view(mw);
+    if (!source_view) return;
+    g_autoptr(TextMatcher) matcher = find_dialog_matcher(mw);
+    if (!matcher) return;
 
-    gint page_num = gtk_notebook_get_current_page(mw->notebook);
-    GtkWidget *scrolled_window = gtk_notebook_get_nth_page(mw->notebook, page_num);
-    GtkSourceView *source_view = GTK_SOURCE_VIEW(gtk_scrolled_window_get_child(GTK_SCROLLED_WINDOW(scrolled_window)));
+    // Search from the end of the selection so repeated clicks move on.
     GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(source_view));
-    GtkTextIter iter;
-    gtk_text_buffer_get_iter_at_mark(buffer, &iter, gtk_text_buffer_get_insert(buffer));
-
-    GtkTextIter start, end;
-    if (gtk_text_iter_forward_search(&iter, search_text, 0, &start, &end, NULL)) {
-        gtk_text_buffer_select_range(buffer, &start, &end);
-        gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(source_view), &start, 0.0, TRUE, 0.5, 0.5);
+    GtkTextIter from, end;
+    gtk_text_buffer_get_selection_bounds(buffer, NULL, &from);
+    gtk_text_buffer_get_end_iter(buffer, &end);
+    g_autofree gchar *text = gtk_text_buffer_get_text(buffer, &from, &end, TRUE);
+    gsize length = strlen(text);
+    TextMatch match;
+    gboolean found = text_matcher_find(matcher, text, length, 0, &match);
+    if (found && match.end == 0 && length > 0) found = text_matcher_find(matcher, text, length, g_utf8_next_char(text) - text, &match);
+    if (!found) {
+        set_find_status(mw, _("No more matches."));
+        return;
     }
+
+    gint base = gtk_text_iter_get_offset(&from);
+    gint start_offset = base + (gint)g_utf8_strlen(text, match.start);
+    gint end_offset = start_offset + (gint)g_utf8_strlen(text + match.start, match.end - match.start);
+    GtkTextIter start;
+    gtk_text_buffer_get_iter_at_offset(buffer, &start, start_offset);
+    gtk_text_buffer_get_iter_at_offset(buffer, &end, end_offset);
+    gtk_text_buffer_select_range(buffer, &start, &end);
+    gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(source_view), &start, 0.0, TRUE, 0.5, 0.5);
 }
 
 static void on_replace_button_clicked(GtkButton *button, gpointer user_data) {
     (void)button;
     MainWindow *mw = (MainWindow *)user_data;
-    const gchar *search_text = gtk_editable_get_text(GTK_EDITABLE(mw->find_entry));
-    const gchar *replace_text = gtk_editable_get_text(GTK_EDITABLE(mw->replace_entry));
-    if (!search_text || !*search_text) {
-        return;
-    }
+    GtkSourceView *source_view = current_source_view(mw);
+    if (!source_view || !gtk_text_view_get_editable(GTK_TEXT_VIEW(source_view))) return;
+    g_autoptr(TextMatcher) matcher = find_dialog_matcher(mw);
+    if (!matcher) return;
 
-    gint page_num = gtk_notebook_get_current_page(mw->notebook);
-    GtkWidget *scrolled_window = gtk_notebook_get_nth_page(mw->notebook, page_num);
-    GtkSourceView *source_view = GTK_SOURCE_VIEW(gtk_scrolled_window_get_child(GTK_SCROLLED_WINDOW(scrolled_window)));
+    // Only a selection that is exactly one match is replaced.
     GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(source_view));
     GtkTextIter start, end;
     if (gtk_text_buffer_get_selection_bounds(buffer, &start, &end)) {
-        gtk_text_buffer_delete(buffer, &start, &end);
-        gtk_text_buffer_insert(buffer, &start, replace_text, -1);
+        g_autofree gchar *selected = gtk_text_buffer_get_text(buffer, &start, &end, TRUE);
+        gsize length = strlen(selected);
+        TextMatch match;
+        if (text_matcher_find(matcher, selected, length, 0, &match) && match.start == 0 && match.end == length) {
+            g_autoptr(GError) error = NULL;
+            const gchar *replace_text = gtk_editable_get_text(GTK_EDITABLE(mw->replace_entry));
+            g_autofree gchar *replaced = text_matcher_replace_all(matcher, selected, length, replace_text, NULL, NULL, NULL, &error);
+            if (!replaced) {
+                set_find_status(mw, error->message);
+                return;
+            }
+            gtk_text_buffer_begin_user_action(buffer);
+            gtk_text_buffer_delete(buffer, &start, &end);
+            gtk_text_buffer_insert(buffer, &start, replaced, -1);
+            gtk_text_buffer_end_user_action(buffer);
+        }
     }
 
     on_find_next_button_clicked(NULL, mw);
 }
 
-static void on_replace_all_button_clicked(GtkButton *button, gpointer user_data) {
-    (void)button;
-    MainWindow *mw = (MainWindow *)user_data;
-    const gchar *search_text = gtk_editable_get_text(GTK_EDITABLE(mw->find_entry));
-    const gchar *replace_text = gtk_editable_get_text(GTK_EDITABLE(mw->replace_entry));
-    if (!search_text || !*search_text) {
-        return;
+// Find All and Replace All scan a snapshot of the buffer on a worker thread.
+// The editor is read-only until the result is applied.
+typedef struct {
+    MainWindow *mw;
+    GtkTextView *view;
+    TextMatcher *matcher;
+    gchar *text;
+    gchar *replacement;     // NULL for Find All
+    gchar *result;
+    GArray *matches;        // Character offsets into the result, or into the text for Find All
+    guint n_matches;
+    gint64 elapsed_us;
+} EditorSearchJob;
+
+static void editor_search_job_free(EditorSearchJob *job) {
+    g_object_unref(job->view);
+    text_matcher_free(job->matcher);
+    g_free(job->text);
+    g_free(job->replacement);
+    g_free(job->result);
+    if (job->matches) g_array_unref(job->matches);
+    g_free(job);
+}
+
+static void editor_search_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    (void)source; (void)cancellable;
+    EditorSearchJob *job = (EditorSearchJob *)task_data;
+    gint64 start = g_get_monotonic_time();
+    gsize length = strlen(job->text);
+    const gchar *highlighted_text = job->text;
+    if (job->replacement) {
+        GError *error = NULL;
+        job->matches = g_array_new(FALSE, FALSE, sizeof(TextMatch));
+        job->result = text_matcher_replace_all(job->matcher, job->text, length, job->replacement, job->matches, &job->n_matches, NULL, &error);
+        if (!job->result) {
+            g_task_return_error(task, error);
+            return;
+        }
+        highlighted_text = job->result;
+    } else {
+        job->matches = text_matcher_find_all(job->matcher, job->text, length, 0);
+        job->n_matches = job->matches->len;
     }
+    if (job->matches->len > EDITOR_MAX_HIGHLIGHTS) g_array_set_size(job->matches, EDITOR_MAX_HIGHLIGHTS);
+    text_matches_to_char_offsets(highlighted_text, job->matches);
+    job->elapsed_us = g_get_monotonic_time() - start;
+    g_task_return_boolean(task, TRUE);
+}
 
-    gint page_num = gtk_notebook_get_current_page(mw->notebook);
-    GtkWidget *scrolled_window = gtk_notebook_get_nth_page(mw->notebook, page_num);
-    GtkSourceView *source_view = GTK_SOURCE_VIEW(gtk_scrolled_window_get_child(GTK_SCROLLED_WINDOW(scrolled_window)));
-    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(source_view));
-    GtkTextIter iter, start, end;
-    gtk_text_buffer_get_start_iter(buffer, &iter);
+static void on_editor_search_done(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source; (void)user_data;
+    gint64 span = trace_begin();
+    EditorSearchJob *job = g_task_get_task_data(G_TASK(result));
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(job->view);
+    if (job->replacement) gtk_text_view_set_editable(job->view, TRUE);
+    g_autoptr(GError) error = NULL;
+    if (!g_task_propagate_boolean(G_TASK(result), &error)) {
+        set_find_status(job->mw, error->message);
+        return;
+    }
 
-    while (gtk_text_iter_forward_search(&iter, search_text, 0, &start, &end, NULL)) {
+    GtkTextIter start, end;
+    if (job->replacement && job->n_matches > 0) {
+        // One user action, so one undo step and one pair of change signals.
+        gtk_text_buffer_begin_user_action(buffer);
+        gtk_text_buffer_get_bounds(buffer, &start, &end);
         gtk_text_buffer_delete(buffer, &start, &end);
-        gtk_text_buffer_insert(buffer, &start, replace_text, -1);
-        gtk_text_buffer_get_iter_at_offset(buffer, &iter, gtk_text_iter_get_offset(&start) + strlen(replace_text));
+        gtk_text_buffer_insert(buffer, &start, job->result, -1);
+        gtk_text_buffer_end_user_action(buffer);
+    }
+    GtkTextTag *tag = search_match_tag(buffer);
+    gtk_text_buffer_get_bounds(buffer, &start, &end);
+    gtk_text_buffer_remove_tag(buffer, tag, &start, &end);
+    for (guint i = 0; i < job->matches->len; i++) {
+        TextMatch *match = &g_array_index(job->matches, TextMatch, i);
+        gtk_text_buffer_get_iter_at_offset(buffer, &start, (gint)match->start);
+        gtk_text_buffer_get_iter_at_offset(buffer, &end, (gint)match->end);
+        gtk_text_buffer_apply_tag(buffer, tag, &start, &end);
+    }
+
+    g_autofree gchar *msg = job->replacement
+        ? g_strdup_printf(_("Replaced %u matches (%.1f ms)."), job->n_matches, job->elapsed_us / 1000.0)
+        : g_strdup_printf(_("%u matches (%.1f ms)."), job->n_matches, job->elapsed_us / 1000.0);
+    set_find_status(job->mw, msg);
+    trace_end(span, "ui", job->replacement ? "editor_replace_all" : "editor_find_all");
+}
+
+static void start_editor_search(MainWindow *mw, gboolean replace) {
+    GtkSourceView *source_view = current_source_view(mw);
+    if (!source_view) return;
+    if (replace && !gtk_text_view_get_editable(GTK_TEXT_VIEW(source_view))) {
+        set_find_status(mw, _("The document is still loading."));
+        return;
     }
+    TextMatcher *matcher = find_dialog_matcher(mw);
+    if (!matcher) return;
+
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(source_view));
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds(buffer, &start, &end);
+    EditorSearchJob *job = g_new0(EditorSearchJob, 1);
+    job->mw = mw;
+    job->view = GTK_TEXT_VIEW(g_object_ref(source_view));
+    job->matcher = matcher;
+    job->text = gtk_text_buffer_get_text(buffer, &start, &end, TRUE);
+    if (replace) {
+        job->replacement = g_strdup(gtk_editable_get_text(GTK_EDITABLE(mw->replace_entry)));
+        gtk_text_view_set_editable(GTK_TEXT_VIEW(source_view), FALSE);
+    }
+    set_find_status(mw, _("Searching..."));
+    GTask *task = g_task_new(NULL, NULL, on_editor_search_done, NULL);
+    g_task_set_task_data(task, job, (GDestroyNotify)editor_search_job_free);
+    g_task_run_in_thread(task, editor_search_thread);
+    g_object_unref(task);
 }
 
+static void on_find_all_button_clicked(GtkButton *button, gpointer user_data) { (void)button; start_editor_search((MainWindow *)user_data, FALSE); }
+static void on_replace_all_button_clicked(GtkButton *button, gpointer user_data) { (void)button; start_editor_search((MainWindow *)user_data, TRUE); }
+
 static void on_find_button_clicked(GtkButton *button, gpointer user_data) {
     (void)button;
     MainWindow *mw = (MainWindow *)user_data;
@@ -926,6 +1775,10 @@ static void on_find_button_clicked(GtkButton *button, gpointer user_data) {
     GtkWidget *find_next_button = gtk_button_new_with_label(_("Find Next"));
     GtkWidget *replace_button = gtk_button_new_with_label(_("Replace"));
     GtkWidget *replace_all_button = gtk_button_new_with_label(_("Replace All"));
+    GtkWidget *find_all_button = gtk_button_new_with_label(_("Find All"));
+    mw->find_regex_check = GTK_CHECK_BUTTON(gtk_check_button_new_with_label(_("Regular expression")));
+    mw->find_case_check = GTK_CHECK_BUTTON(gtk_check_button_new_with_label(_("Match case")));
+    gtk_check_button_set_active(mw->find_case_check, TRUE);
 
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new(_("Find:")), 0, 0, 1, 1);
     gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(mw->find_entry), 1, 0, 1, 1);
@@ -933,26 +1786,37 @@ static void on_find_button_clicked(GtkButton *button, gpointer user_data) {
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new(_("Replace with:")), 0, 1, 1, 1);
     gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(mw->replace_entry), 1, 1, 1, 1);
     gtk_grid_attach(GTK_GRID(grid), replace_button, 2, 1, 1, 1);
-    gtk_grid_attach(GTK_GRID(grid), replace_all_button, 2, 2, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(mw->find_regex_check), 1, 2, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(mw->find_case_check), 1, 3, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), find_all_button, 2, 2, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), replace_all_button, 2, 3, 1, 1);
 
     g_signal_connect(find_next_button, "clicked", G_CALLBACK(on_find_next_button_clicked), mw);
     g_signal_connect(replace_button, "clicked", G_CALLBACK(on_replace_button_clicked), mw);
     g_signal_connect(replace_all_button, "clicked", G_CALLBACK(on_replace_all_button_clicked), mw);
+    g_signal_connect(find_all_button, "clicked", G_CALLBACK(on_find_all_button_clicked), mw);
 
     gtk_window_present(GTK_WINDOW(dialog));
 }
 
 static void on_file_list_row_activated(GtkListView *list_view, guint position, gpointer user_data) {
     (void)list_view; MainWindow *mw = (MainWindow*)user_data;
-    S3Object *obj = g_list_model_get_item(G_LIST_MODEL(gtk_list_view_get_model(list_view)), position);
+    S3ObjectItem *obj = g_list_model_get_item(G_LIST_MODEL(gtk_list_view_get_model(list_view)), position);
     if (!obj) return;
-    if (g_str_has_suffix(obj->key, ".txt") || g_str_has_suffix(obj->key, ".log") || g_str_has_suffix(obj->key, ".json") || g_str_has_suffix(obj->key, ".xml") || g_str_has_suffix(obj->key, ".csv") || g_str_has_suffix(obj->key, ".yaml")) {
-        g_autoptr(GError) error = NULL; gsize length = 0;
-        gchar *content = s3_client_download_object_to_buffer(mw->settings->endpoint, mw->access_key, mw->secret_key, mw->settings->bucket, obj->key, mw->settings->use_ssl, &length, &error);
-        if (!error) {
-            open_editor_tab(mw, obj->key, content);
-            g_free(content);
-        }
+    const gchar *key = s3_object_item_get_key(obj);
+    guint64 size = s3_object_item_get_object(obj)->size;
+    gboolean text = g_str_has_suffix(key, ".txt") || g_str_has_suffix(key, ".log") || g_str_has_suffix(key, ".json") || g_str_has_suffix(key, ".xml") || g_str_has_suffix(key, ".csv") || g_str_has_suffix(key, ".yaml");
+    // Tables open in a grid at any size. Huge and binary objects go to the
+    // range viewer, which downloads only what is on screen; a big .log opens
+    // at its end.
+    if (g_str_has_suffix(key, ".parquet")) {
+        open_parquet_viewer(mw, key, size);
+    } else if (g_str_has_suffix(key, ".csv") || g_str_has_suffix(key, ".tsv")) {
+        open_csv_viewer(mw, key, g_str_has_suffix(key, ".tsv") ? '\t' : ',');
+    } else if (text && size < EDITOR_MAX_FILE_BYTES) {
+        open_editor_tab(mw, key, size);
+    } else {
+        open_range_viewer(mw, key, size, !text, g_str_has_suffix(key, ".log"));
     }
     g_object_unref(obj);
 }
@@ -988,7 +1852,8 @@ static gboolean on_files_dropped(GtkDropTarget *target, const GValue *value, dou
     show_confirmation_popup(GTK_WINDOW(mw->window));
 
     GtkSingleSelection *selection = GTK_SINGLE_SELECTION(gtk_list_view_get_model(mw->folder_tree_view));
-    FolderItem *item = g_list_model_get_item(G_LIST_MODEL(selection), gtk_single_selection_get_selected(selection));
+    GtkTreeListRow *row = gtk_single_selection_get_selected_item(selection);
+    FolderItem *item = row ? gtk_tree_list_row_get_item(row) : NULL;
     if (!item) {
         gtk_statusbar_push(mw->statusbar, 0, _("Please select a folder to upload to."));
         return TRUE;
@@ -997,6 +1862,8 @@ static gboolean on_files_dropped(GtkDropTarget *target, const GValue *value, dou
     g_object_unref(item);
 
     GList *files = g_value_get_boxed(value);
+    GArray *uploaded = g_array_new(FALSE, FALSE, sizeof(S3Object));
+    GPtrArray *keys = g_ptr_array_new_with_free_func(g_free);  // Owns the keys `uploaded` points to
     for (GList *l = files; l != NULL; l = l->next) {
         GFile *file = G_FILE(l->data);
         gchar *local_path = g_file_get_path(file);
@@ -1006,6 +1873,10 @@ static gboolean on_files_dropped(GtkDropTarget *target, const GValue *value, dou
         if (s3_client_upload_object(mw->settings->endpoint, mw->access_key, mw->secret_key, current_bucket, key, local_path, mw->settings->use_ssl, &error)) {
             g_autofree gchar *msg = g_strdup_printf(_("'%s' uploaded successfully."), key);
             gtk_statusbar_push(mw->statusbar, 0, msg);
+            GStatBuf st;
+            S3Object object = local_object(key, g_stat(local_path, &st) == 0 ? (guint64)st.st_size : 0);
+            g_array_append_val(uploaded, object);
+            g_ptr_array_add(keys, g_steal_pointer(&key));
         } else {
             g_autofree gchar *msg = g_strdup_printf(_("Failed to upload '%s': %s"), key, error->message);
             show_error_dialog(GTK_WINDOW(mw->window), msg);
@@ -1013,7 +1884,9 @@ static gboolean on_files_dropped(GtkDropTarget *target, const GValue *value, dou
         g_free(local_path);
         g_free(key);
     }
-    refresh_current_folder(mw);
+    apply_local_changes(mw, current_bucket, (const S3Object *)uploaded->data, uploaded->len, NULL);
+    g_array_free(uploaded, TRUE);
+    g_ptr_array_free(keys, TRUE);
     g_free(current_bucket);
     return TRUE;
 }
@@ -1052,9 +1925,15 @@ static MainWindow* main_window_new(GtkApplication *app) {
     mw->window = GTK_APPLICATION_WINDOW(gtk_builder_get_object(b, "main_window"));
     gtk_window_set_application(GTK_WINDOW(mw->window), app);
     mw->file_list_view = GTK_LIST_VIEW(gtk_builder_get_object(b, "file_list_view"));
+    mw->file_filter_entry = GTK_SEARCH_ENTRY(gtk_builder_get_object(b, "file_filter_entry"));
+    mw->sort_buttons[0] = GTK_TOGGLE_BUTTON(gtk_builder_get_object(b, "sort_name_button"));
+    mw->sort_buttons[1] = GTK_TOGGLE_BUTTON(gtk_builder_get_object(b, "sort_size_button"));
+    mw->sort_buttons[2] = GTK_TOGGLE_BUTTON(gtk_builder_get_object(b, "sort_modified_button"));
+    mw->sort_column = S3_OBJECT_SORT_NONE;
     mw->notebook = GTK_NOTEBOOK(gtk_builder_get_object(b, "notebook"));
     mw->statusbar = GTK_STATUSBAR(gtk_builder_get_object(b, "statusbar"));
     mw->find_button = GTK_BUTTON(gtk_builder_get_object(b, "find_button"));
+    mw->watch_button = GTK_TOGGLE_BUTTON(gtk_builder_get_object(b, "watch_button"));
     gtk_widget_set_sensitive(GTK_WIDGET(mw->find_button), FALSE);
 
     GListStore *folder_store = g_list_store_new(G_TYPE_POINTER);
@@ -1062,23 +1941,31 @@ static MainWindow* main_window_new(GtkApplication *app) {
 
     GtkListItemFactory *folder_factory = gtk_signal_list_item_factory_new();
     g_signal_connect(folder_factory, "setup", G_CALLBACK(setup_folder_list_item_cb), NULL);
-    g_signal_connect(folder_factory, "bind", G_CALLBACK(bind_folder_list_item_cb), NULL);
+    mw->folder_size_labels = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    g_signal_connect(folder_factory, "bind", G_CALLBACK(bind_folder_list_item_cb), mw);
+    g_signal_connect(folder_factory, "unbind", G_CALLBACK(unbind_folder_list_item_cb), mw);
 
     GtkSingleSelection *folder_selection = gtk_single_selection_new(G_LIST_MODEL(mw->folder_tree_model));
     mw->folder_tree_view = GTK_LIST_VIEW(gtk_list_view_new(GTK_SELECTION_MODEL(folder_selection), folder_factory));
     GtkScrolledWindow *scrolled_window = GTK_SCROLLED_WINDOW(gtk_builder_get_object(b, "folder_tree_scrolled_window"));
     gtk_scrolled_window_set_child(scrolled_window, GTK_WIDGET(mw->folder_tree_view));
 
-    mw->file_list_store = g_list_store_new(s3_object_get_type());
+    mw->file_list = s3_object_list_new();
     GtkListItemFactory *f = gtk_signal_list_item_factory_new();
     g_signal_connect(f, "setup", G_CALLBACK(setup_list_item_cb), NULL);
-    g_signal_connect(f, "bind", G_CALLBACK(bind_list_item_cb), NULL);
-    GtkSingleSelection *sel = gtk_single_selection_new(G_LIST_MODEL(mw->file_list_store));
+    g_signal_connect(f, "bind", G_CALLBACK(bind_list_item_cb), mw);
+    g_signal_connect(f, "unbind", G_CALLBACK(unbind_list_item_cb), mw);
+    GtkSingleSelection *sel = gtk_single_selection_new(G_LIST_MODEL(mw->file_list));
     gtk_list_view_set_model(mw->file_list_view, GTK_SELECTION_MODEL(sel));
     gtk_list_view_set_factory(mw->file_list_view, f);
 
     g_signal_connect(mw->folder_tree_view, "row-activated", G_CALLBACK(on_folder_tree_row_activated), mw);
     g_signal_connect(mw->file_list_view, "activate", G_CALLBACK(on_file_list_row_activated), mw);
+    g_signal_connect(mw->file_filter_entry, "search-changed", G_CALLBACK(on_file_filter_changed), mw);
+    for (guint k = 0; k < G_N_ELEMENTS(mw->sort_buttons); k++) {
+        g_object_set_data(G_OBJECT(mw->sort_buttons[k]), "sort-column", GINT_TO_POINTER(S3_OBJECT_SORT_NAME + k));
+        g_signal_connect(mw->sort_buttons[k], "clicked", G_CALLBACK(on_sort_button_clicked), mw);
+    }
     g_signal_connect(GTK_BUTTON(gtk_builder_get_object(b, "settings_button")), "clicked", G_CALLBACK(on_settings_button_clicked), mw);
     g_signal_connect(GTK_BUTTON(gtk_builder_get_object(b, "connect_button")), "clicked", G_CALLBACK(on_connect_button_clicked), mw);
     g_signal_connect(GTK_BUTTON(gtk_builder_get_object(b, "new_folder_button")), "clicked", G_CALLBACK(on_new_folder_button_clicked), mw);
@@ -1086,8 +1973,14 @@ static MainWindow* main_window_new(GtkApplication *app) {
     g_signal_connect(GTK_BUTTON(gtk_builder_get_object(b, "rename_button")), "clicked", G_CALLBACK(on_rename_button_clicked), mw);
     g_signal_connect(GTK_BUTTON(gtk_builder_get_object(b, "delete_button")), "clicked", G_CALLBACK(on_delete_button_clicked), mw);
     g_signal_connect(GTK_BUTTON(gtk_builder_get_object(b, "download_button")), "clicked", G_CALLBACK(on_download_button_clicked), mw);
+    g_signal_connect(GTK_BUTTON(gtk_builder_get_object(b, "query_button")), "clicked", G_CALLBACK(on_query_button_clicked), mw);
     g_signal_connect(GTK_BUTTON(gtk_builder_get_object(b, "refresh_button")), "clicked", G_CALLBACK(on_refresh_button_clicked), mw);
+    g_signal_connect(mw->watch_button, "toggled", G_CALLBACK(on_watch_button_toggled), mw);
     g_signal_connect(mw->find_button, "clicked", G_CALLBACK(on_find_button_clicked), mw);
+    g_signal_connect(GTK_BUTTON(gtk_builder_get_object(b, "find_object_button")), "clicked", G_CALLBACK(on_find_object_button_clicked), mw);
+    g_signal_connect(GTK_BUTTON(gtk_builder_get_object(b, "search_contents_button")), "clicked", G_CALLBACK(on_search_contents_button_clicked), mw);
+    g_signal_connect(GTK_BUTTON(gtk_builder_get_object(b, "folder_sizes_button")), "clicked", G_CALLBACK(on_folder_sizes_button_clicked), mw);
+    g_signal_connect(GTK_BUTTON(gtk_builder_get_object(b, "diagnostics_button")), "clicked", G_CALLBACK(on_diagnostics_button_clicked), mw);
     g_signal_connect(mw->window, "close-request", G_CALLBACK(on_window_close_request), mw);
 
     GtkDropTarget *drop_target = gtk_drop_target_new(G_TYPE_FILE, GDK_ACTION_COPY);
@@ -1111,28 +2004,2248 @@ static MainWindow* main_window_new(GtkApplication *app) {
     return mw;
 }
 
-static void on_window_close_response(GtkButton *button, gpointer user_data) {
-    GtkWindow *window = GTK_WINDOW(user_data);
-    GtkWidget *dialog = gtk_widget_get_ancestor(GTK_WIDGET(button), GTK_TYPE_WINDOW);
-    gtk_window_destroy(GTK_WINDOW(dialog));
-    gtk_window_destroy(window);
-}
+// #############################################################################
+// # Session Snapshot
+// #############################################################################
 
-static gboolean on_window_close_request(GtkApplicationWindow *window, gpointer user_data) {
-    MainWindow *mw = (MainWindow *)user_data;
-    gboolean unsaved_changes = FALSE;
-    for (guint i = 1; i < gtk_notebook_get_n_pages(mw->notebook); ++i) {
-        GtkWidget *page = gtk_notebook_get_nth_page(mw->notebook, i);
-        GtkWidget *tab_box = gtk_notebook_get_tab_label(mw->notebook, page);
-        GtkWidget *tab_label = gtk_widget_get_first_child(tab_box);
-        const gchar *label_text = gtk_label_get_text(GTK_LABEL(tab_label));
-        if (g_str_has_suffix(label_text, "*")) {
-            unsaved_changes = TRUE;
+// Replaces the tree with one row per bucket, unless it already shows exactly
+// those, and reselects the listed folder.
+static void fill_bucket_list(MainWindow *mw, gchar **names) {
+    GListModel *buckets = gtk_tree_list_model_get_model(mw->folder_tree_model);
+    guint n_items = g_list_model_get_n_items(buckets);
+    gboolean unchanged = n_items == g_strv_length(names);
+    for (guint i = 0; unchanged && i < n_items; i++) {
+        FolderItem *item = g_list_model_get_item(buckets, i);
+        unchanged = g_strcmp0(item->name, names[i]) == 0;
+        g_object_unref(item);
+    }
+    if (unchanged) return;
+
+    gint64 span = trace_begin();
+    GListStore *folder_store = G_LIST_STORE(buckets);
+    g_list_store_remove_all(folder_store);
+    for (guint i = 0; names[i]; i++) {
+        FolderItem *item = g_new0(FolderItem, 1);
+        item->name = g_strdup(names[i]);
+        item->is_bucket = TRUE;
+        item->full_path = g_strdup(names[i]);
+        item->children = g_list_store_new(G_TYPE_POINTER);
+        g_list_store_append(folder_store, item);
+    }
+    trace_end(span, "ui", "fill_bucket_list");
+
+    GtkSingleSelection *selection = GTK_SINGLE_SELECTION(gtk_list_view_get_model(mw->folder_tree_view));
+    guint n_rows = g_list_model_get_n_items(G_LIST_MODEL(mw->folder_tree_model));
+    gtk_single_selection_set_selected(selection, GTK_INVALID_LIST_POSITION);
+    for (guint i = 0; mw->current_folder && i < n_rows; i++) {
+        g_autoptr(GtkTreeListRow) row = gtk_tree_list_model_get_row(mw->folder_tree_model, i);
+        FolderItem *item = gtk_tree_list_row_get_item(row);
+        gboolean found = g_strcmp0(item->full_path, mw->current_folder) == 0;
+        g_object_unref(item);
+        if (found) {
+            gtk_single_selection_set_selected(selection, i);
             break;
         }
     }
+}
 
-    if (unsaved_changes) {
+static void save_session(MainWindow *mw) {
+    if (!mw->settings->endpoint || !*mw->settings->endpoint) return;
+    gint64 span = trace_begin();
+    g_autoptr(MyS3Session) session = session_new(mw->settings->endpoint);
+
+    g_autoptr(GStrvBuilder) buckets = g_strv_builder_new();
+    g_autoptr(GStrvBuilder) expanded = g_strv_builder_new();
+    guint n_rows = g_list_model_get_n_items(G_LIST_MODEL(mw->folder_tree_model));
+    for (guint i = 0; i < n_rows; i++) {
+        g_autoptr(GtkTreeListRow) row = gtk_tree_list_model_get_row(mw->folder_tree_model, i);
+        FolderItem *item = gtk_tree_list_row_get_item(row);
+        if (gtk_tree_list_row_get_depth(row) == 0) g_strv_builder_add(buckets, item->name);
+        if (gtk_tree_list_row_get_expanded(row)) g_strv_builder_add(expanded, item->full_path);
+        g_object_unref(item);
+    }
+    session->buckets = g_strv_builder_end(buckets);
+    session->expanded = g_strv_builder_end(expanded);
+
+    // A filtered list holds only some of the folder; the folder is kept and
+    // its listing comes back with the first refresh.
+    if (*gtk_editable_get_text(GTK_EDITABLE(mw->file_filter_entry)) == '\0') {
+        session_set_listing(session, mw->current_folder, mw->file_list);
+    } else {
+        session->folder = g_strdup(mw->current_folder);
+    }
+
+    for (gint i = 1; i < gtk_notebook_get_n_pages(mw->notebook); i++) {
+        EditorSaveData *editor = g_object_get_data(G_OBJECT(gtk_notebook_get_nth_page(mw->notebook, i)), "editor");
+        if (editor) session_add_tab(session, editor->key, editor->size);
+    }
+
+    g_autoptr(GError) error = NULL;
+    if (!session_save(session, &error)) {
+        g_warning("Failed to save session: %s", error->message);
+    }
+    trace_end(span, "ui", "save_session");
+}
+
+// Background work for the file list and tree: reading the snapshot's listing
+// at launch, or listing the buckets and the current folder again.
+typedef struct {
+    MainWindow *mw;
+    guint generation;           // mw->listing_generation when started
+    gchar *folder;
+    MyS3Session *session;       // Restore only
+    gchar *endpoint, *access_key, *secret_key;
+    gboolean use_ssl;
+    gchar **buckets;            // Revalidate only
+    S3ObjectList *list;         // NULL if the folder could not be listed
+    S3KeyIndex *index;
+} SessionJob;
+
+static void session_job_free(gpointer data) {
+    SessionJob *job = (SessionJob *)data;
+    g_free(job->folder);
+    session_free(job->session);
+    g_free(job->endpoint); g_free(job->access_key); g_free(job->secret_key);
+    g_strfreev(job->buckets);
+    g_clear_object(&job->list);
+    g_clear_pointer(&job->index, s3_key_index_unref);
+    g_free(job);
+}
+
+static void restore_listing_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    (void)source_object; (void)cancellable;
+    SessionJob *job = (SessionJob *)task_data;
+    gint64 span = trace_begin();
+    job->list = s3_object_list_new();
+    job->index = s3_key_index_new();
+    ListingSinks sinks = { job->list, job->index };
+    session_foreach_object_page(job->session, on_listing_page, &sinks);
+    trace_end_detail(span, "ui", "restore_listing", job->folder);
+    g_task_return_boolean(task, TRUE);
+}
+
+static void revalidate_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    (void)source_object; (void)cancellable;
+    SessionJob *job = (SessionJob *)task_data;
+    GError *error = NULL;
+    GList *buckets = s3_client_list_buckets(job->endpoint, job->access_key, job->secret_key, job->use_ssl, &error);
+    if (error) {
+        s3_client_free_bucket_list(buckets);
+        g_task_return_error(task, error);
+        return;
+    }
+    g_autoptr(GStrvBuilder) names = g_strv_builder_new();
+    for (GList *l = buckets; l != NULL; l = l->next) g_strv_builder_add(names, ((S3Bucket *)l->data)->name);
+    job->buckets = g_strv_builder_end(names);
+    s3_client_free_bucket_list(buckets);
+
+    if (job->folder) {
+        job->list = s3_object_list_new();
+        job->index = s3_key_index_new();
+        ListingSinks sinks = { job->list, job->index };
+        if (!s3_client_list_objects_paged(job->endpoint, job->access_key, job->secret_key, job->folder, NULL, job->use_ssl, on_listing_page, &sinks, &error)) {
+            g_warning("Failed to revalidate %s: %s", job->folder, error->message);
+            g_clear_error(&error);
+            g_clear_object(&job->list);
+        }
+    }
+    g_task_return_boolean(task, TRUE);
+}
+
+static void on_session_job_done(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source; (void)user_data;
+    SessionJob *job = g_task_get_task_data(G_TASK(result));
+    MainWindow *mw = job->mw;
+    g_autoptr(GError) error = NULL;
+    if (!g_task_propagate_boolean(G_TASK(result), &error)) {
+        g_autofree gchar *msg = g_strdup_printf(_("Failed to list buckets: %s"), error->message);
+        gtk_statusbar_push(mw->statusbar, 0, msg);
+        return;
+    }
+    if (job->buckets) fill_bucket_list(mw, job->buckets);
+    // Dropped if a live listing was installed since the job started. The
+    // restored one is not live, so revalidation still replaces it.
+    if (job->list && job->generation == mw->listing_generation) {
+        if (!job->session) mw->listing_generation++;
+        // Revalidating the restored folder only touches the rows that changed.
+        if (job->session || !update_listing(mw, job->folder, job->list, job->index, NULL)) install_listing(mw, job->folder, job->list, job->index);
+    }
+    if (!job->session) gtk_statusbar_push(mw->statusbar, 0, _("Ready."));
+}
+
+// Lists the buckets and the current folder again on a worker thread and
+// swaps the results in, leaving what is shown in place until then.
+static void revalidate_session(MainWindow *mw) {
+    if (!mw->access_key || !mw->secret_key) return;
+    SessionJob *job = g_new0(SessionJob, 1);
+    job->mw = mw;
+    job->generation = mw->listing_generation;
+    job->folder = g_strdup(mw->current_folder);
+    job->endpoint = g_strdup(mw->settings->endpoint);
+    job->access_key = g_strdup(mw->access_key);
+    job->secret_key = g_strdup(mw->secret_key);
+    job->use_ssl = mw->settings->use_ssl;
+    g_autoptr(GTask) task = g_task_new(NULL, NULL, on_session_job_done, NULL);
+    g_task_set_task_data(task, job, session_job_free);
+    g_task_run_in_thread(task, revalidate_thread);
+}
+
+// Shows the last session without touching the network: buckets, expanded
+// rows and the listed folder come from the snapshot (the listing is decoded
+// on a worker), editor tabs reopen and stream their content in. Then the
+// whole thing is revalidated in the background.
+static void restore_session(MainWindow *mw) {
+    if (!mw->settings->endpoint || !*mw->settings->endpoint) return;
+    gint64 span = trace_begin();
+    MyS3Session *session = session_load(mw->settings->endpoint);
+    if (!session) {
+        trace_end(span, "ui", "restore_session");
+        return;
+    }
+
+    mw->current_folder = g_strdup(session->folder);
+    fill_bucket_list(mw, session->buckets);
+    for (guint i = 0; i < g_list_model_get_n_items(G_LIST_MODEL(mw->folder_tree_model)); i++) {
+        g_autoptr(GtkTreeListRow) row = gtk_tree_list_model_get_row(mw->folder_tree_model, i);
+        FolderItem *item = gtk_tree_list_row_get_item(row);
+        if (g_strv_contains((const gchar * const *)session->expanded, item->full_path)) gtk_tree_list_row_set_expanded(row, TRUE);
+        g_object_unref(item);
+    }
+
+    gboolean have_credentials = credential_storage_load("mys3-client", &mw->access_key, &mw->secret_key);
+    for (guint i = 0; have_credentials && i < session->tabs->len; i++) {
+        const MyS3SessionTab *tab = &g_array_index(session->tabs, MyS3SessionTab, i);
+        open_editor_tab(mw, tab->key, tab->size);
+    }
+
+    if (session->objects) {
+        SessionJob *job = g_new0(SessionJob, 1);
+        job->mw = mw;
+        job->generation = mw->listing_generation;
+        job->folder = g_strdup(session->folder);
+        job->session = session;
+        g_autoptr(GTask) task = g_task_new(NULL, NULL, on_session_job_done, NULL);
+        g_task_set_task_data(task, job, session_job_free);
+        g_task_run_in_thread(task, restore_listing_thread);
+    } else {
+        session_free(session);
+    }
+
+    gtk_statusbar_push(mw->statusbar, 0, have_credentials ? _("Restored last session; refreshing...") : _("Restored last session."));
+    revalidate_session(mw);
+    trace_end(span, "ui", "restore_session");
+}
+
+// #############################################################################
+// # Diagnostics
+// #############################################################################
+
+typedef struct { GtkLabel *label; guint timeout_id; } DiagnosticsWindow;
+
+static gboolean refresh_diagnostics(gpointer user_data) {
+    DiagnosticsWindow *dw = (DiagnosticsWindow *)user_data;
+    g_autofree gchar *text = s3_metrics_format_text();
+    gtk_label_set_text(dw->label, text);
+    return G_SOURCE_CONTINUE;
+}
+
+static void on_diagnostics_window_destroy(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    DiagnosticsWindow *dw = (DiagnosticsWindow *)user_data;
+    g_source_remove(dw->timeout_id);
+    g_free(dw);
+}
+
+static void on_diagnostics_button_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    MainWindow *mw = (MainWindow *)user_data;
+    DiagnosticsWindow *dw = g_new0(DiagnosticsWindow, 1);
+    GtkWidget *window = gtk_window_new();
+    gtk_window_set_title(GTK_WINDOW(window), _("Diagnostics"));
+    gtk_window_set_transient_for(GTK_WINDOW(window), GTK_WINDOW(mw->window));
+    gtk_window_set_destroy_with_parent(GTK_WINDOW(window), TRUE);
+    gtk_window_set_default_size(GTK_WINDOW(window), 720, 320);
+
+    dw->label = GTK_LABEL(gtk_label_new(NULL));
+    gtk_label_set_selectable(dw->label, TRUE);
+    gtk_label_set_xalign(dw->label, 0);
+    gtk_label_set_yalign(dw->label, 0);
+    gtk_widget_add_css_class(GTK_WIDGET(dw->label), "monospace");
+    gtk_widget_set_margin_start(GTK_WIDGET(dw->label), 12);
+    gtk_widget_set_margin_end(GTK_WIDGET(dw->label), 12);
+    gtk_widget_set_margin_top(GTK_WIDGET(dw->label), 12);
+    gtk_widget_set_margin_bottom(GTK_WIDGET(dw->label), 12);
+    GtkWidget *scrolled = gtk_scrolled_window_new();
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), GTK_WIDGET(dw->label));
+    gtk_window_set_child(GTK_WINDOW(window), scrolled);
+
+    refresh_diagnostics(dw);
+    dw->timeout_id = g_timeout_add_seconds(1, refresh_diagnostics, dw);
+    g_signal_connect(window, "destroy", G_CALLBACK(on_diagnostics_window_destroy), dw);
+    gtk_window_present(GTK_WINDOW(window));
+}
+
+// #############################################################################
+// # Find Object
+// #############################################################################
+
+#define FIND_OBJECT_MAX_RESULTS 200
+#define FIND_OBJECT_MAX_COMPLETIONS 20
+
+typedef struct { MainWindow *mw; GtkSearchEntry *entry; GtkStringList *results; GtkLabel *status; guint n_completions; } FindObjectWindow;
+
+static void refresh_find_results(FindObjectWindow *fw) {
+    const gchar *query = gtk_editable_get_text(GTK_EDITABLE(fw->entry));
+    guint n_old = g_list_model_get_n_items(G_LIST_MODEL(fw->results));
+    if (!fw->mw->key_index) {
+        gtk_string_list_splice(fw->results, 0, n_old, NULL);
+        fw->n_completions = 0;
+        gtk_label_set_text(fw->status, _("Open a bucket to search its objects."));
+        return;
+    }
+    gint64 start = g_get_monotonic_time();
+    // Folder completions come first, then the ranked search results.
+    g_auto(GStrv) completions = strpbrk(query, "*?") ? g_new0(gchar *, 1) : s3_key_index_complete(fw->mw->key_index, query, FIND_OBJECT_MAX_COMPLETIONS);
+    g_auto(GStrv) matches = *query ? s3_key_index_search(fw->mw->key_index, query, FIND_OBJECT_MAX_RESULTS) : g_new0(gchar *, 1);
+    gint64 elapsed_us = g_get_monotonic_time() - start;
+    fw->n_completions = g_strv_length(completions);
+    gtk_string_list_splice(fw->results, 0, n_old, (const char * const *)completions);
+    gtk_string_list_splice(fw->results, fw->n_completions, 0, (const char * const *)matches);
+    g_autofree gchar *status = g_strdup_printf(_("%u matches in %u indexed keys (%.1f ms)"), g_strv_length(matches), s3_key_index_get_n_keys(fw->mw->key_index), elapsed_us / 1000.0);
+    gtk_label_set_text(fw->status, status);
+}
+
+static void on_find_object_changed(GtkSearchEntry *entry, gpointer user_data) { (void)entry; refresh_find_results((FindObjectWindow *)user_data); }
+
+static void accept_find_result(FindObjectWindow *fw, guint position) {
+    const gchar *key = gtk_string_list_get_string(fw->results, position);
+    if (!key) return;
+    if (position < fw->n_completions) {
+        // Descend into the folder, or complete the name, and keep searching.
+        gtk_editable_set_text(GTK_EDITABLE(fw->entry), key);
+        gtk_editable_set_position(GTK_EDITABLE(fw->entry), -1);
+    } else {
+        // Reveal the object in the file list.
+        gtk_editable_set_text(GTK_EDITABLE(fw->mw->file_filter_entry), key);
+    }
+}
+
+static void on_find_object_activated(GtkListView *view, guint position, gpointer user_data) { (void)view; accept_find_result((FindObjectWindow *)user_data, position); }
+
+static gboolean on_find_object_key_pressed(GtkEventControllerKey *controller, guint keyval, guint keycode, GdkModifierType state, gpointer user_data) {
+    (void)controller; (void)keycode; (void)state;
+    FindObjectWindow *fw = (FindObjectWindow *)user_data;
+    if (keyval != GDK_KEY_Tab || fw->n_completions == 0) return FALSE;
+    accept_find_result(fw, 0);
+    return TRUE;
+}
+
+static void setup_find_result_cb(GtkListItemFactory *f, GtkListItem *i) { (void)f; GtkWidget *l = gtk_label_new(NULL); gtk_label_set_xalign(GTK_LABEL(l), 0); gtk_label_set_ellipsize(GTK_LABEL(l), PANGO_ELLIPSIZE_START); gtk_list_item_set_child(i, l); }
+static void bind_find_result_cb(GtkListItemFactory *f, GtkListItem *i) { (void)f; gtk_label_set_text(GTK_LABEL(gtk_list_item_get_child(i)), gtk_string_object_get_string(gtk_list_item_get_item(i))); }
+
+static void on_find_object_button_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    MainWindow *mw = (MainWindow *)user_data;
+    FindObjectWindow *fw = g_new0(FindObjectWindow, 1);
+    fw->mw = mw;
+    GtkWidget *window = gtk_window_new();
+    gtk_window_set_title(GTK_WINDOW(window), _("Find Object"));
+    gtk_window_set_transient_for(GTK_WINDOW(window), GTK_WINDOW(mw->window));
+    gtk_window_set_destroy_with_parent(GTK_WINDOW(window), TRUE);
+    gtk_window_set_default_size(GTK_WINDOW(window), 720, 480);
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    gtk_widget_set_margin_start(box, 12);
+    gtk_widget_set_margin_end(box, 12);
+    gtk_widget_set_margin_top(box, 12);
+    gtk_widget_set_margin_bottom(box, 12);
+    gtk_window_set_child(GTK_WINDOW(window), box);
+
+    fw->entry = GTK_SEARCH_ENTRY(gtk_search_entry_new());
+    gtk_search_entry_set_placeholder_text(fw->entry, _("Substring, glob (logs/*/run-42*) or path prefix"));
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(fw->entry));
+
+    fw->results = gtk_string_list_new(NULL);
+    GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(factory, "setup", G_CALLBACK(setup_find_result_cb), NULL);
+    g_signal_connect(factory, "bind", G_CALLBACK(bind_find_result_cb), NULL);
+    GtkWidget *view = gtk_list_view_new(GTK_SELECTION_MODEL(gtk_single_selection_new(G_LIST_MODEL(fw->results))), factory);
+    GtkWidget *scrolled = gtk_scrolled_window_new();
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), view);
+    gtk_box_append(GTK_BOX(box), scrolled);
+
+    fw->status = GTK_LABEL(gtk_label_new(NULL));
+    gtk_label_set_xalign(fw->status, 0);
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(fw->status));
+
+    GtkEventController *keys = gtk_event_controller_key_new();
+    gtk_event_controller_set_propagation_phase(keys, GTK_PHASE_CAPTURE);
+    g_signal_connect(keys, "key-pressed", G_CALLBACK(on_find_object_key_pressed), fw);
+    gtk_widget_add_controller(GTK_WIDGET(fw->entry), keys);
+    g_signal_connect(fw->entry, "search-changed", G_CALLBACK(on_find_object_changed), fw);
+    g_signal_connect(view, "activate", G_CALLBACK(on_find_object_activated), fw);
+    g_signal_connect_swapped(window, "destroy", G_CALLBACK(g_free), fw);
+
+    refresh_find_results(fw);
+    gtk_window_present(GTK_WINDOW(window));
+}
+
+// #############################################################################
+// # Search Contents
+// #############################################################################
+
+#define SEARCH_CONTENTS_MAX_MATCHES 10000
+#define SEARCH_CONTENTS_FLUSH_MS 100
+
+// Matches arrive on the grep workers and are moved into the list in batches.
+typedef struct {
+    gint ref_count;
+    gboolean closed;
+    MainWindow *mw;
+    GtkEntry *prefix_entry;
+    GtkEntry *pattern_entry;
+    GtkCheckButton *regex_check;
+    GtkCheckButton *case_check;
+    GtkCheckButton *files_only_check;
+    GtkButton *search_button;
+    GtkStringList *results;
+    GPtrArray *result_keys;     // Key of each row in results
+    GtkLabel *status;
+    GCancellable *cancellable;  // The running search, or NULL
+    guint flush_id;
+    GMutex lock;                // Guards the fields below
+    GPtrArray *incoming_keys;
+    GPtrArray *incoming_lines;
+    S3GrepStats progress;
+} SearchContentsWindow;
+
+typedef struct {
+    SearchContentsWindow *sw;
+    gchar *endpoint, *access_key, *secret_key, *bucket, *prefix;
+    gboolean use_ssl;
+    gboolean files_only;
+    TextMatcher *matcher;
+    S3GrepStats stats;
+} SearchContentsJob;
+
+static SearchContentsWindow *search_contents_ref(SearchContentsWindow *sw) { g_atomic_int_inc(&sw->ref_count); return sw; }
+
+// Jobs may drop the last reference on their worker thread.
+static void search_contents_unref(SearchContentsWindow *sw) {
+    if (!g_atomic_int_dec_and_test(&sw->ref_count)) return;
+    g_ptr_array_unref(sw->result_keys);
+    g_ptr_array_unref(sw->incoming_keys);
+    g_ptr_array_unref(sw->incoming_lines);
+    g_mutex_clear(&sw->lock);
+    g_free(sw);
+}
+
+static void search_contents_job_free(SearchContentsJob *job) {
+    search_contents_unref(job->sw);
+    g_free(job->endpoint); g_free(job->access_key); g_free(job->secret_key); g_free(job->bucket); g_free(job->prefix);
+    text_matcher_free(job->matcher);
+    g_free(job);
+}
+
+static void on_search_contents_match(const S3GrepMatch *match, gpointer user_data) {
+    SearchContentsWindow *sw = (SearchContentsWindow *)user_data;
+    gchar *line = g_strdup_printf("%s:%" G_GUINT64_FORMAT ": %s", match->key, match->offset, match->line);
+    g_mutex_lock(&sw->lock);
+    g_ptr_array_add(sw->incoming_keys, g_strdup(match->key));
+    g_ptr_array_add(sw->incoming_lines, line);
+    g_mutex_unlock(&sw->lock);
+}
+
+static void on_search_contents_progress(const S3GrepStats *stats, gpointer user_data) {
+    SearchContentsWindow *sw = (SearchContentsWindow *)user_data;
+    g_mutex_lock(&sw->lock);
+    sw->progress = *stats;
+    g_mutex_unlock(&sw->lock);
+}
+
+static void set_search_contents_status(SearchContentsWindow *sw, const S3GrepStats *stats, const gchar *state) {
+    g_autofree gchar *scanned = g_format_size(stats->bytes_scanned);
+    g_autofree gchar *downloaded = g_format_size(stats->bytes_downloaded);
+    g_autofree gchar *msg = g_strdup_printf(_("%s %u of %u objects, %s scanned (%s downloaded), %u matches, %u failed, %u skipped."),
+        state, stats->objects_scanned, stats->objects_listed, scanned, downloaded, stats->matches, stats->objects_failed, stats->objects_skipped);
+    gtk_label_set_text(sw->status, msg);
+}
+
+static gboolean flush_search_contents(gpointer user_data) {
+    SearchContentsWindow *sw = (SearchContentsWindow *)user_data;
+    g_mutex_lock(&sw->lock);
+    GPtrArray *keys = sw->incoming_keys, *lines = sw->incoming_lines;
+    sw->incoming_keys = g_ptr_array_new_with_free_func(g_free);
+    sw->incoming_lines = g_ptr_array_new_with_free_func(g_free);
+    S3GrepStats progress = sw->progress;
+    g_mutex_unlock(&sw->lock);
+
+    if (lines->len > 0) {
+        for (guint i = 0; i < keys->len; i++) g_ptr_array_add(sw->result_keys, g_strdup(g_ptr_array_index(keys, i)));
+        g_ptr_array_add(lines, NULL);
+        gtk_string_list_splice(sw->results, g_list_model_get_n_items(G_LIST_MODEL(sw->results)), 0, (const char * const *)lines->pdata);
+    }
+    g_ptr_array_unref(keys);
+    g_ptr_array_unref(lines);
+    if (sw->cancellable) set_search_contents_status(sw, &progress, _("Searching:"));
+    return G_SOURCE_CONTINUE;
+}
+
+static void search_contents_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    (void)source;
+    SearchContentsJob *job = (SearchContentsJob *)task_data;
+    S3GrepOptions options = {
+        .endpoint = job->endpoint, .access_key = job->access_key, .secret_key = job->secret_key,
+        .bucket = job->bucket, .prefix = job->prefix, .use_ssl = job->use_ssl,
+        .max_matches = SEARCH_CONTENTS_MAX_MATCHES,
+        .max_matches_per_object = job->files_only ? 1 : 0,
+        .match_callback = on_search_contents_match,
+        .progress_callback = on_search_contents_progress,
+        .user_data = job->sw,
+    };
+    GError *error = NULL;
+    if (s3_grep_run(&options, job->matcher, cancellable, &job->stats, &error)) g_task_return_boolean(task, TRUE);
+    else g_task_return_error(task, error);
+}
+
+static void on_search_contents_done(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source; (void)user_data;
+    SearchContentsJob *job = g_task_get_task_data(G_TASK(result));
+    SearchContentsWindow *sw = job->sw;
+    g_autoptr(GError) error = NULL;
+    gboolean ok = g_task_propagate_boolean(G_TASK(result), &error);
+    if (sw->closed) return;
+    g_clear_object(&sw->cancellable);
+    flush_search_contents(sw);
+    g_source_remove(sw->flush_id);
+    sw->flush_id = 0;
+    gtk_button_set_label(sw->search_button, _("Search"));
+    if (!ok && !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_autofree gchar *msg = g_strdup_printf(_("Search failed: %s"), error->message);
+        gtk_label_set_text(sw->status, msg);
+        return;
+    }
+    set_search_contents_status(sw, &job->stats, !ok ? _("Stopped after") : job->stats.truncated ? _("Match limit reached after") : _("Searched"));
+}
+
+static void on_search_contents_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    SearchContentsWindow *sw = (SearchContentsWindow *)user_data;
+    if (sw->cancellable) {
+        g_cancellable_cancel(sw->cancellable);
+        return;
+    }
+    const gchar *pattern = gtk_editable_get_text(GTK_EDITABLE(sw->pattern_entry));
+    if (!*pattern) return;
+    TextSearchFlags flags = TEXT_SEARCH_RAW;
+    if (gtk_check_button_get_active(sw->regex_check)) flags |= TEXT_SEARCH_REGEX;
+    if (!gtk_check_button_get_active(sw->case_check)) flags |= TEXT_SEARCH_CASE_INSENSITIVE;
+    g_autoptr(GError) error = NULL;
+    TextMatcher *matcher = text_matcher_new(pattern, flags, &error);
+    if (!matcher) {
+        gtk_label_set_text(sw->status, error->message);
+        return;
+    }
+
+    MainWindow *mw = sw->mw;
+    SearchContentsJob *job = g_new0(SearchContentsJob, 1);
+    job->sw = search_contents_ref(sw);
+    job->endpoint = g_strdup(mw->settings->endpoint);
+    job->access_key = g_strdup(mw->access_key);
+    job->secret_key = g_strdup(mw->secret_key);
+    job->bucket = g_strdup(mw->settings->bucket);
+    job->prefix = g_strdup(gtk_editable_get_text(GTK_EDITABLE(sw->prefix_entry)));
+    job->use_ssl = mw->settings->use_ssl;
+    job->files_only = gtk_check_button_get_active(sw->files_only_check);
+    job->matcher = matcher;
+
+    gtk_string_list_splice(sw->results, 0, g_list_model_get_n_items(G_LIST_MODEL(sw->results)), NULL);
+    g_ptr_array_set_size(sw->result_keys, 0);
+    g_mutex_lock(&sw->lock);
+    memset(&sw->progress, 0, sizeof(sw->progress));
+    g_mutex_unlock(&sw->lock);
+    gtk_label_set_text(sw->status, _("Searching..."));
+    gtk_button_set_label(sw->search_button, _("Stop"));
+    sw->cancellable = g_cancellable_new();
+    sw->flush_id = g_timeout_add(SEARCH_CONTENTS_FLUSH_MS, flush_search_contents, sw);
+
+    GTask *task = g_task_new(NULL, sw->cancellable, on_search_contents_done, NULL);
+    g_task_set_task_data(task, job, (GDestroyNotify)search_contents_job_free);
+    g_task_run_in_thread(task, search_contents_thread);
+    g_object_unref(task);
+}
+
+static void on_search_contents_entry_activated(GtkEntry *entry, gpointer user_data) {
+    (void)entry;
+    SearchContentsWindow *sw = (SearchContentsWindow *)user_data;
+    if (!sw->cancellable) on_search_contents_clicked(NULL, sw);
+}
+
+static void setup_search_contents_row_cb(GtkListItemFactory *f, GtkListItem *i) { (void)f; GtkWidget *l = gtk_label_new(NULL); gtk_label_set_xalign(GTK_LABEL(l), 0); gtk_label_set_ellipsize(GTK_LABEL(l), PANGO_ELLIPSIZE_END); gtk_widget_add_css_class(l, "monospace"); gtk_list_item_set_child(i, l); }
+
+static void on_search_contents_activated(GtkListView *view, guint position, gpointer user_data) {
+    (void)view;
+    SearchContentsWindow *sw = (SearchContentsWindow *)user_data;
+    if (position < sw->result_keys->len) gtk_editable_set_text(GTK_EDITABLE(sw->mw->file_filter_entry), g_ptr_array_index(sw->result_keys, position));
+}
+
+static void on_search_contents_destroy(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    SearchContentsWindow *sw = (SearchContentsWindow *)user_data;
+    sw->closed = TRUE;
+    if (sw->cancellable) g_cancellable_cancel(sw->cancellable);
+    g_clear_object(&sw->cancellable);
+    if (sw->flush_id) g_source_remove(sw->flush_id);
+    search_contents_unref(sw);
+}
+
+static void on_search_contents_button_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    MainWindow *mw = (MainWindow *)user_data;
+    SearchContentsWindow *sw = g_new0(SearchContentsWindow, 1);
+    sw->ref_count = 1;
+    sw->mw = mw;
+    sw->result_keys = g_ptr_array_new_with_free_func(g_free);
+    sw->incoming_keys = g_ptr_array_new_with_free_func(g_free);
+    sw->incoming_lines = g_ptr_array_new_with_free_func(g_free);
+    g_mutex_init(&sw->lock);
+
+    GtkWidget *window = gtk_window_new();
+    gtk_window_set_title(GTK_WINDOW(window), _("Search Contents"));
+    gtk_window_set_transient_for(GTK_WINDOW(window), GTK_WINDOW(mw->window));
+    gtk_window_set_destroy_with_parent(GTK_WINDOW(window), TRUE);
+    gtk_window_set_default_size(GTK_WINDOW(window), 900, 560);
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    gtk_widget_set_margin_start(box, 12);
+    gtk_widget_set_margin_end(box, 12);
+    gtk_widget_set_margin_top(box, 12);
+    gtk_widget_set_margin_bottom(box, 12);
+    gtk_window_set_child(GTK_WINDOW(window), box);
+
+    GtkWidget *grid = gtk_grid_new();
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 6);
+    gtk_grid_set_row_spacing(GTK_GRID(grid), 6);
+    sw->prefix_entry = GTK_ENTRY(gtk_entry_new());
+    gtk_entry_set_placeholder_text(sw->prefix_entry, _("logs/2026/"));
+    gtk_widget_set_hexpand(GTK_WIDGET(sw->prefix_entry), TRUE);
+    sw->pattern_entry = GTK_ENTRY(gtk_entry_new());
+    sw->search_button = GTK_BUTTON(gtk_button_new_with_label(_("Search")));
+    sw->regex_check = GTK_CHECK_BUTTON(gtk_check_button_new_with_label(_("Regular expression")));
+    sw->case_check = GTK_CHECK_BUTTON(gtk_check_button_new_with_label(_("Match case")));
+    gtk_check_button_set_active(sw->case_check, TRUE);
+    sw->files_only_check = GTK_CHECK_BUTTON(gtk_check_button_new_with_label(_("First match per object")));
+    GtkWidget *options = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+    gtk_box_append(GTK_BOX(options), GTK_WIDGET(sw->regex_check));
+    gtk_box_append(GTK_BOX(options), GTK_WIDGET(sw->case_check));
+    gtk_box_append(GTK_BOX(options), GTK_WIDGET(sw->files_only_check));
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new(_("Prefix:")), 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sw->prefix_entry), 1, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new(_("Find:")), 0, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sw->pattern_entry), 1, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), GTK_WIDGET(sw->search_button), 2, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), options, 1, 2, 1, 1);
+    gtk_box_append(GTK_BOX(box), grid);
+
+    sw->results = gtk_string_list_new(NULL);
+    GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(factory, "setup", G_CALLBACK(setup_search_contents_row_cb), NULL);
+    g_signal_connect(factory, "bind", G_CALLBACK(bind_find_result_cb), NULL);
+    GtkWidget *view = gtk_list_view_new(GTK_SELECTION_MODEL(gtk_single_selection_new(G_LIST_MODEL(sw->results))), factory);
+    GtkWidget *scrolled = gtk_scrolled_window_new();
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), view);
+    gtk_box_append(GTK_BOX(box), scrolled);
+
+    sw->status = GTK_LABEL(gtk_label_new(NULL));
+    gtk_label_set_xalign(sw->status, 0);
+    gtk_label_set_wrap(sw->status, TRUE);
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(sw->status));
+
+    g_signal_connect(sw->search_button, "clicked", G_CALLBACK(on_search_contents_clicked), sw);
+    g_signal_connect(sw->pattern_entry, "activate", G_CALLBACK(on_search_contents_entry_activated), sw);
+    g_signal_connect(view, "activate", G_CALLBACK(on_search_contents_activated), sw);
+    g_signal_connect(window, "destroy", G_CALLBACK(on_search_contents_destroy), sw);
+    gtk_window_present(GTK_WINDOW(window));
+}
+
+// #############################################################################
+// # Folder Sizes
+// #############################################################################
+
+#define FOLDER_SIZES_FLUSH_MS 200
+
+// The counts arrive on the du workers; a copy of the running totals is
+// shown every FOLDER_SIZES_FLUSH_MS.
+typedef struct {
+    gint ref_count;
+    gboolean closed;
+    MainWindow *mw;
+    gchar *bucket;
+    GtkEntry *prefix_entry;
+    GtkButton *compute_button;
+    GtkStringList *rows;
+    GPtrArray *row_prefixes;    // Prefix of each row in rows
+    GtkLabel *status;
+    GCancellable *cancellable;  // The running computation, or NULL
+    guint flush_id;
+    GMutex lock;                // Guards the fields below
+    S3DuResult *partial;        // Latest copy of the totals, or NULL
+    gint64 partial_time;
+} FolderSizesWindow;
+
+typedef struct {
+    FolderSizesWindow *fw;
+    gchar *endpoint, *access_key, *secret_key, *bucket, *prefix;
+    gboolean use_ssl;
+    S3DuResult *result;
+} FolderSizesJob;
+
+static FolderSizesWindow *folder_sizes_ref(FolderSizesWindow *fw) { g_atomic_int_inc(&fw->ref_count); return fw; }
+
+// Jobs may drop the last reference on their worker thread.
+static void folder_sizes_unref(FolderSizesWindow *fw) {
+    if (!g_atomic_int_dec_and_test(&fw->ref_count)) return;
+    g_free(fw->bucket);
+    g_ptr_array_unref(fw->row_prefixes);
+    g_clear_pointer(&fw->partial, s3_du_result_unref);
+    g_mutex_clear(&fw->lock);
+    g_free(fw);
+}
+
+static void folder_sizes_job_free(FolderSizesJob *job) {
+    folder_sizes_unref(job->fw);
+    g_free(job->endpoint); g_free(job->access_key); g_free(job->secret_key); g_free(job->bucket); g_free(job->prefix);
+    g_clear_pointer(&job->result, s3_du_result_unref);
+    g_free(job);
+}
+
+// Copying the totals costs a pass over the subfolders, so it is done at
+// most once per flush rather than once per page.
+static void on_folder_sizes_progress(const S3DuResult *partial, gpointer user_data) {
+    FolderSizesWindow *fw = (FolderSizesWindow *)user_data;
+    gint64 now = g_get_monotonic_time();
+    g_mutex_lock(&fw->lock);
+    if (now - fw->partial_time >= FOLDER_SIZES_FLUSH_MS * 1000) {
+        g_clear_pointer(&fw->partial, s3_du_result_unref);
+        fw->partial = s3_du_result_copy(partial);
+        fw->partial_time = now;
+    }
+    g_mutex_unlock(&fw->lock);
+}
+
+static gint compare_du_entries_by_bytes(gconstpointer a, gconstpointer b) {
+    const S3DuEntry *x = (const S3DuEntry *)a, *y = (const S3DuEntry *)b;
+    return x->bytes < y->bytes ? 1 : x->bytes > y->bytes ? -1 : 0;
+}
+
+// Lists the subfolders of `du` largest first.
+static void show_folder_sizes(FolderSizesWindow *fw, const S3DuResult *du, const gchar *state) {
+    g_autoptr(GArray) entries = g_array_sized_new(FALSE, FALSE, sizeof(S3DuEntry), du->children->len);
+    g_array_append_vals(entries, du->children->data, du->children->len);
+    g_array_sort(entries, compare_du_entries_by_bytes);
+
+    g_autoptr(GPtrArray) lines = g_ptr_array_new_with_free_func(g_free);
+    g_ptr_array_set_size(fw->row_prefixes, 0);
+    for (guint i = 0; i < entries->len; i++) {
+        const S3DuEntry *entry = &g_array_index(entries, S3DuEntry, i);
+        g_autofree gchar *size = g_format_size(entry->bytes);
+        gboolean loose = g_strcmp0(entry->prefix, du->prefix) == 0;
+        g_ptr_array_add(lines, g_strdup_printf("%10s %12" G_GUINT64_FORMAT "  %s", size, entry->objects, loose ? _("(objects directly in this folder)") : entry->prefix + strlen(du->prefix)));
+        g_ptr_array_add(fw->row_prefixes, g_strdup(loose ? NULL : entry->prefix));
+    }
+    g_ptr_array_add(lines, NULL);
+    gtk_string_list_splice(fw->rows, 0, g_list_model_get_n_items(G_LIST_MODEL(fw->rows)), (const char * const *)lines->pdata);
+
+    g_autofree gchar *total = g_format_size(du->bytes);
+    g_autoptr(GDateTime) dt = du->computed_at ? g_date_time_new_from_unix_local(du->computed_at) : NULL;
+    g_autofree gchar *when = dt ? g_date_time_format(dt, "%Y-%m-%d %H:%M") : NULL;
+    g_autofree gchar *count = g_strdup_printf("%" G_GUINT64_FORMAT, du->objects);
+    g_autofree gchar *msg = when ? g_strdup_printf(_("%s %s objects, %s, computed %s."), state, count, total, when)
+                                 : g_strdup_printf(_("%s %s objects, %s so far."), state, count, total);
+    gtk_label_set_text(fw->status, msg);
+}
+
+static gboolean flush_folder_sizes(gpointer user_data) {
+    FolderSizesWindow *fw = (FolderSizesWindow *)user_data;
+    g_mutex_lock(&fw->lock);
+    S3DuResult *partial = g_steal_pointer(&fw->partial);
+    g_mutex_unlock(&fw->lock);
+    if (partial) {
+        show_folder_sizes(fw, partial, _("Counting:"));
+        s3_du_result_unref(partial);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void folder_sizes_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    (void)source;
+    FolderSizesJob *job = (FolderSizesJob *)task_data;
+    S3DuOptions options = {
+        .endpoint = job->endpoint, .access_key = job->access_key, .secret_key = job->secret_key,
+        .bucket = job->bucket, .prefix = job->prefix, .use_ssl = job->use_ssl,
+        .progress_callback = on_folder_sizes_progress,
+        .user_data = job->fw,
+    };
+    GError *error = NULL;
+    job->result = s3_du_run(&options, cancellable, &error);
+    if (job->result) g_task_return_boolean(task, TRUE);
+    else g_task_return_error(task, error);
+}
+
+static void on_folder_sizes_done(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source; (void)user_data;
+    FolderSizesJob *job = g_task_get_task_data(G_TASK(result));
+    FolderSizesWindow *fw = job->fw;
+    g_autoptr(GError) error = NULL;
+    gboolean ok = g_task_propagate_boolean(G_TASK(result), &error);
+    if (ok) s3_du_cache_store(job->endpoint, job->result);
+    if (fw->closed) return;
+    // A whole-bucket count also fills the bucket's row in the tree.
+    GtkWidget *objects = ok && !*job->prefix ? g_hash_table_lookup(fw->mw->folder_size_labels, job->bucket) : NULL;
+    if (objects) set_folder_size_labels(fw->mw, objects, job->bucket);
+    g_clear_object(&fw->cancellable);
+    g_source_remove(fw->flush_id);
+    fw->flush_id = 0;
+    gtk_button_set_label(fw->compute_button, _("Recount"));
+    if (!ok) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_autofree gchar *msg = g_strdup_printf(_("Counting failed: %s"), error->message);
+            gtk_label_set_text(fw->status, msg);
+        } else {
+            gtk_label_set_text(fw->status, _("Stopped."));
+        }
+        return;
+    }
+    show_folder_sizes(fw, job->result, _("Counted"));
+}
+
+static void start_folder_sizes(FolderSizesWindow *fw) {
+    MainWindow *mw = fw->mw;
+    FolderSizesJob *job = g_new0(FolderSizesJob, 1);
+    job->fw = folder_sizes_ref(fw);
+    job->endpoint = g_strdup(mw->settings->endpoint);
+    job->access_key = g_strdup(mw->access_key);
+    job->secret_key = g_strdup(mw->secret_key);
+    job->bucket = g_strdup(fw->bucket);
+    job->prefix = g_strdup(gtk_editable_get_text(GTK_EDITABLE(fw->prefix_entry)));
+    job->use_ssl = mw->settings->use_ssl;
+
+    g_mutex_lock(&fw->lock);
+    g_clear_pointer(&fw->partial, s3_du_result_unref);
+    fw->partial_time = 0;
+    g_mutex_unlock(&fw->lock);
+    gtk_label_set_text(fw->status, _("Counting..."));
+    gtk_button_set_label(fw->compute_button, _("Stop"));
+    fw->cancellable = g_cancellable_new();
+    fw->flush_id = g_timeout_add(FOLDER_SIZES_FLUSH_MS, flush_folder_sizes, fw);
+
+    GTask *task = g_task_new(NULL, fw->cancellable, on_folder_sizes_done, NULL);
+    g_task_set_task_data(task, job, (GDestroyNotify)folder_sizes_job_free);
+    g_task_run_in_thread(task, folder_sizes_thread);
+    g_object_unref(task);
+}
+
+// Shows the cached sizes of the prefix in the entry, counting them if there
+// are none yet.
+static void load_folder_sizes(FolderSizesWindow *fw) {
+    if (fw->cancellable) return;
+    g_autoptr(S3DuResult) du = s3_du_cache_lookup(fw->mw->settings->endpoint, fw->bucket, gtk_editable_get_text(GTK_EDITABLE(fw->prefix_entry)));
+    if (du) {
+        show_folder_sizes(fw, du, _("Cached:"));
+        gtk_button_set_label(fw->compute_button, _("Recount"));
+    } else {
+        gtk_string_list_splice(fw->rows, 0, g_list_model_get_n_items(G_LIST_MODEL(fw->rows)), NULL);
+        g_ptr_array_set_size(fw->row_prefixes, 0);
+        start_folder_sizes(fw);
+    }
+}
+
+static void on_folder_sizes_compute_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    FolderSizesWindow *fw = (FolderSizesWindow *)user_data;
+    if (fw->cancellable) g_cancellable_cancel(fw->cancellable);
+    else start_folder_sizes(fw);
+}
+
+static void on_folder_sizes_prefix_activated(GtkEntry *entry, gpointer user_data) {
+    (void)entry;
+    load_folder_sizes((FolderSizesWindow *)user_data);
+}
+
+// Opening a subfolder shows its own breakdown.
+static void on_folder_sizes_row_activated(GtkListView *view, guint position, gpointer user_data) {
+    (void)view;
+    FolderSizesWindow *fw = (FolderSizesWindow *)user_data;
+    if (fw->cancellable || position >= fw->row_prefixes->len || !g_ptr_array_index(fw->row_prefixes, position)) return;
+    gtk_editable_set_text(GTK_EDITABLE(fw->prefix_entry), g_ptr_array_index(fw->row_prefixes, position));
+    load_folder_sizes(fw);
+}
+
+static void on_folder_sizes_destroy(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    FolderSizesWindow *fw = (FolderSizesWindow *)user_data;
+    fw->closed = TRUE;
+    if (fw->cancellable) g_cancellable_cancel(fw->cancellable);
+    g_clear_object(&fw->cancellable);
+    if (fw->flush_id) g_source_remove(fw->flush_id);
+    folder_sizes_unref(fw);
+}
+
+static void on_folder_sizes_button_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    MainWindow *mw = (MainWindow *)user_data;
+    GtkSingleSelection *selection = GTK_SINGLE_SELECTION(gtk_list_view_get_model(mw->folder_tree_view));
+    GtkTreeListRow *row = gtk_single_selection_get_selected_item(selection);
+    FolderItem *item = row ? gtk_tree_list_row_get_item(row) : NULL;
+    g_autofree gchar *bucket = g_strdup(item ? item->full_path : mw->current_folder);
+    if (item) g_object_unref(item);
+    if (!bucket || !mw->access_key) {
+        gtk_statusbar_push(mw->statusbar, 0, _("Please select a bucket first."));
+        return;
+    }
+
+    FolderSizesWindow *fw = g_new0(FolderSizesWindow, 1);
+    fw->ref_count = 1;
+    fw->mw = mw;
+    fw->bucket = g_steal_pointer(&bucket);
+    fw->row_prefixes = g_ptr_array_new_with_free_func(g_free);
+    g_mutex_init(&fw->lock);
+
+    GtkWidget *window = gtk_window_new();
+    g_autofree gchar *title = g_strdup_printf(_("Folder Sizes: %s"), fw->bucket);
+    gtk_window_set_title(GTK_WINDOW(window), title);
+    gtk_window_set_transient_for(GTK_WINDOW(window), GTK_WINDOW(mw->window));
+    gtk_window_set_destroy_with_parent(GTK_WINDOW(window), TRUE);
+    gtk_window_set_default_size(GTK_WINDOW(window), 720, 520);
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    gtk_widget_set_margin_start(box, 12);
+    gtk_widget_set_margin_end(box, 12);
+    gtk_widget_set_margin_top(box, 12);
+    gtk_widget_set_margin_bottom(box, 12);
+    gtk_window_set_child(GTK_WINDOW(window), box);
+
+    GtkWidget *toolbar = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    fw->prefix_entry = GTK_ENTRY(gtk_entry_new());
+    gtk_entry_set_placeholder_text(fw->prefix_entry, _("Whole bucket"));
+    gtk_widget_set_hexpand(GTK_WIDGET(fw->prefix_entry), TRUE);
+    fw->compute_button = GTK_BUTTON(gtk_button_new_with_label(_("Count")));
+    gtk_box_append(GTK_BOX(toolbar), gtk_label_new(_("Prefix:")));
+    gtk_box_append(GTK_BOX(toolbar), GTK_WIDGET(fw->prefix_entry));
+    gtk_box_append(GTK_BOX(toolbar), GTK_WIDGET(fw->compute_button));
+    gtk_box_append(GTK_BOX(box), toolbar);
+
+    fw->rows = gtk_string_list_new(NULL);
+    GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(factory, "setup", G_CALLBACK(setup_search_contents_row_cb), NULL);
+    g_signal_connect(factory, "bind", G_CALLBACK(bind_find_result_cb), NULL);
+    GtkWidget *view = gtk_list_view_new(GTK_SELECTION_MODEL(gtk_single_selection_new(G_LIST_MODEL(fw->rows))), factory);
+    GtkWidget *scrolled = gtk_scrolled_window_new();
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), view);
+    gtk_box_append(GTK_BOX(box), scrolled);
+
+    fw->status = GTK_LABEL(gtk_label_new(NULL));
+    gtk_label_set_xalign(fw->status, 0);
+    gtk_label_set_wrap(fw->status, TRUE);
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(fw->status));
+
+    g_signal_connect(fw->compute_button, "clicked", G_CALLBACK(on_folder_sizes_compute_clicked), fw);
+    g_signal_connect(fw->prefix_entry, "activate", G_CALLBACK(on_folder_sizes_prefix_activated), fw);
+    g_signal_connect(view, "activate", G_CALLBACK(on_folder_sizes_row_activated), fw);
+    g_signal_connect(window, "destroy", G_CALLBACK(on_folder_sizes_destroy), fw);
+    gtk_window_present(GTK_WINDOW(window));
+    load_folder_sizes(fw);
+}
+
+// #############################################################################
+// # S3 Select Query
+// #############################################################################
+
+#define QUERY_MAX_ROWS 100000
+#define QUERY_FLUSH_MS 100
+// Joins the fields of a result row inside one GtkStringObject.
+#define QUERY_FIELD_SEPARATOR '\x1f'
+
+// Splits the CSV that S3 Select returns into rows, across event boundaries.
+typedef struct { GString *field; GString *row; guint n_fields; gboolean in_quotes; gboolean quote_pending; } QueryCsvParser;
+
+typedef struct {
+    gint ref_count;
+    gboolean closed;
+    MainWindow *mw;
+    gchar *key;
+    GtkDropDown *format_dropdown;
+    GtkCheckButton *header_check;
+    GtkCheckButton *gzip_check;
+    GtkTextView *expression_view;
+    GtkButton *run_button;
+    GtkColumnView *grid;
+    GtkStringList *rows;
+    guint n_columns;
+    GtkLabel *status;
+    GCancellable *cancellable;  // The running query, or NULL
+    guint flush_id;
+    GMutex lock;                // Guards the fields below
+    GPtrArray *incoming;        // Rows parsed on the worker, waiting for the next flush
+    guint incoming_columns;
+    S3SelectStats progress;
+} QueryWindow;
+
+typedef struct {
+    QueryWindow *qw;
+    gchar *endpoint, *access_key, *secret_key, *bucket, *key, *expression;
+    gboolean use_ssl;
+    S3SelectInputFormat format;
+    gboolean header, gzip;
+    GCancellable *cancellable;
+    QueryCsvParser parser;
+    guint n_rows;
+    S3SelectStats stats;
+} QueryJob;
+
+static QueryWindow *query_window_ref(QueryWindow *qw) { g_atomic_int_inc(&qw->ref_count); return qw; }
+
+// Jobs may drop the last reference on their worker thread.
+static void query_window_unref(QueryWindow *qw) {
+    if (!g_atomic_int_dec_and_test(&qw->ref_count)) return;
+    g_free(qw->key);
+    g_ptr_array_unref(qw->incoming);
+    g_mutex_clear(&qw->lock);
+    g_free(qw);
+}
+
+static void query_job_free(QueryJob *job) {
+    query_window_unref(job->qw);
+    g_free(job->endpoint); g_free(job->access_key); g_free(job->secret_key); g_free(job->bucket); g_free(job->key); g_free(job->expression);
+    g_object_unref(job->cancellable);
+    g_string_free(job->parser.field, TRUE);
+    g_string_free(job->parser.row, TRUE);
+    g_free(job);
+}
+
+static void query_end_field(QueryCsvParser *p) {
+    if (p->n_fields++ > 0) g_string_append_c(p->row, QUERY_FIELD_SEPARATOR);
+    g_string_append_len(p->row, p->field->str, p->field->len);
+    g_string_truncate(p->field, 0);
+}
+
+static void query_end_row(QueryJob *job) {
+    QueryCsvParser *p = &job->parser;
+    query_end_field(p);
+    QueryWindow *qw = job->qw;
+    g_mutex_lock(&qw->lock);
+    g_ptr_array_add(qw->incoming, g_strndup(p->row->str, p->row->len));
+    qw->incoming_columns = MAX(qw->incoming_columns, p->n_fields);
+    g_mutex_unlock(&qw->lock);
+    g_string_truncate(p->row, 0);
+    p->n_fields = 0;
+    job->n_rows++;
+}
+
+static gboolean on_query_records(const gchar *data, gsize length, gpointer user_data) {
+    QueryJob *job = (QueryJob *)user_data;
+    QueryCsvParser *p = &job->parser;
+    for (gsize i = 0; i < length; i++) {
+        gchar c = data[i];
+        if (p->in_quotes) {
+            if (c == '"') { p->in_quotes = FALSE; p->quote_pending = TRUE; }
+            else g_string_append_c(p->field, c);
+            continue;
+        }
+        if (p->quote_pending && c == '"') {
+            // A doubled quote inside a quoted field.
+            g_string_append_c(p->field, '"');
+            p->in_quotes = TRUE;
+            p->quote_pending = FALSE;
+            continue;
+        }
+        p->quote_pending = FALSE;
+        if (c == '"' && p->field->len == 0) {
+            p->in_quotes = TRUE;
+        } else if (c == ',') {
+            query_end_field(p);
+        } else if (c == '\n') {
+            query_end_row(job);
+            if (job->n_rows >= QUERY_MAX_ROWS) return FALSE;
+        } else if (c != '\r') {
+            g_string_append_c(p->field, c);
+        }
+    }
+    return !g_cancellable_is_cancelled(job->cancellable);
+}
+
+static void on_query_stats(const S3SelectStats *stats, gpointer user_data) {
+    QueryWindow *qw = ((QueryJob *)user_data)->qw;
+    g_mutex_lock(&qw->lock);
+    qw->progress = *stats;
+    g_mutex_unlock(&qw->lock);
+}
+
+static void set_query_status(QueryWindow *qw, const S3SelectStats *stats, const gchar *state) {
+    g_autofree gchar *scanned = g_format_size(stats->bytes_scanned);
+    g_autofree gchar *processed = g_format_size(stats->bytes_processed);
+    g_autofree gchar *returned = g_format_size(stats->bytes_returned);
+    guint n_rows = g_list_model_get_n_items(G_LIST_MODEL(qw->rows));
+    g_autofree gchar *msg = g_strdup_printf(_("%s %u rows. Scanned %s, processed %s, returned %s."), state, n_rows, scanned, processed, returned);
+    gtk_label_set_text(qw->status, msg);
+}
+
+static void setup_query_cell_cb(GtkListItemFactory *f, GtkListItem *i) { (void)f; GtkWidget *l = gtk_label_new(NULL); gtk_label_set_xalign(GTK_LABEL(l), 0); gtk_label_set_ellipsize(GTK_LABEL(l), PANGO_ELLIPSIZE_END); gtk_list_item_set_child(i, l); }
+
+static void bind_query_cell_cb(GtkListItemFactory *f, GtkListItem *i, gpointer user_data) {
+    (void)f;
+    guint column = GPOINTER_TO_UINT(user_data);
+    const gchar *field = gtk_string_object_get_string(gtk_list_item_get_item(i));
+    for (guint k = 0; k < column && field; k++) {
+        field = strchr(field, QUERY_FIELD_SEPARATOR);
+        if (field) field++;
+    }
+    if (!field) {
+        gtk_label_set_text(GTK_LABEL(gtk_list_item_get_child(i)), "");
+        return;
+    }
+    const gchar *end = strchr(field, QUERY_FIELD_SEPARATOR);
+    g_autofree gchar *text = g_strndup(field, end ? (gsize)(end - field) : strlen(field));
+    gtk_label_set_text(GTK_LABEL(gtk_list_item_get_child(i)), text);
+}
+
+// S3 Select names result columns _1, _2, ... whatever the source header.
+static void query_add_columns(QueryWindow *qw, guint n_columns) {
+    for (; qw->n_columns < n_columns; qw->n_columns++) {
+        GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+        g_signal_connect(factory, "setup", G_CALLBACK(setup_query_cell_cb), NULL);
+        g_signal_connect(factory, "bind", G_CALLBACK(bind_query_cell_cb), GUINT_TO_POINTER(qw->n_columns));
+        g_autofree gchar *title = g_strdup_printf("_%u", qw->n_columns + 1);
+        GtkColumnViewColumn *column = gtk_column_view_column_new(title, factory);
+        gtk_column_view_column_set_resizable(column, TRUE);
+        gtk_column_view_append_column(qw->grid, column);
+        g_object_unref(column);
+    }
+}
+
+static gboolean flush_query_rows(gpointer user_data) {
+    QueryWindow *qw = (QueryWindow *)user_data;
+    g_mutex_lock(&qw->lock);
+    GPtrArray *rows = qw->incoming;
+    qw->incoming = g_ptr_array_new_with_free_func(g_free);
+    guint n_columns = qw->incoming_columns;
+    S3SelectStats progress = qw->progress;
+    g_mutex_unlock(&qw->lock);
+
+    query_add_columns(qw, n_columns);
+    if (rows->len > 0) {
+        g_ptr_array_add(rows, NULL);
+        gtk_string_list_splice(qw->rows, g_list_model_get_n_items(G_LIST_MODEL(qw->rows)), 0, (const char * const *)rows->pdata);
+    }
+    g_ptr_array_unref(rows);
+    if (qw->cancellable) set_query_status(qw, &progress, _("Running:"));
+    return G_SOURCE_CONTINUE;
+}
+
+static void query_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    (void)source; (void)cancellable;
+    QueryJob *job = (QueryJob *)task_data;
+    GError *error = NULL;
+    if (!s3_client_select_object_content(job->endpoint, job->access_key, job->secret_key, job->bucket, job->key, job->expression, job->format, job->header, job->gzip, job->use_ssl, on_query_records, on_query_stats, job, &job->stats, &error)) {
+        g_task_return_error(task, error);
+        return;
+    }
+    // The last record may lack its newline.
+    if (job->parser.field->len > 0 || job->parser.n_fields > 0) query_end_row(job);
+    g_task_return_boolean(task, TRUE);
+}
+
+static void on_query_done(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source; (void)user_data;
+    QueryJob *job = g_task_get_task_data(G_TASK(result));
+    QueryWindow *qw = job->qw;
+    g_autoptr(GError) error = NULL;
+    gboolean ok = g_task_propagate_boolean(G_TASK(result), &error);
+    if (qw->closed) return;
+    gboolean cancelled = g_cancellable_is_cancelled(qw->cancellable);
+    g_clear_object(&qw->cancellable);
+    flush_query_rows(qw);
+    g_source_remove(qw->flush_id);
+    qw->flush_id = 0;
+    gtk_button_set_label(qw->run_button, _("Run"));
+    if (!ok) {
+        g_autofree gchar *msg = g_strdup_printf(_("Query failed: %s"), error->message);
+        gtk_label_set_text(qw->status, msg);
+        return;
+    }
+    set_query_status(qw, &job->stats, cancelled ? _("Stopped after") : job->n_rows >= QUERY_MAX_ROWS ? _("Row limit reached after") : _("Done:"));
+}
+
+static void on_query_run_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    QueryWindow *qw = (QueryWindow *)user_data;
+    if (qw->cancellable) {
+        g_cancellable_cancel(qw->cancellable);
+        return;
+    }
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(qw->expression_view);
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds(buffer, &start, &end);
+    g_autofree gchar *expression = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
+    if (!*g_strstrip(expression)) return;
+
+    MainWindow *mw = qw->mw;
+    QueryJob *job = g_new0(QueryJob, 1);
+    job->qw = query_window_ref(qw);
+    job->endpoint = g_strdup(mw->settings->endpoint);
+    job->access_key = g_strdup(mw->access_key);
+    job->secret_key = g_strdup(mw->secret_key);
+    job->bucket = g_strdup(mw->settings->bucket);
+    job->key = g_strdup(qw->key);
+    job->expression = g_steal_pointer(&expression);
+    job->use_ssl = mw->settings->use_ssl;
+    job->format = (S3SelectInputFormat)gtk_drop_down_get_selected(qw->format_dropdown);
+    job->header = gtk_check_button_get_active(qw->header_check);
+    job->gzip = gtk_check_button_get_active(qw->gzip_check);
+    job->parser.field = g_string_new(NULL);
+    job->parser.row = g_string_new(NULL);
+
+    // Columns from an earlier query may not fit this one.
+    gtk_string_list_splice(qw->rows, 0, g_list_model_get_n_items(G_LIST_MODEL(qw->rows)), NULL);
+    GListModel *columns = gtk_column_view_get_columns(qw->grid);
+    while (g_list_model_get_n_items(columns) > 0) {
+        g_autoptr(GtkColumnViewColumn) column = g_list_model_get_item(columns, 0);
+        gtk_column_view_remove_column(qw->grid, column);
+    }
+    qw->n_columns = 0;
+    g_mutex_lock(&qw->lock);
+    qw->incoming_columns = 0;
+    memset(&qw->progress, 0, sizeof(qw->progress));
+    g_mutex_unlock(&qw->lock);
+
+    qw->cancellable = g_cancellable_new();
+    job->cancellable = g_object_ref(qw->cancellable);
+    qw->flush_id = g_timeout_add(QUERY_FLUSH_MS, flush_query_rows, qw);
+    gtk_button_set_label(qw->run_button, _("Stop"));
+    gtk_label_set_text(qw->status, _("Running..."));
+
+    GTask *task = g_task_new(NULL, qw->cancellable, on_query_done, NULL);
+    g_task_set_task_data(task, job, (GDestroyNotify)query_job_free);
+    g_task_run_in_thread(task, query_thread);
+    g_object_unref(task);
+}
+
+static void on_query_window_destroy(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    QueryWindow *qw = (QueryWindow *)user_data;
+    qw->closed = TRUE;
+    if (qw->cancellable) g_cancellable_cancel(qw->cancellable);
+    g_clear_object(&qw->cancellable);
+    if (qw->flush_id) g_source_remove(qw->flush_id);
+    query_window_unref(qw);
+}
+
+static void open_query_window(MainWindow *mw, const gchar *key) {
+    QueryWindow *qw = g_new0(QueryWindow, 1);
+    qw->ref_count = 1;
+    qw->mw = mw;
+    qw->key = g_strdup(key);
+    qw->incoming = g_ptr_array_new_with_free_func(g_free);
+    g_mutex_init(&qw->lock);
+
+    GtkWidget *window = gtk_window_new();
+    g_autofree gchar *title = g_strdup_printf(_("Query %s"), key);
+    gtk_window_set_title(GTK_WINDOW(window), title);
+    gtk_window_set_transient_for(GTK_WINDOW(window), GTK_WINDOW(mw->window));
+    gtk_window_set_destroy_with_parent(GTK_WINDOW(window), TRUE);
+    gtk_window_set_default_size(GTK_WINDOW(window), 960, 640);
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    gtk_widget_set_margin_start(box, 12);
+    gtk_widget_set_margin_end(box, 12);
+    gtk_widget_set_margin_top(box, 12);
+    gtk_widget_set_margin_bottom(box, 12);
+    gtk_window_set_child(GTK_WINDOW(window), box);
+
+    const gchar *formats[] = { "CSV", "JSON Lines", "Parquet", NULL };
+    qw->format_dropdown = GTK_DROP_DOWN(gtk_drop_down_new_from_strings(formats));
+    g_autofree gchar *lower = g_ascii_strdown(key, -1);
+    gboolean gzip = g_str_has_suffix(lower, ".gz");
+    if (gzip) lower[strlen(lower) - 3] = '\0';
+    if (g_str_has_suffix(lower, ".json") || g_str_has_suffix(lower, ".jsonl") || g_str_has_suffix(lower, ".ndjson")) gtk_drop_down_set_selected(qw->format_dropdown, S3_SELECT_INPUT_JSON_LINES);
+    else if (g_str_has_suffix(lower, ".parquet")) gtk_drop_down_set_selected(qw->format_dropdown, S3_SELECT_INPUT_PARQUET);
+    qw->header_check = GTK_CHECK_BUTTON(gtk_check_button_new_with_label(_("CSV header row")));
+    gtk_check_button_set_active(qw->header_check, TRUE);
+    qw->gzip_check = GTK_CHECK_BUTTON(gtk_check_button_new_with_label(_("gzip")));
+    gtk_check_button_set_active(qw->gzip_check, gzip);
+    qw->run_button = GTK_BUTTON(gtk_button_new_with_label(_("Run")));
+    GtkWidget *toolbar = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+    gtk_box_append(GTK_BOX(toolbar), GTK_WIDGET(qw->format_dropdown));
+    gtk_box_append(GTK_BOX(toolbar), GTK_WIDGET(qw->header_check));
+    gtk_box_append(GTK_BOX(toolbar), GTK_WIDGET(qw->gzip_check));
+    GtkWidget *spacer = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+    gtk_widget_set_hexpand(spacer, TRUE);
+    gtk_box_append(GTK_BOX(toolbar), spacer);
+    gtk_box_append(GTK_BOX(toolbar), GTK_WIDGET(qw->run_button));
+    gtk_box_append(GTK_BOX(box), toolbar);
+
+    qw->expression_view = GTK_TEXT_VIEW(gtk_text_view_new());
+    gtk_text_view_set_monospace(qw->expression_view, TRUE);
+    gtk_text_buffer_set_text(gtk_text_view_get_buffer(qw->expression_view), "SELECT * FROM S3Object s LIMIT 100", -1);
+    GtkWidget *expression_scrolled = gtk_scrolled_window_new();
+    gtk_scrolled_window_set_min_content_height(GTK_SCROLLED_WINDOW(expression_scrolled), 72);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(expression_scrolled), GTK_WIDGET(qw->expression_view));
+    gtk_box_append(GTK_BOX(box), expression_scrolled);
+
+    qw->rows = gtk_string_list_new(NULL);
+    qw->grid = GTK_COLUMN_VIEW(gtk_column_view_new(GTK_SELECTION_MODEL(gtk_no_selection_new(G_LIST_MODEL(qw->rows)))));
+    gtk_column_view_set_show_column_separators(qw->grid, TRUE);
+    GtkWidget *grid_scrolled = gtk_scrolled_window_new();
+    gtk_widget_set_vexpand(grid_scrolled, TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(grid_scrolled), GTK_WIDGET(qw->grid));
+    gtk_box_append(GTK_BOX(box), grid_scrolled);
+
+    qw->status = GTK_LABEL(gtk_label_new(_("Only the matching records are transferred; the object is scanned on the server.")));
+    gtk_label_set_xalign(qw->status, 0);
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(qw->status));
+
+    g_signal_connect(qw->run_button, "clicked", G_CALLBACK(on_query_run_clicked), qw);
+    g_signal_connect(window, "destroy", G_CALLBACK(on_query_window_destroy), qw);
+    gtk_window_present(GTK_WINDOW(window));
+}
+
+static void on_query_button_clicked(GtkButton *b, gpointer user_data) {
+    (void)b;
+    MainWindow *mw = (MainWindow*)user_data;
+    GtkSelectionModel *selection_model = gtk_list_view_get_model(mw->file_list_view);
+    guint position = gtk_single_selection_get_selected(GTK_SINGLE_SELECTION(selection_model));
+    S3ObjectItem *obj = position != GTK_INVALID_LIST_POSITION ? g_list_model_get_item(G_LIST_MODEL(selection_model), position) : NULL;
+    if (!obj) {
+        gtk_statusbar_push(mw->statusbar, 0, _("Please select a file to query."));
+        return;
+    }
+    open_query_window(mw, s3_object_item_get_key(obj));
+    g_object_unref(obj);
+}
+
+// #############################################################################
+// # CSV Viewer
+// #############################################################################
+
+#define CSV_VIEWER_UPDATE_MS 200
+
+// Streams a CSV object into a CsvTable and shows it in a grid. The first
+// record is taken as the header; a file without one still shows every value,
+// with its first row as column titles.
+typedef struct {
+    gint ref_count;
+    gboolean closed;
+    MainWindow *mw;
+    gchar *key;
+    CsvTable *table;
+    GtkColumnView *grid;
+    GtkLabel *status;
+    GCancellable *cancellable;      // The download
+    GCancellable *sort_cancellable; // The running sort, or NULL
+    guint update_id;
+    guint n_columns;
+    gboolean loaded;
+    gboolean sort_requested;        // A header was clicked while loading
+    gint sort_column;
+    gboolean sort_descending;
+    gint64 started;
+    GMutex lock;                    // Guards the fields below
+    guint64 bytes_received;
+    guint64 total_bytes;
+} CsvViewer;
+
+typedef struct {
+    CsvViewer *cv;
+    gchar *endpoint, *access_key, *secret_key, *bucket, *key;
+    gboolean use_ssl;
+    GCancellable *cancellable;
+    GError *write_error;
+} CsvDownloadJob;
+
+static CsvViewer *csv_viewer_ref(CsvViewer *cv) { g_atomic_int_inc(&cv->ref_count); return cv; }
+
+// Jobs may drop the last reference on their worker thread.
+static void csv_viewer_unref(CsvViewer *cv) {
+    if (!g_atomic_int_dec_and_test(&cv->ref_count)) return;
+    g_free(cv->key);
+    g_object_unref(cv->table);
+    g_mutex_clear(&cv->lock);
+    g_free(cv);
+}
+
+static void csv_download_job_free(CsvDownloadJob *job) {
+    csv_viewer_unref(job->cv);
+    g_free(job->endpoint); g_free(job->access_key); g_free(job->secret_key); g_free(job->bucket); g_free(job->key);
+    g_object_unref(job->cancellable);
+    g_clear_error(&job->write_error);
+    g_free(job);
+}
+
+static gboolean on_csv_download_chunk(const gchar *data, gsize length, guint64 total_bytes, gpointer user_data) {
+    CsvDownloadJob *job = (CsvDownloadJob *)user_data;
+    if (!csv_table_write(job->cv->table, data, length, &job->write_error)) return FALSE;
+    g_mutex_lock(&job->cv->lock);
+    job->cv->bytes_received += length;
+    job->cv->total_bytes = total_bytes;
+    g_mutex_unlock(&job->cv->lock);
+    return !g_cancellable_is_cancelled(job->cancellable);
+}
+
+static void csv_download_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    (void)source; (void)cancellable;
+    CsvDownloadJob *job = (CsvDownloadJob *)task_data;
+    GError *error = NULL;
+    gboolean ok = s3_client_download_object_streaming(job->endpoint, job->access_key, job->secret_key, job->bucket, job->key, job->use_ssl, on_csv_download_chunk, job, &error);
+    // Whatever arrived stays viewable, even after a failure.
+    csv_table_write_finish(job->cv->table);
+    if (job->write_error) {
+        g_clear_error(&error);
+        g_task_return_error(task, g_steal_pointer(&job->write_error));
+    } else if (!ok) {
+        g_task_return_error(task, error);
+    } else {
+        g_task_return_boolean(task, TRUE);
+    }
+}
+
+static void setup_csv_cell_cb(GtkListItemFactory *f, GtkListItem *i) { (void)f; GtkWidget *l = gtk_label_new(NULL); gtk_label_set_xalign(GTK_LABEL(l), 0); gtk_label_set_ellipsize(GTK_LABEL(l), PANGO_ELLIPSIZE_END); gtk_list_item_set_child(i, l); }
+
+static void bind_csv_cell_cb(GtkListItemFactory *f, GtkListItem *i, gpointer user_data) {
+    (void)f;
+    CsvRow *row = CSV_ROW(gtk_list_item_get_item(i));
+    gtk_label_set_text(GTK_LABEL(gtk_list_item_get_child(i)), csv_row_get_field(row, GPOINTER_TO_UINT(user_data)));
+}
+
+// Column headers only record which column to sort by; the CsvTable sorts.
+static int csv_keep_order(gconstpointer a, gconstpointer b, gpointer user_data) { (void)a; (void)b; (void)user_data; return 0; }
+
+static void csv_viewer_add_columns(CsvViewer *cv) {
+    guint n_columns = csv_table_get_n_columns(cv->table);
+    for (; cv->n_columns < n_columns; cv->n_columns++) {
+        GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+        g_signal_connect(factory, "setup", G_CALLBACK(setup_csv_cell_cb), NULL);
+        g_signal_connect(factory, "bind", G_CALLBACK(bind_csv_cell_cb), GUINT_TO_POINTER(cv->n_columns));
+        const gchar *header = csv_table_get_column_title(cv->table, cv->n_columns);
+        g_autofree gchar *title = header && *header ? g_strdup(header) : g_strdup_printf(_("Column %u"), cv->n_columns + 1);
+        GtkColumnViewColumn *column = gtk_column_view_column_new(title, factory);
+        gtk_column_view_column_set_resizable(column, TRUE);
+        g_autoptr(GtkSorter) sorter = GTK_SORTER(gtk_custom_sorter_new(csv_keep_order, NULL, NULL));
+        gtk_column_view_column_set_sorter(column, sorter);
+        g_object_set_data(G_OBJECT(column), "csv-column", GUINT_TO_POINTER(cv->n_columns));
+        gtk_column_view_append_column(cv->grid, column);
+        g_object_unref(column);
+    }
+}
+
+static void set_csv_viewer_status(CsvViewer *cv, const gchar *state) {
+    g_mutex_lock(&cv->lock);
+    guint64 received = cv->bytes_received, total = cv->total_bytes;
+    g_mutex_unlock(&cv->lock);
+    guint n_rows = g_list_model_get_n_items(G_LIST_MODEL(cv->table));
+    g_autofree gchar *done = g_format_size(received);
+    g_autofree gchar *msg = NULL;
+    if (cv->loaded) {
+        msg = g_strdup_printf(_("%s%u rows, %s in %.1f s."), state ? state : "", n_rows, done, (g_get_monotonic_time() - cv->started) / (gdouble)G_USEC_PER_SEC);
+    } else {
+        g_autofree gchar *size = g_format_size(total);
+        msg = g_strdup_printf(_("%s%u rows, %s of %s loaded..."), state ? state : "", n_rows, done, total ? size : "?");
+    }
+    gtk_label_set_text(cv->status, msg);
+}
+
+static gboolean update_csv_viewer(gpointer user_data) {
+    CsvViewer *cv = (CsvViewer *)user_data;
+    csv_table_update(cv->table);
+    csv_viewer_add_columns(cv);
+    set_csv_viewer_status(cv, NULL);
+    return G_SOURCE_CONTINUE;
+}
+
+static void on_csv_sort_done(GObject *source, GAsyncResult *result, gpointer user_data) {
+    CsvViewer *cv = (CsvViewer *)user_data;
+    g_autoptr(GError) error = NULL;
+    gboolean ok = csv_table_sort_finish(CSV_TABLE(source), result, &error);
+    if (!cv->closed && !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_clear_object(&cv->sort_cancellable);
+        if (ok) {
+            set_csv_viewer_status(cv, NULL);
+        } else {
+            g_autofree gchar *msg = g_strdup_printf(_("Sort failed: %s"), error->message);
+            gtk_label_set_text(cv->status, msg);
+        }
+    }
+    csv_viewer_unref(cv);
+}
+
+static void csv_viewer_sort(CsvViewer *cv) {
+    if (cv->sort_cancellable) g_cancellable_cancel(cv->sort_cancellable);
+    g_clear_object(&cv->sort_cancellable);
+    cv->sort_requested = FALSE;
+    cv->sort_cancellable = g_cancellable_new();
+    gtk_label_set_text(cv->status, _("Sorting..."));
+    csv_table_sort_async(cv->table, cv->sort_column, cv->sort_descending, cv->sort_cancellable, on_csv_sort_done, csv_viewer_ref(cv));
+}
+
+static void on_csv_sorter_changed(GtkSorter *sorter, GtkSorterChange change, gpointer user_data) {
+    (void)change;
+    CsvViewer *cv = (CsvViewer *)user_data;
+    GtkColumnViewColumn *column = gtk_column_view_sorter_get_primary_sort_column(GTK_COLUMN_VIEW_SORTER(sorter));
+    cv->sort_column = column ? (gint)GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(column), "csv-column")) : -1;
+    cv->sort_descending = gtk_column_view_sorter_get_primary_sort_order(GTK_COLUMN_VIEW_SORTER(sorter)) == GTK_SORT_DESCENDING;
+    if (cv->loaded) {
+        csv_viewer_sort(cv);
+    } else {
+        // Sorting reads every row, so it waits for the download.
+        cv->sort_requested = TRUE;
+        set_csv_viewer_status(cv, _("Sorting once loaded. "));
+    }
+}
+
+static void on_csv_download_done(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source; (void)user_data;
+    CsvDownloadJob *job = g_task_get_task_data(G_TASK(result));
+    CsvViewer *cv = job->cv;
+    g_autoptr(GError) error = NULL;
+    gboolean ok = g_task_propagate_boolean(G_TASK(result), &error);
+    if (cv->closed) return;
+    g_source_remove(cv->update_id);
+    cv->update_id = 0;
+    csv_table_update(cv->table);
+    cv->loaded = TRUE;
+    csv_viewer_add_columns(cv);
+    if (!ok) {
+        g_autofree gchar *msg = g_strdup_printf(_("Download failed: %s. "), error->message);
+        set_csv_viewer_status(cv, msg);
+        return;
+    }
+    set_csv_viewer_status(cv, NULL);
+    if (cv->sort_requested) csv_viewer_sort(cv);
+}
+
+static void on_csv_viewer_destroy(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    CsvViewer *cv = (CsvViewer *)user_data;
+    cv->closed = TRUE;
+    g_cancellable_cancel(cv->cancellable);
+    g_clear_object(&cv->cancellable);
+    if (cv->sort_cancellable) g_cancellable_cancel(cv->sort_cancellable);
+    g_clear_object(&cv->sort_cancellable);
+    if (cv->update_id) g_source_remove(cv->update_id);
+    g_signal_handlers_disconnect_by_data(gtk_column_view_get_sorter(cv->grid), cv);
+    csv_viewer_unref(cv);
+}
+
+static void open_csv_viewer(MainWindow *mw, const gchar *key, gchar delimiter) {
+    g_autoptr(GError) error = NULL;
+    CsvTable *table = csv_table_new(delimiter, TRUE, &error);
+    if (!table) {
+        g_autofree gchar *msg = g_strdup_printf(_("Cannot open %s: %s"), key, error->message);
+        gtk_statusbar_push(mw->statusbar, 0, msg);
+        return;
+    }
+    CsvViewer *cv = g_new0(CsvViewer, 1);
+    cv->ref_count = 1;
+    cv->mw = mw;
+    cv->key = g_strdup(key);
+    cv->table = table;
+    cv->sort_column = -1;
+    cv->started = g_get_monotonic_time();
+    g_mutex_init(&cv->lock);
+
+    GtkWidget *window = gtk_window_new();
+    gtk_window_set_title(GTK_WINDOW(window), key);
+    gtk_window_set_transient_for(GTK_WINDOW(window), GTK_WINDOW(mw->window));
+    gtk_window_set_destroy_with_parent(GTK_WINDOW(window), TRUE);
+    gtk_window_set_default_size(GTK_WINDOW(window), 960, 640);
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    gtk_widget_set_margin_start(box, 12);
+    gtk_widget_set_margin_end(box, 12);
+    gtk_widget_set_margin_top(box, 12);
+    gtk_widget_set_margin_bottom(box, 12);
+    gtk_window_set_child(GTK_WINDOW(window), box);
+
+    cv->grid = GTK_COLUMN_VIEW(gtk_column_view_new(GTK_SELECTION_MODEL(gtk_no_selection_new(G_LIST_MODEL(g_object_ref(table))))));
+    gtk_column_view_set_show_column_separators(cv->grid, TRUE);
+    gtk_column_view_set_show_row_separators(cv->grid, TRUE);
+    GtkWidget *scrolled = gtk_scrolled_window_new();
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), GTK_WIDGET(cv->grid));
+    gtk_box_append(GTK_BOX(box), scrolled);
+
+    cv->status = GTK_LABEL(gtk_label_new(_("Loading...")));
+    gtk_label_set_xalign(cv->status, 0);
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(cv->status));
+
+    CsvDownloadJob *job = g_new0(CsvDownloadJob, 1);
+    job->cv = csv_viewer_ref(cv);
+    job->endpoint = g_strdup(mw->settings->endpoint);
+    job->access_key = g_strdup(mw->access_key);
+    job->secret_key = g_strdup(mw->secret_key);
+    job->bucket = g_strdup(mw->settings->bucket);
+    job->key = g_strdup(key);
+    job->use_ssl = mw->settings->use_ssl;
+    cv->cancellable = g_cancellable_new();
+    job->cancellable = g_object_ref(cv->cancellable);
+    cv->update_id = g_timeout_add(CSV_VIEWER_UPDATE_MS, update_csv_viewer, cv);
+
+    g_signal_connect(gtk_column_view_get_sorter(cv->grid), "changed", G_CALLBACK(on_csv_sorter_changed), cv);
+    g_signal_connect(window, "destroy", G_CALLBACK(on_csv_viewer_destroy), cv);
+    gtk_window_present(GTK_WINDOW(window));
+
+    GTask *task = g_task_new(NULL, cv->cancellable, on_csv_download_done, NULL);
+    g_task_set_task_data(task, job, (GDestroyNotify)csv_download_job_free);
+    g_task_run_in_thread(task, csv_download_thread);
+    g_object_unref(task);
+}
+
+// #############################################################################
+// # Parquet Viewer
+// #############################################################################
+
+// Columns shown when a file opens; the rest are one click away in the
+// Columns menu. Hidden columns are never fetched.
+#define PARQUET_VIEWER_INITIAL_COLUMNS 12
+
+typedef struct _ParquetViewer ParquetViewer;
+
+typedef struct {
+    ParquetViewer *pv;
+    guint index;
+    GtkColumnViewColumn *column;
+    gboolean shown;
+} ParquetViewerColumn;
+
+struct _ParquetViewer {
+    gint ref_count;
+    gboolean closed;
+    MainWindow *mw;
+    gchar *key;
+    guint64 size;
+    ParquetTable *table;
+    GCancellable *cancellable;
+    GtkColumnView *grid;
+    GtkLabel *summary;
+    GtkLabel *schema;
+    GtkBox *columns_box;
+    GtkLabel *status;
+    GPtrArray *columns;     // ParquetViewerColumn
+};
+
+static ParquetViewer *parquet_viewer_ref(ParquetViewer *pv) { g_atomic_int_inc(&pv->ref_count); return pv; }
+
+static void parquet_viewer_column_free(ParquetViewerColumn *column) {
+    g_object_unref(column->column);
+    g_free(column);
+}
+
+static void parquet_viewer_unref(ParquetViewer *pv) {
+    if (!g_atomic_int_dec_and_test(&pv->ref_count)) return;
+    if (pv->table) g_signal_handlers_disconnect_by_data(pv->table, pv);
+    g_clear_object(&pv->table);
+    g_ptr_array_unref(pv->columns);
+    g_free(pv->key);
+    g_free(pv);
+}
+
+static void setup_parquet_cell_cb(GtkListItemFactory *f, GtkListItem *i) { (void)f; GtkWidget *l = gtk_label_new(NULL); gtk_label_set_xalign(GTK_LABEL(l), 0); gtk_label_set_ellipsize(GTK_LABEL(l), PANGO_ELLIPSIZE_END); gtk_list_item_set_child(i, l); }
+
+static void bind_parquet_cell_cb(GtkListItemFactory *f, GtkListItem *i, gpointer user_data) {
+    (void)f;
+    ParquetViewerColumn *column = (ParquetViewerColumn *)user_data;
+    GtkWidget *label = gtk_list_item_get_child(i);
+    guint64 row = parquet_row_get_index(PARQUET_ROW(gtk_list_item_get_item(i)));
+    ParquetCellState state;
+    const gchar *value = parquet_table_get_cell(column->pv->table, row, column->index, &state);
+    gtk_widget_remove_css_class(label, "dim-label");
+    gtk_widget_remove_css_class(label, "error");
+    gtk_widget_set_tooltip_text(label, NULL);
+    if (state == PARQUET_CELL_PENDING) {
+        gtk_label_set_text(GTK_LABEL(label), "\xe2\x80\xa6");
+        gtk_widget_add_css_class(label, "dim-label");
+    } else if (state == PARQUET_CELL_FAILED) {
+        gtk_label_set_text(GTK_LABEL(label), value);
+        gtk_widget_set_tooltip_text(label, value);
+        gtk_widget_add_css_class(label, "error");
+    } else if (!value) {
+        gtk_label_set_text(GTK_LABEL(label), "null");
+        gtk_widget_add_css_class(label, "dim-label");
+    } else {
+        gtk_label_set_text(GTK_LABEL(label), value);
+    }
+}
+
+static void update_parquet_viewer_status(ParquetViewer *pv) {
+    g_autofree gchar *fetched = g_format_size(parquet_table_get_bytes_fetched(pv->table));
+    g_autofree gchar *size = g_format_size(pv->size);
+    g_autofree gchar *msg = g_strdup_printf(_("Transferred %s of %s in %u range requests."), fetched, size, parquet_table_get_n_requests(pv->table));
+    gtk_label_set_text(pv->status, msg);
+}
+
+static void on_parquet_table_items_changed(GListModel *model, guint position, guint removed, guint added, gpointer user_data) {
+    (void)model; (void)position; (void)removed; (void)added;
+    update_parquet_viewer_status((ParquetViewer *)user_data);
+}
+
+static void on_parquet_column_toggled(GtkCheckButton *check, gpointer user_data) {
+    ParquetViewerColumn *column = (ParquetViewerColumn *)user_data;
+    ParquetViewer *pv = column->pv;
+    gboolean shown = gtk_check_button_get_active(check);
+    if (shown == column->shown) return;
+    column->shown = shown;
+    if (!shown) {
+        gtk_column_view_remove_column(pv->grid, column->column);
+        return;
+    }
+    // Keep file order among the shown columns.
+    guint position = 0;
+    for (guint i = 0; i < column->index; i++) {
+        if (((ParquetViewerColumn *)g_ptr_array_index(pv->columns, i))->shown) position++;
+    }
+    gtk_column_view_insert_column(pv->grid, position, column->column);
+}
+
+static void parquet_viewer_show_file(ParquetViewer *pv) {
+    const ParquetFile *file = parquet_table_get_file(pv->table);
+    guint n_columns = parquet_file_get_n_columns(file);
+    const gchar *created_by = parquet_file_get_created_by(file);
+    g_autofree gchar *summary = g_strdup_printf(_("%" G_GUINT64_FORMAT " rows, %u columns, %u row groups%s%s"), parquet_file_get_n_rows(file), n_columns, parquet_file_get_n_row_groups(file), created_by ? _(", written by ") : "", created_by ? created_by : "");
+    gtk_label_set_text(pv->summary, summary);
+
+    GString *schema = g_string_new(NULL);
+    for (guint c = 0; c < n_columns; c++) {
+        const gchar *name = parquet_file_get_column_name(file, c);
+        const gchar *type = parquet_file_get_column_type(file, c);
+        g_autofree gchar *min = NULL, *max = NULL;
+        guint64 null_count, compressed;
+        parquet_file_get_column_statistics(file, c, &min, &max, &null_count, &compressed);
+        g_autofree gchar *size = g_format_size(compressed);
+        g_string_append_printf(schema, "%s\t%s\t%s", name, type, size);
+        if (min && max) g_string_append_printf(schema, _("\tmin %s, max %s"), min, max);
+        if (null_count) g_string_append_printf(schema, _("\t%" G_GUINT64_FORMAT " nulls"), null_count);
+        if (c + 1 < n_columns) g_string_append_c(schema, '\n');
+
+        ParquetViewerColumn *column = g_new0(ParquetViewerColumn, 1);
+        column->pv = pv;
+        column->index = c;
+        GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+        g_signal_connect(factory, "setup", G_CALLBACK(setup_parquet_cell_cb), NULL);
+        g_signal_connect(factory, "bind", G_CALLBACK(bind_parquet_cell_cb), column);
+        column->column = gtk_column_view_column_new(name, factory);
+        gtk_column_view_column_set_resizable(column->column, TRUE);
+        g_ptr_array_add(pv->columns, column);
+
+        g_autofree gchar *label = g_strdup_printf("%s (%s)", name, type);
+        GtkWidget *check = gtk_check_button_new_with_label(label);
+        gtk_box_append(pv->columns_box, check);
+        g_signal_connect(check, "toggled", G_CALLBACK(on_parquet_column_toggled), column);
+        gtk_check_button_set_active(GTK_CHECK_BUTTON(check), c < PARQUET_VIEWER_INITIAL_COLUMNS);
+    }
+    gtk_label_set_text(pv->schema, schema->str);
+    g_string_free(schema, TRUE);
+
+    gtk_column_view_set_model(pv->grid, GTK_SELECTION_MODEL(gtk_no_selection_new(G_LIST_MODEL(g_object_ref(pv->table)))));
+    g_signal_connect(pv->table, "items-changed", G_CALLBACK(on_parquet_table_items_changed), pv);
+    update_parquet_viewer_status(pv);
+}
+
+static void on_parquet_table_opened(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source;
+    ParquetViewer *pv = (ParquetViewer *)user_data;
+    g_autoptr(GError) error = NULL;
+    ParquetTable *table = parquet_table_open_finish(result, &error);
+    if (pv->closed) {
+        g_clear_object(&table);
+    } else if (!table) {
+        g_autofree gchar *msg = g_strdup_printf(_("Cannot read the Parquet footer: %s"), error->message);
+        gtk_label_set_text(pv->status, msg);
+    } else {
+        pv->table = table;
+        parquet_viewer_show_file(pv);
+    }
+    parquet_viewer_unref(pv);
+}
+
+static void on_parquet_viewer_destroy(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    ParquetViewer *pv = (ParquetViewer *)user_data;
+    pv->closed = TRUE;
+    g_cancellable_cancel(pv->cancellable);
+    g_clear_object(&pv->cancellable);
+    if (pv->table) parquet_table_cancel(pv->table);
+    parquet_viewer_unref(pv);
+}
+
+static void open_parquet_viewer(MainWindow *mw, const gchar *key, guint64 size) {
+    ParquetViewer *pv = g_new0(ParquetViewer, 1);
+    pv->ref_count = 1;
+    pv->mw = mw;
+    pv->key = g_strdup(key);
+    pv->size = size;
+    pv->columns = g_ptr_array_new_with_free_func((GDestroyNotify)parquet_viewer_column_free);
+    pv->cancellable = g_cancellable_new();
+
+    GtkWidget *window = gtk_window_new();
+    gtk_window_set_title(GTK_WINDOW(window), key);
+    gtk_window_set_transient_for(GTK_WINDOW(window), GTK_WINDOW(mw->window));
+    gtk_window_set_destroy_with_parent(GTK_WINDOW(window), TRUE);
+    gtk_window_set_default_size(GTK_WINDOW(window), 1024, 680);
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    gtk_widget_set_margin_start(box, 12);
+    gtk_widget_set_margin_end(box, 12);
+    gtk_widget_set_margin_top(box, 12);
+    gtk_widget_set_margin_bottom(box, 12);
+    gtk_window_set_child(GTK_WINDOW(window), box);
+
+    GtkWidget *toolbar = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+    pv->summary = GTK_LABEL(gtk_label_new(NULL));
+    gtk_label_set_xalign(pv->summary, 0);
+    gtk_label_set_ellipsize(pv->summary, PANGO_ELLIPSIZE_END);
+    gtk_widget_set_hexpand(GTK_WIDGET(pv->summary), TRUE);
+    gtk_box_append(GTK_BOX(toolbar), GTK_WIDGET(pv->summary));
+    pv->columns_box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_VERTICAL, 2));
+    GtkWidget *columns_scrolled = gtk_scrolled_window_new();
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(columns_scrolled), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_scrolled_window_set_max_content_height(GTK_SCROLLED_WINDOW(columns_scrolled), 480);
+    gtk_scrolled_window_set_propagate_natural_height(GTK_SCROLLED_WINDOW(columns_scrolled), TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(columns_scrolled), GTK_WIDGET(pv->columns_box));
+    GtkWidget *popover = gtk_popover_new();
+    gtk_popover_set_child(GTK_POPOVER(popover), columns_scrolled);
+    GtkWidget *columns_button = gtk_menu_button_new();
+    gtk_menu_button_set_label(GTK_MENU_BUTTON(columns_button), _("Columns"));
+    gtk_menu_button_set_popover(GTK_MENU_BUTTON(columns_button), popover);
+    gtk_box_append(GTK_BOX(toolbar), columns_button);
+    gtk_box_append(GTK_BOX(box), toolbar);
+
+    pv->schema = GTK_LABEL(gtk_label_new(NULL));
+    gtk_label_set_xalign(pv->schema, 0);
+    gtk_label_set_selectable(pv->schema, TRUE);
+    gtk_widget_add_css_class(GTK_WIDGET(pv->schema), "monospace");
+    GtkWidget *expander = gtk_expander_new(_("Schema and statistics"));
+    gtk_expander_set_child(GTK_EXPANDER(expander), GTK_WIDGET(pv->schema));
+    gtk_box_append(GTK_BOX(box), expander);
+
+    pv->grid = GTK_COLUMN_VIEW(gtk_column_view_new(NULL));
+    gtk_column_view_set_show_column_separators(pv->grid, TRUE);
+    gtk_column_view_set_show_row_separators(pv->grid, TRUE);
+    GtkWidget *scrolled = gtk_scrolled_window_new();
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), GTK_WIDGET(pv->grid));
+    gtk_box_append(GTK_BOX(box), scrolled);
+
+    pv->status = GTK_LABEL(gtk_label_new(_("Reading the footer...")));
+    gtk_label_set_xalign(pv->status, 0);
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(pv->status));
+
+    g_signal_connect(window, "destroy", G_CALLBACK(on_parquet_viewer_destroy), pv);
+    gtk_window_present(GTK_WINDOW(window));
+
+    parquet_table_open_async(mw->settings->endpoint, mw->access_key, mw->secret_key, mw->settings->bucket, key, mw->settings->use_ssl, size, pv->cancellable, on_parquet_table_opened, parquet_viewer_ref(pv));
+}
+
+// #############################################################################
+// # Range Viewer
+// #############################################################################
+
+// Bytes fetched per Range GET and shown at once.
+#define VIEWER_WINDOW_BYTES (256 * 1024)
+#define VIEWER_HEX_ROW 16
+// Windows kept around the displayed one for read-ahead.
+#define VIEWER_CACHE_RADIUS 2
+#define VIEWER_FOLLOW_INTERVAL_SECONDS 2
+#define VIEWER_SEEK_DELAY_MS 150
+
+typedef enum { VIEWER_SCROLL_TOP, VIEWER_SCROLL_BOTTOM } ViewerScroll;
+
+// Read-only view of one window of an object. Only the displayed window and its
+// neighbours are ever downloaded, each with its own Range GET.
+typedef struct {
+    gint ref_count;
+    gboolean closed;        // The window is gone; pending fetches only drop their result
+    gchar *endpoint, *access_key, *secret_key, *bucket, *key;
+    gboolean use_ssl;
+    guint64 size;
+    guint64 offset;         // Start of the displayed window
+    ViewerScroll scroll;
+    gboolean hex;
+    gboolean following;
+    gboolean head_pending;
+    GHashTable *cache;      // guint64 window offset -> GBytes
+    GHashTable *pending;    // guint64 window offsets being fetched
+    guint generation;       // Bumped when the cache is dropped; older fetches are discarded
+    GtkTextView *view;
+    GtkScrolledWindow *scrolled;
+    GtkAdjustment *position;
+    gulong position_handler;
+    GtkLabel *status;
+    guint seek_id;
+    guint follow_id;
+} RangeViewer;
+
+typedef struct { RangeViewer *viewer; guint64 offset; guint64 size; guint generation; } ViewerFetch;
+
+static RangeViewer *range_viewer_ref(RangeViewer *v) { g_atomic_int_inc(&v->ref_count); return v; }
+
+// A GTask may release the last reference on its worker thread.
+static void range_viewer_unref(RangeViewer *v) {
+    if (!g_atomic_int_dec_and_test(&v->ref_count)) return;
+    g_hash_table_unref(v->cache);
+    g_hash_table_unref(v->pending);
+    g_free(v->endpoint); g_free(v->access_key); g_free(v->secret_key); g_free(v->bucket); g_free(v->key);
+    g_free(v);
+}
+
+static void viewer_fetch_free(ViewerFetch *fetch) { range_viewer_unref(fetch->viewer); g_free(fetch); }
+
+static guint64 viewer_last_window(const RangeViewer *v) { return v->size > VIEWER_WINDOW_BYTES ? v->size - VIEWER_WINDOW_BYTES : 0; }
+
+static gchar *format_hex_window(const guint8 *data, gsize length, guint64 base) {
+    GString *text = g_string_sized_new((length / VIEWER_HEX_ROW + 1) * 80);
+    for (gsize row = 0; row < length; row += VIEWER_HEX_ROW) {
+        gsize n = MIN(VIEWER_HEX_ROW, length - row);
+        g_string_append_printf(text, "%010" G_GINT64_MODIFIER "x  ", base + row);
+        for (gsize i = 0; i < VIEWER_HEX_ROW; i++) {
+            if (i < n) g_string_append_printf(text, "%02x ", data[row + i]);
+            else g_string_append(text, "   ");
+            if (i == 7) g_string_append_c(text, ' ');
+        }
+        g_string_append(text, " |");
+        for (gsize i = 0; i < n; i++) g_string_append_c(text, g_ascii_isprint(data[row + i]) ? data[row + i] : '.');
+        g_string_append(text, "|\n");
+    }
+    return g_string_free(text, FALSE);
+}
+
+static void viewer_set_status(RangeViewer *v) {
+    guint64 end = MIN(v->offset + VIEWER_WINDOW_BYTES, v->size);
+    g_autofree gchar *from = g_format_size(v->offset);
+    g_autofree gchar *to = g_format_size(end);
+    g_autofree gchar *total = g_format_size(v->size);
+    g_autofree gchar *msg = g_strdup_printf(_("%s – %s of %s%s"), from, to, total, v->following ? _(" (following)") : "");
+    gtk_label_set_text(v->status, msg);
+}
+
+static void viewer_prefetch(RangeViewer *v);
+
+static void viewer_show(RangeViewer *v, GBytes *bytes) {
+    gint64 span = trace_begin();
+    gsize length = 0;
+    const guint8 *data = g_bytes_get_data(bytes, &length);
+    // A text window may start or end inside a multi-byte character; those few
+    // bytes show as replacement characters.
+    g_autofree gchar *text = v->hex ? format_hex_window(data, length, v->offset) : g_utf8_make_valid((const gchar *)data, length);
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(v->view);
+    gtk_text_buffer_set_text(buffer, text, -1);
+    GtkTextIter iter;
+    if (v->scroll == VIEWER_SCROLL_BOTTOM) gtk_text_buffer_get_end_iter(buffer, &iter);
+    else gtk_text_buffer_get_start_iter(buffer, &iter);
+    gtk_text_buffer_place_cursor(buffer, &iter);
+    gtk_text_view_scroll_to_mark(v->view, gtk_text_buffer_get_insert(buffer), 0, FALSE, 0, 0);
+
+    g_signal_handler_block(v->position, v->position_handler);
+    gtk_adjustment_configure(v->position, v->offset, 0, MAX(v->size, 1), VIEWER_WINDOW_BYTES / 4, VIEWER_WINDOW_BYTES, MIN(VIEWER_WINDOW_BYTES, MAX(v->size, 1)));
+    g_signal_handler_unblock(v->position, v->position_handler);
+    viewer_set_status(v);
+    viewer_prefetch(v);
+    trace_end_detail(span, "ui", "range_viewer_show", v->key);
+}
+
+static void viewer_fetch_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    (void)source; (void)cancellable;
+    ViewerFetch *fetch = (ViewerFetch *)task_data;
+    RangeViewer *v = fetch->viewer;
+    GError *error = NULL;
+    GBytes *bytes = s3_client_download_range(v->endpoint, v->access_key, v->secret_key, v->bucket, v->key, fetch->offset, VIEWER_WINDOW_BYTES, v->use_ssl, &fetch->size, &error);
+    if (bytes) g_task_return_pointer(task, bytes, (GDestroyNotify)g_bytes_unref);
+    else g_task_return_error(task, error);
+}
+
+static void on_viewer_fetched(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source; (void)user_data;
+    ViewerFetch *fetch = g_task_get_task_data(G_TASK(result));
+    RangeViewer *v = fetch->viewer;
+    g_autoptr(GError) error = NULL;
+    GBytes *bytes = g_task_propagate_pointer(G_TASK(result), &error);
+    if (fetch->generation != v->generation) {
+        // Started before the object changed size; its bytes may be stale.
+        if (bytes) g_bytes_unref(bytes);
+        return;
+    }
+    g_hash_table_remove(v->pending, &fetch->offset);
+    if (v->closed) {
+        if (bytes) g_bytes_unref(bytes);
+        return;
+    }
+    if (!bytes) {
+        if (fetch->offset == v->offset) {
+            g_autofree gchar *msg = g_strdup_printf(_("Failed to read %s: %s"), v->key, error->message);
+            gtk_label_set_text(v->status, msg);
+        }
+        return;
+    }
+    g_hash_table_insert(v->cache, g_memdup2(&fetch->offset, sizeof(guint64)), bytes);
+    if (fetch->offset == v->offset) viewer_show(v, bytes);
+}
+
+static void viewer_fetch(RangeViewer *v, guint64 offset) {
+    if (offset >= v->size || g_hash_table_contains(v->cache, &offset) || g_hash_table_contains(v->pending, &offset)) return;
+    g_hash_table_add(v->pending, g_memdup2(&offset, sizeof(guint64)));
+    ViewerFetch *fetch = g_new0(ViewerFetch, 1);
+    fetch->viewer = range_viewer_ref(v);
+    fetch->offset = offset;
+    fetch->generation = v->generation;
+    GTask *task = g_task_new(NULL, NULL, on_viewer_fetched, NULL);
+    g_task_set_task_data(task, fetch, (GDestroyNotify)viewer_fetch_free);
+    g_task_run_in_thread(task, viewer_fetch_thread);
+    g_object_unref(task);
+}
+
+static gboolean viewer_window_is_stale(gpointer key, gpointer value, gpointer user_data) {
+    (void)value;
+    guint64 offset = *(guint64 *)key, current = *(guint64 *)user_data;
+    guint64 distance = offset > current ? offset - current : current - offset;
+    return distance > VIEWER_CACHE_RADIUS * (guint64)VIEWER_WINDOW_BYTES;
+}
+
+// Reads the windows on either side of the displayed one so paging through
+// the object shows cached data, and drops windows that fell out of range.
+static void viewer_prefetch(RangeViewer *v) {
+    g_hash_table_foreach_remove(v->cache, viewer_window_is_stale, &v->offset);
+    viewer_fetch(v, v->offset + VIEWER_WINDOW_BYTES);
+    if (v->offset > 0) viewer_fetch(v, v->offset > VIEWER_WINDOW_BYTES ? v->offset - VIEWER_WINDOW_BYTES : 0);
+}
+
+static void viewer_go_to(RangeViewer *v, guint64 offset, ViewerScroll scroll) {
+    v->offset = MIN(offset, viewer_last_window(v));
+    v->scroll = scroll;
+    if (v->size == 0) {
+        gtk_text_buffer_set_text(gtk_text_view_get_buffer(v->view), "", -1);
+        viewer_set_status(v);
+        return;
+    }
+    GBytes *cached = g_hash_table_lookup(v->cache, &v->offset);
+    if (cached) {
+        viewer_show(v, cached);
+        return;
+    }
+    gtk_label_set_text(v->status, _("Loading..."));
+    viewer_fetch(v, v->offset);
+}
+
+static gboolean viewer_seek_timeout(gpointer user_data) {
+    RangeViewer *v = (RangeViewer *)user_data;
+    v->seek_id = 0;
+    viewer_go_to(v, (guint64)gtk_adjustment_get_value(v->position), VIEWER_SCROLL_TOP);
+    return G_SOURCE_REMOVE;
+}
+
+// Dragging the position slider only fetches once it rests.
+static void on_viewer_position_changed(GtkAdjustment *adjustment, gpointer user_data) {
+    (void)adjustment;
+    RangeViewer *v = (RangeViewer *)user_data;
+    if (v->seek_id) g_source_remove(v->seek_id);
+    v->seek_id = g_timeout_add(VIEWER_SEEK_DELAY_MS, viewer_seek_timeout, v);
+}
+
+// Scrolling on past either end of the text moves to the adjacent window, which
+// read-ahead has usually fetched already.
+static void on_viewer_edge_overshot(GtkScrolledWindow *scrolled, GtkPositionType pos, gpointer user_data) {
+    (void)scrolled;
+    RangeViewer *v = (RangeViewer *)user_data;
+    if (pos == GTK_POS_BOTTOM && v->offset < viewer_last_window(v)) {
+        viewer_go_to(v, v->offset + VIEWER_WINDOW_BYTES, VIEWER_SCROLL_TOP);
+    } else if (pos == GTK_POS_TOP && v->offset > 0) {
+        viewer_go_to(v, v->offset > VIEWER_WINDOW_BYTES ? v->offset - VIEWER_WINDOW_BYTES : 0, VIEWER_SCROLL_BOTTOM);
+    }
+}
+
+static void on_viewer_start_clicked(GtkButton *button, gpointer user_data) { (void)button; viewer_go_to((RangeViewer *)user_data, 0, VIEWER_SCROLL_TOP); }
+static void on_viewer_end_clicked(GtkButton *button, gpointer user_data) { RangeViewer *v = (RangeViewer *)user_data; (void)button; viewer_go_to(v, viewer_last_window(v), VIEWER_SCROLL_BOTTOM); }
+
+static void on_viewer_hex_toggled(GtkToggleButton *button, gpointer user_data) {
+    RangeViewer *v = (RangeViewer *)user_data;
+    v->hex = gtk_toggle_button_get_active(button);
+    viewer_go_to(v, v->offset, v->scroll);
+}
+
+static void viewer_head_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    (void)source; (void)cancellable;
+    RangeViewer *v = (RangeViewer *)task_data;
+    guint64 size = 0;
+    GError *error = NULL;
+    if (s3_client_head_object(v->endpoint, v->access_key, v->secret_key, v->bucket, v->key, v->use_ssl, &size, NULL, &error)) g_task_return_pointer(task, g_memdup2(&size, sizeof(size)), g_free);
+    else g_task_return_error(task, error);
+}
+
+static void on_viewer_head_done(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source; (void)user_data;
+    RangeViewer *v = g_task_get_task_data(G_TASK(result));
+    g_autofree guint64 *size = g_task_propagate_pointer(G_TASK(result), NULL);
+    v->head_pending = FALSE;
+    if (v->closed || !size || *size == v->size) return;
+    // The object was rewritten. Cached windows may hold old bytes.
+    v->size = *size;
+    v->generation++;
+    g_hash_table_remove_all(v->cache);
+    g_hash_table_remove_all(v->pending);
+    if (v->following) viewer_go_to(v, viewer_last_window(v), VIEWER_SCROLL_BOTTOM);
+    else viewer_go_to(v, v->offset, v->scroll);
+}
+
+// Like tail -f: a HEAD request per interval, and a Range GET of the last
+// window only when the size changed.
+static gboolean viewer_follow_tick(gpointer user_data) {
+    RangeViewer *v = (RangeViewer *)user_data;
+    if (v->head_pending) return G_SOURCE_CONTINUE;
+    v->head_pending = TRUE;
+    GTask *task = g_task_new(NULL, NULL, on_viewer_head_done, NULL);
+    g_task_set_task_data(task, range_viewer_ref(v), (GDestroyNotify)range_viewer_unref);
+    g_task_run_in_thread(task, viewer_head_thread);
+    g_object_unref(task);
+    return G_SOURCE_CONTINUE;
+}
+
+static void on_viewer_follow_toggled(GtkToggleButton *button, gpointer user_data) {
+    RangeViewer *v = (RangeViewer *)user_data;
+    v->following = gtk_toggle_button_get_active(button);
+    if (v->follow_id) {
+        g_source_remove(v->follow_id);
+        v->follow_id = 0;
+    }
+    if (v->following) {
+        v->follow_id = g_timeout_add_seconds(VIEWER_FOLLOW_INTERVAL_SECONDS, viewer_follow_tick, v);
+        viewer_go_to(v, viewer_last_window(v), VIEWER_SCROLL_BOTTOM);
+    } else {
+        viewer_set_status(v);
+    }
+}
+
+static void on_range_viewer_destroy(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    RangeViewer *v = (RangeViewer *)user_data;
+    v->closed = TRUE;
+    if (v->seek_id) g_source_remove(v->seek_id);
+    if (v->follow_id) g_source_remove(v->follow_id);
+    range_viewer_unref(v);
+}
+
+// Opens a read-only window onto `key` that downloads only what it shows.
+// `tail` starts at the end and follows the object as it is rewritten.
+static void open_range_viewer(MainWindow *mw, const gchar *key, guint64 size, gboolean hex, gboolean tail) {
+    RangeViewer *v = g_new0(RangeViewer, 1);
+    v->ref_count = 1;
+    v->endpoint = g_strdup(mw->settings->endpoint);
+    v->access_key = g_strdup(mw->access_key);
+    v->secret_key = g_strdup(mw->secret_key);
+    v->bucket = g_strdup(mw->settings->bucket);
+    v->key = g_strdup(key);
+    v->use_ssl = mw->settings->use_ssl;
+    v->size = size;
+    v->hex = hex;
+    v->cache = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, (GDestroyNotify)g_bytes_unref);
+    v->pending = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+
+    GtkWidget *window = gtk_window_new();
+    g_autofree gchar *basename = g_path_get_basename(key);
+    g_autofree gchar *title = g_strdup_printf(_("%s (read-only)"), basename);
+    gtk_window_set_title(GTK_WINDOW(window), title);
+    gtk_window_set_transient_for(GTK_WINDOW(window), GTK_WINDOW(mw->window));
+    gtk_window_set_destroy_with_parent(GTK_WINDOW(window), TRUE);
+    gtk_window_set_default_size(GTK_WINDOW(window), 900, 640);
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    gtk_widget_set_margin_start(box, 12);
+    gtk_widget_set_margin_end(box, 12);
+    gtk_widget_set_margin_top(box, 12);
+    gtk_widget_set_margin_bottom(box, 12);
+    gtk_window_set_child(GTK_WINDOW(window), box);
+
+    GtkWidget *toolbar = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    GtkWidget *start_button = gtk_button_new_from_icon_name("go-top-symbolic");
+    gtk_widget_set_tooltip_text(start_button, _("Start of object"));
+    GtkWidget *end_button = gtk_button_new_from_icon_name("go-bottom-symbolic");
+    gtk_widget_set_tooltip_text(end_button, _("End of object"));
+    GtkWidget *hex_button = gtk_toggle_button_new_with_label(_("Hex"));
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(hex_button), hex);
+    GtkWidget *follow_button = gtk_toggle_button_new_with_label(_("Follow"));
+    gtk_widget_set_tooltip_text(follow_button, _("Show the end of the object and poll it for changes"));
+    v->status = GTK_LABEL(gtk_label_new(NULL));
+    gtk_label_set_xalign(v->status, 1);
+    gtk_widget_set_hexpand(GTK_WIDGET(v->status), TRUE);
+    gtk_box_append(GTK_BOX(toolbar), start_button);
+    gtk_box_append(GTK_BOX(toolbar), end_button);
+    gtk_box_append(GTK_BOX(toolbar), hex_button);
+    gtk_box_append(GTK_BOX(toolbar), follow_button);
+    gtk_box_append(GTK_BOX(toolbar), GTK_WIDGET(v->status));
+    gtk_box_append(GTK_BOX(box), toolbar);
+
+    v->position = gtk_adjustment_new(0, 0, MAX(size, 1), VIEWER_WINDOW_BYTES / 4, VIEWER_WINDOW_BYTES, MIN(VIEWER_WINDOW_BYTES, MAX(size, 1)));
+    gtk_box_append(GTK_BOX(box), gtk_scale_new(GTK_ORIENTATION_HORIZONTAL, v->position));
+
+    v->view = GTK_TEXT_VIEW(gtk_text_view_new());
+    gtk_text_view_set_editable(v->view, FALSE);
+    gtk_text_view_set_monospace(v->view, TRUE);
+    v->scrolled = GTK_SCROLLED_WINDOW(gtk_scrolled_window_new());
+    gtk_scrolled_window_set_child(v->scrolled, GTK_WIDGET(v->view));
+    gtk_widget_set_vexpand(GTK_WIDGET(v->scrolled), TRUE);
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(v->scrolled));
+
+    v->position_handler = g_signal_connect(v->position, "value-changed", G_CALLBACK(on_viewer_position_changed), v);
+    g_signal_connect(v->scrolled, "edge-overshot", G_CALLBACK(on_viewer_edge_overshot), v);
+    g_signal_connect(start_button, "clicked", G_CALLBACK(on_viewer_start_clicked), v);
+    g_signal_connect(end_button, "clicked", G_CALLBACK(on_viewer_end_clicked), v);
+    g_signal_connect(hex_button, "toggled", G_CALLBACK(on_viewer_hex_toggled), v);
+    g_signal_connect(follow_button, "toggled", G_CALLBACK(on_viewer_follow_toggled), v);
+    g_signal_connect(window, "destroy", G_CALLBACK(on_range_viewer_destroy), v);
+
+    if (tail) gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(follow_button), TRUE);
+    else viewer_go_to(v, 0, VIEWER_SCROLL_TOP);
+    gtk_window_present(GTK_WINDOW(window));
+}
+
+// Periodically dumps the metrics for the node exporter textfile collector.
+static gboolean write_prometheus_metrics(gpointer user_data) {
+    const gchar *path = (const gchar *)user_data;
+    g_autoptr(GError) error = NULL;
+    if (!s3_metrics_write_prometheus(path, &error)) {
+        g_warning("Failed to write metrics to %s: %s", path, error->message);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void start_prometheus_writer(const MyS3Settings *s) {
+    static guint source_id = 0;
+    if (source_id || !s->prometheus_file || !*s->prometheus_file) return;
+    source_id = g_timeout_add_seconds_full(G_PRIORITY_LOW, s->prometheus_interval_seconds, write_prometheus_metrics, g_strdup(s->prometheus_file), g_free);
+}
+
+static void on_window_close_response(GtkButton *button, gpointer user_data) {
+    MainWindow *mw = (MainWindow *)user_data;
+    GtkWidget *dialog = gtk_widget_get_ancestor(GTK_WIDGET(button), GTK_TYPE_WINDOW);
+    gtk_window_destroy(GTK_WINDOW(dialog));
+    save_session(mw);
+    gtk_window_destroy(GTK_WINDOW(mw->window));
+}
+
+static gboolean on_window_close_request(GtkApplicationWindow *window, gpointer user_data) {
+    MainWindow *mw = (MainWindow *)user_data;
+    gboolean unsaved_changes = FALSE;
+    for (guint i = 1; i < gtk_notebook_get_n_pages(mw->notebook); ++i) {
+        GtkWidget *page = gtk_notebook_get_nth_page(mw->notebook, i);
+        GtkWidget *tab_box = gtk_notebook_get_tab_label(mw->notebook, page);
+        GtkWidget *tab_label = gtk_widget_get_first_child(tab_box);
+        const gchar *label_text = gtk_label_get_text(GTK_LABEL(tab_label));
+        if (g_str_has_suffix(label_text, "*")) {
+            unsaved_changes = TRUE;
+            break;
+        }
+    }
+
+    if (unsaved_changes) {
         GtkWidget *dialog = gtk_window_new();
         gtk_window_set_transient_for(GTK_WINDOW(dialog), GTK_WINDOW(window));
         gtk_window_set_modal(GTK_WINDOW(dialog), TRUE);
@@ -1157,12 +4270,13 @@ static gboolean on_window_close_request(GtkApplicationWindow *window, gpointer u
         gtk_box_append(GTK_BOX(button_box), no_button);
         gtk_box_append(GTK_BOX(content_area), button_box);
 
-        g_signal_connect(yes_button, "clicked", G_CALLBACK(on_window_close_response), window);
+        g_signal_connect(yes_button, "clicked", G_CALLBACK(on_window_close_response), mw);
         g_signal_connect_swapped(no_button, "clicked", G_CALLBACK(gtk_window_destroy), dialog);
         gtk_window_present(GTK_WINDOW(dialog));
         return TRUE; // Prevent window from closing
     }
 
+    save_session(mw);
     return FALSE; // No unsaved changes, close the window
 }
 
@@ -1174,6 +4288,8 @@ static void app_activate (GApplication *app) {
     } else {
         logging_set_level(LOG_LEVEL_DISABLED);
     }
+    settings_apply_transfer_backend(s);
+    start_prometheus_writer(s);
 
     if (!s->endpoint || !*(s->endpoint)) {
         GtkWindow* w = GTK_WINDOW(gtk_application_window_new(GTK_APPLICATION(app)));
@@ -1181,18 +4297,30 @@ static void app_activate (GApplication *app) {
     } else {
         MainWindow *mw = main_window_new(GTK_APPLICATION(app));
         gtk_window_present(GTK_WINDOW(mw->window));
+        restore_session(mw);
     }
     settings_free(s);
 }
 
 int main (int argc, char *argv[]) {
     logging_init();
+    // The window and the last session come up while the SDK initializes;
+    // the first S3 call waits for it.
+    s3_client_init_async();
     setlocale(LC_ALL, "");
     bindtextdomain("mys3-client", "po");
     textdomain("mys3-client");
 
+    // `mys3-client --batch <command> ...` runs headless, like mys3-cli.
+    if (argc > 1 && g_strcmp0(argv[1], "--batch") == 0) {
+        argv[1] = argv[0];
+        int cli_status = cli_run(argc - 1, argv + 1);
+        s3_client_cleanup();
+        logging_cleanup();
+        return cli_status;
+    }
+
     g_autoptr(GtkApplication) app = NULL; int status;
-    s3_object_get_type();
     app = gtk_application_new ("com.example.mys3client", G_APPLICATION_DEFAULT_FLAGS);
 
     g_signal_connect (app, "activate", G_CALLBACK(app_activate), NULL);
@@ -1204,6 +4332,7 @@ int main (int argc, char *argv[]) {
 
     status = g_application_run (G_APPLICATION (app), argc, argv);
     g_object_unref(provider);
+    s3_client_cleanup();
     logging_cleanup();
     return status;
 }
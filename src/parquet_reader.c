@@ -0,0 +1,1314 @@
+#include "parquet_reader.h"
+#include <gio/gio.h>
+#include <math.h>
+#include <string.h>
+#ifdef MYS3_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// Largest page this reader inflates; real writers stay near 1 MiB.
+#define PARQUET_MAX_PAGE_BYTES (512u * 1024 * 1024)
+// Bytes of a binary value shown before it is cut.
+#define PARQUET_MAX_HEX_BYTES 32
+
+#define PARQUET_ERROR g_quark_from_static_string("Parquet")
+
+// Physical types
+enum { PQ_BOOLEAN, PQ_INT32, PQ_INT64, PQ_INT96, PQ_FLOAT, PQ_DOUBLE, PQ_BYTE_ARRAY, PQ_FIXED_LEN_BYTE_ARRAY };
+// Page types
+enum { PQ_DATA_PAGE = 0, PQ_INDEX_PAGE = 1, PQ_DICTIONARY_PAGE = 2, PQ_DATA_PAGE_V2 = 3 };
+// Encodings
+enum { PQ_PLAIN = 0, PQ_PLAIN_DICTIONARY = 2, PQ_RLE = 3, PQ_RLE_DICTIONARY = 8 };
+// Codecs
+enum { PQ_UNCOMPRESSED = 0, PQ_SNAPPY = 1, PQ_GZIP = 2, PQ_ZSTD = 6 };
+// Repetition types
+enum { PQ_REQUIRED = 0, PQ_OPTIONAL = 1, PQ_REPEATED = 2 };
+
+static const gchar *physical_type_names[] = { "BOOLEAN", "INT32", "INT64", "INT96", "FLOAT", "DOUBLE", "BYTE_ARRAY", "FIXED_LEN_BYTE_ARRAY" };
+static const gchar *codec_names[] = { "UNCOMPRESSED", "SNAPPY", "GZIP", "LZO", "BROTLI", "LZ4", "ZSTD", "LZ4_RAW" };
+
+// How values of a column are shown, from its converted or logical type.
+typedef enum {
+    KIND_DEFAULT,
+    KIND_STRING,
+    KIND_DATE,
+    KIND_TIME_MILLIS,
+    KIND_TIME_MICROS,
+    KIND_TIME_NANOS,
+    KIND_TIMESTAMP_MILLIS,
+    KIND_TIMESTAMP_MICROS,
+    KIND_TIMESTAMP_NANOS,
+    KIND_DECIMAL,
+    KIND_UNSIGNED,
+    KIND_UUID,
+} ValueKind;
+
+typedef struct {
+    gchar *name;
+    gchar *type_name;
+    gint type;
+    gint type_length;
+    ValueKind kind;
+    gint scale;
+    guint max_definition;
+    guint max_repetition;
+} ParquetColumn;
+
+typedef struct {
+    gint codec;
+    gboolean external;          // Data lives in another file (file_path)
+    gint64 data_page_offset;
+    gint64 dictionary_page_offset;  // -1 without a dictionary
+    guint64 compressed_size;
+    gint64 offset_index_offset;     // -1 without an offset index
+    guint32 offset_index_length;
+    GBytes *min, *max;
+    gboolean has_null_count;
+    guint64 null_count;
+} ParquetChunk;
+
+typedef struct {
+    guint64 first_row;
+    guint64 n_rows;
+    ParquetChunk *chunks;       // One per leaf column
+} ParquetRowGroup;
+
+struct _ParquetFile {
+    guint64 n_rows;
+    gchar *created_by;
+    GPtrArray *columns;         // ParquetColumn
+    GArray *row_groups;         // ParquetRowGroup
+};
+
+static inline guint32 read_le32(const guint8 *data) {
+    guint32 value;
+    memcpy(&value, data, sizeof(value));
+    return GUINT32_FROM_LE(value);
+}
+
+static inline guint64 read_le64(const guint8 *data) {
+    guint64 value;
+    memcpy(&value, data, sizeof(value));
+    return GUINT64_FROM_LE(value);
+}
+
+// #############################################################################
+// # Thrift compact protocol
+// #############################################################################
+
+enum { T_STOP, T_TRUE, T_FALSE, T_BYTE, T_I16, T_I32, T_I64, T_DOUBLE, T_BINARY, T_LIST, T_SET, T_MAP, T_STRUCT };
+
+typedef struct {
+    const guint8 *pos;
+    const guint8 *end;
+    gboolean failed;
+} ThriftReader;
+
+static guint64 thrift_read_varint(ThriftReader *r) {
+    guint64 value = 0;
+    for (guint shift = 0; r->pos < r->end && shift < 64; shift += 7) {
+        guint8 byte = *r->pos++;
+        value |= (guint64)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    r->failed = TRUE;
+    return 0;
+}
+
+static gint64 thrift_read_zigzag(ThriftReader *r) {
+    guint64 value = thrift_read_varint(r);
+    return (gint64)(value >> 1) ^ -(gint64)(value & 1);
+}
+
+static guint8 thrift_read_byte(ThriftReader *r) {
+    if (r->pos >= r->end) {
+        r->failed = TRUE;
+        return 0;
+    }
+    return *r->pos++;
+}
+
+static const guint8 *thrift_read_binary(ThriftReader *r, gsize *length) {
+    guint64 len = thrift_read_varint(r);
+    if (r->failed || len > (guint64)(r->end - r->pos)) {
+        r->failed = TRUE;
+        *length = 0;
+        return NULL;
+    }
+    const guint8 *data = r->pos;
+    r->pos += len;
+    *length = len;
+    return data;
+}
+
+static gchar *thrift_read_string(ThriftReader *r) {
+    gsize length;
+    const guint8 *data = thrift_read_binary(r, &length);
+    return data ? g_strndup((const gchar *)data, length) : g_strdup("");
+}
+
+// Reads the next field header of a struct. Returns FALSE at its end.
+static gboolean thrift_read_field(ThriftReader *r, gint *last_id, guint8 *type, gint *id) {
+    guint8 byte = thrift_read_byte(r);
+    if (r->failed || byte == T_STOP) return FALSE;
+    *type = byte & 0x0f;
+    guint delta = byte >> 4;
+    *id = delta ? *last_id + (gint)delta : (gint)thrift_read_zigzag(r);
+    *last_id = *id;
+    return !r->failed;
+}
+
+static guint32 thrift_read_list(ThriftReader *r, guint8 *element_type) {
+    guint8 byte = thrift_read_byte(r);
+    *element_type = byte & 0x0f;
+    guint64 size = byte >> 4;
+    if (size == 15) size = thrift_read_varint(r);
+    // Every element takes at least one byte.
+    if (size > (guint64)(r->end - r->pos)) {
+        r->failed = TRUE;
+        return 0;
+    }
+    return (guint32)size;
+}
+
+static void thrift_skip(ThriftReader *r, guint8 type, guint depth) {
+    if (depth > 64) {
+        r->failed = TRUE;
+        return;
+    }
+    switch (type) {
+    case T_TRUE:
+    case T_FALSE:
+        break;  // A struct field stores the value in its type
+    case T_BYTE:
+        thrift_read_byte(r);
+        break;
+    case T_I16:
+    case T_I32:
+    case T_I64:
+        thrift_read_varint(r);
+        break;
+    case T_DOUBLE:
+        if (r->end - r->pos < 8) r->failed = TRUE;
+        else r->pos += 8;
+        break;
+    case T_BINARY: {
+        gsize length;
+        thrift_read_binary(r, &length);
+        break;
+    }
+    case T_LIST:
+    case T_SET: {
+        guint8 element_type;
+        guint32 n = thrift_read_list(r, &element_type);
+        for (guint32 i = 0; i < n && !r->failed; i++) {
+            // List elements of type bool take a byte each.
+            if (element_type == T_TRUE || element_type == T_FALSE) thrift_read_byte(r);
+            else thrift_skip(r, element_type, depth + 1);
+        }
+        break;
+    }
+    case T_MAP: {
+        guint64 n = thrift_read_varint(r);
+        if (n == 0) break;
+        guint8 types = thrift_read_byte(r);
+        for (guint64 i = 0; i < n && !r->failed; i++) {
+            thrift_skip(r, types >> 4, depth + 1);
+            thrift_skip(r, types & 0x0f, depth + 1);
+        }
+        break;
+    }
+    case T_STRUCT: {
+        gint last_id = 0, id;
+        guint8 field_type;
+        while (thrift_read_field(r, &last_id, &field_type, &id)) thrift_skip(r, field_type, depth + 1);
+        break;
+    }
+    default:
+        r->failed = TRUE;
+    }
+}
+
+// #############################################################################
+// # Footer
+// #############################################################################
+
+typedef struct {
+    gint type;              // -1 for groups
+    gint type_length;
+    gint repetition;
+    gchar *name;
+    gint n_children;
+    gint converted_type;    // -1 if absent
+    gint scale;
+    ValueKind logical_kind; // From LogicalType, KIND_DEFAULT if absent
+    gboolean logical_unsigned;
+} SchemaElement;
+
+static void schema_element_clear(SchemaElement *element) {
+    g_free(element->name);
+}
+
+static ValueKind read_time_unit(ThriftReader *r, ValueKind millis) {
+    ValueKind kind = KIND_DEFAULT;
+    gint last_id = 0, id;
+    guint8 type;
+    while (thrift_read_field(r, &last_id, &type, &id)) {
+        // TimeUnit is a union of empty structs: MILLIS, MICROS, NANOS.
+        if (id >= 1 && id <= 3) kind = (ValueKind)(millis + id - 1);
+        thrift_skip(r, type, 0);
+    }
+    return kind;
+}
+
+static void read_logical_type(ThriftReader *r, SchemaElement *element) {
+    gint last_id = 0, id;
+    guint8 type;
+    while (thrift_read_field(r, &last_id, &type, &id)) {
+        if (type != T_STRUCT) {
+            thrift_skip(r, type, 0);
+            continue;
+        }
+        gint inner_last = 0, inner_id;
+        guint8 inner_type;
+        switch (id) {
+        case 1: case 4: case 12:    // STRING, ENUM, JSON
+            element->logical_kind = KIND_STRING;
+            thrift_skip(r, type, 0);
+            break;
+        case 5:                     // DECIMAL
+            element->logical_kind = KIND_DECIMAL;
+            while (thrift_read_field(r, &inner_last, &inner_type, &inner_id)) {
+                if (inner_id == 1 && inner_type == T_I32) element->scale = (gint)thrift_read_zigzag(r);
+                else thrift_skip(r, inner_type, 0);
+            }
+            break;
+        case 6:                     // DATE
+            element->logical_kind = KIND_DATE;
+            thrift_skip(r, type, 0);
+            break;
+        case 7:                     // TIME
+        case 8:                     // TIMESTAMP
+            while (thrift_read_field(r, &inner_last, &inner_type, &inner_id)) {
+                if (inner_id == 2 && inner_type == T_STRUCT) element->logical_kind = read_time_unit(r, id == 7 ? KIND_TIME_MILLIS : KIND_TIMESTAMP_MILLIS);
+                else thrift_skip(r, inner_type, 0);
+            }
+            break;
+        case 10:                    // INTEGER
+            while (thrift_read_field(r, &inner_last, &inner_type, &inner_id)) {
+                if (inner_id == 2) element->logical_unsigned = inner_type == T_FALSE;
+                else thrift_skip(r, inner_type, 0);
+            }
+            if (element->logical_unsigned) element->logical_kind = KIND_UNSIGNED;
+            break;
+        case 14:                    // UUID
+            element->logical_kind = KIND_UUID;
+            thrift_skip(r, type, 0);
+            break;
+        default:
+            thrift_skip(r, type, 0);
+        }
+    }
+}
+
+static void read_schema_element(ThriftReader *r, SchemaElement *element) {
+    element->type = -1;
+    element->converted_type = -1;
+    gint last_id = 0, id;
+    guint8 type;
+    while (thrift_read_field(r, &last_id, &type, &id)) {
+        if (id == 1 && type == T_I32) element->type = (gint)thrift_read_zigzag(r);
+        else if (id == 2 && type == T_I32) element->type_length = (gint)thrift_read_zigzag(r);
+        else if (id == 3 && type == T_I32) element->repetition = (gint)thrift_read_zigzag(r);
+        else if (id == 4 && type == T_BINARY) element->name = thrift_read_string(r);
+        else if (id == 5 && type == T_I32) element->n_children = (gint)thrift_read_zigzag(r);
+        else if (id == 6 && type == T_I32) element->converted_type = (gint)thrift_read_zigzag(r);
+        else if (id == 7 && type == T_I32) element->scale = (gint)thrift_read_zigzag(r);
+        else if (id == 10 && type == T_STRUCT) read_logical_type(r, element);
+        else thrift_skip(r, type, 0);
+    }
+}
+
+static void read_statistics(ThriftReader *r, ParquetChunk *chunk, gint physical_type) {
+    GBytes *legacy_min = NULL, *legacy_max = NULL;
+    gint last_id = 0, id;
+    guint8 type;
+    while (thrift_read_field(r, &last_id, &type, &id)) {
+        gsize length;
+        const guint8 *data;
+        if ((id == 1 || id == 2 || id == 5 || id == 6) && type == T_BINARY) {
+            data = thrift_read_binary(r, &length);
+            if (!data) continue;
+            GBytes **slot = id == 1 ? &legacy_max : id == 2 ? &legacy_min : id == 5 ? &chunk->max : &chunk->min;
+            if (*slot) g_bytes_unref(*slot);
+            *slot = g_bytes_new(data, length);
+        } else if (id == 3 && type == T_I64) {
+            chunk->null_count = (guint64)thrift_read_zigzag(r);
+            chunk->has_null_count = TRUE;
+        } else {
+            thrift_skip(r, type, 0);
+        }
+    }
+    // The deprecated min/max compared bytes as signed, which misorders UTF-8.
+    gboolean legacy_ok = physical_type != PQ_BYTE_ARRAY && physical_type != PQ_FIXED_LEN_BYTE_ARRAY;
+    if (!chunk->min && !chunk->max && legacy_ok) {
+        chunk->min = g_steal_pointer(&legacy_min);
+        chunk->max = g_steal_pointer(&legacy_max);
+    }
+    if (legacy_min) g_bytes_unref(legacy_min);
+    if (legacy_max) g_bytes_unref(legacy_max);
+}
+
+static void read_column_meta_data(ThriftReader *r, ParquetChunk *chunk, gint physical_type) {
+    gint last_id = 0, id;
+    guint8 type;
+    while (thrift_read_field(r, &last_id, &type, &id)) {
+        if (id == 4 && type == T_I32) chunk->codec = (gint)thrift_read_zigzag(r);
+        else if (id == 7 && type == T_I64) chunk->compressed_size = (guint64)thrift_read_zigzag(r);
+        else if (id == 9 && type == T_I64) chunk->data_page_offset = thrift_read_zigzag(r);
+        else if (id == 11 && type == T_I64) chunk->dictionary_page_offset = thrift_read_zigzag(r);
+        else if (id == 12 && type == T_STRUCT) read_statistics(r, chunk, physical_type);
+        else thrift_skip(r, type, 0);
+    }
+}
+
+static void read_column_chunk(ThriftReader *r, ParquetChunk *chunk, gint physical_type) {
+    chunk->dictionary_page_offset = -1;
+    chunk->offset_index_offset = -1;
+    gint last_id = 0, id;
+    guint8 type;
+    while (thrift_read_field(r, &last_id, &type, &id)) {
+        if (id == 1 && type == T_BINARY) {
+            gsize length;
+            thrift_read_binary(r, &length);
+            chunk->external = length > 0;
+        } else if (id == 3 && type == T_STRUCT) {
+            read_column_meta_data(r, chunk, physical_type);
+        } else if (id == 4 && type == T_I64) {
+            chunk->offset_index_offset = thrift_read_zigzag(r);
+        } else if (id == 5 && type == T_I32) {
+            chunk->offset_index_length = (guint32)thrift_read_zigzag(r);
+        } else {
+            thrift_skip(r, type, 0);
+        }
+    }
+    // Some writers store 0 for an absent dictionary.
+    if (chunk->dictionary_page_offset <= 0 || chunk->dictionary_page_offset >= chunk->data_page_offset) chunk->dictionary_page_offset = -1;
+}
+
+static void read_row_group(ThriftReader *r, ParquetFile *file, ParquetRowGroup *group) {
+    guint n_columns = file->columns->len;
+    group->chunks = g_new0(ParquetChunk, n_columns);
+    gint last_id = 0, id;
+    guint8 type;
+    while (thrift_read_field(r, &last_id, &type, &id)) {
+        if (id == 1 && type == T_LIST) {
+            guint8 element_type;
+            guint32 n = thrift_read_list(r, &element_type);
+            for (guint32 i = 0; i < n && !r->failed; i++) {
+                if (i < n_columns && element_type == T_STRUCT) {
+                    ParquetColumn *column = g_ptr_array_index(file->columns, i);
+                    read_column_chunk(r, &group->chunks[i], column->type);
+                } else {
+                    thrift_skip(r, element_type, 0);
+                }
+            }
+            if (n != n_columns) r->failed = TRUE;
+        } else if (id == 3 && type == T_I64) {
+            group->n_rows = (guint64)thrift_read_zigzag(r);
+        } else {
+            thrift_skip(r, type, 0);
+        }
+    }
+}
+
+static ValueKind kind_from_converted_type(gint converted_type) {
+    switch (converted_type) {
+    case 0: case 4: case 19: return KIND_STRING;   // UTF8, ENUM, JSON
+    case 5: return KIND_DECIMAL;
+    case 6: return KIND_DATE;
+    case 7: return KIND_TIME_MILLIS;
+    case 8: return KIND_TIME_MICROS;
+    case 9: return KIND_TIMESTAMP_MILLIS;
+    case 10: return KIND_TIMESTAMP_MICROS;
+    case 11: case 12: case 13: case 14: return KIND_UNSIGNED;
+    default: return KIND_DEFAULT;
+    }
+}
+
+static gchar *column_type_name(const ParquetColumn *column) {
+    const gchar *physical = column->type >= 0 && column->type < (gint)G_N_ELEMENTS(physical_type_names) ? physical_type_names[column->type] : "?";
+    switch (column->kind) {
+    case KIND_STRING: return g_strdup_printf("%s STRING", physical);
+    case KIND_DATE: return g_strdup_printf("%s DATE", physical);
+    case KIND_TIME_MILLIS: return g_strdup_printf("%s TIME(ms)", physical);
+    case KIND_TIME_MICROS: return g_strdup_printf("%s TIME(us)", physical);
+    case KIND_TIME_NANOS: return g_strdup_printf("%s TIME(ns)", physical);
+    case KIND_TIMESTAMP_MILLIS: return g_strdup_printf("%s TIMESTAMP(ms)", physical);
+    case KIND_TIMESTAMP_MICROS: return g_strdup_printf("%s TIMESTAMP(us)", physical);
+    case KIND_TIMESTAMP_NANOS: return g_strdup_printf("%s TIMESTAMP(ns)", physical);
+    case KIND_DECIMAL: return g_strdup_printf("%s DECIMAL(scale %d)", physical, column->scale);
+    case KIND_UNSIGNED: return g_strdup_printf("%s UNSIGNED", physical);
+    case KIND_UUID: return g_strdup_printf("%s UUID", physical);
+    default: return g_strdup(physical);
+    }
+}
+
+// Walks the depth-first schema list, collecting leaves with their levels.
+static gboolean collect_columns(ParquetFile *file, GArray *schema, guint *next, const gchar *parent, guint definition, guint repetition, guint depth) {
+    if (*next >= schema->len || depth > 64) return FALSE;
+    SchemaElement *element = &g_array_index(schema, SchemaElement, (*next)++);
+    if (element->repetition == PQ_OPTIONAL) definition++;
+    if (element->repetition == PQ_REPEATED) {
+        definition++;
+        repetition++;
+    }
+    g_autofree gchar *path = parent ? g_strconcat(parent, ".", element->name ? element->name : "", NULL) : g_strdup(element->name ? element->name : "");
+    if (element->n_children > 0) {
+        for (gint i = 0; i < element->n_children; i++) {
+            if (!collect_columns(file, schema, next, path, definition, repetition, depth + 1)) return FALSE;
+        }
+        return TRUE;
+    }
+    ParquetColumn *column = g_new0(ParquetColumn, 1);
+    column->name = g_steal_pointer(&path);
+    column->type = element->type;
+    column->type_length = element->type_length;
+    column->kind = element->logical_kind != KIND_DEFAULT ? element->logical_kind : kind_from_converted_type(element->converted_type);
+    column->scale = element->scale;
+    column->max_definition = definition;
+    column->max_repetition = repetition;
+    column->type_name = column_type_name(column);
+    g_ptr_array_add(file->columns, column);
+    return TRUE;
+}
+
+static void parquet_column_free(ParquetColumn *column) {
+    g_free(column->name);
+    g_free(column->type_name);
+    g_free(column);
+}
+
+gboolean parquet_trailer_get_metadata_length(const guint8 *trailer, guint32 *length, GError **error) {
+    if (memcmp(trailer + 4, "PAR1", 4) != 0) {
+        g_set_error(error, PARQUET_ERROR, 0, "Not a Parquet file (no PAR1 trailer)");
+        return FALSE;
+    }
+    *length = read_le32(trailer);
+    return TRUE;
+}
+
+ParquetFile *parquet_file_new(const guint8 *metadata, gsize length, GError **error) {
+    ParquetFile *file = g_new0(ParquetFile, 1);
+    file->columns = g_ptr_array_new_with_free_func((GDestroyNotify)parquet_column_free);
+    file->row_groups = g_array_new(FALSE, TRUE, sizeof(ParquetRowGroup));
+    GArray *schema = g_array_new(FALSE, TRUE, sizeof(SchemaElement));
+    g_array_set_clear_func(schema, (GDestroyNotify)schema_element_clear);
+
+    ThriftReader reader = { metadata, metadata + length, FALSE };
+    ThriftReader *r = &reader;
+    gint last_id = 0, id;
+    guint8 type;
+    while (thrift_read_field(r, &last_id, &type, &id)) {
+        if (id == 2 && type == T_LIST) {
+            guint8 element_type;
+            guint32 n = thrift_read_list(r, &element_type);
+            for (guint32 i = 0; i < n && !r->failed; i++) {
+                SchemaElement element = { 0 };
+                read_schema_element(r, &element);
+                g_array_append_val(schema, element);
+            }
+            // The schema comes before the row groups, which need the leaves.
+            guint next = 0;
+            if (!r->failed && schema->len > 0) {
+                SchemaElement *root = &g_array_index(schema, SchemaElement, 0);
+                next = 1;
+                for (gint i = 0; i < root->n_children && !r->failed; i++) {
+                    if (!collect_columns(file, schema, &next, NULL, 0, 0, 0)) r->failed = TRUE;
+                }
+            }
+        } else if (id == 3 && type == T_I64) {
+            file->n_rows = (guint64)thrift_read_zigzag(r);
+        } else if (id == 4 && type == T_LIST) {
+            guint8 element_type;
+            guint32 n = thrift_read_list(r, &element_type);
+            guint64 first_row = 0;
+            for (guint32 i = 0; i < n && !r->failed; i++) {
+                ParquetRowGroup group = { 0 };
+                group.first_row = first_row;
+                read_row_group(r, file, &group);
+                first_row += group.n_rows;
+                g_array_append_val(file->row_groups, group);
+            }
+        } else if (id == 6 && type == T_BINARY) {
+            file->created_by = thrift_read_string(r);
+        } else {
+            thrift_skip(r, type, 0);
+        }
+    }
+    g_array_unref(schema);
+    if (r->failed || file->columns->len == 0) {
+        g_set_error(error, PARQUET_ERROR, 0, "Corrupt Parquet footer");
+        parquet_file_free(file);
+        return NULL;
+    }
+    return file;
+}
+
+void parquet_file_free(ParquetFile *file) {
+    if (!file) return;
+    for (guint i = 0; i < file->row_groups->len; i++) {
+        ParquetRowGroup *group = &g_array_index(file->row_groups, ParquetRowGroup, i);
+        for (guint c = 0; group->chunks && c < file->columns->len; c++) {
+            if (group->chunks[c].min) g_bytes_unref(group->chunks[c].min);
+            if (group->chunks[c].max) g_bytes_unref(group->chunks[c].max);
+        }
+        g_free(group->chunks);
+    }
+    g_array_unref(file->row_groups);
+    g_ptr_array_unref(file->columns);
+    g_free(file->created_by);
+    g_free(file);
+}
+
+guint64 parquet_file_get_n_rows(const ParquetFile *file) {
+    return file->n_rows;
+}
+
+const gchar *parquet_file_get_created_by(const ParquetFile *file) {
+    return file->created_by;
+}
+
+guint parquet_file_get_n_columns(const ParquetFile *file) {
+    return file->columns->len;
+}
+
+const gchar *parquet_file_get_column_name(const ParquetFile *file, guint column) {
+    return ((ParquetColumn *)g_ptr_array_index(file->columns, column))->name;
+}
+
+const gchar *parquet_file_get_column_type(const ParquetFile *file, guint column) {
+    return ((ParquetColumn *)g_ptr_array_index(file->columns, column))->type_name;
+}
+
+guint parquet_file_get_n_row_groups(const ParquetFile *file) {
+    return file->row_groups->len;
+}
+
+guint64 parquet_file_get_row_group_first_row(const ParquetFile *file, guint row_group) {
+    return g_array_index(file->row_groups, ParquetRowGroup, row_group).first_row;
+}
+
+guint64 parquet_file_get_row_group_n_rows(const ParquetFile *file, guint row_group) {
+    return g_array_index(file->row_groups, ParquetRowGroup, row_group).n_rows;
+}
+
+guint parquet_file_find_row_group(const ParquetFile *file, guint64 row) {
+    guint low = 0, high = file->row_groups->len;
+    while (high - low > 1) {
+        guint mid = low + (high - low) / 2;
+        if (g_array_index(file->row_groups, ParquetRowGroup, mid).first_row <= row) low = mid;
+        else high = mid;
+    }
+    return low;
+}
+
+static const ParquetChunk *get_chunk(const ParquetFile *file, guint row_group, guint column) {
+    return &g_array_index(file->row_groups, ParquetRowGroup, row_group).chunks[column];
+}
+
+void parquet_file_get_chunk_range(const ParquetFile *file, guint row_group, guint column, guint64 *offset, guint64 *length) {
+    const ParquetChunk *chunk = get_chunk(file, row_group, column);
+    *offset = chunk->dictionary_page_offset >= 0 ? (guint64)chunk->dictionary_page_offset : (guint64)chunk->data_page_offset;
+    *length = chunk->compressed_size;
+}
+
+gboolean parquet_file_get_dictionary_offset(const ParquetFile *file, guint row_group, guint column, guint64 *offset) {
+    const ParquetChunk *chunk = get_chunk(file, row_group, column);
+    if (chunk->dictionary_page_offset < 0) return FALSE;
+    *offset = (guint64)chunk->dictionary_page_offset;
+    return TRUE;
+}
+
+gboolean parquet_file_get_offset_index_range(const ParquetFile *file, guint row_group, guint column, guint64 *offset, guint64 *length) {
+    const ParquetChunk *chunk = get_chunk(file, row_group, column);
+    if (chunk->offset_index_offset < 0 || chunk->offset_index_length == 0) return FALSE;
+    *offset = (guint64)chunk->offset_index_offset;
+    *length = chunk->offset_index_length;
+    return TRUE;
+}
+
+GArray *parquet_parse_offset_index(const guint8 *data, gsize length, GError **error) {
+    GArray *pages = g_array_new(FALSE, TRUE, sizeof(ParquetPageLocation));
+    ThriftReader reader = { data, data + length, FALSE };
+    ThriftReader *r = &reader;
+    gint last_id = 0, id;
+    guint8 type;
+    while (thrift_read_field(r, &last_id, &type, &id)) {
+        if (id != 1 || type != T_LIST) {
+            thrift_skip(r, type, 0);
+            continue;
+        }
+        guint8 element_type;
+        guint32 n = thrift_read_list(r, &element_type);
+        for (guint32 i = 0; i < n && !r->failed; i++) {
+            ParquetPageLocation page = { 0 };
+            gint page_last = 0, page_id;
+            guint8 page_type;
+            while (thrift_read_field(r, &page_last, &page_type, &page_id)) {
+                if (page_id == 1 && page_type == T_I64) page.offset = (guint64)thrift_read_zigzag(r);
+                else if (page_id == 2 && page_type == T_I32) page.length = (guint64)thrift_read_zigzag(r);
+                else if (page_id == 3 && page_type == T_I64) page.first_row = (guint64)thrift_read_zigzag(r);
+                else thrift_skip(r, page_type, 0);
+            }
+            g_array_append_val(pages, page);
+        }
+    }
+    if (r->failed || pages->len == 0) {
+        g_set_error(error, PARQUET_ERROR, 0, "Corrupt offset index");
+        g_array_unref(pages);
+        return NULL;
+    }
+    return pages;
+}
+
+// #############################################################################
+// # Values
+// #############################################################################
+
+static void append_hex(GString *out, const guint8 *data, gsize length) {
+    g_string_append(out, "0x");
+    for (gsize i = 0; i < length && i < PARQUET_MAX_HEX_BYTES; i++) g_string_append_printf(out, "%02x", data[i]);
+    if (length > PARQUET_MAX_HEX_BYTES) g_string_append(out, "\xe2\x80\xa6");
+}
+
+static void append_decimal(GString *out, gint64 unscaled, gint scale) {
+    gchar digits[32];
+    guint64 magnitude = unscaled < 0 ? -(guint64)unscaled : (guint64)unscaled;
+    g_snprintf(digits, sizeof(digits), "%" G_GUINT64_FORMAT, magnitude);
+    gint n = (gint)strlen(digits);
+    if (unscaled < 0) g_string_append_c(out, '-');
+    if (scale <= 0) {
+        g_string_append(out, digits);
+        return;
+    }
+    if (n <= scale) {
+        g_string_append(out, "0.");
+        for (gint i = n; i < scale; i++) g_string_append_c(out, '0');
+        g_string_append(out, digits);
+    } else {
+        g_string_append_len(out, digits, n - scale);
+        g_string_append_c(out, '.');
+        g_string_append(out, digits + n - scale);
+    }
+}
+
+// Formats `value` units of 10^-`digits` seconds since the epoch, in UTC.
+static void append_timestamp(GString *out, gint64 value, guint digits) {
+    gint64 per_second = 1;
+    for (guint i = 0; i < digits; i++) per_second *= 10;
+    gint64 seconds = value / per_second, fraction = value % per_second;
+    if (fraction < 0) {
+        seconds--;
+        fraction += per_second;
+    }
+    g_autoptr(GDateTime) time = g_date_time_new_from_unix_utc(seconds);
+    if (!time) {
+        g_string_append_printf(out, "%" G_GINT64_FORMAT, value);
+        return;
+    }
+    g_autofree gchar *text = g_date_time_format(time, "%Y-%m-%d %H:%M:%S");
+    g_string_append(out, text);
+    if (fraction) g_string_append_printf(out, ".%0*" G_GINT64_FORMAT, (gint)digits, fraction);
+}
+
+static void append_date(GString *out, gint32 days) {
+    g_autoptr(GDateTime) time = g_date_time_new_from_unix_utc((gint64)days * 86400);
+    if (!time) {
+        g_string_append_printf(out, "%d", days);
+        return;
+    }
+    g_autofree gchar *text = g_date_time_format(time, "%Y-%m-%d");
+    g_string_append(out, text);
+}
+
+static void append_time_of_day(GString *out, gint64 value, guint digits) {
+    gint64 per_second = 1;
+    for (guint i = 0; i < digits; i++) per_second *= 10;
+    gint64 seconds = value / per_second, fraction = value % per_second;
+    g_string_append_printf(out, "%02" G_GINT64_FORMAT ":%02" G_GINT64_FORMAT ":%02" G_GINT64_FORMAT, seconds / 3600, seconds / 60 % 60, seconds % 60);
+    if (fraction) g_string_append_printf(out, ".%0*" G_GINT64_FORMAT, (gint)digits, fraction);
+}
+
+// Two's complement big-endian integers up to 8 bytes, as DECIMAL stores them.
+static gboolean read_big_endian(const guint8 *data, gsize length, gint64 *value) {
+    if (length == 0 || length > 8) return FALSE;
+    guint64 result = (data[0] & 0x80) ? G_MAXUINT64 : 0;
+    for (gsize i = 0; i < length; i++) result = (result << 8) | data[i];
+    *value = (gint64)result;
+    return TRUE;
+}
+
+// Appends one value in its PLAIN encoding (without the length prefix of
+// BYTE_ARRAY) as text. Statistics use the same encoding.
+static void format_value(const ParquetColumn *column, const guint8 *data, gsize length, GString *out) {
+    gint32 i32;
+    gint64 i64;
+    switch (column->type) {
+    case PQ_BOOLEAN:
+        g_string_append(out, length > 0 && data[0] ? "true" : "false");
+        return;
+    case PQ_INT32:
+        if (length < 4) break;
+        i32 = (gint32)read_le32(data);
+        switch (column->kind) {
+        case KIND_DATE: append_date(out, i32); return;
+        case KIND_TIME_MILLIS: append_time_of_day(out, i32, 3); return;
+        case KIND_DECIMAL: append_decimal(out, i32, column->scale); return;
+        case KIND_UNSIGNED: g_string_append_printf(out, "%u", (guint32)i32); return;
+        default: g_string_append_printf(out, "%d", i32); return;
+        }
+    case PQ_INT64:
+        if (length < 8) break;
+        i64 = (gint64)read_le64(data);
+        switch (column->kind) {
+        case KIND_TIMESTAMP_MILLIS: append_timestamp(out, i64, 3); return;
+        case KIND_TIMESTAMP_MICROS: append_timestamp(out, i64, 6); return;
+        case KIND_TIMESTAMP_NANOS: append_timestamp(out, i64, 9); return;
+        case KIND_TIME_MICROS: append_time_of_day(out, i64, 6); return;
+        case KIND_TIME_NANOS: append_time_of_day(out, i64, 9); return;
+        case KIND_DECIMAL: append_decimal(out, i64, column->scale); return;
+        case KIND_UNSIGNED: g_string_append_printf(out, "%" G_GUINT64_FORMAT, (guint64)i64); return;
+        default: g_string_append_printf(out, "%" G_GINT64_FORMAT, i64); return;
+        }
+    case PQ_INT96: {
+        // Legacy Impala/Spark timestamps: nanoseconds of the day, Julian day.
+        if (length < 12) break;
+        gint64 nanos = (gint64)read_le64(data);
+        gint64 julian_day = (gint32)read_le32(data + 8);
+        append_timestamp(out, (julian_day - 2440588) * 86400 * G_GINT64_CONSTANT(1000000000) + nanos, 9);
+        return;
+    }
+    case PQ_FLOAT: {
+        if (length < 4) break;
+        gfloat f;
+        guint32 bits = read_le32(data);
+        memcpy(&f, &bits, sizeof(f));
+        gchar text[G_ASCII_DTOSTR_BUF_SIZE];
+        g_string_append(out, g_ascii_formatd(text, sizeof(text), "%.7g", f));
+        return;
+    }
+    case PQ_DOUBLE: {
+        if (length < 8) break;
+        gdouble d;
+        guint64 bits = read_le64(data);
+        memcpy(&d, &bits, sizeof(d));
+        gchar text[G_ASCII_DTOSTR_BUF_SIZE];
+        g_string_append(out, g_ascii_formatd(text, sizeof(text), "%.15g", d));
+        return;
+    }
+    case PQ_BYTE_ARRAY:
+    case PQ_FIXED_LEN_BYTE_ARRAY:
+        if (column->kind == KIND_DECIMAL && read_big_endian(data, length, &i64)) {
+            append_decimal(out, i64, column->scale);
+        } else if (column->kind == KIND_UUID && length == 16) {
+            g_string_append_printf(out, "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+                                   data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7],
+                                   data[8], data[9], data[10], data[11], data[12], data[13], data[14], data[15]);
+        } else if (column->type == PQ_BYTE_ARRAY && g_utf8_validate((const gchar *)data, length, NULL)) {
+            g_string_append_len(out, (const gchar *)data, length);
+        } else {
+            append_hex(out, data, length);
+        }
+        return;
+    }
+    g_string_append(out, "?");
+}
+
+// Orders two statistics values of a column.
+static gint compare_values(const ParquetColumn *column, GBytes *a, GBytes *b) {
+    gsize la, lb;
+    const guint8 *da = g_bytes_get_data(a, &la), *db = g_bytes_get_data(b, &lb);
+    switch (column->type) {
+    case PQ_INT32:
+        if (la < 4 || lb < 4) break;
+        if (column->kind == KIND_UNSIGNED) {
+            guint32 ua = read_le32(da), ub = read_le32(db);
+            return ua < ub ? -1 : ua > ub;
+        } else {
+            gint32 ia = (gint32)read_le32(da), ib = (gint32)read_le32(db);
+            return ia < ib ? -1 : ia > ib;
+        }
+    case PQ_INT64:
+        if (la < 8 || lb < 8) break;
+        if (column->kind == KIND_UNSIGNED) {
+            guint64 ua = read_le64(da), ub = read_le64(db);
+            return ua < ub ? -1 : ua > ub;
+        } else {
+            gint64 ia = (gint64)read_le64(da), ib = (gint64)read_le64(db);
+            return ia < ib ? -1 : ia > ib;
+        }
+    case PQ_FLOAT:
+    case PQ_DOUBLE: {
+        if (la < 4 || lb < 4) break;
+        gdouble fa, fb;
+        if (column->type == PQ_FLOAT) {
+            gfloat f;
+            guint32 bits = read_le32(da);
+            memcpy(&f, &bits, 4);
+            fa = f;
+            bits = read_le32(db);
+            memcpy(&f, &bits, 4);
+            fb = f;
+        } else {
+            if (la < 8 || lb < 8) break;
+            guint64 bits = read_le64(da);
+            memcpy(&fa, &bits, 8);
+            bits = read_le64(db);
+            memcpy(&fb, &bits, 8);
+        }
+        return fa < fb ? -1 : fa > fb;
+    }
+    default:
+        break;
+    }
+    gint result = memcmp(da, db, MIN(la, lb));
+    return result ? result : (la < lb ? -1 : la > lb);
+}
+
+void parquet_file_get_column_statistics(const ParquetFile *file, guint column, gchar **min, gchar **max, guint64 *null_count, guint64 *compressed_bytes) {
+    const ParquetColumn *col = g_ptr_array_index(file->columns, column);
+    GBytes *lowest = NULL, *highest = NULL;
+    gboolean complete = file->row_groups->len > 0;
+    *null_count = 0;
+    *compressed_bytes = 0;
+    for (guint g = 0; g < file->row_groups->len; g++) {
+        const ParquetChunk *chunk = get_chunk(file, g, column);
+        *compressed_bytes += chunk->compressed_size;
+        *null_count += chunk->null_count;
+        if (!chunk->min || !chunk->max) {
+            complete = FALSE;
+            continue;
+        }
+        if (!lowest || compare_values(col, chunk->min, lowest) < 0) lowest = chunk->min;
+        if (!highest || compare_values(col, chunk->max, highest) > 0) highest = chunk->max;
+    }
+    *min = *max = NULL;
+    if (!complete) return;
+    GString *text = g_string_new(NULL);
+    gsize length;
+    const guint8 *data = g_bytes_get_data(lowest, &length);
+    format_value(col, data, length, text);
+    *min = g_strdup(text->str);
+    g_string_truncate(text, 0);
+    data = g_bytes_get_data(highest, &length);
+    format_value(col, data, length, text);
+    *max = g_string_free(text, FALSE);
+}
+
+// #############################################################################
+// # Pages
+// #############################################################################
+
+void parquet_cells_free(ParquetCells *cells) {
+    if (!cells) return;
+    g_string_chunk_free(cells->strings);
+    g_ptr_array_unref(cells->cells);
+    g_free(cells);
+}
+
+// Raw Snappy block format: a varint length, then literals and back-references.
+static gboolean snappy_decompress(const guint8 *in, gsize in_length, guint8 *out, gsize out_length) {
+    const guint8 *end = in + in_length;
+    guint64 expected = 0;
+    guint shift = 0;
+    while (in < end && shift < 35) {
+        expected |= (guint64)(*in & 0x7f) << shift;
+        shift += 7;
+        if (!(*in++ & 0x80)) break;
+    }
+    if (expected != out_length) return FALSE;
+    gsize pos = 0;
+    while (in < end) {
+        guint8 tag = *in++;
+        gsize length, offset;
+        if ((tag & 3) == 0) {
+            length = (tag >> 2) + 1;
+            if (length > 60) {
+                gsize n = length - 60;
+                if ((gsize)(end - in) < n) return FALSE;
+                length = 0;
+                for (gsize i = 0; i < n; i++) length |= (gsize)in[i] << (8 * i);
+                length++;
+                in += n;
+            }
+            if ((gsize)(end - in) < length || out_length - pos < length) return FALSE;
+            memcpy(out + pos, in, length);
+            in += length;
+            pos += length;
+            continue;
+        }
+        if ((tag & 3) == 1) {
+            if (end - in < 1) return FALSE;
+            length = 4 + ((tag >> 2) & 7);
+            offset = ((gsize)(tag >> 5) << 8) | in[0];
+            in += 1;
+        } else if ((tag & 3) == 2) {
+            if (end - in < 2) return FALSE;
+            length = (tag >> 2) + 1;
+            offset = in[0] | ((gsize)in[1] << 8);
+            in += 2;
+        } else {
+            if (end - in < 4) return FALSE;
+            length = (tag >> 2) + 1;
+            offset = in[0] | ((gsize)in[1] << 8) | ((gsize)in[2] << 16) | ((gsize)in[3] << 24);
+            in += 4;
+        }
+        if (offset == 0 || offset > pos || out_length - pos < length) return FALSE;
+        // Copies may overlap their own output, so go byte by byte.
+        for (gsize i = 0; i < length; i++, pos++) out[pos] = out[pos - offset];
+    }
+    return pos == out_length;
+}
+
+static GBytes *decompress_page(gint codec, const guint8 *data, gsize length, gsize uncompressed_length, GError **error) {
+    if (codec == PQ_UNCOMPRESSED) return g_bytes_new_static(data, length);
+    if (uncompressed_length > PARQUET_MAX_PAGE_BYTES) {
+        g_set_error(error, PARQUET_ERROR, 0, "Page of %" G_GSIZE_FORMAT " bytes is too large", uncompressed_length);
+        return NULL;
+    }
+    guint8 *out = g_malloc(MAX(uncompressed_length, 1));
+    gboolean ok = FALSE;
+    if (codec == PQ_SNAPPY) {
+        ok = snappy_decompress(data, length, out, uncompressed_length);
+    } else if (codec == PQ_GZIP) {
+        g_autoptr(GZlibDecompressor) inflater = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP);
+        gsize read = 0, written = 0;
+        while (read < length && written < uncompressed_length) {
+            gsize r = 0, w = 0;
+            GConverterResult result = g_converter_convert(G_CONVERTER(inflater), data + read, length - read, out + written, uncompressed_length - written, G_CONVERTER_INPUT_AT_END, &r, &w, NULL);
+            read += r;
+            written += w;
+            if (result == G_CONVERTER_ERROR || result == G_CONVERTER_FINISHED || (r == 0 && w == 0)) break;
+        }
+        ok = written == uncompressed_length;
+#ifdef MYS3_HAVE_ZSTD
+    } else if (codec == PQ_ZSTD) {
+        size_t result = ZSTD_decompress(out, uncompressed_length, data, length);
+        ok = !ZSTD_isError(result) && result == uncompressed_length;
+#endif
+    } else {
+        const gchar *name = codec >= 0 && codec < (gint)G_N_ELEMENTS(codec_names) ? codec_names[codec] : "unknown";
+        g_set_error(error, PARQUET_ERROR, 0, "%s compression is not supported", name);
+        g_free(out);
+        return NULL;
+    }
+    if (!ok) {
+        g_set_error(error, PARQUET_ERROR, 0, "Corrupt compressed page");
+        g_free(out);
+        return NULL;
+    }
+    return g_bytes_new_take(out, uncompressed_length);
+}
+
+// Decoder for the RLE / bit-packing hybrid used by levels and dictionary ids.
+typedef struct {
+    const guint8 *pos, *end;
+    guint bit_width;
+    guint32 run_value;
+    guint64 run_left;
+    const guint8 *packed;
+    guint64 packed_left;
+    guint64 packed_bit;
+} RleDecoder;
+
+static void rle_init(RleDecoder *d, const guint8 *data, gsize length, guint bit_width) {
+    memset(d, 0, sizeof(*d));
+    d->pos = data;
+    d->end = data + length;
+    d->bit_width = bit_width;
+}
+
+static gboolean rle_next(RleDecoder *d, guint32 *value) {
+    for (;;) {
+        if (d->run_left > 0) {
+            d->run_left--;
+            *value = d->run_value;
+            return TRUE;
+        }
+        if (d->packed_left > 0) {
+            guint32 v = 0;
+            for (guint b = 0; b < d->bit_width; b++) {
+                guint64 bit = d->packed_bit + b;
+                v |= (guint32)((d->packed[bit >> 3] >> (bit & 7)) & 1) << b;
+            }
+            d->packed_bit += d->bit_width;
+            d->packed_left--;
+            *value = v;
+            return TRUE;
+        }
+        if (d->pos >= d->end) return FALSE;
+        ThriftReader r = { d->pos, d->end, FALSE };
+        guint64 header = thrift_read_varint(&r);
+        if (r.failed) return FALSE;
+        d->pos = r.pos;
+        if (header & 1) {
+            guint64 bytes = (header >> 1) * d->bit_width;
+            guint64 available = MIN(bytes, (guint64)(d->end - d->pos));
+            d->packed = d->pos;
+            d->packed_bit = 0;
+            // A last group cut short still holds whole values.
+            d->packed_left = d->bit_width ? MIN((header >> 1) * 8, available * 8 / d->bit_width) : (header >> 1) * 8;
+            d->pos += available;
+        } else {
+            guint n = (d->bit_width + 7) / 8;
+            if ((guint)(d->end - d->pos) < n) return FALSE;
+            d->run_value = 0;
+            for (guint i = 0; i < n; i++) d->run_value |= (guint32)d->pos[i] << (8 * i);
+            d->pos += n;
+            d->run_left = header >> 1;
+        }
+    }
+}
+
+static guint bit_width(guint max_value) {
+    guint width = 0;
+    while (max_value) {
+        width++;
+        max_value >>= 1;
+    }
+    return width;
+}
+
+typedef struct {
+    const ParquetColumn *column;
+    gint codec;
+    ParquetCells *cells;
+    GPtrArray *dictionary;      // Formatted dictionary entries, in cells->strings
+    GString *scratch;
+} PageDecoder;
+
+// Reads n PLAIN values into `out` (strings in the cells' chunk).
+static gboolean decode_plain(PageDecoder *pd, const guint8 *data, gsize length, guint64 n, GPtrArray *out) {
+    const ParquetColumn *column = pd->column;
+    gsize pos = 0;
+    for (guint64 i = 0; i < n; i++) {
+        g_string_truncate(pd->scratch, 0);
+        gsize size;
+        if (column->type == PQ_BOOLEAN) {
+            if (i / 8 >= length) return FALSE;
+            guint8 bit = (data[i / 8] >> (i % 8)) & 1;
+            format_value(column, &bit, 1, pd->scratch);
+        } else if (column->type == PQ_BYTE_ARRAY) {
+            if (length - pos < 4) return FALSE;
+            size = read_le32(data + pos);
+            pos += 4;
+            if (length - pos < size) return FALSE;
+            format_value(column, data + pos, size, pd->scratch);
+            pos += size;
+        } else {
+            size = column->type == PQ_INT32 || column->type == PQ_FLOAT ? 4 : column->type == PQ_INT96 ? 12 : column->type == PQ_FIXED_LEN_BYTE_ARRAY ? (gsize)column->type_length : 8;
+            if (length - pos < size) return FALSE;
+            format_value(column, data + pos, size, pd->scratch);
+            pos += size;
+        }
+        g_ptr_array_add(out, g_string_chunk_insert_len(pd->cells->strings, pd->scratch->str, pd->scratch->len));
+    }
+    return TRUE;
+}
+
+// Decodes the values of one data page and appends a cell per level.
+static gboolean decode_values(PageDecoder *pd, gint encoding, const guint8 *data, gsize length, const guint8 *definitions, gsize definitions_length, guint64 n_levels, GError **error) {
+    const ParquetColumn *column = pd->column;
+    // Which slots hold values.
+    guint8 *present = g_malloc(MAX(n_levels, 1));
+    guint64 n_values = 0;
+    if (column->max_definition > 0) {
+        RleDecoder levels;
+        rle_init(&levels, definitions, definitions_length, bit_width(column->max_definition));
+        for (guint64 i = 0; i < n_levels; i++) {
+            guint32 level = 0;
+            if (!rle_next(&levels, &level)) {
+                g_free(present);
+                g_set_error(error, PARQUET_ERROR, 0, "Corrupt definition levels");
+                return FALSE;
+            }
+            present[i] = level == column->max_definition;
+            n_values += present[i];
+        }
+    } else {
+        memset(present, 1, MAX(n_levels, 1));
+        n_values = n_levels;
+    }
+
+    GPtrArray *values = g_ptr_array_sized_new(n_values);
+    gboolean ok = FALSE;
+    if (encoding == PQ_PLAIN) {
+        ok = decode_plain(pd, data, length, n_values, values);
+    } else if ((encoding == PQ_PLAIN_DICTIONARY || encoding == PQ_RLE_DICTIONARY) && pd->dictionary && length > 0) {
+        RleDecoder ids;
+        rle_init(&ids, data + 1, length - 1, data[0]);
+        ok = data[0] <= 32;
+        for (guint64 i = 0; ok && i < n_values; i++) {
+            guint32 id = 0;
+            ok = rle_next(&ids, &id) && id < pd->dictionary->len;
+            if (ok) g_ptr_array_add(values, g_ptr_array_index(pd->dictionary, id));
+        }
+    } else if (encoding == PQ_RLE && column->type == PQ_BOOLEAN && length >= 4) {
+        RleDecoder bits;
+        rle_init(&bits, data + 4, MIN(length - 4, read_le32(data)), 1);
+        ok = TRUE;
+        for (guint64 i = 0; ok && i < n_values; i++) {
+            guint32 bit = 0;
+            ok = rle_next(&bits, &bit);
+            if (ok) g_ptr_array_add(values, (gpointer)(bit ? "true" : "false"));
+        }
+    } else {
+        g_ptr_array_unref(values);
+        g_free(present);
+        if (encoding == PQ_PLAIN_DICTIONARY || encoding == PQ_RLE_DICTIONARY) g_set_error(error, PARQUET_ERROR, 0, "Dictionary page missing");
+        else g_set_error(error, PARQUET_ERROR, 0, "Encoding %d is not supported", encoding);
+        return FALSE;
+    }
+    if (!ok) {
+        g_ptr_array_unref(values);
+        g_free(present);
+        g_set_error(error, PARQUET_ERROR, 0, "Corrupt data page");
+        return FALSE;
+    }
+    guint64 next = 0;
+    for (guint64 i = 0; i < n_levels; i++) g_ptr_array_add(pd->cells->cells, present[i] ? g_ptr_array_index(values, next++) : NULL);
+    g_ptr_array_unref(values);
+    g_free(present);
+    return TRUE;
+}
+
+typedef struct {
+    gint type;
+    gint32 uncompressed_size;
+    gint32 compressed_size;
+    gint32 n_values;
+    gint encoding;
+    gint32 definitions_length;      // Data page v2
+    gint32 repetitions_length;      // Data page v2
+    gboolean is_compressed;         // Data page v2
+} PageHeader;
+
+static void read_page_header(ThriftReader *r, PageHeader *header) {
+    memset(header, 0, sizeof(*header));
+    header->type = -1;
+    header->is_compressed = TRUE;
+    gint last_id = 0, id;
+    guint8 type;
+    while (thrift_read_field(r, &last_id, &type, &id)) {
+        if (id == 1 && type == T_I32) header->type = (gint)thrift_read_zigzag(r);
+        else if (id == 2 && type == T_I32) header->uncompressed_size = (gint32)thrift_read_zigzag(r);
+        else if (id == 3 && type == T_I32) header->compressed_size = (gint32)thrift_read_zigzag(r);
+        else if ((id == 5 || id == 7 || id == 8) && type == T_STRUCT) {
+            // Data, dictionary and v2 data page headers share their first fields.
+            gint inner_last = 0, inner_id;
+            guint8 inner_type;
+            while (thrift_read_field(r, &inner_last, &inner_type, &inner_id)) {
+                if (inner_id == 1 && inner_type == T_I32) header->n_values = (gint32)thrift_read_zigzag(r);
+                else if (inner_id == 2 && inner_type == T_I32 && id != 8) header->encoding = (gint)thrift_read_zigzag(r);
+                else if (inner_id == 4 && inner_type == T_I32 && id == 8) header->encoding = (gint)thrift_read_zigzag(r);
+                else if (inner_id == 5 && inner_type == T_I32 && id == 8) header->definitions_length = (gint32)thrift_read_zigzag(r);
+                else if (inner_id == 6 && inner_type == T_I32 && id == 8) header->repetitions_length = (gint32)thrift_read_zigzag(r);
+                else if (inner_id == 7 && id == 8 && (inner_type == T_TRUE || inner_type == T_FALSE)) header->is_compressed = inner_type == T_TRUE;
+                else thrift_skip(r, inner_type, 0);
+            }
+        } else {
+            thrift_skip(r, type, 0);
+        }
+    }
+}
+
+static gboolean decode_page_run(PageDecoder *pd, const guint8 *data, gsize length, GError **error) {
+    gsize pos = 0;
+    while (pos < length) {
+        ThriftReader r = { data + pos, data + length, FALSE };
+        PageHeader header;
+        read_page_header(&r, &header);
+        if (r.failed || header.compressed_size < 0 || header.uncompressed_size < 0 || (gsize)header.compressed_size > (gsize)(r.end - r.pos)) {
+            g_set_error(error, PARQUET_ERROR, 0, "Corrupt or truncated page header");
+            return FALSE;
+        }
+        const guint8 *page = r.pos;
+        gsize page_length = header.compressed_size;
+        pos = (r.pos - data) + page_length;
+
+        if (header.type == PQ_DICTIONARY_PAGE) {
+            g_autoptr(GBytes) bytes = decompress_page(pd->codec, page, page_length, header.uncompressed_size, error);
+            if (!bytes) return FALSE;
+            gsize size;
+            const guint8 *values = g_bytes_get_data(bytes, &size);
+            if (pd->dictionary) g_ptr_array_unref(pd->dictionary);
+            pd->dictionary = g_ptr_array_sized_new(MAX(header.n_values, 0));
+            if (header.n_values < 0 || !decode_plain(pd, values, size, header.n_values, pd->dictionary)) {
+                g_set_error(error, PARQUET_ERROR, 0, "Corrupt dictionary page");
+                return FALSE;
+            }
+        } else if (header.type == PQ_DATA_PAGE) {
+            g_autoptr(GBytes) bytes = decompress_page(pd->codec, page, page_length, header.uncompressed_size, error);
+            if (!bytes) return FALSE;
+            gsize size;
+            const guint8 *body = g_bytes_get_data(bytes, &size);
+            const guint8 *definitions = NULL;
+            gsize definitions_length = 0;
+            if (pd->column->max_definition > 0) {
+                if (size < 4 || read_le32(body) > size - 4) {
+                    g_set_error(error, PARQUET_ERROR, 0, "Corrupt data page");
+                    return FALSE;
+                }
+                definitions_length = read_le32(body);
+                definitions = body + 4;
+                body += 4 + definitions_length;
+                size -= 4 + definitions_length;
+            }
+            if (!decode_values(pd, header.encoding, body, size, definitions, definitions_length, MAX(header.n_values, 0), error)) return FALSE;
+        } else if (header.type == PQ_DATA_PAGE_V2) {
+            // Levels are never compressed in v2 pages; the values may be.
+            gsize levels = (gsize)MAX(header.repetitions_length, 0) + MAX(header.definitions_length, 0);
+            if (levels > page_length || (gsize)header.uncompressed_size < levels) {
+                g_set_error(error, PARQUET_ERROR, 0, "Corrupt data page");
+                return FALSE;
+            }
+            const guint8 *definitions = page + MAX(header.repetitions_length, 0);
+            g_autoptr(GBytes) bytes = header.is_compressed ? decompress_page(pd->codec, page + levels, page_length - levels, header.uncompressed_size - levels, error) : g_bytes_new_static(page + levels, page_length - levels);
+            if (!bytes) return FALSE;
+            gsize size;
+            const guint8 *body = g_bytes_get_data(bytes, &size);
+            if (!decode_values(pd, header.encoding, body, size, definitions, MAX(header.definitions_length, 0), MAX(header.n_values, 0), error)) return FALSE;
+        }
+        // Index pages and unknown page types are skipped.
+    }
+    return TRUE;
+}
+
+ParquetCells *parquet_decode_pages(const ParquetFile *file, guint row_group, guint column, const guint8 *dictionary, gsize dictionary_length, const guint8 *data, gsize length, GError **error) {
+    const ParquetColumn *col = g_ptr_array_index(file->columns, column);
+    const ParquetChunk *chunk = get_chunk(file, row_group, column);
+    if (col->max_repetition > 0) {
+        g_set_error(error, PARQUET_ERROR, 0, "Nested column %s is not supported", col->name);
+        return NULL;
+    }
+    if (chunk->external) {
+        g_set_error(error, PARQUET_ERROR, 0, "Column chunk stored in another file");
+        return NULL;
+    }
+    PageDecoder pd = { 0 };
+    pd.column = col;
+    pd.codec = chunk->codec;
+    pd.cells = g_new0(ParquetCells, 1);
+    pd.cells->strings = g_string_chunk_new(64 * 1024);
+    pd.cells->cells = g_ptr_array_new();
+    pd.scratch = g_string_new(NULL);
+    gboolean ok = (!dictionary || decode_page_run(&pd, dictionary, dictionary_length, error)) && decode_page_run(&pd, data, length, error);
+    if (pd.dictionary) g_ptr_array_unref(pd.dictionary);
+    g_string_free(pd.scratch, TRUE);
+    if (!ok) {
+        parquet_cells_free(pd.cells);
+        return NULL;
+    }
+    return pd.cells;
+}
@@ -0,0 +1,77 @@
+#ifndef MYS3_PARQUET_READER_H
+#define MYS3_PARQUET_READER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Bytes at the end of a Parquet file: metadata length and the "PAR1" magic.
+#define PARQUET_TRAILER_BYTES 8
+
+// Decoded Parquet footer (FileMetaData). Reads nothing by itself: callers
+// fetch the byte ranges it points at and hand them back for decoding, so a
+// viewer transfers only the pages it shows. Flat schemas only; columns under
+// a repeated field report an error when decoded. Read-only once created, so
+// it may be shared between threads.
+typedef struct _ParquetFile ParquetFile;
+
+// Checks the trailer and returns the length of the metadata before it.
+gboolean parquet_trailer_get_metadata_length(const guint8 *trailer, guint32 *length, GError **error);
+ParquetFile *parquet_file_new(const guint8 *metadata, gsize length, GError **error);
+void parquet_file_free(ParquetFile *file);
+
+guint64 parquet_file_get_n_rows(const ParquetFile *file);
+const gchar *parquet_file_get_created_by(const ParquetFile *file);
+guint parquet_file_get_n_columns(const ParquetFile *file);
+// Dotted path of a leaf column.
+const gchar *parquet_file_get_column_name(const ParquetFile *file, guint column);
+// Physical type with its logical annotation, e.g. "INT64 TIMESTAMP(us)".
+const gchar *parquet_file_get_column_type(const ParquetFile *file, guint column);
+
+guint parquet_file_get_n_row_groups(const ParquetFile *file);
+guint64 parquet_file_get_row_group_first_row(const ParquetFile *file, guint row_group);
+guint64 parquet_file_get_row_group_n_rows(const ParquetFile *file, guint row_group);
+// Row group holding `row`, which must be below the row count.
+guint parquet_file_find_row_group(const ParquetFile *file, guint64 row);
+
+// Byte range of a column chunk, dictionary page included.
+void parquet_file_get_chunk_range(const ParquetFile *file, guint row_group, guint column, guint64 *offset, guint64 *length);
+// Byte range of the dictionary page, when the chunk has one. It ends where
+// the first data page starts, which only the offset index tells.
+gboolean parquet_file_get_dictionary_offset(const ParquetFile *file, guint row_group, guint column, guint64 *offset);
+// Byte range of the chunk's OffsetIndex, written by most current writers.
+gboolean parquet_file_get_offset_index_range(const ParquetFile *file, guint row_group, guint column, guint64 *offset, guint64 *length);
+
+// Statistics of a column over all row groups, formatted like cell values.
+// min and max are NULL when some row group has none.
+void parquet_file_get_column_statistics(const ParquetFile *file, guint column, gchar **min, gchar **max, guint64 *null_count, guint64 *compressed_bytes);
+
+typedef struct {
+    guint64 offset;
+    guint64 length;
+    guint64 first_row;  // Relative to the row group
+} ParquetPageLocation;
+
+// Parses an OffsetIndex into a GArray of ParquetPageLocation, in row order.
+GArray *parquet_parse_offset_index(const guint8 *data, gsize length, GError **error);
+
+// Formatted values of consecutive rows; NULL cells are null values.
+typedef struct {
+    GStringChunk *strings;
+    GPtrArray *cells;
+} ParquetCells;
+
+void parquet_cells_free(ParquetCells *cells);
+
+// Decodes consecutive pages of one column chunk into one cell per row.
+// `dictionary`, which may be NULL, holds the chunk's dictionary page when
+// `data` does not start with it. PLAIN and dictionary encodings are read;
+// pages may be uncompressed, Snappy or gzip, and zstd when built with
+// libzstd.
+ParquetCells *parquet_decode_pages(const ParquetFile *file, guint row_group, guint column, const guint8 *dictionary, gsize dictionary_length, const guint8 *data, gsize length, GError **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(ParquetCells, parquet_cells_free)
+
+G_END_DECLS
+
+#endif // MYS3_PARQUET_READER_H
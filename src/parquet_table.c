@@ -0,0 +1,492 @@
+#include "parquet_table.h"
+#include "s3_client.h"
+#include <string.h>
+
+// Tail fetched first; covers the footer of all but very wide files.
+#define PARQUET_FOOTER_GUESS (64 * 1024)
+// Decoded pages (or whole column chunks) kept while scrolling.
+#define PARQUET_TABLE_CACHED_BLOCKS 128
+// Page number of a block that holds a whole column chunk.
+#define PARQUET_WHOLE_CHUNK 0xffffff
+
+// #############################################################################
+// # ParquetRow
+// #############################################################################
+
+struct _ParquetRow {
+    GObject parent_instance;
+    guint64 index;
+};
+
+G_DEFINE_TYPE(ParquetRow, parquet_row, G_TYPE_OBJECT)
+
+static void parquet_row_class_init(ParquetRowClass *klass) {
+    (void)klass;
+}
+
+static void parquet_row_init(ParquetRow *row) {
+    (void)row;
+}
+
+guint64 parquet_row_get_index(ParquetRow *row) {
+    g_return_val_if_fail(PARQUET_IS_ROW(row), 0);
+    return row->index;
+}
+
+// #############################################################################
+// # ParquetTable
+// #############################################################################
+
+typedef enum { INDEX_UNKNOWN, INDEX_FETCHING, INDEX_READY, INDEX_NONE } IndexState;
+
+// What is known about one column chunk beyond the footer.
+typedef struct {
+    IndexState index;
+    GArray *pages;          // ParquetPageLocation, once the offset index is read
+    GBytes *dictionary;     // Dictionary page, once a page fetch brought it
+} ChunkState;
+
+typedef struct {
+    guint64 first_row;
+    guint64 n_rows;
+    gboolean pending;
+    ParquetCells *cells;
+    gchar *error;
+} Block;
+
+struct _ParquetTable {
+    GObject parent_instance;
+    gchar *endpoint, *access_key, *secret_key, *bucket, *key;
+    gboolean use_ssl;
+    ParquetFile *file;
+    GCancellable *cancellable;
+    GHashTable *chunks;     // (row group << 32 | column) -> ChunkState
+    GHashTable *blocks;     // (row group << 40 | column << 24 | page) -> Block
+    GQueue block_lru;       // Keys of loaded blocks, most recently used first
+    guint64 bytes_fetched;
+    guint n_requests;
+};
+
+static void parquet_table_model_init(GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(ParquetTable, parquet_table, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL, parquet_table_model_init))
+
+static void chunk_state_free(ChunkState *state) {
+    if (state->pages) g_array_unref(state->pages);
+    if (state->dictionary) g_bytes_unref(state->dictionary);
+    g_free(state);
+}
+
+static void block_free(Block *block) {
+    parquet_cells_free(block->cells);
+    g_free(block->error);
+    g_free(block);
+}
+
+static GType parquet_table_get_item_type(GListModel *model) {
+    (void)model;
+    return PARQUET_TYPE_ROW;
+}
+
+static guint parquet_table_get_n_items(GListModel *model) {
+    ParquetTable *table = PARQUET_TABLE(model);
+    return table->file ? (guint)MIN(parquet_file_get_n_rows(table->file), (guint64)G_MAXUINT) : 0;
+}
+
+static gpointer parquet_table_get_item(GListModel *model, guint position) {
+    if (position >= parquet_table_get_n_items(model)) return NULL;
+    ParquetRow *row = g_object_new(PARQUET_TYPE_ROW, NULL);
+    row->index = position;
+    return row;
+}
+
+static void parquet_table_model_init(GListModelInterface *iface) {
+    iface->get_item_type = parquet_table_get_item_type;
+    iface->get_n_items = parquet_table_get_n_items;
+    iface->get_item = parquet_table_get_item;
+}
+
+static void parquet_table_finalize(GObject *object) {
+    ParquetTable *table = PARQUET_TABLE(object);
+    g_free(table->endpoint); g_free(table->access_key); g_free(table->secret_key); g_free(table->bucket); g_free(table->key);
+    parquet_file_free(table->file);
+    g_object_unref(table->cancellable);
+    g_hash_table_unref(table->chunks);
+    g_hash_table_unref(table->blocks);
+    g_queue_clear_full(&table->block_lru, g_free);
+    G_OBJECT_CLASS(parquet_table_parent_class)->finalize(object);
+}
+
+static void parquet_table_class_init(ParquetTableClass *klass) {
+    G_OBJECT_CLASS(klass)->finalize = parquet_table_finalize;
+}
+
+static void parquet_table_init(ParquetTable *table) {
+    table->cancellable = g_cancellable_new();
+    table->chunks = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, (GDestroyNotify)chunk_state_free);
+    table->blocks = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, (GDestroyNotify)block_free);
+    g_queue_init(&table->block_lru);
+}
+
+// #############################################################################
+// # Opening
+// #############################################################################
+
+typedef struct {
+    gchar *endpoint, *access_key, *secret_key, *bucket, *key;
+    gboolean use_ssl;
+    guint64 size;
+    guint64 bytes_fetched;
+    guint n_requests;
+} OpenJob;
+
+static void open_job_free(OpenJob *job) {
+    g_free(job->endpoint); g_free(job->access_key); g_free(job->secret_key); g_free(job->bucket); g_free(job->key);
+    g_free(job);
+}
+
+static GBytes *open_job_fetch(OpenJob *job, guint64 offset, guint64 length, GError **error) {
+    GBytes *bytes = s3_client_download_range(job->endpoint, job->access_key, job->secret_key, job->bucket, job->key, offset, length, job->use_ssl, NULL, error);
+    job->n_requests++;
+    if (!bytes) return NULL;
+    job->bytes_fetched += g_bytes_get_size(bytes);
+    if (g_bytes_get_size(bytes) != length) {
+        g_bytes_unref(bytes);
+        g_set_error(error, g_quark_from_static_string("Parquet"), 0, "Short read of the Parquet footer");
+        return NULL;
+    }
+    return bytes;
+}
+
+static void open_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    (void)source;
+    OpenJob *job = (OpenJob *)task_data;
+    GError *error = NULL;
+    if (job->size < 12) {
+        g_task_return_new_error(task, g_quark_from_static_string("Parquet"), 0, "Not a Parquet file (too small)");
+        return;
+    }
+    guint64 tail_length = MIN(job->size, (guint64)PARQUET_FOOTER_GUESS);
+    g_autoptr(GBytes) tail = open_job_fetch(job, job->size - tail_length, tail_length, &error);
+    if (!tail) {
+        g_task_return_error(task, error);
+        return;
+    }
+    const guint8 *data = g_bytes_get_data(tail, NULL);
+    guint32 metadata_length;
+    if (!parquet_trailer_get_metadata_length(data + tail_length - PARQUET_TRAILER_BYTES, &metadata_length, &error)) {
+        g_task_return_error(task, error);
+        return;
+    }
+    if ((guint64)metadata_length + PARQUET_TRAILER_BYTES > job->size) {
+        g_task_return_new_error(task, g_quark_from_static_string("Parquet"), 0, "Corrupt Parquet trailer");
+        return;
+    }
+    const guint8 *metadata = data + tail_length - PARQUET_TRAILER_BYTES - MIN((guint64)metadata_length, tail_length - PARQUET_TRAILER_BYTES);
+    g_autoptr(GBytes) footer = NULL;
+    if ((guint64)metadata_length + PARQUET_TRAILER_BYTES > tail_length) {
+        // A wide schema: fetch exactly the rest of the footer.
+        if (g_cancellable_set_error_if_cancelled(cancellable, &error)) {
+            g_task_return_error(task, error);
+            return;
+        }
+        footer = open_job_fetch(job, job->size - PARQUET_TRAILER_BYTES - metadata_length, metadata_length, &error);
+        if (!footer) {
+            g_task_return_error(task, error);
+            return;
+        }
+        metadata = g_bytes_get_data(footer, NULL);
+    }
+    ParquetFile *file = parquet_file_new(metadata, metadata_length, &error);
+    if (!file) {
+        g_task_return_error(task, error);
+        return;
+    }
+    g_task_return_pointer(task, file, (GDestroyNotify)parquet_file_free);
+}
+
+void parquet_table_open_async(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, guint64 size, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data) {
+    OpenJob *job = g_new0(OpenJob, 1);
+    job->endpoint = g_strdup(endpoint);
+    job->access_key = g_strdup(access_key);
+    job->secret_key = g_strdup(secret_key);
+    job->bucket = g_strdup(bucket);
+    job->key = g_strdup(key);
+    job->use_ssl = use_ssl;
+    job->size = size;
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, parquet_table_open_async);
+    g_task_set_task_data(task, job, (GDestroyNotify)open_job_free);
+    g_task_run_in_thread(task, open_thread);
+    g_object_unref(task);
+}
+
+ParquetTable *parquet_table_open_finish(GAsyncResult *result, GError **error) {
+    g_return_val_if_fail(g_task_is_valid(result, NULL), NULL);
+    ParquetFile *file = g_task_propagate_pointer(G_TASK(result), error);
+    if (!file) return NULL;
+    OpenJob *job = g_task_get_task_data(G_TASK(result));
+    ParquetTable *table = g_object_new(PARQUET_TYPE_TABLE, NULL);
+    table->endpoint = g_strdup(job->endpoint);
+    table->access_key = g_strdup(job->access_key);
+    table->secret_key = g_strdup(job->secret_key);
+    table->bucket = g_strdup(job->bucket);
+    table->key = g_strdup(job->key);
+    table->use_ssl = job->use_ssl;
+    table->file = file;
+    table->bytes_fetched = job->bytes_fetched;
+    table->n_requests = job->n_requests;
+    return table;
+}
+
+const ParquetFile *parquet_table_get_file(ParquetTable *table) {
+    g_return_val_if_fail(PARQUET_IS_TABLE(table), NULL);
+    return table->file;
+}
+
+guint64 parquet_table_get_bytes_fetched(ParquetTable *table) {
+    return table->bytes_fetched;
+}
+
+guint parquet_table_get_n_requests(ParquetTable *table) {
+    return table->n_requests;
+}
+
+void parquet_table_cancel(ParquetTable *table) {
+    g_cancellable_cancel(table->cancellable);
+}
+
+// #############################################################################
+// # Fetching
+// #############################################################################
+
+typedef enum { FETCH_OFFSET_INDEX, FETCH_PAGES } FetchKind;
+
+typedef struct {
+    FetchKind kind;
+    guint row_group;
+    guint column;
+    guint64 block_key;
+    guint64 offset, length;
+    guint64 dictionary_offset, dictionary_length;   // Fetched first when non-zero
+    GBytes *dictionary;
+    GArray *pages;              // Result of FETCH_OFFSET_INDEX
+    ParquetCells *cells;        // Result of FETCH_PAGES
+    guint64 bytes_fetched;
+    guint n_requests;
+} FetchJob;
+
+static void fetch_job_free(FetchJob *job) {
+    if (job->dictionary) g_bytes_unref(job->dictionary);
+    if (job->pages) g_array_unref(job->pages);
+    parquet_cells_free(job->cells);
+    g_free(job);
+}
+
+static GBytes *fetch_range(ParquetTable *table, FetchJob *job, guint64 offset, guint64 length, GError **error) {
+    GBytes *bytes = s3_client_download_range(table->endpoint, table->access_key, table->secret_key, table->bucket, table->key, offset, length, table->use_ssl, NULL, error);
+    job->n_requests++;
+    if (bytes) job->bytes_fetched += g_bytes_get_size(bytes);
+    return bytes;
+}
+
+static void fetch_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    ParquetTable *table = PARQUET_TABLE(source);
+    FetchJob *job = (FetchJob *)task_data;
+    GError *error = NULL;
+    if (g_cancellable_set_error_if_cancelled(cancellable, &error)) {
+        g_task_return_error(task, error);
+        return;
+    }
+    if (job->kind == FETCH_OFFSET_INDEX) {
+        g_autoptr(GBytes) bytes = fetch_range(table, job, job->offset, job->length, &error);
+        gsize length;
+        const guint8 *data = bytes ? g_bytes_get_data(bytes, &length) : NULL;
+        if (data) job->pages = parquet_parse_offset_index(data, length, &error);
+        if (!job->pages) g_task_return_error(task, error);
+        else g_task_return_boolean(task, TRUE);
+        return;
+    }
+    if (job->dictionary_length > 0) {
+        job->dictionary = fetch_range(table, job, job->dictionary_offset, job->dictionary_length, &error);
+        if (!job->dictionary) {
+            g_task_return_error(task, error);
+            return;
+        }
+    }
+    g_autoptr(GBytes) bytes = fetch_range(table, job, job->offset, job->length, &error);
+    if (!bytes) {
+        g_task_return_error(task, error);
+        return;
+    }
+    gsize length, dictionary_length = 0;
+    const guint8 *data = g_bytes_get_data(bytes, &length);
+    const guint8 *dictionary = job->dictionary ? g_bytes_get_data(job->dictionary, &dictionary_length) : NULL;
+    job->cells = parquet_decode_pages(table->file, job->row_group, job->column, dictionary, dictionary_length, data, length, &error);
+    if (!job->cells) g_task_return_error(task, error);
+    else g_task_return_boolean(task, TRUE);
+}
+
+// Tells views to rebind rows whose cells changed state.
+static void emit_rows_changed(ParquetTable *table, guint64 first, guint64 n) {
+    if (first >= G_MAXUINT) return;
+    n = MIN(n, (guint64)G_MAXUINT - first);
+    if (n > 0) g_list_model_items_changed(G_LIST_MODEL(table), (guint)first, (guint)n, (guint)n);
+}
+
+static ChunkState *get_chunk_state(ParquetTable *table, guint row_group, guint column) {
+    guint64 key = (guint64)row_group << 32 | column;
+    ChunkState *state = g_hash_table_lookup(table->chunks, &key);
+    if (!state) {
+        state = g_new0(ChunkState, 1);
+        g_hash_table_insert(table->chunks, g_memdup2(&key, sizeof(key)), state);
+    }
+    return state;
+}
+
+static void on_fetch_done(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)user_data;
+    ParquetTable *table = PARQUET_TABLE(source);
+    FetchJob *job = g_task_get_task_data(G_TASK(result));
+    g_autoptr(GError) error = NULL;
+    gboolean ok = g_task_propagate_boolean(G_TASK(result), &error);
+    table->bytes_fetched += job->bytes_fetched;
+    table->n_requests += job->n_requests;
+    if (g_cancellable_is_cancelled(table->cancellable)) return;
+
+    const ParquetFile *file = table->file;
+    guint64 group_first = parquet_file_get_row_group_first_row(file, job->row_group);
+    ChunkState *state = get_chunk_state(table, job->row_group, job->column);
+    if (job->kind == FETCH_OFFSET_INDEX) {
+        // Without a usable index the whole chunk is fetched instead.
+        state->index = ok ? INDEX_READY : INDEX_NONE;
+        state->pages = g_steal_pointer(&job->pages);
+        emit_rows_changed(table, group_first, parquet_file_get_row_group_n_rows(file, job->row_group));
+        return;
+    }
+
+    if (job->dictionary && !state->dictionary) state->dictionary = g_bytes_ref(job->dictionary);
+    Block *block = g_hash_table_lookup(table->blocks, &job->block_key);
+    if (!block) return;
+    block->pending = FALSE;
+    if (ok) block->cells = g_steal_pointer(&job->cells);
+    else block->error = g_strdup(error->message);
+    g_queue_push_head(&table->block_lru, g_memdup2(&job->block_key, sizeof(job->block_key)));
+    while (g_queue_get_length(&table->block_lru) > PARQUET_TABLE_CACHED_BLOCKS) {
+        guint64 *evicted = g_queue_pop_tail(&table->block_lru);
+        g_hash_table_remove(table->blocks, evicted);
+        g_free(evicted);
+    }
+    emit_rows_changed(table, block->first_row, block->n_rows);
+}
+
+static void start_fetch(ParquetTable *table, FetchJob *job) {
+    GTask *task = g_task_new(table, table->cancellable, on_fetch_done, NULL);
+    g_task_set_task_data(task, job, (GDestroyNotify)fetch_job_free);
+    g_task_run_in_thread(task, fetch_thread);
+    g_object_unref(task);
+}
+
+static gint compare_block_keys(gconstpointer a, gconstpointer b) {
+    return *(const guint64 *)a != *(const guint64 *)b;
+}
+
+static void touch_block(ParquetTable *table, guint64 key) {
+    GList *link = g_queue_find_custom(&table->block_lru, &key, compare_block_keys);
+    if (!link || link == table->block_lru.head) return;
+    g_queue_unlink(&table->block_lru, link);
+    g_queue_push_head_link(&table->block_lru, link);
+}
+
+const gchar *parquet_table_get_cell(ParquetTable *table, guint64 row, guint column, ParquetCellState *state) {
+    const ParquetFile *file = table->file;
+    *state = PARQUET_CELL_PENDING;
+    if (row >= parquet_file_get_n_rows(file) || column >= parquet_file_get_n_columns(file)) {
+        *state = PARQUET_CELL_READY;
+        return NULL;
+    }
+    guint group = parquet_file_find_row_group(file, row);
+    guint64 group_first = parquet_file_get_row_group_first_row(file, group);
+    guint64 group_rows = parquet_file_get_row_group_n_rows(file, group);
+    ChunkState *chunk = get_chunk_state(table, group, column);
+    gboolean cancelled = g_cancellable_is_cancelled(table->cancellable);
+
+    if (chunk->index == INDEX_UNKNOWN) {
+        guint64 offset, length;
+        if (!parquet_file_get_offset_index_range(file, group, column, &offset, &length)) {
+            chunk->index = INDEX_NONE;
+        } else if (!cancelled) {
+            FetchJob *job = g_new0(FetchJob, 1);
+            job->kind = FETCH_OFFSET_INDEX;
+            job->row_group = group;
+            job->column = column;
+            job->offset = offset;
+            job->length = length;
+            chunk->index = INDEX_FETCHING;
+            start_fetch(table, job);
+            return NULL;
+        }
+    }
+    if (chunk->index == INDEX_FETCHING) return NULL;
+
+    // The block is the page holding the row, or the whole chunk.
+    guint page = PARQUET_WHOLE_CHUNK;
+    guint64 block_first = group_first, block_rows = group_rows, offset, length;
+    parquet_file_get_chunk_range(file, group, column, &offset, &length);
+    if (chunk->pages) {
+        guint64 local = row - group_first;
+        guint low = 0, high = chunk->pages->len;
+        while (high - low > 1) {
+            guint mid = low + (high - low) / 2;
+            if (g_array_index(chunk->pages, ParquetPageLocation, mid).first_row <= local) low = mid;
+            else high = mid;
+        }
+        ParquetPageLocation *location = &g_array_index(chunk->pages, ParquetPageLocation, low);
+        page = low;
+        block_first = group_first + location->first_row;
+        guint64 next = low + 1 < chunk->pages->len ? g_array_index(chunk->pages, ParquetPageLocation, low + 1).first_row : group_rows;
+        block_rows = next > location->first_row ? next - location->first_row : 0;
+        offset = location->offset;
+        length = location->length;
+    }
+    guint64 key = (guint64)group << 40 | (guint64)column << 24 | page;
+    Block *block = g_hash_table_lookup(table->blocks, &key);
+    if (!block) {
+        if (cancelled) return NULL;
+        FetchJob *job = g_new0(FetchJob, 1);
+        job->kind = FETCH_PAGES;
+        job->row_group = group;
+        job->column = column;
+        job->block_key = key;
+        job->offset = offset;
+        job->length = length;
+        guint64 dictionary_offset;
+        if (chunk->pages && parquet_file_get_dictionary_offset(file, group, column, &dictionary_offset)) {
+            // The dictionary page ends where the first data page starts.
+            guint64 first_page = g_array_index(chunk->pages, ParquetPageLocation, 0).offset;
+            if (chunk->dictionary) {
+                job->dictionary = g_bytes_ref(chunk->dictionary);
+            } else if (first_page > dictionary_offset) {
+                job->dictionary_offset = dictionary_offset;
+                job->dictionary_length = first_page - dictionary_offset;
+            }
+        }
+        block = g_new0(Block, 1);
+        block->first_row = block_first;
+        block->n_rows = block_rows;
+        block->pending = TRUE;
+        g_hash_table_insert(table->blocks, g_memdup2(&key, sizeof(key)), block);
+        start_fetch(table, job);
+        return NULL;
+    }
+    if (block->pending) return NULL;
+    touch_block(table, key);
+    if (block->error) {
+        *state = PARQUET_CELL_FAILED;
+        return block->error;
+    }
+    *state = PARQUET_CELL_READY;
+    guint64 index = row - block->first_row;
+    return index < block->cells->cells->len ? g_ptr_array_index(block->cells->cells, index) : NULL;
+}
@@ -0,0 +1,46 @@
+#ifndef MYS3_PARQUET_TABLE_H
+#define MYS3_PARQUET_TABLE_H
+
+#include <gio/gio.h>
+#include "parquet_reader.h"
+
+G_BEGIN_DECLS
+
+// One row of a ParquetTable. Holds only its index; cells come from the table.
+#define PARQUET_TYPE_ROW (parquet_row_get_type())
+G_DECLARE_FINAL_TYPE(ParquetRow, parquet_row, PARQUET, ROW, GObject)
+
+guint64 parquet_row_get_index(ParquetRow *row);
+
+// GListModel of ParquetRow over a Parquet object in a bucket. Opening reads
+// the footer with one or two Range GETs. Cells are fetched on demand: asking
+// for a cell that is not loaded starts a Range GET of the page holding it
+// (found through the offset index when the file has one, otherwise the whole
+// column chunk) and emits items-changed for its rows once it is decoded. A
+// few dozen decoded pages are kept. Main thread only.
+#define PARQUET_TYPE_TABLE (parquet_table_get_type())
+G_DECLARE_FINAL_TYPE(ParquetTable, parquet_table, PARQUET, TABLE, GObject)
+
+void parquet_table_open_async(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, guint64 size, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+ParquetTable *parquet_table_open_finish(GAsyncResult *result, GError **error);
+
+const ParquetFile *parquet_table_get_file(ParquetTable *table);
+
+typedef enum {
+    PARQUET_CELL_READY,     // The value, or NULL for a null
+    PARQUET_CELL_PENDING,   // Being fetched; items-changed follows
+    PARQUET_CELL_FAILED,    // The error message
+} ParquetCellState;
+
+const gchar *parquet_table_get_cell(ParquetTable *table, guint64 row, guint column, ParquetCellState *state);
+
+// Bytes and requests spent so far, the footer included.
+guint64 parquet_table_get_bytes_fetched(ParquetTable *table);
+guint parquet_table_get_n_requests(ParquetTable *table);
+
+// Stops starting fetches; those in flight are dropped when they finish.
+void parquet_table_cancel(ParquetTable *table);
+
+G_END_DECLS
+
+#endif // MYS3_PARQUET_TABLE_H
@@ -1,64 +1,355 @@
 #include "s3_client.h"
 #include "s3_client_cpp.h"
+#include "trace.h"
 #include <glib.h>
 
-void s3_client_init() {
+// Aws::InitAPI() takes a few hundred milliseconds (it loads the TLS stack
+// and probes the environment), so the GUI runs it on a thread while the
+// window comes up. Every call below waits for it first.
+enum { SDK_NOT_STARTED, SDK_STARTING, SDK_READY };
+
+static GMutex sdk_mutex;
+static GCond sdk_ready_cond;
+static gint sdk_state = SDK_NOT_STARTED;
+
+static void sdk_init_now(void) {
+    gint64 span = trace_begin();
     s3_client_cpp_init();
+    trace_end(span, "s3", "sdk_init");
+    g_mutex_lock(&sdk_mutex);
+    g_atomic_int_set(&sdk_state, SDK_READY);
+    g_cond_broadcast(&sdk_ready_cond);
+    g_mutex_unlock(&sdk_mutex);
 }
 
-void s3_client_cleanup() {
-    s3_client_cpp_cleanup();
+static gpointer sdk_init_thread(gpointer user_data) {
+    (void)user_data;
+    sdk_init_now();
+    return NULL;
+}
+
+void s3_client_init(void) {
+    trace_init();
+    s3_client_ensure_ready();
+}
+
+void s3_client_init_async(void) {
+    trace_init();
+    g_mutex_lock(&sdk_mutex);
+    gboolean start = sdk_state == SDK_NOT_STARTED;
+    if (start) g_atomic_int_set(&sdk_state, SDK_STARTING);
+    g_mutex_unlock(&sdk_mutex);
+    if (start) g_thread_unref(g_thread_new("s3-sdk-init", sdk_init_thread, NULL));
+}
+
+void s3_client_ensure_ready(void) {
+    if (g_atomic_int_get(&sdk_state) == SDK_READY) return;
+    g_mutex_lock(&sdk_mutex);
+    if (sdk_state == SDK_NOT_STARTED) {
+        g_atomic_int_set(&sdk_state, SDK_STARTING);
+        g_mutex_unlock(&sdk_mutex);
+        sdk_init_now();
+        return;
+    }
+    while (sdk_state != SDK_READY) g_cond_wait(&sdk_ready_cond, &sdk_mutex);
+    g_mutex_unlock(&sdk_mutex);
+}
+
+void s3_client_cleanup(void) {
+    g_mutex_lock(&sdk_mutex);
+    while (sdk_state == SDK_STARTING) g_cond_wait(&sdk_ready_cond, &sdk_mutex);
+    gboolean ready = sdk_state == SDK_READY;
+    g_mutex_unlock(&sdk_mutex);
+    if (ready) s3_client_cpp_cleanup();
+    trace_stop();
+}
+
+gboolean
+s3_client_set_transfer_backend(S3TransferBackend backend, guint64 threshold_bytes, gdouble target_gbps) {
+    return s3_client_cpp_set_transfer_backend(backend, threshold_bytes, target_gbps);
 }
 
 S3ConnectionStatus
 s3_client_test_connection(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, gboolean use_ssl) {
-    return s3_client_cpp_test_connection(endpoint, access_key, secret_key, bucket, use_ssl);
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    S3ConnectionStatus status = s3_client_cpp_test_connection(endpoint, access_key, secret_key, bucket, use_ssl);
+    trace_end_detail(span, "s3", "test_connection", bucket);
+    return status;
 }
 
 GList*
 s3_client_list_buckets(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, gboolean use_ssl, GError **error) {
-    return s3_client_cpp_list_buckets(endpoint, access_key, secret_key, use_ssl, error);
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    GList *buckets = s3_client_cpp_list_buckets(endpoint, access_key, secret_key, use_ssl, error);
+    trace_end_detail(span, "s3", "list_buckets", endpoint);
+    return buckets;
 }
 
 GList*
 s3_client_list_objects(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *prefix, gboolean use_ssl, GError **error) {
-    return s3_client_cpp_list_objects(endpoint, access_key, secret_key, bucket, prefix, use_ssl, error);
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    GList *objects = s3_client_cpp_list_objects(endpoint, access_key, secret_key, bucket, prefix, use_ssl, error);
+    trace_end_detail(span, "s3", "list_objects", bucket);
+    return objects;
+}
+
+gboolean
+s3_client_list_objects_paged(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *prefix, gboolean use_ssl, S3ListPageCallback page_callback, gpointer user_data, GError **error) {
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gboolean ok = s3_client_cpp_list_objects_paged(endpoint, access_key, secret_key, bucket, prefix, use_ssl, page_callback, user_data, error);
+    trace_end_detail(span, "s3", "list_objects_paged", bucket);
+    return ok;
+}
+
+gboolean
+s3_client_list_objects_delimited(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *prefix, gboolean use_ssl, S3ListPageCallback page_callback, S3ListPrefixesCallback prefixes_callback, gpointer user_data, GError **error) {
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gboolean ok = s3_client_cpp_list_objects_delimited(endpoint, access_key, secret_key, bucket, prefix, use_ssl, page_callback, prefixes_callback, user_data, error);
+    trace_end_detail(span, "s3", "list_objects_delimited", prefix);
+    return ok;
+}
+
+// Size of each block of the key arena; one allocation holds the keys of a
+// few thousand objects.
+#define LISTING_KEY_CHUNK_SIZE (64 * 1024)
+
+static gboolean append_page_to_listing(const S3Object *objects, guint n_objects, gpointer user_data) {
+    S3ObjectListing *listing = (S3ObjectListing *)user_data;
+    for (guint i = 0; i < n_objects; i++) {
+        S3Object view = objects[i];
+        view.key = g_string_chunk_insert_len(listing->keys, objects[i].key, -1);
+        // Identical content (empty objects, folder markers, copies) shares an
+        // ETag, so ETags are interned rather than copied per row.
+        view.etag = objects[i].etag ? g_string_chunk_insert_const(listing->keys, objects[i].etag) : NULL;
+        g_array_append_val(listing->storage, view);
+    }
+    return TRUE;
+}
+
+S3ObjectListing*
+s3_client_list_objects_listing(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *prefix, gboolean use_ssl, GError **error) {
+    S3ObjectListing *listing = g_new0(S3ObjectListing, 1);
+    listing->ref_count = 1;
+    listing->storage = g_array_new(FALSE, FALSE, sizeof(S3Object));
+    listing->keys = g_string_chunk_new(LISTING_KEY_CHUNK_SIZE);
+    if (!s3_client_list_objects_paged(endpoint, access_key, secret_key, bucket, prefix, use_ssl, append_page_to_listing, listing, error)) {
+        s3_object_listing_unref(listing);
+        return NULL;
+    }
+    listing->objects = (S3Object *)listing->storage->data;
+    listing->n_objects = listing->storage->len;
+    return listing;
+}
+
+S3ObjectListing *s3_object_listing_ref(S3ObjectListing *listing) {
+    g_atomic_int_inc(&listing->ref_count);
+    return listing;
+}
+
+void s3_object_listing_unref(S3ObjectListing *listing) {
+    if (!listing || !g_atomic_int_dec_and_test(&listing->ref_count)) return;
+    g_array_unref(listing->storage);
+    g_string_chunk_free(listing->keys);
+    g_free(listing);
 }
 
 gboolean
 s3_client_create_folder(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *folder_path, gboolean use_ssl, GError **error) {
-    return s3_client_cpp_create_folder(endpoint, access_key, secret_key, bucket, folder_path, use_ssl, error);
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gboolean ok = s3_client_cpp_create_folder(endpoint, access_key, secret_key, bucket, folder_path, use_ssl, error);
+    trace_end_detail(span, "s3", "create_folder", folder_path);
+    return ok;
 }
 
 gboolean
 s3_client_upload_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *local_file_path, gboolean use_ssl, GError **error) {
-    return s3_client_cpp_upload_object(endpoint, access_key, secret_key, bucket, key, local_file_path, use_ssl, error);
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gboolean ok = s3_client_cpp_upload_object(endpoint, access_key, secret_key, bucket, key, local_file_path, use_ssl, error);
+    trace_end_detail(span, "s3", "upload_object", key);
+    return ok;
 }
 
 gchar*
 s3_client_download_object_to_buffer(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, gsize *length, GError **error) {
-    return s3_client_cpp_download_object_to_buffer(endpoint, access_key, secret_key, bucket, key, use_ssl, length, error);
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gchar *buffer = s3_client_cpp_download_object_to_buffer(endpoint, access_key, secret_key, bucket, key, use_ssl, length, error);
+    trace_end_detail(span, "s3", "download_object_to_buffer", key);
+    return buffer;
+}
+
+gboolean
+s3_client_download_object_streaming(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, S3DownloadChunkCallback chunk_callback, gpointer user_data, GError **error) {
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gboolean ok = s3_client_cpp_download_object_streaming(endpoint, access_key, secret_key, bucket, key, use_ssl, chunk_callback, user_data, error);
+    trace_end_detail(span, "s3", "download_object_streaming", key);
+    return ok;
+}
+
+GBytes*
+s3_client_download_range(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, guint64 offset, guint64 length, gboolean use_ssl, guint64 *object_size, GError **error) {
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    GBytes *bytes = s3_client_cpp_download_range(endpoint, access_key, secret_key, bucket, key, offset, length, use_ssl, object_size, error);
+    trace_end_detail(span, "s3", "download_range", key);
+    return bytes;
 }
 
 gboolean
-s3_client_download_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *local_file_path, gboolean use_ssl, S3DownloadProgressCallback progress_callback, gpointer progress_user_data, GError **error) {
-    return s3_client_cpp_download_object(endpoint, access_key, secret_key, bucket, key, local_file_path, use_ssl, progress_callback, progress_user_data, error);
+s3_client_download_range_into(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, guint64 offset, gsize length, guint8 *buffer, gboolean use_ssl, gsize *received, GError **error) {
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gboolean ok = s3_client_cpp_download_range_into(endpoint, access_key, secret_key, bucket, key, offset, length, buffer, use_ssl, received, error);
+    trace_end_detail(span, "s3", "download_range_into", key);
+    return ok;
+}
+
+gboolean
+s3_client_head_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, guint64 *size, gint64 *last_modified, GError **error) {
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gboolean ok = s3_client_cpp_head_object(endpoint, access_key, secret_key, bucket, key, use_ssl, size, last_modified, error);
+    trace_end_detail(span, "s3", "head_object", key);
+    return ok;
+}
+
+S3ObjectMetadata *
+s3_client_head_object_metadata(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, GError **error) {
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    S3ObjectMetadata *metadata = s3_client_cpp_head_object_metadata(endpoint, access_key, secret_key, bucket, key, use_ssl, error);
+    trace_end_detail(span, "s3", "head_object_metadata", key);
+    return metadata;
+}
+
+gboolean
+s3_client_select_object_content(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *expression, S3SelectInputFormat input_format, gboolean csv_header, gboolean gzip, gboolean use_ssl, S3SelectRecordsCallback records_callback, S3SelectStatsCallback stats_callback, gpointer user_data, S3SelectStats *stats, GError **error) {
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gboolean ok = s3_client_cpp_select_object_content(endpoint, access_key, secret_key, bucket, key, expression, input_format, csv_header, gzip, use_ssl, records_callback, stats_callback, user_data, stats, error);
+    trace_end_detail(span, "s3", "select_object_content", key);
+    return ok;
+}
+
+gboolean
+s3_client_download_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *local_file_path, gboolean use_ssl, guint64 known_size, S3DownloadProgressCallback progress_callback, gpointer progress_user_data, GError **error) {
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gboolean ok = s3_client_cpp_download_object(endpoint, access_key, secret_key, bucket, key, local_file_path, use_ssl, known_size, progress_callback, progress_user_data, error);
+    trace_end_detail(span, "s3", "download_object", key);
+    return ok;
+}
+
+gboolean
+s3_client_copy_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *src_bucket, const gchar *src_key, const gchar *dst_bucket, const gchar *dst_key, gboolean use_ssl, GError **error) {
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gboolean ok = s3_client_cpp_copy_object(endpoint, access_key, secret_key, src_bucket, src_key, dst_bucket, dst_key, use_ssl, error);
+    trace_end_detail(span, "s3", "copy_object", src_key);
+    return ok;
+}
+
+gchar*
+s3_client_create_multipart_upload(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, GError **error) {
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gchar *upload_id = s3_client_cpp_create_multipart_upload(endpoint, access_key, secret_key, bucket, key, use_ssl, error);
+    trace_end_detail(span, "s3", "create_multipart_upload", key);
+    return upload_id;
+}
+
+gchar*
+s3_client_upload_part(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *upload_id, guint part_number, const guint8 *data, gsize length, gboolean use_ssl, GError **error) {
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gchar *etag = s3_client_cpp_upload_part(endpoint, access_key, secret_key, bucket, key, upload_id, part_number, data, length, use_ssl, error);
+    trace_end_detail(span, "s3", "upload_part", key);
+    return etag;
+}
+
+gboolean
+s3_client_complete_multipart_upload(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *upload_id, const gchar * const *etags, guint n_parts, gboolean use_ssl, GError **error) {
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gboolean ok = s3_client_cpp_complete_multipart_upload(endpoint, access_key, secret_key, bucket, key, upload_id, etags, n_parts, use_ssl, error);
+    trace_end_detail(span, "s3", "complete_multipart_upload", key);
+    return ok;
+}
+
+gboolean
+s3_client_abort_multipart_upload(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *upload_id, gboolean use_ssl, GError **error) {
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gboolean ok = s3_client_cpp_abort_multipart_upload(endpoint, access_key, secret_key, bucket, key, upload_id, use_ssl, error);
+    trace_end_detail(span, "s3", "abort_multipart_upload", key);
+    return ok;
 }
 
 gboolean
 s3_client_rename_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *old_key, const gchar *new_key, gboolean use_ssl, GError **error) {
-    return s3_client_cpp_rename_object(endpoint, access_key, secret_key, bucket, old_key, new_key, use_ssl, error);
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gboolean ok = s3_client_cpp_rename_object(endpoint, access_key, secret_key, bucket, old_key, new_key, use_ssl, error);
+    trace_end_detail(span, "s3", "rename_object", old_key);
+    return ok;
 }
 
 gboolean
 s3_client_delete_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, GError **error) {
-    return s3_client_cpp_delete_object(endpoint, access_key, secret_key, bucket, key, use_ssl, error);
+    s3_client_ensure_ready();
+    gint64 span = trace_begin();
+    gboolean ok = s3_client_cpp_delete_object(endpoint, access_key, secret_key, bucket, key, use_ssl, error);
+    trace_end_detail(span, "s3", "delete_object", key);
+    return ok;
+}
+
+void s3_object_free(S3Object *object) {
+    if (object) {
+        g_free(object->key);
+        g_free(object->etag);
+        g_free(object);
+    }
+}
+
+S3ObjectMetadata *s3_object_metadata_copy(const S3ObjectMetadata *metadata) {
+    if (!metadata) return NULL;
+    S3ObjectMetadata *copy = g_new0(S3ObjectMetadata, 1);
+    copy->content_type = g_strdup(metadata->content_type);
+    copy->storage_class = g_strdup(metadata->storage_class);
+    copy->etag = g_strdup(metadata->etag);
+    copy->user_metadata = g_strdupv(metadata->user_metadata);
+    return copy;
+}
+
+void s3_object_metadata_free(S3ObjectMetadata *metadata) {
+    if (metadata) {
+        g_free(metadata->content_type);
+        g_free(metadata->storage_class);
+        g_free(metadata->etag);
+        g_strfreev(metadata->user_metadata);
+        g_free(metadata);
+    }
+}
+
+void s3_bucket_free(S3Bucket *bucket) {
+    if (bucket) {
+        g_free(bucket->name);
+        g_free(bucket);
+    }
 }
 
 void s3_client_free_object_list(GList *object_list) {
-    g_list_free_full(object_list, (GDestroyNotify)g_free);
+    g_list_free_full(object_list, (GDestroyNotify)s3_object_free);
 }
 
 void s3_client_free_bucket_list(GList *bucket_list) {
-    g_list_free_full(bucket_list, (GDestroyNotify)g_free);
+    g_list_free_full(bucket_list, (GDestroyNotify)s3_bucket_free);
 }
@@ -3,11 +3,14 @@
 
 #include <glib.h>
 
+G_BEGIN_DECLS
+
 // Represents a single S3 object (a file)
 typedef struct {
     gchar *key;
     guint64 size;
     gint64 last_modified;
+    gchar *etag;        // As listed, quotes included; NULL when unknown
 } S3Object;
 
 // Represents a single bucket
@@ -24,6 +27,30 @@ typedef enum {
   S3_ERROR_UNKNOWN
 } S3ConnectionStatus;
 
+// Engine used for object uploads and downloads. Metadata calls (listing,
+// copy, delete, ...) always use the classic client.
+typedef enum {
+  S3_TRANSFER_BACKEND_CLASSIC,
+  S3_TRANSFER_BACKEND_CRT
+} S3TransferBackend;
+
+// Initializes the SDK on the calling thread.
+void s3_client_init(void);
+// Starts initializing the SDK on a background thread and returns at once.
+// Calls made before it is done wait for it.
+void s3_client_init_async(void);
+// Blocks until the SDK is initialized, initializing it here if nobody
+// started to. Every s3_client_* call does this itself.
+void s3_client_ensure_ready(void);
+void s3_client_cleanup(void);
+
+// Selects the transfer backend. Transfers of at least threshold_bytes use the
+// CRT client, which splits them into parallel ranged requests sized to reach
+// target_gbps. Returns FALSE if the backend is not compiled in.
+gboolean s3_client_set_transfer_backend(S3TransferBackend backend,
+                                        guint64 threshold_bytes,
+                                        gdouble target_gbps);
+
 S3ConnectionStatus s3_client_test_connection(const gchar *endpoint,
                                              const gchar *access_key,
                                              const gchar *secret_key,
@@ -44,6 +71,70 @@ GList* s3_client_list_objects(const gchar *endpoint,
                                gboolean use_ssl,
                                GError **error);
 
+// Called once per ListObjectsV2 page. The objects (and their keys) are only
+// valid during the call. Return FALSE to stop listing.
+typedef gboolean (*S3ListPageCallback)(const S3Object *objects,
+                                       guint n_objects,
+                                       gpointer user_data);
+
+// Lists like s3_client_list_objects() but hands each page to page_callback
+// instead of building a GList, so callers can copy rows straight into their
+// own storage.
+gboolean s3_client_list_objects_paged(const gchar *endpoint,
+                                      const gchar *access_key,
+                                      const gchar *secret_key,
+                                      const gchar *bucket,
+                                      const gchar *prefix,
+                                      gboolean use_ssl,
+                                      S3ListPageCallback page_callback,
+                                      gpointer user_data,
+                                      GError **error);
+
+// Called with the common prefixes of a delimited listing page, each ending
+// in the delimiter. Only valid during the call. Return FALSE to stop listing.
+typedef gboolean (*S3ListPrefixesCallback)(const gchar * const *prefixes,
+                                           guint n_prefixes,
+                                           gpointer user_data);
+
+// Lists one level below `prefix` with "/" as the delimiter: the objects
+// directly under it go to page_callback and the "subfolders" to
+// prefixes_callback, page by page.
+gboolean s3_client_list_objects_delimited(const gchar *endpoint,
+                                          const gchar *access_key,
+                                          const gchar *secret_key,
+                                          const gchar *bucket,
+                                          const gchar *prefix,
+                                          gboolean use_ssl,
+                                          S3ListPageCallback page_callback,
+                                          S3ListPrefixesCallback prefixes_callback,
+                                          gpointer user_data,
+                                          GError **error);
+
+// Result of a listing held in one block: the S3Objects are views whose keys
+// and ETags point into a string arena shared by the whole listing, so listing
+// costs no allocation per object. Repeated ETags are stored once. Keys stay
+// whole so obj->key is a plain string; the file list front-codes them
+// separately (S3KeyArena). Do not free individual objects or keys;
+// release everything at once with s3_object_listing_unref().
+typedef struct {
+    S3Object *objects;
+    guint n_objects;
+    /*< private >*/
+    gint ref_count;
+    GArray *storage;
+    GStringChunk *keys;
+} S3ObjectListing;
+
+S3ObjectListing *s3_client_list_objects_listing(const gchar *endpoint,
+                                                const gchar *access_key,
+                                                const gchar *secret_key,
+                                                const gchar *bucket,
+                                                const gchar *prefix,
+                                                gboolean use_ssl,
+                                                GError **error);
+S3ObjectListing *s3_object_listing_ref(S3ObjectListing *listing);
+void s3_object_listing_unref(S3ObjectListing *listing);
+
 gboolean s3_client_create_folder(const gchar *endpoint,
                                  const gchar *access_key,
                                  const gchar *secret_key,
@@ -70,10 +161,133 @@ gchar* s3_client_download_object_to_buffer(const gchar *endpoint,
                                            gsize *length,
                                            GError **error);
 
+// Called with successive pieces of an object body, on the downloading thread.
+// total_bytes is the object size, or 0 if the server did not say. Return
+// FALSE to abort the download.
+typedef gboolean (*S3DownloadChunkCallback)(const gchar *data,
+                                            gsize length,
+                                            guint64 total_bytes,
+                                            gpointer user_data);
+
+// Downloads an object without holding it in memory, handing the body to
+// chunk_callback as it arrives.
+gboolean s3_client_download_object_streaming(const gchar *endpoint,
+                                             const gchar *access_key,
+                                             const gchar *secret_key,
+                                             const gchar *bucket,
+                                             const gchar *key,
+                                             gboolean use_ssl,
+                                             S3DownloadChunkCallback chunk_callback,
+                                             gpointer user_data,
+                                             GError **error);
+
+// Fetches bytes [offset, offset + length) of an object with a Range GET.
+// The result may be shorter near the end of the object. object_size, if not
+// NULL, receives the full size reported in Content-Range.
+GBytes* s3_client_download_range(const gchar *endpoint,
+                                 const gchar *access_key,
+                                 const gchar *secret_key,
+                                 const gchar *bucket,
+                                 const gchar *key,
+                                 guint64 offset,
+                                 guint64 length,
+                                 gboolean use_ssl,
+                                 guint64 *object_size,
+                                 GError **error);
+
+// Like s3_client_download_range() but writes the bytes into `buffer`, which
+// holds at least `length` bytes, so callers can recycle their buffers.
+gboolean s3_client_download_range_into(const gchar *endpoint,
+                                       const gchar *access_key,
+                                       const gchar *secret_key,
+                                       const gchar *bucket,
+                                       const gchar *key,
+                                       guint64 offset,
+                                       gsize length,
+                                       guint8 *buffer,
+                                       gboolean use_ssl,
+                                       gsize *received,
+                                       GError **error);
+
+// Reads an object's size and modification time (ms since the epoch) without
+// fetching it. Either output may be NULL.
+gboolean s3_client_head_object(const gchar *endpoint,
+                               const gchar *access_key,
+                               const gchar *secret_key,
+                               const gchar *bucket,
+                               const gchar *key,
+                               gboolean use_ssl,
+                               guint64 *size,
+                               gint64 *last_modified,
+                               GError **error);
+
+// Headers of an object that a listing does not return.
+typedef struct {
+    gchar *content_type;
+    gchar *storage_class;
+    gchar *etag;
+    gchar **user_metadata;      // x-amz-meta-* names and values, alternating, NULL-terminated
+} S3ObjectMetadata;
+
+S3ObjectMetadata *s3_object_metadata_copy(const S3ObjectMetadata *metadata);
+void s3_object_metadata_free(S3ObjectMetadata *metadata);
+
+// Reads an object's extended metadata with a HEAD request. Returns NULL and
+// sets `error` on failure.
+S3ObjectMetadata *s3_client_head_object_metadata(const gchar *endpoint,
+                                                 const gchar *access_key,
+                                                 const gchar *secret_key,
+                                                 const gchar *bucket,
+                                                 const gchar *key,
+                                                 gboolean use_ssl,
+                                                 GError **error);
+
+typedef enum {
+    S3_SELECT_INPUT_CSV,
+    S3_SELECT_INPUT_JSON_LINES,
+    S3_SELECT_INPUT_PARQUET
+} S3SelectInputFormat;
+
+// Running totals from the Progress and Stats events of an S3 Select request.
+typedef struct {
+    guint64 bytes_scanned;
+    guint64 bytes_processed;
+    guint64 bytes_returned;
+} S3SelectStats;
+
+// Called with each Records event payload: CSV rows, which may be split
+// anywhere between two events. Return FALSE to stop the query.
+typedef gboolean (*S3SelectRecordsCallback)(const gchar *data,
+                                            gsize length,
+                                            gpointer user_data);
+typedef void (*S3SelectStatsCallback)(const S3SelectStats *stats,
+                                      gpointer user_data);
+
+// Runs an S3 Select (SelectObjectContent) SQL expression against one object
+// and streams the matching records back as CSV while the server scans. gzip
+// applies to CSV and JSON input. Callbacks run on the calling thread.
+gboolean s3_client_select_object_content(const gchar *endpoint,
+                                         const gchar *access_key,
+                                         const gchar *secret_key,
+                                         const gchar *bucket,
+                                         const gchar *key,
+                                         const gchar *expression,
+                                         S3SelectInputFormat input_format,
+                                         gboolean csv_header,
+                                         gboolean gzip,
+                                         gboolean use_ssl,
+                                         S3SelectRecordsCallback records_callback,
+                                         S3SelectStatsCallback stats_callback,
+                                         gpointer user_data,
+                                         S3SelectStats *stats,
+                                         GError **error);
+
 typedef gboolean (*S3DownloadProgressCallback)(guint64 downloaded_bytes,
                                              guint64 total_bytes,
                                              gpointer user_data);
 
+// known_size is the object size when the caller already has it from a
+// listing, or 0 to have the CRT backend look it up before choosing a client.
 gboolean s3_client_download_object(const gchar *endpoint,
                                    const gchar *access_key,
                                    const gchar *secret_key,
@@ -81,15 +295,30 @@ gboolean s3_client_download_object(const gchar *endpoint,
                                    const gchar *key,
                                    const gchar *local_file_path,
                                    gboolean use_ssl,
+                                   guint64 known_size,
                                    S3DownloadProgressCallback progress_callback,
                                    gpointer progress_user_data,
                                    GError **error);
 
+gboolean s3_client_copy_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *src_bucket, const gchar *src_key, const gchar *dst_bucket, const gchar *dst_key, gboolean use_ssl, GError **error);
+// Multipart upload. Parts are numbered from 1, at least 5 MiB each except the
+// last, at most 10000. upload_part returns the part's ETag;
+// complete_multipart_upload takes them in part order.
+gchar* s3_client_create_multipart_upload(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, GError **error);
+gchar* s3_client_upload_part(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *upload_id, guint part_number, const guint8 *data, gsize length, gboolean use_ssl, GError **error);
+gboolean s3_client_complete_multipart_upload(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *upload_id, const gchar * const *etags, guint n_parts, gboolean use_ssl, GError **error);
+gboolean s3_client_abort_multipart_upload(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *upload_id, gboolean use_ssl, GError **error);
 gboolean s3_client_rename_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *old_key, const gchar *new_key, gboolean use_ssl, GError **error);
 gboolean s3_client_delete_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, GError **error);
 
+void s3_object_free(S3Object *object);
+void s3_bucket_free(S3Bucket *bucket);
 void s3_client_free_object_list(GList *object_list);
 void s3_client_free_bucket_list(GList *bucket_list);
 
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(S3ObjectListing, s3_object_listing_unref)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(S3ObjectMetadata, s3_object_metadata_free)
+
+G_END_DECLS
 
 #endif // MYS3_S3_CLIENT_H
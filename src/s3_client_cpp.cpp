@@ -5,33 +5,181 @@
 #include <aws/s3/model/Bucket.h>
 #include <aws/s3/model/ListObjectsV2Request.h>
 #include <aws/s3/model/Object.h>
+#include <aws/s3/model/CommonPrefix.h>
 #include <aws/s3/model/CreateBucketRequest.h>
 #include <aws/s3/model/PutObjectRequest.h>
 #include <aws/s3/model/GetObjectRequest.h>
+#include <aws/s3/model/HeadObjectRequest.h>
+#include <aws/s3/model/StorageClass.h>
 #include <aws/s3/model/DeleteObjectRequest.h>
 #include <aws/s3/model/CopyObjectRequest.h>
+#include <aws/s3/model/SelectObjectContentRequest.h>
+#include <aws/s3/model/CreateMultipartUploadRequest.h>
+#include <aws/s3/model/UploadPartRequest.h>
+#include <aws/s3/model/CompleteMultipartUploadRequest.h>
+#include <aws/s3/model/AbortMultipartUploadRequest.h>
+#include <aws/s3/model/CompletedMultipartUpload.h>
+#include <aws/s3/model/CompletedPart.h>
 #include <aws/core/auth/AWSCredentials.h>
 #include <aws/core/auth/AWSCredentialsProvider.h>
 #include <aws/core/client/ClientConfiguration.h>
 #include <aws/core/utils/memory/stl/AWSString.h>
+#include <aws/core/http/HttpResponse.h>
+#include <aws/core/utils/stream/PreallocatedStreamBuf.h>
+#include <aws/core/monitoring/MonitoringInterface.h>
+#include <aws/core/monitoring/MonitoringFactory.h>
+#include <aws/core/monitoring/HttpClientMetrics.h>
+#ifdef MYS3_HAVE_S3_CRT
+#include <aws/s3-crt/S3CrtClient.h>
+#include <aws/s3-crt/ClientConfiguration.h>
+#include <aws/s3-crt/model/PutObjectRequest.h>
+#include <aws/s3-crt/model/GetObjectRequest.h>
+#endif
+#include <glib/gstdio.h>
+#include <atomic>
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <streambuf>
+#include <vector>
+
+#include "s3_metrics.h"
+#include "trace.h"
 
 static Aws::SDKOptions options;
 
-void s3_client_cpp_init() {
-    Aws::InitAPI(options);
-}
+namespace {
+    // Transfer backend selection, see s3_client_cpp_set_transfer_backend().
+    std::mutex backend_mutex;
+    S3TransferBackend transfer_backend = S3_TRANSFER_BACKEND_CLASSIC;
+    guint64 crt_threshold_bytes = 16 * 1024 * 1024;
+    gdouble crt_target_gbps = 5.0;
 
-void s3_client_cpp_cleanup() {
-    Aws::ShutdownAPI(options);
-}
+    // Clients are expensive to build (and the CRT one owns an event loop), so
+    // they are kept per connection and reused across calls.
+    std::mutex clients_mutex;
+    std::map<Aws::String, std::shared_ptr<Aws::S3::S3Client>> classic_clients;
+#ifdef MYS3_HAVE_S3_CRT
+    std::map<Aws::String, std::shared_ptr<Aws::S3Crt::S3CrtClient>> crt_clients;
+#endif
 
-#include <aws/core/auth/AWSCredentialsProvider.h>
+    // Records one S3 operation into the metrics histograms when it goes out
+    // of scope, so every return path of a wrapper function is measured.
+    class OperationTimer {
+    public:
+        explicit OperationTimer(S3Operation op) : op_(op), start_(g_get_monotonic_time()) {}
+        ~OperationTimer() {
+            s3_metrics_record(op_, g_get_monotonic_time() - start_, bytes_in, bytes_out, ok);
+        }
+        OperationTimer(const OperationTimer &) = delete;
+        OperationTimer &operator=(const OperationTimer &) = delete;
+
+        guint64 bytes_in = 0;
+        guint64 bytes_out = 0;
+        gboolean ok = FALSE;
+
+    private:
+        S3Operation op_;
+        gint64 start_;
+    };
+
+    // Per HTTP request hooks from the SDK, used for the numbers the wrapper
+    // functions cannot see themselves: retries, connection reuse and, when
+    // tracing, the time spent in each HTTP phase.
+    class MetricsMonitor : public Aws::Monitoring::MonitoringInterface {
+    public:
+        // The context is the start time of the current attempt, only
+        // allocated while tracing.
+        void *OnRequestStarted(const Aws::String &, const Aws::String &, const std::shared_ptr<const Aws::Http::HttpRequest> &) const override {
+            gint64 start = trace_begin();
+            return start ? new gint64(start) : nullptr;
+        }
+
+        void OnRequestSucceeded(const Aws::String &, const Aws::String &request_name, const std::shared_ptr<const Aws::Http::HttpRequest> &,
+                                const Aws::Client::HttpResponseOutcome &, const Aws::Monitoring::CoreMetricsCollection &metrics, void *context) const override {
+            record_connection(metrics);
+            trace_request(request_name, metrics, context);
+        }
+
+        void OnRequestFailed(const Aws::String &, const Aws::String &request_name, const std::shared_ptr<const Aws::Http::HttpRequest> &,
+                             const Aws::Client::HttpResponseOutcome &, const Aws::Monitoring::CoreMetricsCollection &metrics, void *context) const override {
+            record_connection(metrics);
+            trace_request(request_name, metrics, context);
+        }
+
+        void OnRequestRetry(const Aws::String &, const Aws::String &, const std::shared_ptr<const Aws::Http::HttpRequest> &, void *context) const override {
+            s3_metrics_record_retry();
+            if (context) {
+                *static_cast<gint64 *>(context) = g_get_monotonic_time();
+            }
+        }
+
+        void OnFinish(const Aws::String &, const Aws::String &, const std::shared_ptr<const Aws::Http::HttpRequest> &, void *context) const override {
+            delete static_cast<gint64 *>(context);
+        }
+
+    private:
+        // The SDK reports phase latencies in milliseconds after the fact; they
+        // are laid out back to back from the start of the attempt.
+        static void trace_request(const Aws::String &request_name, const Aws::Monitoring::CoreMetricsCollection &metrics, void *context) {
+            if (!context) return;
+            gint64 start = *static_cast<gint64 *>(context);
+            trace_end(start, "http", g_intern_string(request_name.c_str()));
+
+            static const struct { Aws::Monitoring::HttpClientMetricsType type; const gchar *name; } phases[] = {
+                { Aws::Monitoring::HttpClientMetricsType::AcquireConnectionLatency, "acquire_connection" },
+                { Aws::Monitoring::HttpClientMetricsType::DnsLatency, "dns" },
+                { Aws::Monitoring::HttpClientMetricsType::ConnectLatency, "connect" },
+                { Aws::Monitoring::HttpClientMetricsType::SslLatency, "tls" },
+            };
+            gint64 offset = start;
+            for (const auto &phase : phases) {
+                auto it = metrics.httpClientMetrics.find(Aws::Monitoring::GetHttpClientMetricNameByType(phase.type));
+                if (it == metrics.httpClientMetrics.end() || it->second <= 0) continue;
+                gint64 duration = it->second * 1000;
+                trace_span("http", phase.name, offset, duration);
+                offset += duration;
+            }
+        }
+
+        static void record_connection(const Aws::Monitoring::CoreMetricsCollection &metrics) {
+            const auto &http = metrics.httpClientMetrics;
+            auto reused = http.find(Aws::Monitoring::GetHttpClientMetricNameByType(Aws::Monitoring::HttpClientMetricsType::ConnectionReused));
+            if (reused != http.end()) {
+                s3_metrics_record_connection(reused->second != 0);
+                return;
+            }
+            // Not every HTTP client reports reuse; a request that did not
+            // spend any time connecting went over a pooled connection.
+            auto connect = http.find(Aws::Monitoring::GetHttpClientMetricNameByType(Aws::Monitoring::HttpClientMetricsType::ConnectLatency));
+            s3_metrics_record_connection(connect == http.end() || connect->second == 0);
+        }
+    };
+
+    class MetricsMonitorFactory : public Aws::Monitoring::MonitoringFactory {
+    public:
+        Aws::UniquePtr<Aws::Monitoring::MonitoringInterface> CreateMonitoringInstance() const override {
+            return Aws::MakeUnique<MetricsMonitor>("S3Metrics");
+        }
+    };
+
+    Aws::String client_cache_key(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, gboolean use_ssl) {
+        g_autofree gchar *secret_hash = g_compute_checksum_for_string(G_CHECKSUM_SHA256, secret_key ? secret_key : "", -1);
+        return Aws::String(use_ssl ? "https://" : "http://") + (endpoint ? endpoint : "") + "|" + (access_key ? access_key : "") + "|" + secret_hash;
+    }
+
+    std::shared_ptr<Aws::S3::S3Client> create_s3_client(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, gboolean use_ssl) {
+        Aws::String cache_key = client_cache_key(endpoint, access_key, secret_key, use_ssl);
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        auto it = classic_clients.find(cache_key);
+        if (it != classic_clients.end()) {
+            s3_metrics_record_cache(TRUE);
+            return it->second;
+        }
+        s3_metrics_record_cache(FALSE);
 
-namespace {
-    Aws::S3::S3Client create_s3_client(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, gboolean use_ssl) {
         Aws::Client::ClientConfiguration clientConfig;
         if (use_ssl) {
             clientConfig.scheme = Aws::Http::Scheme::HTTPS;
@@ -41,14 +189,112 @@ namespace {
         clientConfig.endpointOverride = endpoint;
 
         auto credentialsProvider = Aws::MakeShared<Aws::Auth::SimpleAWSCredentialsProvider>("S3Client", access_key, secret_key);
-        return Aws::S3::S3Client(credentialsProvider, clientConfig, Aws::Client::AWSAuthV4Signer::PayloadSigningPolicy::Never, false);
+        auto client = Aws::MakeShared<Aws::S3::S3Client>("S3Client", credentialsProvider, clientConfig, Aws::Client::AWSAuthV4Signer::PayloadSigningPolicy::Never, false);
+        classic_clients[cache_key] = client;
+        return client;
+    }
+
+#ifdef MYS3_HAVE_S3_CRT
+    std::shared_ptr<Aws::S3Crt::S3CrtClient> create_s3_crt_client(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, gboolean use_ssl) {
+        Aws::String cache_key = client_cache_key(endpoint, access_key, secret_key, use_ssl);
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        auto it = crt_clients.find(cache_key);
+        if (it != crt_clients.end()) {
+            s3_metrics_record_cache(TRUE);
+            return it->second;
+        }
+        s3_metrics_record_cache(FALSE);
+
+        Aws::S3Crt::ClientConfiguration clientConfig;
+        if (use_ssl) {
+            clientConfig.scheme = Aws::Http::Scheme::HTTPS;
+        } else {
+            clientConfig.scheme = Aws::Http::Scheme::HTTP;
+        }
+        clientConfig.endpointOverride = endpoint;
+        clientConfig.partSize = 8 * 1024 * 1024;
+        {
+            std::lock_guard<std::mutex> backend_lock(backend_mutex);
+            clientConfig.throughputTargetGbps = crt_target_gbps;
+        }
+
+        auto credentialsProvider = Aws::MakeShared<Aws::Auth::SimpleAWSCredentialsProvider>("S3CrtClient", access_key, secret_key);
+        auto client = Aws::MakeShared<Aws::S3Crt::S3CrtClient>("S3CrtClient", credentialsProvider, clientConfig, Aws::Client::AWSAuthV4Signer::PayloadSigningPolicy::Never, false);
+        crt_clients[cache_key] = client;
+        return client;
+    }
+#endif
+
+#ifdef MYS3_HAVE_S3_CRT
+    // Large transfers go through the CRT client when it is selected; everything
+    // else stays on the classic client.
+    gboolean use_crt_for_size(guint64 size) {
+        std::lock_guard<std::mutex> lock(backend_mutex);
+        return transfer_backend == S3_TRANSFER_BACKEND_CRT && size >= crt_threshold_bytes;
+    }
+
+    gboolean crt_backend_selected() {
+        std::lock_guard<std::mutex> lock(backend_mutex);
+        return transfer_backend == S3_TRANSFER_BACKEND_CRT;
+    }
+#endif
+
+    void clear_client_cache() {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        classic_clients.clear();
+#ifdef MYS3_HAVE_S3_CRT
+        crt_clients.clear();
+#endif
     }
 } // namespace
 
+void s3_client_cpp_init() {
+    // options outlives init/cleanup cycles; registering the factory again on
+    // re-init would install a second monitor and count every request twice.
+    static std::once_flag monitoring_registered;
+    std::call_once(monitoring_registered, []() {
+        options.monitoringOptions.customizedMonitoringFactory_create_fn.push_back([]() {
+            return Aws::UniquePtr<Aws::Monitoring::MonitoringFactory>(Aws::New<MetricsMonitorFactory>("S3Metrics"));
+        });
+    });
+    Aws::InitAPI(options);
+}
+
+void s3_client_cpp_cleanup() {
+    clear_client_cache();
+    Aws::ShutdownAPI(options);
+}
+
+gboolean s3_client_cpp_set_transfer_backend(S3TransferBackend backend, guint64 threshold_bytes, gdouble target_gbps) {
+    gboolean changed_target;
+    {
+        std::lock_guard<std::mutex> lock(backend_mutex);
+        changed_target = target_gbps > 0 && target_gbps != crt_target_gbps;
+        transfer_backend = backend;
+        crt_threshold_bytes = threshold_bytes;
+        if (target_gbps > 0) {
+            crt_target_gbps = target_gbps;
+        }
+    }
+#ifdef MYS3_HAVE_S3_CRT
+    if (changed_target) {
+        // The throughput target is fixed at client creation time.
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        crt_clients.clear();
+    }
+    return TRUE;
+#else
+    (void)changed_target;
+    return backend == S3_TRANSFER_BACKEND_CLASSIC;
+#endif
+}
+
 S3ConnectionStatus s3_client_cpp_test_connection(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, gboolean use_ssl) {
     auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
 
-    auto outcome = s3_client.ListBuckets();
+    OperationTimer timer(S3_OP_TEST_CONNECTION);
+    auto outcome = s3_client->ListBuckets();
+    timer.ok = outcome.IsSuccess();
 
     if (outcome.IsSuccess()) {
         return S3_CONNECTION_OK;
@@ -62,7 +308,9 @@ S3ConnectionStatus s3_client_cpp_test_connection(const gchar *endpoint, const gc
 GList* s3_client_cpp_list_buckets(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, gboolean use_ssl, GError **error) {
     auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
 
-    auto outcome = s3_client.ListBuckets();
+    OperationTimer timer(S3_OP_LIST_BUCKETS);
+    auto outcome = s3_client->ListBuckets();
+    timer.ok = outcome.IsSuccess();
 
     if (outcome.IsSuccess()) {
         GList *buckets = NULL;
@@ -80,7 +328,7 @@ GList* s3_client_cpp_list_buckets(const gchar *endpoint, const gchar *access_key
     }
 }
 
-GList* s3_client_cpp_list_objects(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *prefix, gboolean use_ssl, GError **error) {
+gboolean s3_client_cpp_list_objects_paged(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *prefix, gboolean use_ssl, S3ListPageCallback page_callback, gpointer user_data, GError **error) {
     auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
 
     Aws::S3::Model::ListObjectsV2Request request;
@@ -89,23 +337,118 @@ GList* s3_client_cpp_list_objects(const gchar *endpoint, const gchar *access_key
         request.SetPrefix(prefix);
     }
 
-    auto outcome = s3_client.ListObjectsV2(request);
+    std::vector<S3Object> page;
+    // Follow continuation tokens so prefixes with more than one page of keys
+    // are listed completely.
+    while (true) {
+        // Each page is its own request and is measured separately.
+        OperationTimer timer(S3_OP_LIST_OBJECTS);
+        auto outcome = s3_client->ListObjectsV2(request);
+        timer.ok = outcome.IsSuccess();
 
-    if (outcome.IsSuccess()) {
-        GList *objects = NULL;
-        const auto &result_objects = outcome.GetResult().GetContents();
-        for (const auto &object : result_objects) {
+        if (!outcome.IsSuccess()) {
+            g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+            return FALSE;
+        }
+
+        // The page entries borrow their keys from the SDK result.
+        const auto &result = outcome.GetResult();
+        page.clear();
+        page.reserve(result.GetContents().size());
+        for (const auto &object : result.GetContents()) {
+            S3Object o;
+            o.key = const_cast<gchar *>(object.GetKey().c_str());
+            o.size = object.GetSize();
+            o.last_modified = object.GetLastModified().Millis();
+            o.etag = const_cast<gchar *>(object.GetETag().c_str());
+            page.push_back(o);
+        }
+        if (!page.empty() && !page_callback(page.data(), (guint)page.size(), user_data)) {
+            break;
+        }
+
+        if (!result.GetIsTruncated() || result.GetNextContinuationToken().empty()) {
+            break;
+        }
+        request.SetContinuationToken(result.GetNextContinuationToken());
+    }
+    return TRUE;
+}
+
+gboolean s3_client_cpp_list_objects_delimited(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *prefix, gboolean use_ssl, S3ListPageCallback page_callback, S3ListPrefixesCallback prefixes_callback, gpointer user_data, GError **error) {
+    auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
+
+    Aws::S3::Model::ListObjectsV2Request request;
+    request.SetBucket(bucket);
+    request.SetDelimiter("/");
+    if (prefix && *prefix) {
+        request.SetPrefix(prefix);
+    }
+
+    std::vector<S3Object> page;
+    std::vector<const gchar *> prefixes;
+    while (true) {
+        OperationTimer timer(S3_OP_LIST_OBJECTS);
+        auto outcome = s3_client->ListObjectsV2(request);
+        timer.ok = outcome.IsSuccess();
+
+        if (!outcome.IsSuccess()) {
+            g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+            return FALSE;
+        }
+
+        const auto &result = outcome.GetResult();
+        page.clear();
+        page.reserve(result.GetContents().size());
+        for (const auto &object : result.GetContents()) {
+            S3Object o;
+            o.key = const_cast<gchar *>(object.GetKey().c_str());
+            o.size = object.GetSize();
+            o.last_modified = object.GetLastModified().Millis();
+            o.etag = const_cast<gchar *>(object.GetETag().c_str());
+            page.push_back(o);
+        }
+        if (!page.empty() && !page_callback(page.data(), (guint)page.size(), user_data)) {
+            break;
+        }
+        prefixes.clear();
+        for (const auto &common_prefix : result.GetCommonPrefixes()) {
+            prefixes.push_back(common_prefix.GetPrefix().c_str());
+        }
+        if (!prefixes.empty() && !prefixes_callback(prefixes.data(), (guint)prefixes.size(), user_data)) {
+            break;
+        }
+
+        if (!result.GetIsTruncated() || result.GetNextContinuationToken().empty()) {
+            break;
+        }
+        request.SetContinuationToken(result.GetNextContinuationToken());
+    }
+    return TRUE;
+}
+
+namespace {
+    gboolean prepend_page_to_list(const S3Object *objects, guint n_objects, gpointer user_data) {
+        GList **list = static_cast<GList **>(user_data);
+        for (guint i = 0; i < n_objects; i++) {
             S3Object *o = g_new0(S3Object, 1);
-            o->key = g_strdup(object.GetKey().c_str());
-            o->size = object.GetSize();
-            o->last_modified = object.GetLastModified().Millis();
-            objects = g_list_prepend(objects, o);
+            o->key = g_strdup(objects[i].key);
+            o->size = objects[i].size;
+            o->last_modified = objects[i].last_modified;
+            o->etag = g_strdup(objects[i].etag);
+            *list = g_list_prepend(*list, o);
         }
-        return g_list_reverse(objects);
-    } else {
-        g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+        return TRUE;
+    }
+} // namespace
+
+GList* s3_client_cpp_list_objects(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *prefix, gboolean use_ssl, GError **error) {
+    GList *objects = NULL;
+    if (!s3_client_cpp_list_objects_paged(endpoint, access_key, secret_key, bucket, prefix, use_ssl, prepend_page_to_list, &objects, error)) {
+        g_list_free_full(objects, (GDestroyNotify)s3_object_free);
         return NULL;
     }
+    return g_list_reverse(objects);
 }
 
 gboolean s3_client_cpp_create_folder(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *folder_path, gboolean use_ssl, GError **error) {
@@ -115,7 +458,9 @@ gboolean s3_client_cpp_create_folder(const gchar *endpoint, const gchar *access_
     request.SetBucket(bucket);
     request.SetKey(folder_path);
 
-    auto outcome = s3_client.PutObject(request);
+    OperationTimer timer(S3_OP_PUT_OBJECT);
+    auto outcome = s3_client->PutObject(request);
+    timer.ok = outcome.IsSuccess();
 
     if (outcome.IsSuccess()) {
         return TRUE;
@@ -125,7 +470,86 @@ gboolean s3_client_cpp_create_folder(const gchar *endpoint, const gchar *access_
     }
 }
 
+#ifdef MYS3_HAVE_S3_CRT
+namespace {
+    gboolean crt_upload_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *local_file_path, gboolean use_ssl, GError **error) {
+        auto crt_client = create_s3_crt_client(endpoint, access_key, secret_key, use_ssl);
+
+        Aws::S3Crt::Model::PutObjectRequest request;
+        request.SetBucket(bucket);
+        request.SetKey(key);
+
+        std::shared_ptr<Aws::IOStream> input_data =
+            Aws::MakeShared<Aws::FStream>("S3CrtClient",
+                                          local_file_path,
+                                          std::ios_base::in | std::ios_base::binary);
+        if (!input_data->good()) {
+            g_set_error(error, g_quark_from_static_string("S3Client"), 0, "Failed to open file %s", local_file_path);
+            return FALSE;
+        }
+        request.SetBody(input_data);
+
+        auto outcome = crt_client->PutObject(request);
+
+        if (outcome.IsSuccess()) {
+            return TRUE;
+        } else {
+            g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+            return FALSE;
+        }
+    }
+
+    gboolean crt_download_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *local_file_path, gboolean use_ssl, guint64 total_bytes, S3DownloadProgressCallback progress_callback, gpointer progress_user_data, GError **error) {
+        auto crt_client = create_s3_crt_client(endpoint, access_key, secret_key, use_ssl);
+
+        Aws::S3Crt::Model::GetObjectRequest request;
+        request.SetBucket(bucket);
+        request.SetKey(key);
+
+        request.SetResponseStreamFactory([=]() { return Aws::New<Aws::FStream>("S3CrtClient", local_file_path, std::ios_base::out | std::ios_base::binary); });
+
+        if (progress_callback) {
+            // The CRT splits the GET into ranged parts, so progress is summed
+            // here instead of being read from a single Content-Range header.
+            // Parts arrive on several event-loop threads; the lock keeps the
+            // caller's callback single-threaded and its totals increasing.
+            struct Progress {
+                std::mutex lock;
+                guint64 received = 0;
+            };
+            auto state = std::make_shared<Progress>();
+            request.SetDataReceivedEventHandler(std::function<void(const Aws::Http::HttpRequest*, Aws::Http::HttpResponse*, long long)>(
+                [=](const Aws::Http::HttpRequest*, Aws::Http::HttpResponse*, long long progress) {
+                    std::lock_guard<std::mutex> guard(state->lock);
+                    state->received += (guint64)progress;
+                    progress_callback(state->received, total_bytes, progress_user_data);
+                }
+            ));
+        }
+
+        auto outcome = crt_client->GetObject(request);
+
+        if (outcome.IsSuccess()) {
+            return TRUE;
+        } else {
+            g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+            return FALSE;
+        }
+    }
+} // namespace
+#endif
+
 gboolean s3_client_cpp_upload_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *local_file_path, gboolean use_ssl, GError **error) {
+    OperationTimer timer(S3_OP_PUT_OBJECT);
+    GStatBuf st;
+    gboolean have_size = g_stat(local_file_path, &st) == 0;
+#ifdef MYS3_HAVE_S3_CRT
+    if (have_size && use_crt_for_size((guint64)st.st_size)) {
+        timer.ok = crt_upload_object(endpoint, access_key, secret_key, bucket, key, local_file_path, use_ssl, error);
+        timer.bytes_out = timer.ok ? (guint64)st.st_size : 0;
+        return timer.ok;
+    }
+#endif
     auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
 
     Aws::S3::Model::PutObjectRequest request;
@@ -142,9 +566,11 @@ gboolean s3_client_cpp_upload_object(const gchar *endpoint, const gchar *access_
     }
     request.SetBody(input_data);
 
-    auto outcome = s3_client.PutObject(request);
+    auto outcome = s3_client->PutObject(request);
+    timer.ok = outcome.IsSuccess();
 
     if (outcome.IsSuccess()) {
+        timer.bytes_out = have_size ? (guint64)st.st_size : 0;
         return TRUE;
     } else {
         g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
@@ -159,13 +585,16 @@ gchar* s3_client_cpp_download_object_to_buffer(const gchar *endpoint, const gcha
     request.SetBucket(bucket);
     request.SetKey(key);
 
-    auto outcome = s3_client.GetObject(request);
+    OperationTimer timer(S3_OP_GET_OBJECT);
+    auto outcome = s3_client->GetObject(request);
+    timer.ok = outcome.IsSuccess();
 
     if (outcome.IsSuccess()) {
         auto &stream = outcome.GetResult().GetBody();
         std::string str((std::istreambuf_iterator<char>(stream)),
                         std::istreambuf_iterator<char>());
         *length = str.length();
+        timer.bytes_in = str.length();
         return g_strdup(str.c_str());
     } else {
         g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
@@ -173,9 +602,341 @@ gchar* s3_client_cpp_download_object_to_buffer(const gchar *endpoint, const gcha
     }
 }
 
-gboolean s3_client_cpp_download_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *local_file_path, gboolean use_ssl, S3DownloadProgressCallback progress_callback, gpointer progress_user_data, GError **error) {
+namespace {
+    // Stream buffer that passes the response body to a chunk callback in
+    // fixed-size pieces instead of accumulating it.
+    class ChunkStreamBuf : public std::streambuf {
+    public:
+        ChunkStreamBuf(S3DownloadChunkCallback callback, gpointer user_data)
+            : callback_(callback), user_data_(user_data), buffer_(kChunkSize) {
+            setp(buffer_.data(), buffer_.data() + buffer_.size());
+        }
+
+        void set_total(guint64 total) { total_ = total; }
+        void cancel() { cancelled_ = true; }
+        bool cancelled() const { return cancelled_; }
+        guint64 delivered() const { return delivered_; }
+        // Drops what a failed attempt left buffered but not yet handed over.
+        void discard() { setp(buffer_.data(), buffer_.data() + buffer_.size()); }
+
+        // Hands over whatever is buffered. Returns false once the callback
+        // asked to stop.
+        bool deliver() {
+            gsize n = pptr() - pbase();
+            if (n > 0 && !cancelled_) {
+                if (!callback_(pbase(), n, total_, user_data_)) {
+                    cancelled_ = true;
+                }
+                delivered_ += n;
+            }
+            setp(buffer_.data(), buffer_.data() + buffer_.size());
+            return !cancelled_;
+        }
+
+    protected:
+        int_type overflow(int_type ch) override {
+            if (!deliver()) return traits_type::eof();
+            if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(ch);
+                pbump(1);
+            }
+            return traits_type::not_eof(ch);
+        }
+
+        int sync() override { return deliver() ? 0 : -1; }
+
+    private:
+        static constexpr size_t kChunkSize = 256 * 1024;
+        S3DownloadChunkCallback callback_;
+        gpointer user_data_;
+        std::vector<char> buffer_;
+        std::atomic<bool> cancelled_{false};
+        guint64 total_ = 0;
+        guint64 delivered_ = 0;
+    };
+} // namespace
+
+gboolean s3_client_cpp_download_object_streaming(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, S3DownloadChunkCallback chunk_callback, gpointer user_data, GError **error) {
+    auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
+
+    ChunkStreamBuf body(chunk_callback, user_data);
+    bool body_started = false;
+
+    Aws::S3::Model::GetObjectRequest request;
+    request.SetBucket(bucket);
+    request.SetKey(key);
+    request.SetResponseStreamFactory([&body, &body_started]() {
+        // A retry after part of the body went out would deliver it twice;
+        // before that, only the buffered bytes of the failed attempt go.
+        if (body_started && body.delivered() > 0) {
+            body.cancel();
+        }
+        body.discard();
+        body_started = true;
+        return Aws::New<Aws::IOStream>("mys3-streaming-body", &body);
+    });
+    request.SetHeadersReceivedEventHandler(std::function<void(const Aws::Http::HttpRequest*, Aws::Http::HttpResponse*)>(
+        [&body](const Aws::Http::HttpRequest*, Aws::Http::HttpResponse *response) {
+            if (response->HasHeader("content-length")) {
+                body.set_total(g_ascii_strtoull(response->GetHeader("content-length").c_str(), NULL, 10));
+            }
+        }));
+    request.SetContinueRequestHandler([&body](const Aws::Http::HttpRequest*) {
+        return !body.cancelled();
+    });
+
+    OperationTimer timer(S3_OP_GET_OBJECT);
+    auto outcome = s3_client->GetObject(request);
+    if (outcome.IsSuccess()) {
+        body.deliver();
+    }
+    timer.bytes_in = body.delivered();
+    timer.ok = outcome.IsSuccess() && !body.cancelled();
+
+    if (body.cancelled()) {
+        g_set_error(error, g_quark_from_static_string("S3Client"), 0, "Download of %s was interrupted", key);
+        return FALSE;
+    }
+    if (!outcome.IsSuccess()) {
+        g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+        return FALSE;
+    }
+    return TRUE;
+}
+
+GBytes* s3_client_cpp_download_range(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, guint64 offset, guint64 length, gboolean use_ssl, guint64 *object_size, GError **error) {
+    g_return_val_if_fail(length > 0, NULL);
+    auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
+
+    Aws::S3::Model::GetObjectRequest request;
+    request.SetBucket(bucket);
+    request.SetKey(key);
+    g_autofree gchar *range = g_strdup_printf("bytes=%" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT, offset, offset + length - 1);
+    request.SetRange(range);
+
+    OperationTimer timer(S3_OP_GET_OBJECT);
+    auto outcome = s3_client->GetObject(request);
+    timer.ok = outcome.IsSuccess();
+    if (!outcome.IsSuccess()) {
+        g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+        return NULL;
+    }
+
+    auto &result = outcome.GetResult();
+    gsize expected = (gsize)MIN((guint64)result.GetContentLength(), length);
+    gchar *data = (gchar *)g_malloc(MAX(expected, 1));
+    result.GetBody().read(data, expected);
+    gsize received = (gsize)result.GetBody().gcount();
+    timer.bytes_in = received;
+
+    if (object_size) {
+        // Content-Range is "bytes first-last/total"; total may be "*".
+        const Aws::String &content_range = result.GetContentRange();
+        size_t slash = content_range.find('/');
+        if (slash != Aws::String::npos && content_range[slash + 1] != '*') {
+            *object_size = g_ascii_strtoull(content_range.c_str() + slash + 1, NULL, 10);
+        } else {
+            *object_size = offset + received;
+        }
+    }
+    return g_bytes_new_take(data, received);
+}
+
+gboolean s3_client_cpp_download_range_into(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, guint64 offset, gsize length, guint8 *buffer, gboolean use_ssl, gsize *received, GError **error) {
+    g_return_val_if_fail(length > 0, FALSE);
+    auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
+
+    Aws::S3::Model::GetObjectRequest request;
+    request.SetBucket(bucket);
+    request.SetKey(key);
+    g_autofree gchar *range = g_strdup_printf("bytes=%" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT, offset, offset + length - 1);
+    request.SetRange(range);
+    // The body is written straight into the caller's buffer instead of the
+    // SDK's default string stream. A retried attempt starts over at its
+    // beginning.
+    Aws::Utils::Stream::PreallocatedStreamBuf streambuf(buffer, length);
+    request.SetResponseStreamFactory([&streambuf]() {
+        streambuf.pubseekpos(0, std::ios_base::out);
+        return Aws::New<Aws::IOStream>("S3RangeInto", &streambuf);
+    });
+
+    OperationTimer timer(S3_OP_GET_OBJECT);
+    auto outcome = s3_client->GetObject(request);
+    timer.ok = outcome.IsSuccess();
+    if (!outcome.IsSuccess()) {
+        g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+        return FALSE;
+    }
+    *received = (gsize)MIN((guint64)outcome.GetResult().GetContentLength(), (guint64)length);
+    timer.bytes_in = *received;
+    return TRUE;
+}
+
+gboolean s3_client_cpp_head_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, guint64 *size, gint64 *last_modified, GError **error) {
+    auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
+
+    Aws::S3::Model::HeadObjectRequest request;
+    request.SetBucket(bucket);
+    request.SetKey(key);
+
+    OperationTimer timer(S3_OP_HEAD_OBJECT);
+    auto outcome = s3_client->HeadObject(request);
+    timer.ok = outcome.IsSuccess();
+    if (!outcome.IsSuccess()) {
+        g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+        return FALSE;
+    }
+    if (size) *size = (guint64)outcome.GetResult().GetContentLength();
+    if (last_modified) *last_modified = outcome.GetResult().GetLastModified().Millis();
+    return TRUE;
+}
+
+S3ObjectMetadata* s3_client_cpp_head_object_metadata(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, GError **error) {
+    auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
+
+    Aws::S3::Model::HeadObjectRequest request;
+    request.SetBucket(bucket);
+    request.SetKey(key);
+
+    OperationTimer timer(S3_OP_HEAD_OBJECT);
+    auto outcome = s3_client->HeadObject(request);
+    timer.ok = outcome.IsSuccess();
+    if (!outcome.IsSuccess()) {
+        g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+        return NULL;
+    }
+
+    const auto &result = outcome.GetResult();
+    S3ObjectMetadata *metadata = g_new0(S3ObjectMetadata, 1);
+    metadata->content_type = g_strdup(result.GetContentType().c_str());
+    // S3 leaves the header out for STANDARD objects.
+    auto storage_class = result.GetStorageClass();
+    metadata->storage_class = g_strdup(storage_class == Aws::S3::Model::StorageClass::NOT_SET ? "STANDARD" : Aws::S3::Model::StorageClassMapper::GetNameForStorageClass(storage_class).c_str());
+    metadata->etag = g_strdup(result.GetETag().c_str());
+    const auto &user_metadata = result.GetMetadata();
+    metadata->user_metadata = g_new0(gchar *, user_metadata.size() * 2 + 1);
+    gsize i = 0;
+    for (const auto &entry : user_metadata) {
+        metadata->user_metadata[i++] = g_strdup(entry.first.c_str());
+        metadata->user_metadata[i++] = g_strdup(entry.second.c_str());
+    }
+    return metadata;
+}
+
+gboolean s3_client_cpp_select_object_content(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *expression, S3SelectInputFormat input_format, gboolean csv_header, gboolean gzip, gboolean use_ssl, S3SelectRecordsCallback records_callback, S3SelectStatsCallback stats_callback, gpointer user_data, S3SelectStats *stats, GError **error) {
+    auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
+
+    Aws::S3::Model::SelectObjectContentRequest request;
+    request.SetBucket(bucket);
+    request.SetKey(key);
+    request.SetExpressionType(Aws::S3::Model::ExpressionType::SQL);
+    request.SetExpression(expression);
+
+    Aws::S3::Model::InputSerialization input;
+    switch (input_format) {
+    case S3_SELECT_INPUT_CSV: {
+        Aws::S3::Model::CSVInput csv;
+        csv.SetFileHeaderInfo(csv_header ? Aws::S3::Model::FileHeaderInfo::USE : Aws::S3::Model::FileHeaderInfo::NONE);
+        input.SetCSV(csv);
+        break;
+    }
+    case S3_SELECT_INPUT_JSON_LINES: {
+        Aws::S3::Model::JSONInput json;
+        json.SetType(Aws::S3::Model::JSONType::LINES);
+        input.SetJSON(json);
+        break;
+    }
+    case S3_SELECT_INPUT_PARQUET:
+        input.SetParquet(Aws::S3::Model::ParquetInput());
+        break;
+    }
+    if (input_format != S3_SELECT_INPUT_PARQUET) {
+        input.SetCompressionType(gzip ? Aws::S3::Model::CompressionType::GZIP : Aws::S3::Model::CompressionType::NONE);
+    }
+    request.SetInputSerialization(input);
+    Aws::S3::Model::OutputSerialization output;
+    output.SetCSV(Aws::S3::Model::CSVOutput());
+    request.SetOutputSerialization(output);
+
+    // The SDK decodes the event stream and calls these as each message arrives.
+    S3SelectStats totals = {};
+    std::atomic<bool> stopped(false);
+    Aws::String event_error;
+    Aws::S3::Model::SelectObjectContentHandler handler;
+    handler.SetRecordsEventCallback(std::function<void(const Aws::S3::Model::RecordsEvent&)>(
+        [&](const Aws::S3::Model::RecordsEvent &event) {
+            const auto &payload = event.GetPayload();
+            totals.bytes_returned += payload.size();
+            if (!stopped && !records_callback((const gchar *)payload.data(), payload.size(), user_data)) {
+                stopped = true;
+            }
+        }));
+    auto report = [&](guint64 scanned, guint64 processed) {
+        totals.bytes_scanned = scanned;
+        totals.bytes_processed = processed;
+        if (stats_callback) stats_callback(&totals, user_data);
+    };
+    handler.SetProgressEventCallback(std::function<void(const Aws::S3::Model::ProgressEvent&)>(
+        [&](const Aws::S3::Model::ProgressEvent &event) {
+            report(event.GetDetails().GetBytesScanned(), event.GetDetails().GetBytesProcessed());
+        }));
+    handler.SetStatsEventCallback(std::function<void(const Aws::S3::Model::StatsEvent&)>(
+        [&](const Aws::S3::Model::StatsEvent &event) {
+            report(event.GetDetails().GetBytesScanned(), event.GetDetails().GetBytesProcessed());
+        }));
+    handler.SetOnErrorCallback(std::function<void(const Aws::Client::AWSError<Aws::S3::S3Errors>&)>(
+        [&](const Aws::Client::AWSError<Aws::S3::S3Errors> &err) {
+            event_error = err.GetMessage();
+        }));
+    request.SetEventStreamHandler(handler);
+    request.SetContinueRequestHandler([&stopped](const Aws::Http::HttpRequest*) {
+        return !stopped.load();
+    });
+
+    OperationTimer timer(S3_OP_SELECT_OBJECT_CONTENT);
+    auto outcome = s3_client->SelectObjectContent(request);
+    timer.bytes_in = totals.bytes_returned;
+    timer.ok = (outcome.IsSuccess() && event_error.empty()) || stopped;
+    if (stats) *stats = totals;
+
+    if (stopped) return TRUE;
+    if (!outcome.IsSuccess()) {
+        g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+        return FALSE;
+    }
+    if (!event_error.empty()) {
+        g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", event_error.c_str());
+        return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean s3_client_cpp_download_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *local_file_path, gboolean use_ssl, guint64 known_size, S3DownloadProgressCallback progress_callback, gpointer progress_user_data, GError **error) {
     auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
 
+#ifdef MYS3_HAVE_S3_CRT
+    if (crt_backend_selected()) {
+        guint64 total_bytes = known_size;
+        if (total_bytes == 0) {
+            // The size probe is a cheap metadata call and stays on the classic
+            // client; callers that listed the object skip it.
+            Aws::S3::Model::HeadObjectRequest head_request;
+            head_request.SetBucket(bucket);
+            head_request.SetKey(key);
+            OperationTimer head_timer(S3_OP_HEAD_OBJECT);
+            auto head_outcome = s3_client->HeadObject(head_request);
+            head_timer.ok = head_outcome.IsSuccess();
+            if (head_outcome.IsSuccess()) total_bytes = (guint64)head_outcome.GetResult().GetContentLength();
+        }
+        if (use_crt_for_size(total_bytes)) {
+            OperationTimer timer(S3_OP_GET_OBJECT);
+            timer.ok = crt_download_object(endpoint, access_key, secret_key, bucket, key, local_file_path, use_ssl, total_bytes, progress_callback, progress_user_data, error);
+            timer.bytes_in = timer.ok ? total_bytes : 0;
+            return timer.ok;
+        }
+    }
+#endif
+
     Aws::S3::Model::GetObjectRequest request;
     request.SetBucket(bucket);
     request.SetKey(key);
@@ -183,25 +944,57 @@ gboolean s3_client_cpp_download_object(const gchar *endpoint, const gchar *acces
     request.SetResponseStreamFactory([=]() { return Aws::New<Aws::FStream>("SampleAllocationTag", local_file_path, std::ios_base::out | std::ios_base::binary); });
 
     if (progress_callback) {
+        // The handler gets the size of each received chunk; report the running
+        // total like the CRT path does. The object size comes from
+        // Content-Range for ranged responses and Content-Length otherwise.
+        auto received = std::make_shared<guint64>(0);
         request.SetDataReceivedEventHandler(std::function<void(const Aws::Http::HttpRequest*, Aws::Http::HttpResponse*, long long)>(
             [=](const Aws::Http::HttpRequest* req, Aws::Http::HttpResponse* res, long long progress) {
+                (void)req;
+                *received += (guint64)progress;
+                guint64 total_bytes = 0;
                 if (res) {
                     const auto& headers = res->GetHeaders();
                     const auto& range = headers.find("content-range");
+                    const auto& content_length = headers.find("content-length");
                     if (range != headers.end()) {
-                        const std::string& range_str = range->second;
-                        size_t pos = range_str.find('/');
+                        size_t pos = range->second.find('/');
                         if (pos != std::string::npos) {
-                            long long total_bytes = std::stoll(range_str.substr(pos + 1));
-                            progress_callback(progress, total_bytes, progress_user_data);
+                            total_bytes = g_ascii_strtoull(range->second.c_str() + pos + 1, NULL, 10);
                         }
+                    } else if (content_length != headers.end()) {
+                        total_bytes = g_ascii_strtoull(content_length->second.c_str(), NULL, 10);
                     }
                 }
+                progress_callback(*received, total_bytes, progress_user_data);
             }
         ));
     }
 
-    auto outcome = s3_client.GetObject(request);
+    OperationTimer timer(S3_OP_GET_OBJECT);
+    auto outcome = s3_client->GetObject(request);
+    timer.ok = outcome.IsSuccess();
+
+    if (outcome.IsSuccess()) {
+        timer.bytes_in = (guint64)outcome.GetResult().GetContentLength();
+        return TRUE;
+    } else {
+        g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+        return FALSE;
+    }
+}
+
+gboolean s3_client_cpp_copy_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *src_bucket, const gchar *src_key, const gchar *dst_bucket, const gchar *dst_key, gboolean use_ssl, GError **error) {
+    auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
+
+    Aws::S3::Model::CopyObjectRequest request;
+    request.SetCopySource(Aws::String(src_bucket) + "/" + src_key);
+    request.SetBucket(dst_bucket);
+    request.SetKey(dst_key);
+
+    OperationTimer timer(S3_OP_COPY_OBJECT);
+    auto outcome = s3_client->CopyObject(request);
+    timer.ok = outcome.IsSuccess();
 
     if (outcome.IsSuccess()) {
         return TRUE;
@@ -211,6 +1004,89 @@ gboolean s3_client_cpp_download_object(const gchar *endpoint, const gchar *acces
     }
 }
 
+gchar* s3_client_cpp_create_multipart_upload(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, GError **error) {
+    auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
+
+    Aws::S3::Model::CreateMultipartUploadRequest request;
+    request.SetBucket(bucket);
+    request.SetKey(key);
+
+    OperationTimer timer(S3_OP_MULTIPART_UPLOAD);
+    auto outcome = s3_client->CreateMultipartUpload(request);
+    timer.ok = outcome.IsSuccess();
+    if (!outcome.IsSuccess()) {
+        g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+        return NULL;
+    }
+    return g_strdup(outcome.GetResult().GetUploadId().c_str());
+}
+
+gchar* s3_client_cpp_upload_part(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *upload_id, guint part_number, const guint8 *data, gsize length, gboolean use_ssl, GError **error) {
+    auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
+
+    Aws::S3::Model::UploadPartRequest request;
+    request.SetBucket(bucket);
+    request.SetKey(key);
+    request.SetUploadId(upload_id);
+    request.SetPartNumber((int)part_number);
+    request.SetContentLength((long long)length);
+    // Sent from the caller's buffer without copying it; the SDK rewinds the
+    // stream itself when it retries.
+    Aws::Utils::Stream::PreallocatedStreamBuf streambuf(const_cast<guint8 *>(data), length);
+    request.SetBody(Aws::MakeShared<Aws::IOStream>("S3UploadPart", &streambuf));
+
+    OperationTimer timer(S3_OP_UPLOAD_PART);
+    auto outcome = s3_client->UploadPart(request);
+    timer.ok = outcome.IsSuccess();
+    if (!outcome.IsSuccess()) {
+        g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+        return NULL;
+    }
+    timer.bytes_out = length;
+    return g_strdup(outcome.GetResult().GetETag().c_str());
+}
+
+gboolean s3_client_cpp_complete_multipart_upload(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *upload_id, const gchar * const *etags, guint n_parts, gboolean use_ssl, GError **error) {
+    auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
+
+    Aws::S3::Model::CompletedMultipartUpload upload;
+    for (guint i = 0; i < n_parts; i++) {
+        upload.AddParts(Aws::S3::Model::CompletedPart().WithETag(etags[i]).WithPartNumber((int)(i + 1)));
+    }
+    Aws::S3::Model::CompleteMultipartUploadRequest request;
+    request.SetBucket(bucket);
+    request.SetKey(key);
+    request.SetUploadId(upload_id);
+    request.SetMultipartUpload(upload);
+
+    OperationTimer timer(S3_OP_MULTIPART_UPLOAD);
+    auto outcome = s3_client->CompleteMultipartUpload(request);
+    timer.ok = outcome.IsSuccess();
+    if (!outcome.IsSuccess()) {
+        g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+        return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean s3_client_cpp_abort_multipart_upload(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *upload_id, gboolean use_ssl, GError **error) {
+    auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
+
+    Aws::S3::Model::AbortMultipartUploadRequest request;
+    request.SetBucket(bucket);
+    request.SetKey(key);
+    request.SetUploadId(upload_id);
+
+    OperationTimer timer(S3_OP_MULTIPART_UPLOAD);
+    auto outcome = s3_client->AbortMultipartUpload(request);
+    timer.ok = outcome.IsSuccess();
+    if (!outcome.IsSuccess()) {
+        g_set_error(error, g_quark_from_static_string("S3Client"), 0, "%s", outcome.GetError().GetMessage().c_str());
+        return FALSE;
+    }
+    return TRUE;
+}
+
 gboolean s3_client_cpp_rename_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *old_key, const gchar *new_key, gboolean use_ssl, GError **error) {
     auto s3_client = create_s3_client(endpoint, access_key, secret_key, use_ssl);
 
@@ -219,14 +1095,21 @@ gboolean s3_client_cpp_rename_object(const gchar *endpoint, const gchar *access_
     copy_request.SetBucket(bucket);
     copy_request.SetKey(new_key);
 
-    auto copy_outcome = s3_client.CopyObject(copy_request);
+    Aws::S3::Model::CopyObjectOutcome copy_outcome;
+    {
+        OperationTimer copy_timer(S3_OP_COPY_OBJECT);
+        copy_outcome = s3_client->CopyObject(copy_request);
+        copy_timer.ok = copy_outcome.IsSuccess();
+    }
 
     if (copy_outcome.IsSuccess()) {
         Aws::S3::Model::DeleteObjectRequest delete_request;
         delete_request.SetBucket(bucket);
         delete_request.SetKey(old_key);
 
-        auto delete_outcome = s3_client.DeleteObject(delete_request);
+        OperationTimer delete_timer(S3_OP_DELETE_OBJECT);
+        auto delete_outcome = s3_client->DeleteObject(delete_request);
+        delete_timer.ok = delete_outcome.IsSuccess();
 
         if (delete_outcome.IsSuccess()) {
             return TRUE;
@@ -247,7 +1130,9 @@ gboolean s3_client_cpp_delete_object(const gchar *endpoint, const gchar *access_
     request.SetBucket(bucket);
     request.SetKey(key);
 
-    auto outcome = s3_client.DeleteObject(request);
+    OperationTimer timer(S3_OP_DELETE_OBJECT);
+    auto outcome = s3_client->DeleteObject(request);
+    timer.ok = outcome.IsSuccess();
 
     if (outcome.IsSuccess()) {
         return TRUE;
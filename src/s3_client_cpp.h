@@ -10,14 +10,28 @@ extern "C" {
 
 void s3_client_cpp_init();
 void s3_client_cpp_cleanup();
+gboolean s3_client_cpp_set_transfer_backend(S3TransferBackend backend, guint64 threshold_bytes, gdouble target_gbps);
 
 S3ConnectionStatus s3_client_cpp_test_connection(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, gboolean use_ssl);
 GList* s3_client_cpp_list_buckets(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, gboolean use_ssl, GError **error);
 GList* s3_client_cpp_list_objects(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *prefix, gboolean use_ssl, GError **error);
+gboolean s3_client_cpp_list_objects_paged(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *prefix, gboolean use_ssl, S3ListPageCallback page_callback, gpointer user_data, GError **error);
+gboolean s3_client_cpp_list_objects_delimited(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *prefix, gboolean use_ssl, S3ListPageCallback page_callback, S3ListPrefixesCallback prefixes_callback, gpointer user_data, GError **error);
 gboolean s3_client_cpp_create_folder(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *folder_path, gboolean use_ssl, GError **error);
 gboolean s3_client_cpp_upload_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *local_file_path, gboolean use_ssl, GError **error);
 gchar* s3_client_cpp_download_object_to_buffer(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, gsize *length, GError **error);
-gboolean s3_client_cpp_download_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *local_file_path, gboolean use_ssl, S3DownloadProgressCallback progress_callback, gpointer progress_user_data, GError **error);
+gboolean s3_client_cpp_download_object_streaming(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, S3DownloadChunkCallback chunk_callback, gpointer user_data, GError **error);
+GBytes* s3_client_cpp_download_range(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, guint64 offset, guint64 length, gboolean use_ssl, guint64 *object_size, GError **error);
+gboolean s3_client_cpp_download_range_into(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, guint64 offset, gsize length, guint8 *buffer, gboolean use_ssl, gsize *received, GError **error);
+gboolean s3_client_cpp_head_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, guint64 *size, gint64 *last_modified, GError **error);
+S3ObjectMetadata* s3_client_cpp_head_object_metadata(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, GError **error);
+gboolean s3_client_cpp_select_object_content(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *expression, S3SelectInputFormat input_format, gboolean csv_header, gboolean gzip, gboolean use_ssl, S3SelectRecordsCallback records_callback, S3SelectStatsCallback stats_callback, gpointer user_data, S3SelectStats *stats, GError **error);
+gboolean s3_client_cpp_download_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *local_file_path, gboolean use_ssl, guint64 known_size, S3DownloadProgressCallback progress_callback, gpointer progress_user_data, GError **error);
+gboolean s3_client_cpp_copy_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *src_bucket, const gchar *src_key, const gchar *dst_bucket, const gchar *dst_key, gboolean use_ssl, GError **error);
+gchar* s3_client_cpp_create_multipart_upload(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, GError **error);
+gchar* s3_client_cpp_upload_part(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *upload_id, guint part_number, const guint8 *data, gsize length, gboolean use_ssl, GError **error);
+gboolean s3_client_cpp_complete_multipart_upload(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *upload_id, const gchar * const *etags, guint n_parts, gboolean use_ssl, GError **error);
+gboolean s3_client_cpp_abort_multipart_upload(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, const gchar *upload_id, gboolean use_ssl, GError **error);
 gboolean s3_client_cpp_rename_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *old_key, const gchar *new_key, gboolean use_ssl, GError **error);
 gboolean s3_client_cpp_delete_object(const gchar *endpoint, const gchar *access_key, const gchar *secret_key, const gchar *bucket, const gchar *key, gboolean use_ssl, GError **error);
 
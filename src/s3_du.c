@@ -0,0 +1,316 @@
+#include "s3_du.h"
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "s3_client.h"
+#include "trace.h"
+
+#define S3_DU_DEFAULT_CONCURRENCY 16
+#define S3_DU_DEFAULT_SPLIT_DEPTH 3
+#define S3_DU_CACHE_VERSION 1
+// Results kept in the cache; the oldest go first.
+#define S3_DU_CACHE_MAX_ENTRIES 256
+
+typedef struct {
+    const S3DuOptions *options;
+    GCancellable *cancellable;
+    guint split_depth;
+    GThreadPool *pool;
+    gint stop;
+    GMutex lock;            // Guards everything below and serializes the callback
+    GCond idle;
+    guint pending;          // Listings queued or running
+    S3DuResult *result;
+    GHashTable *slots;      // Subfolder -> index in result->children + 1
+    GError *error;          // First failure
+} DuRun;
+
+typedef struct {
+    DuRun *run;
+    gchar *prefix;
+    guint depth;
+    guint slot;             // Subfolder of the run's prefix this falls under, G_MAXUINT for the top listing
+} DuListing;
+
+static S3DuResult *du_result_new(const gchar *bucket, const gchar *prefix) {
+    S3DuResult *result = g_new0(S3DuResult, 1);
+    result->ref_count = 1;
+    result->bucket = g_strdup(bucket);
+    result->prefix = g_strdup(prefix ? prefix : "");
+    result->children = g_array_new(FALSE, TRUE, sizeof(S3DuEntry));
+    return result;
+}
+
+S3DuResult *s3_du_result_ref(S3DuResult *result) {
+    g_atomic_int_inc(&result->ref_count);
+    return result;
+}
+
+void s3_du_result_unref(S3DuResult *result) {
+    if (!result || !g_atomic_int_dec_and_test(&result->ref_count)) return;
+    for (guint i = 0; i < result->children->len; i++) g_free(g_array_index(result->children, S3DuEntry, i).prefix);
+    g_array_unref(result->children);
+    g_free(result->bucket);
+    g_free(result->prefix);
+    g_free(result);
+}
+
+S3DuResult *s3_du_result_copy(const S3DuResult *result) {
+    S3DuResult *copy = du_result_new(result->bucket, result->prefix);
+    copy->objects = result->objects;
+    copy->bytes = result->bytes;
+    copy->computed_at = result->computed_at;
+    g_array_set_size(copy->children, result->children->len);
+    for (guint i = 0; i < result->children->len; i++) {
+        const S3DuEntry *entry = &g_array_index(result->children, S3DuEntry, i);
+        S3DuEntry *dest = &g_array_index(copy->children, S3DuEntry, i);
+        dest->prefix = g_strdup(entry->prefix);
+        dest->objects = entry->objects;
+        dest->bytes = entry->bytes;
+    }
+    return copy;
+}
+
+static gboolean du_stopped(DuRun *run) {
+    return g_atomic_int_get(&run->stop) || g_cancellable_is_cancelled(run->cancellable);
+}
+
+// Index of the entry for `prefix` in the result. Called with the lock held.
+static guint du_slot(DuRun *run, const gchar *prefix) {
+    guint index = GPOINTER_TO_UINT(g_hash_table_lookup(run->slots, prefix));
+    if (index > 0) return index - 1;
+    S3DuEntry entry = { g_strdup(prefix), 0, 0 };
+    g_array_append_val(run->result->children, entry);
+    g_hash_table_insert(run->slots, entry.prefix, GUINT_TO_POINTER(run->result->children->len));
+    return run->result->children->len - 1;
+}
+
+static void du_push(DuRun *run, const gchar *prefix, guint depth, guint slot) {
+    DuListing *listing = g_new0(DuListing, 1);
+    listing->run = run;
+    listing->prefix = g_strdup(prefix);
+    listing->depth = depth;
+    listing->slot = slot;
+    g_mutex_lock(&run->lock);
+    run->pending++;
+    g_mutex_unlock(&run->lock);
+    g_thread_pool_push(run->pool, listing, NULL);
+}
+
+static gboolean on_du_page(const S3Object *objects, guint n_objects, gpointer user_data) {
+    DuListing *listing = (DuListing *)user_data;
+    DuRun *run = listing->run;
+    guint64 bytes = 0;
+    for (guint i = 0; i < n_objects; i++) bytes += objects[i].size;
+
+    g_mutex_lock(&run->lock);
+    guint slot = listing->slot != G_MAXUINT ? listing->slot : du_slot(run, run->result->prefix);
+    S3DuEntry *entry = &g_array_index(run->result->children, S3DuEntry, slot);
+    entry->objects += n_objects;
+    entry->bytes += bytes;
+    run->result->objects += n_objects;
+    run->result->bytes += bytes;
+    if (run->options->progress_callback) run->options->progress_callback(run->result, run->options->user_data);
+    g_mutex_unlock(&run->lock);
+    return !du_stopped(run);
+}
+
+static gboolean on_du_prefixes(const gchar * const *prefixes, guint n_prefixes, gpointer user_data) {
+    DuListing *listing = (DuListing *)user_data;
+    DuRun *run = listing->run;
+    for (guint i = 0; i < n_prefixes && !du_stopped(run); i++) {
+        guint slot = listing->slot;
+        if (slot == G_MAXUINT) {
+            g_mutex_lock(&run->lock);
+            slot = du_slot(run, prefixes[i]);
+            g_mutex_unlock(&run->lock);
+        }
+        du_push(run, prefixes[i], listing->depth + 1, slot);
+    }
+    return !du_stopped(run);
+}
+
+static void du_list(gpointer data, gpointer user_data) {
+    DuListing *listing = (DuListing *)data;
+    DuRun *run = (DuRun *)user_data;
+    const S3DuOptions *o = run->options;
+    if (!du_stopped(run)) {
+        gint64 span = trace_begin();
+        GError *error = NULL;
+        gboolean ok;
+        if (listing->depth < run->split_depth) {
+            ok = s3_client_list_objects_delimited(o->endpoint, o->access_key, o->secret_key, o->bucket, listing->prefix, o->use_ssl, on_du_page, on_du_prefixes, listing, &error);
+        } else {
+            ok = s3_client_list_objects_paged(o->endpoint, o->access_key, o->secret_key, o->bucket, listing->prefix, o->use_ssl, on_du_page, listing, &error);
+        }
+        if (!ok) {
+            g_mutex_lock(&run->lock);
+            if (!run->error) {
+                run->error = error;
+                error = NULL;
+            }
+            g_mutex_unlock(&run->lock);
+            g_atomic_int_set(&run->stop, TRUE);
+            g_clear_error(&error);
+        }
+        trace_end_detail(span, "du", "list", listing->prefix);
+    }
+
+    g_mutex_lock(&run->lock);
+    if (--run->pending == 0) g_cond_signal(&run->idle);
+    g_mutex_unlock(&run->lock);
+    g_free(listing->prefix);
+    g_free(listing);
+}
+
+static gint compare_du_entries(gconstpointer a, gconstpointer b) {
+    return strcmp(((const S3DuEntry *)a)->prefix, ((const S3DuEntry *)b)->prefix);
+}
+
+S3DuResult *s3_du_run(const S3DuOptions *options, GCancellable *cancellable, GError **error) {
+    gint64 span = trace_begin();
+    DuRun run = { .options = options, .cancellable = cancellable };
+    run.split_depth = options->split_depth ? options->split_depth : S3_DU_DEFAULT_SPLIT_DEPTH;
+    run.result = du_result_new(options->bucket, options->prefix);
+    run.slots = g_hash_table_new(g_str_hash, g_str_equal);
+    g_mutex_init(&run.lock);
+    g_cond_init(&run.idle);
+    guint concurrency = options->max_concurrency ? options->max_concurrency : S3_DU_DEFAULT_CONCURRENCY;
+    run.pool = g_thread_pool_new(du_list, &run, concurrency, FALSE, NULL);
+
+    // Listings queue the subfolders they find, so the pool only runs dry
+    // once everything is counted.
+    du_push(&run, run.result->prefix, 0, G_MAXUINT);
+    g_mutex_lock(&run.lock);
+    while (run.pending > 0) g_cond_wait(&run.idle, &run.lock);
+    g_mutex_unlock(&run.lock);
+    g_thread_pool_free(run.pool, FALSE, TRUE);
+
+    S3DuResult *result = run.result;
+    g_hash_table_unref(run.slots);
+    g_cond_clear(&run.idle);
+    g_mutex_clear(&run.lock);
+    trace_end_detail(span, "du", "run", result->prefix);
+    if (g_cancellable_set_error_if_cancelled(cancellable, error)) {
+        g_clear_error(&run.error);
+        s3_du_result_unref(result);
+        return NULL;
+    }
+    if (run.error) {
+        g_propagate_error(error, run.error);
+        s3_du_result_unref(result);
+        return NULL;
+    }
+    g_array_sort(result->children, compare_du_entries);
+    result->computed_at = g_get_real_time() / G_USEC_PER_SEC;
+    return result;
+}
+
+// #############################################################################
+// # Cache
+// #############################################################################
+
+static GMutex cache_lock;
+static GHashTable *cache;   // Cache key -> S3DuResult, loaded on first use
+
+static gchar *du_cache_path(void) {
+    return g_build_filename(g_get_user_cache_dir(), "mys3-client", "du.gvariant", NULL);
+}
+
+static gchar *du_cache_key(const gchar *endpoint, const gchar *bucket, const gchar *prefix) {
+    return g_strdup_printf("%s\n%s\n%s", endpoint ? endpoint : "", bucket, prefix ? prefix : "");
+}
+
+static void du_cache_load_locked(void) {
+    if (cache) return;
+    cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)s3_du_result_unref);
+    g_autofree gchar *path = du_cache_path();
+    g_autofree gchar *contents = NULL;
+    gsize length = 0;
+    if (!g_file_get_contents(path, &contents, &length, NULL)) return;
+    g_autoptr(GBytes) bytes = g_bytes_new_take(g_steal_pointer(&contents), length);
+    g_autoptr(GVariant) root = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE_VARDICT, bytes, FALSE));
+
+    guint32 version = 0;
+    g_autoptr(GVariantIter) results = NULL;
+    if (!g_variant_lookup(root, "version", "u", &version) || version != S3_DU_CACHE_VERSION) return;
+    if (!g_variant_lookup(root, "results", "a(sssttxa(stt))", &results)) return;
+    const gchar *endpoint, *bucket, *prefix;
+    guint64 objects, bytes_total;
+    gint64 computed_at;
+    GVariantIter *children;
+    while (g_variant_iter_next(results, "(&s&s&sttxa(stt))", &endpoint, &bucket, &prefix, &objects, &bytes_total, &computed_at, &children)) {
+        S3DuResult *result = du_result_new(bucket, prefix);
+        result->objects = objects;
+        result->bytes = bytes_total;
+        result->computed_at = computed_at;
+        S3DuEntry entry;
+        while (g_variant_iter_next(children, "(stt)", &entry.prefix, &entry.objects, &entry.bytes)) g_array_append_val(result->children, entry);
+        g_variant_iter_free(children);
+        g_hash_table_replace(cache, du_cache_key(endpoint, bucket, prefix), result);
+    }
+}
+
+static void du_cache_save_locked(void) {
+    GVariantBuilder results;
+    g_variant_builder_init(&results, G_VARIANT_TYPE("a(sssttxa(stt))"));
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, cache);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        const S3DuResult *result = value;
+        g_auto(GStrv) parts = g_strsplit(key, "\n", 3);
+        GVariantBuilder children;
+        g_variant_builder_init(&children, G_VARIANT_TYPE("a(stt)"));
+        for (guint i = 0; i < result->children->len; i++) {
+            const S3DuEntry *entry = &g_array_index(result->children, S3DuEntry, i);
+            g_variant_builder_add(&children, "(stt)", entry->prefix, entry->objects, entry->bytes);
+        }
+        g_variant_builder_add(&results, "(sssttxa(stt))", parts[0], result->bucket, result->prefix, result->objects, result->bytes, result->computed_at, &children);
+    }
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&builder, "{sv}", "version", g_variant_new_uint32(S3_DU_CACHE_VERSION));
+    g_variant_builder_add(&builder, "{sv}", "results", g_variant_builder_end(&results));
+    g_autoptr(GVariant) root = g_variant_ref_sink(g_variant_builder_end(&builder));
+
+    g_autofree gchar *path = du_cache_path();
+    g_autofree gchar *dir = g_path_get_dirname(path);
+    g_autoptr(GError) error = NULL;
+    if (g_mkdir_with_parents(dir, 0700) != 0) {
+        g_warning("Cannot create %s: %s", dir, g_strerror(errno));
+    } else if (!g_file_set_contents(path, g_variant_get_data(root), g_variant_get_size(root), &error)) {
+        g_warning("Failed to save folder sizes: %s", error->message);
+    }
+}
+
+S3DuResult *s3_du_cache_lookup(const gchar *endpoint, const gchar *bucket, const gchar *prefix) {
+    g_autofree gchar *key = du_cache_key(endpoint, bucket, prefix);
+    g_mutex_lock(&cache_lock);
+    du_cache_load_locked();
+    S3DuResult *result = g_hash_table_lookup(cache, key);
+    if (result) s3_du_result_ref(result);
+    g_mutex_unlock(&cache_lock);
+    return result;
+}
+
+void s3_du_cache_store(const gchar *endpoint, S3DuResult *result) {
+    g_mutex_lock(&cache_lock);
+    du_cache_load_locked();
+    g_hash_table_replace(cache, du_cache_key(endpoint, result->bucket, result->prefix), s3_du_result_ref(result));
+    while (g_hash_table_size(cache) > S3_DU_CACHE_MAX_ENTRIES) {
+        GHashTableIter iter;
+        gpointer key, value, oldest = NULL;
+        gint64 oldest_time = G_MAXINT64;
+        g_hash_table_iter_init(&iter, cache);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            if (((S3DuResult *)value)->computed_at < oldest_time) {
+                oldest_time = ((S3DuResult *)value)->computed_at;
+                oldest = key;
+            }
+        }
+        g_hash_table_remove(cache, oldest);
+    }
+    du_cache_save_locked();
+    g_mutex_unlock(&cache_lock);
+}
@@ -0,0 +1,67 @@
+#ifndef MYS3_S3_DU_H
+#define MYS3_S3_DU_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct {
+    gchar *prefix;      // A subfolder of the result's prefix, ending in "/", or the prefix itself for the objects directly in it
+    guint64 objects;
+    guint64 bytes;
+} S3DuEntry;
+
+// Objects and bytes below a prefix, broken down by its immediate subfolders.
+typedef struct {
+    gchar *bucket;
+    gchar *prefix;          // "" for the whole bucket
+    guint64 objects;
+    guint64 bytes;
+    GArray *children;       // S3DuEntry, by prefix once complete
+    gint64 computed_at;     // Unix time the computation finished, 0 until then
+    /*< private >*/
+    gint ref_count;
+} S3DuResult;
+
+S3DuResult *s3_du_result_ref(S3DuResult *result);
+void s3_du_result_unref(S3DuResult *result);
+// Deep copy, for keeping a snapshot of the totals handed to a progress
+// callback.
+S3DuResult *s3_du_result_copy(const S3DuResult *result);
+
+// Runs on a worker thread after each listing page, one call at a time, with
+// the totals so far. `partial` is only valid during the call.
+typedef void (*S3DuProgressCallback)(const S3DuResult *partial, gpointer user_data);
+
+typedef struct {
+    const gchar *endpoint;
+    const gchar *access_key;
+    const gchar *secret_key;
+    const gchar *bucket;
+    const gchar *prefix;        // NULL or "" for the whole bucket
+    gboolean use_ssl;
+    guint max_concurrency;      // Listings at once; 0 for the default
+    guint split_depth;          // Levels listed with a delimiter to find parallel work; 0 for the default
+    S3DuProgressCallback progress_callback;  // May be NULL
+    gpointer user_data;
+} S3DuOptions;
+
+// Counts the objects and bytes under options->prefix. A listing cannot be
+// split once started, so the first split_depth levels are listed with a
+// delimiter and every subfolder found becomes a listing of its own on the
+// worker pool; below that, a subfolder is listed flat. Each listing sums its
+// pages itself and adds them to the total of the subfolder of the prefix it
+// falls under, so the workers only meet once per page. Blocks until done.
+S3DuResult *s3_du_run(const S3DuOptions *options, GCancellable *cancellable, GError **error);
+
+// Results are kept per endpoint, bucket and prefix in a file under the user
+// cache directory, so they show again at once next time. Lookup returns a
+// new reference or NULL.
+S3DuResult *s3_du_cache_lookup(const gchar *endpoint, const gchar *bucket, const gchar *prefix);
+void s3_du_cache_store(const gchar *endpoint, S3DuResult *result);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(S3DuResult, s3_du_result_unref)
+
+G_END_DECLS
+
+#endif // MYS3_S3_DU_H
@@ -0,0 +1,265 @@
+#include "s3_grep.h"
+#include <string.h>
+#include "s3_client.h"
+#include "trace.h"
+#ifdef MYS3_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define S3_GREP_DEFAULT_CONCURRENCY 8
+// The listing waits while this many keys are queued for the workers.
+#define S3_GREP_MAX_QUEUED_KEYS 1024
+// A line longer than this is scanned in pieces that overlap by
+// S3_GREP_OVERLAP bytes, so matches up to that long are still found.
+#define S3_GREP_MAX_LINE (1024 * 1024)
+#define S3_GREP_OVERLAP 4096
+#define S3_GREP_MAX_REPORTED_LINE 512
+#define S3_GREP_DECOMPRESS_BUFFER (256 * 1024)
+
+typedef struct {
+    const S3GrepOptions *options;
+    const TextMatcher *matcher;
+    GCancellable *cancellable;
+    GThreadPool *pool;
+    gint stop;
+    GMutex lock;        // Guards stats and serializes the callbacks
+    S3GrepStats stats;
+} GrepRun;
+
+typedef enum { GREP_UNKNOWN, GREP_PLAIN, GREP_GZIP, GREP_ZSTD } GrepEncoding;
+
+typedef struct {
+    GrepRun *run;
+    const gchar *key;
+    GrepEncoding encoding;
+    GConverter *gunzip;
+#ifdef MYS3_HAVE_ZSTD
+    ZSTD_DStream *zstd;
+#endif
+    guint8 *decompressed;
+    GByteArray *pending;    // Decompressed bytes not scanned yet, mostly a partial line
+    guint64 pending_offset; // Object offset of pending->data[0]
+    guint64 bytes_downloaded;
+    guint64 bytes_scanned;
+    guint matches;
+    gboolean object_done;   // Reached max_matches_per_object
+    gboolean unsupported;
+    GError *error;
+} GrepObject;
+
+static gboolean grep_stopped(GrepRun *run) {
+    return g_atomic_int_get(&run->stop) || g_cancellable_is_cancelled(run->cancellable);
+}
+
+static gboolean grep_object_stopped(GrepObject *obj) {
+    return obj->object_done || obj->unsupported || obj->error || grep_stopped(obj->run);
+}
+
+static void grep_report(GrepObject *obj, gsize line_offset, const gchar *line, gsize length) {
+    GrepRun *run = obj->run;
+    g_autofree gchar *shown = g_utf8_make_valid(line, MIN(length, S3_GREP_MAX_REPORTED_LINE));
+    S3GrepMatch match = { obj->key, obj->pending_offset + line_offset, shown };
+    g_mutex_lock(&run->lock);
+    if (!g_atomic_int_get(&run->stop)) {
+        run->stats.matches++;
+        if (run->options->match_callback) run->options->match_callback(&match, run->options->user_data);
+        if (run->options->max_matches && run->stats.matches >= run->options->max_matches) {
+            run->stats.truncated = TRUE;
+            g_atomic_int_set(&run->stop, TRUE);
+        }
+    }
+    g_mutex_unlock(&run->lock);
+    obj->matches++;
+    if (run->options->max_matches_per_object && obj->matches >= run->options->max_matches_per_object) obj->object_done = TRUE;
+}
+
+// Reports each line of `block` holding a match that starts before `limit`.
+static void grep_scan(GrepObject *obj, const gchar *block, gsize length, gsize limit) {
+    gsize from = 0;
+    TextMatch match;
+    while (from < limit && !grep_object_stopped(obj) && text_matcher_find(obj->run->matcher, block, length, from, &match)) {
+        if (match.start >= limit) break;
+        gsize line_start = match.start;
+        while (line_start > 0 && block[line_start - 1] != '\n') line_start--;
+        const gchar *newline = memchr(block + match.start, '\n', length - match.start);
+        gsize line_end = newline ? (gsize)(newline - block) : length;
+        grep_report(obj, line_start, block + line_start, line_end - line_start);
+        from = line_end + 1;
+    }
+}
+
+// Scans the complete lines in `pending` and keeps the partial last line.
+static void grep_scan_pending(GrepObject *obj, gboolean at_end) {
+    GByteArray *pending = obj->pending;
+    gsize consumed;
+    if (at_end) {
+        consumed = pending->len;
+        grep_scan(obj, (const gchar *)pending->data, pending->len, pending->len);
+    } else {
+        gsize last_newline = pending->len;
+        while (last_newline > 0 && pending->data[last_newline - 1] != '\n') last_newline--;
+        if (last_newline > 0) {
+            consumed = last_newline;
+        } else if (pending->len > S3_GREP_MAX_LINE) {
+            consumed = pending->len - S3_GREP_OVERLAP;
+        } else {
+            return;
+        }
+        grep_scan(obj, (const gchar *)pending->data, pending->len, consumed);
+    }
+    obj->bytes_scanned += consumed;
+    obj->pending_offset += consumed;
+    g_byte_array_remove_range(pending, 0, consumed);
+}
+
+static void grep_feed(GrepObject *obj, const guint8 *data, gsize length) {
+    if (length == 0) return;
+    g_byte_array_append(obj->pending, data, length);
+    grep_scan_pending(obj, FALSE);
+}
+
+static void grep_gunzip(GrepObject *obj, const guint8 *data, gsize length) {
+    gsize written = 0;
+    do {
+        gsize read = 0;
+        GConverterResult result = g_converter_convert(obj->gunzip, data, length, obj->decompressed, S3_GREP_DECOMPRESS_BUFFER, G_CONVERTER_NO_FLAGS, &read, &written, &obj->error);
+        if (result == G_CONVERTER_ERROR) {
+            // Everything fed so far is consumed; wait for the next chunk.
+            if (g_error_matches(obj->error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT)) g_clear_error(&obj->error);
+            return;
+        }
+        grep_feed(obj, obj->decompressed, written);
+        data += read;
+        length -= read;
+        // Concatenated gzip members, as written by many log shippers.
+        if (result == G_CONVERTER_FINISHED) g_converter_reset(obj->gunzip);
+    } while ((length > 0 || written == S3_GREP_DECOMPRESS_BUFFER) && !grep_object_stopped(obj));
+}
+
+#ifdef MYS3_HAVE_ZSTD
+static void grep_unzstd(GrepObject *obj, const guint8 *data, gsize length) {
+    ZSTD_inBuffer in = { data, length, 0 };
+    ZSTD_outBuffer out = { obj->decompressed, S3_GREP_DECOMPRESS_BUFFER, 0 };
+    do {
+        out.pos = 0;
+        size_t ret = ZSTD_decompressStream(obj->zstd, &out, &in);
+        if (ZSTD_isError(ret)) {
+            g_set_error(&obj->error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "zstd: %s", ZSTD_getErrorName(ret));
+            return;
+        }
+        grep_feed(obj, obj->decompressed, out.pos);
+    } while ((in.pos < in.size || out.pos == out.size) && !grep_object_stopped(obj));
+}
+#endif
+
+static GrepEncoding sniff_encoding(const guint8 *data, gsize length) {
+    if (length >= 2 && data[0] == 0x1f && data[1] == 0x8b) return GREP_GZIP;
+    if (length >= 4 && data[0] == 0x28 && data[1] == 0xb5 && data[2] == 0x2f && data[3] == 0xfd) return GREP_ZSTD;
+    return GREP_PLAIN;
+}
+
+static gboolean on_grep_chunk(const gchar *data, gsize length, guint64 total_bytes, gpointer user_data) {
+    (void)total_bytes;
+    GrepObject *obj = (GrepObject *)user_data;
+    const guint8 *bytes = (const guint8 *)data;
+    obj->bytes_downloaded += length;
+    if (obj->encoding == GREP_UNKNOWN) {
+        obj->encoding = sniff_encoding(bytes, length);
+        if (obj->encoding == GREP_GZIP) {
+            obj->gunzip = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+        } else if (obj->encoding == GREP_ZSTD) {
+#ifdef MYS3_HAVE_ZSTD
+            obj->zstd = ZSTD_createDStream();
+            ZSTD_initDStream(obj->zstd);
+#else
+            obj->unsupported = TRUE;
+            return FALSE;
+#endif
+        }
+        if (obj->encoding != GREP_PLAIN) obj->decompressed = g_malloc(S3_GREP_DECOMPRESS_BUFFER);
+    }
+    switch (obj->encoding) {
+    case GREP_GZIP: grep_gunzip(obj, bytes, length); break;
+#ifdef MYS3_HAVE_ZSTD
+    case GREP_ZSTD: grep_unzstd(obj, bytes, length); break;
+#endif
+    default: grep_feed(obj, bytes, length); break;
+    }
+    return !grep_object_stopped(obj);
+}
+
+static void grep_object(gpointer data, gpointer user_data) {
+    gchar *key = (gchar *)data;
+    GrepRun *run = (GrepRun *)user_data;
+    if (grep_stopped(run)) {
+        g_free(key);
+        return;
+    }
+    gint64 span = trace_begin();
+    const S3GrepOptions *o = run->options;
+    GrepObject obj = { .run = run, .key = key, .pending = g_byte_array_new() };
+    GError *download_error = NULL;
+    gboolean ok = s3_client_download_object_streaming(o->endpoint, o->access_key, o->secret_key, o->bucket, key, o->use_ssl, on_grep_chunk, &obj, &download_error);
+    if (ok && !obj.error) grep_scan_pending(&obj, TRUE);
+
+    g_mutex_lock(&run->lock);
+    // Downloads interrupted by our own limits are not failures.
+    if (obj.unsupported) run->stats.objects_skipped++;
+    else if (obj.error || (!ok && !obj.object_done && !grep_stopped(run))) run->stats.objects_failed++;
+    else run->stats.objects_scanned++;
+    run->stats.bytes_downloaded += obj.bytes_downloaded;
+    run->stats.bytes_scanned += obj.bytes_scanned;
+    if (o->progress_callback) o->progress_callback(&run->stats, o->user_data);
+    g_mutex_unlock(&run->lock);
+
+    g_clear_error(&download_error);
+    g_clear_error(&obj.error);
+    g_clear_object(&obj.gunzip);
+#ifdef MYS3_HAVE_ZSTD
+    if (obj.zstd) ZSTD_freeDStream(obj.zstd);
+#endif
+    g_free(obj.decompressed);
+    g_byte_array_unref(obj.pending);
+    trace_end_detail(span, "grep", "object", key);
+    g_free(key);
+}
+
+static gboolean on_grep_listing_page(const S3Object *objects, guint n_objects, gpointer user_data) {
+    GrepRun *run = (GrepRun *)user_data;
+    for (guint i = 0; i < n_objects && !grep_stopped(run); i++) {
+        if (objects[i].size == 0 || g_str_has_suffix(objects[i].key, "/")) continue;
+        while (g_thread_pool_unprocessed(run->pool) >= S3_GREP_MAX_QUEUED_KEYS && !grep_stopped(run)) g_usleep(10000);
+        g_mutex_lock(&run->lock);
+        run->stats.objects_listed++;
+        g_mutex_unlock(&run->lock);
+        g_thread_pool_push(run->pool, g_strdup(objects[i].key), NULL);
+    }
+    return !grep_stopped(run);
+}
+
+gboolean s3_grep_run(const S3GrepOptions *options, const TextMatcher *matcher, GCancellable *cancellable, S3GrepStats *stats, GError **error) {
+    gint64 span = trace_begin();
+    GrepRun run = { .options = options, .matcher = matcher, .cancellable = cancellable };
+    g_mutex_init(&run.lock);
+    guint concurrency = options->max_concurrency ? options->max_concurrency : S3_GREP_DEFAULT_CONCURRENCY;
+    run.pool = g_thread_pool_new(grep_object, &run, concurrency, FALSE, NULL);
+
+    GError *list_error = NULL;
+    gboolean listed = s3_client_list_objects_paged(options->endpoint, options->access_key, options->secret_key, options->bucket, options->prefix, options->use_ssl, on_grep_listing_page, &run, &list_error);
+    // Wait for the objects already queued; they return at once after a stop.
+    g_thread_pool_free(run.pool, FALSE, TRUE);
+
+    if (stats) *stats = run.stats;
+    g_mutex_clear(&run.lock);
+    trace_end_detail(span, "grep", "run", options->prefix);
+    if (g_cancellable_set_error_if_cancelled(cancellable, error)) {
+        g_clear_error(&list_error);
+        return FALSE;
+    }
+    if (!listed && !g_atomic_int_get(&run.stop)) {
+        g_propagate_error(error, list_error);
+        return FALSE;
+    }
+    g_clear_error(&list_error);
+    return TRUE;
+}
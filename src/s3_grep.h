@@ -0,0 +1,55 @@
+#ifndef MYS3_S3_GREP_H
+#define MYS3_S3_GREP_H
+
+#include <gio/gio.h>
+#include "text_search.h"
+
+G_BEGIN_DECLS
+
+typedef struct {
+    const gchar *key;
+    guint64 offset;     // Offset of the line in the object, after decompression
+    const gchar *line;  // The matching line without its newline, possibly shortened
+} S3GrepMatch;
+
+typedef struct {
+    guint objects_listed;
+    guint objects_scanned;
+    guint objects_failed;
+    guint objects_skipped;      // Compressed with a format this build cannot read
+    guint64 bytes_downloaded;
+    guint64 bytes_scanned;
+    guint matches;
+    gboolean truncated;         // max_matches stopped the search early
+} S3GrepStats;
+
+// Both callbacks run on worker threads, one at a time.
+typedef void (*S3GrepMatchCallback)(const S3GrepMatch *match, gpointer user_data);
+typedef void (*S3GrepProgressCallback)(const S3GrepStats *stats, gpointer user_data);
+
+typedef struct {
+    const gchar *endpoint;
+    const gchar *access_key;
+    const gchar *secret_key;
+    const gchar *bucket;
+    const gchar *prefix;
+    gboolean use_ssl;
+    guint max_concurrency;          // Objects streamed at once; 0 for the default
+    guint max_matches;              // 0 for no limit
+    guint max_matches_per_object;   // 0 for no limit; 1 lists matching objects
+    S3GrepMatchCallback match_callback;
+    S3GrepProgressCallback progress_callback;  // After each object, may be NULL
+    gpointer user_data;
+} S3GrepOptions;
+
+// Searches every object under options->prefix for `matcher`, which should be
+// built with TEXT_SEARCH_RAW. Objects are streamed while the listing is still
+// arriving and scanned line by line as their chunks come in; gzip bodies, and
+// zstd ones when built with libzstd, are decompressed on the fly. Memory
+// stays bounded by the concurrency whatever the object sizes. Blocks until
+// the search ends; failures of single objects only show in the stats.
+gboolean s3_grep_run(const S3GrepOptions *options, const TextMatcher *matcher, GCancellable *cancellable, S3GrepStats *stats, GError **error);
+
+G_END_DECLS
+
+#endif // MYS3_S3_GREP_H
@@ -0,0 +1,208 @@
+#include "s3_key_arena.h"
+#include <string.h>
+
+// Keys between restart points. Random access decodes at most this many.
+#define RESTART_INTERVAL 16
+
+// Each entry is varint(shared prefix length), varint(suffix length), suffix.
+struct _S3KeyArena {
+    gint ref_count;
+    GByteArray *bytes;
+    GArray *restarts;   // guint32 offset of every RESTART_INTERVAL-th entry
+    guint n_keys;
+    GString *last_key;  // Previous key, to find the shared prefix of the next
+};
+
+static void write_varint(GByteArray *bytes, guint32 value) {
+    while (value >= 0x80) {
+        guint8 byte = (value & 0x7f) | 0x80;
+        g_byte_array_append(bytes, &byte, 1);
+        value >>= 7;
+    }
+    guint8 byte = value;
+    g_byte_array_append(bytes, &byte, 1);
+}
+
+static inline guint32 read_varint(const guint8 **cursor) {
+    guint32 value = 0;
+    guint shift = 0;
+    while (**cursor & 0x80) {
+        value |= (guint32)(**cursor & 0x7f) << shift;
+        shift += 7;
+        (*cursor)++;
+    }
+    value |= (guint32)**cursor << shift;
+    (*cursor)++;
+    return value;
+}
+
+// Applies the entry at `offset` to `key` and returns the offset of the next.
+static gsize decode_entry(const S3KeyArena *arena, gsize offset, GString *key) {
+    const guint8 *cursor = arena->bytes->data + offset;
+    guint32 shared = read_varint(&cursor);
+    guint32 suffix = read_varint(&cursor);
+    g_string_truncate(key, shared);
+    g_string_append_len(key, (const gchar *)cursor, suffix);
+    return (cursor - arena->bytes->data) + suffix;
+}
+
+S3KeyArena *s3_key_arena_new(void) {
+    S3KeyArena *arena = g_new0(S3KeyArena, 1);
+    arena->ref_count = 1;
+    arena->bytes = g_byte_array_new();
+    arena->restarts = g_array_new(FALSE, FALSE, sizeof(guint32));
+    arena->last_key = g_string_new(NULL);
+    return arena;
+}
+
+S3KeyArena *s3_key_arena_copy(const S3KeyArena *arena) {
+    S3KeyArena *copy = s3_key_arena_new();
+    g_byte_array_append(copy->bytes, arena->bytes->data, arena->bytes->len);
+    g_array_append_vals(copy->restarts, arena->restarts->data, arena->restarts->len);
+    copy->n_keys = arena->n_keys;
+    g_string_assign(copy->last_key, arena->last_key->str);
+    return copy;
+}
+
+S3KeyArena *s3_key_arena_copy_prefix(const S3KeyArena *arena, guint n_keys) {
+    g_return_val_if_fail(n_keys <= arena->n_keys, NULL);
+    S3KeyArena *copy = s3_key_arena_new();
+    if (n_keys == 0) return copy;
+    // The offset after the last kept key is where the copied bytes end.
+    guint block = (n_keys - 1) / RESTART_INTERVAL;
+    gsize end = g_array_index(arena->restarts, guint32, block);
+    for (guint i = block * RESTART_INTERVAL; i < n_keys; i++) {
+        end = decode_entry(arena, end, copy->last_key);
+    }
+    g_byte_array_append(copy->bytes, arena->bytes->data, end);
+    g_array_append_vals(copy->restarts, arena->restarts->data, block + 1);
+    copy->n_keys = n_keys;
+    return copy;
+}
+
+S3KeyArena *s3_key_arena_ref(S3KeyArena *arena) {
+    g_atomic_int_inc(&arena->ref_count);
+    return arena;
+}
+
+void s3_key_arena_unref(S3KeyArena *arena) {
+    if (!arena || !g_atomic_int_dec_and_test(&arena->ref_count)) return;
+    g_byte_array_unref(arena->bytes);
+    g_array_unref(arena->restarts);
+    g_string_free(arena->last_key, TRUE);
+    g_free(arena);
+}
+
+gboolean s3_key_arena_append(S3KeyArena *arena, const gchar *key) {
+    gsize len = strlen(key);
+    gsize shared = 0;
+    gboolean restart = arena->n_keys % RESTART_INTERVAL == 0;
+    if (!restart) {
+        while (shared < len && shared < arena->last_key->len && key[shared] == arena->last_key->str[shared]) {
+            shared++;
+        }
+    }
+    // Two varints of at most five bytes each, then the suffix.
+    if (arena->bytes->len + 10 + (len - shared) > G_MAXUINT32) return FALSE;
+
+    if (restart) {
+        guint32 offset = arena->bytes->len;
+        g_array_append_val(arena->restarts, offset);
+    }
+    write_varint(arena->bytes, shared);
+    write_varint(arena->bytes, len - shared);
+    g_byte_array_append(arena->bytes, (const guint8 *)key + shared, len - shared);
+    g_string_truncate(arena->last_key, shared);
+    g_string_append_len(arena->last_key, key + shared, len - shared);
+    arena->n_keys++;
+    return TRUE;
+}
+
+guint s3_key_arena_get_n_keys(const S3KeyArena *arena) {
+    return arena->n_keys;
+}
+
+gsize s3_key_arena_get_size(const S3KeyArena *arena) {
+    return arena->bytes->len + arena->restarts->len * sizeof(guint32);
+}
+
+const gchar *s3_key_arena_get(const S3KeyArena *arena, guint index, GString *buffer) {
+    g_return_val_if_fail(index < arena->n_keys, NULL);
+    guint block = index / RESTART_INTERVAL;
+    gsize offset = g_array_index(arena->restarts, guint32, block);
+    g_string_truncate(buffer, 0);
+    for (guint i = block * RESTART_INTERVAL; i <= index; i++) {
+        offset = decode_entry(arena, offset, buffer);
+    }
+    return buffer->str;
+}
+
+// Compares the whole key stored at a restart point with `key`.
+static gint compare_restart(const S3KeyArena *arena, guint block, const gchar *key, gsize key_len) {
+    const guint8 *cursor = arena->bytes->data + g_array_index(arena->restarts, guint32, block);
+    read_varint(&cursor);   // Shared prefix, always 0 here
+    guint32 len = read_varint(&cursor);
+    gint cmp = memcmp(cursor, key, MIN(len, key_len));
+    return cmp ? cmp : (len > key_len) - (len < key_len);
+}
+
+gboolean s3_key_arena_find(const S3KeyArena *arena, const gchar *key, GString *buffer, guint *index) {
+    gsize key_len = strlen(key);
+    // Count the blocks whose first key is not after `key`.
+    guint lo = 0, hi = arena->restarts->len;
+    while (lo < hi) {
+        guint mid = lo + (hi - lo) / 2;
+        if (compare_restart(arena, mid, key, key_len) <= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) {
+        *index = 0;
+        return FALSE;
+    }
+
+    guint block = lo - 1;
+    guint end = MIN((block + 1) * RESTART_INTERVAL, arena->n_keys);
+    gsize offset = g_array_index(arena->restarts, guint32, block);
+    g_string_truncate(buffer, 0);
+    for (guint i = block * RESTART_INTERVAL; i < end; i++) {
+        offset = decode_entry(arena, offset, buffer);
+        gint cmp = strcmp(buffer->str, key);
+        if (cmp >= 0) {
+            *index = i;
+            return cmp == 0;
+        }
+    }
+    *index = end;
+    return FALSE;
+}
+
+void s3_key_arena_iter_init(S3KeyArenaIter *iter, const S3KeyArena *arena, guint first) {
+    iter->arena = arena;
+    iter->key = g_string_new(NULL);
+    if (first >= arena->n_keys) {
+        iter->next = arena->n_keys;
+        iter->offset = arena->bytes->len;
+        return;
+    }
+    guint block = first / RESTART_INTERVAL;
+    iter->next = block * RESTART_INTERVAL;
+    iter->offset = g_array_index(arena->restarts, guint32, block);
+    while (iter->next < first) {
+        iter->offset = decode_entry(arena, iter->offset, iter->key);
+        iter->next++;
+    }
+}
+
+const gchar *s3_key_arena_iter_next(S3KeyArenaIter *iter) {
+    if (iter->next >= iter->arena->n_keys) return NULL;
+    iter->offset = decode_entry(iter->arena, iter->offset, iter->key);
+    iter->next++;
+    return iter->key->str;
+}
+
+void s3_key_arena_iter_clear(S3KeyArenaIter *iter) {
+    if (iter->key) {
+        g_string_free(iter->key, TRUE);
+        iter->key = NULL;
+    }
+}
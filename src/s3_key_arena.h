@@ -0,0 +1,53 @@
+#ifndef MYS3_S3_KEY_ARENA_H
+#define MYS3_S3_KEY_ARENA_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Append-only, front-coded store for keys that arrive in listing order. Each
+// key keeps only the bytes that differ from the key before it; every 16th key
+// is stored whole as a restart point for random access. Keys sharing long
+// prefixes (logs/2026/10/16/host-123/...) shrink to their last few bytes.
+// An arena that is no longer appended to may be read from any thread.
+typedef struct _S3KeyArena S3KeyArena;
+
+S3KeyArena *s3_key_arena_new(void);
+S3KeyArena *s3_key_arena_copy(const S3KeyArena *arena);
+// Copies the first `n_keys` keys. Their encoded bytes are copied as they are;
+// only the last key is decoded, to continue front-coding from it.
+S3KeyArena *s3_key_arena_copy_prefix(const S3KeyArena *arena, guint n_keys);
+S3KeyArena *s3_key_arena_ref(S3KeyArena *arena);
+void s3_key_arena_unref(S3KeyArena *arena);
+
+// Returns FALSE, leaving the arena unchanged, once it reaches 4 GiB.
+gboolean s3_key_arena_append(S3KeyArena *arena, const gchar *key);
+guint s3_key_arena_get_n_keys(const S3KeyArena *arena);
+// Bytes used by the encoded keys and restart table.
+gsize s3_key_arena_get_size(const S3KeyArena *arena);
+
+// Decodes key `index` into `buffer` and returns buffer->str.
+const gchar *s3_key_arena_get(const S3KeyArena *arena, guint index, GString *buffer);
+// Binary search in an arena whose keys were appended in strcmp() order, as
+// listings return them. Sets `index` to the key's index, or to where it would
+// be inserted when it is missing. Decodes at most one block into `buffer`.
+gboolean s3_key_arena_find(const S3KeyArena *arena, const gchar *key, GString *buffer, guint *index);
+
+// Sequential decoding, which costs one copy of the differing bytes per key.
+typedef struct {
+    const S3KeyArena *arena;
+    guint next;
+    gsize offset;
+    GString *key;
+} S3KeyArenaIter;
+
+void s3_key_arena_iter_init(S3KeyArenaIter *iter, const S3KeyArena *arena, guint first);
+// Returns the next key, valid until the following call, or NULL at the end.
+const gchar *s3_key_arena_iter_next(S3KeyArenaIter *iter);
+void s3_key_arena_iter_clear(S3KeyArenaIter *iter);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(S3KeyArena, s3_key_arena_unref)
+
+G_END_DECLS
+
+#endif // MYS3_S3_KEY_ARENA_H
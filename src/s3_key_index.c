@@ -0,0 +1,394 @@
+#include "s3_key_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Key ids containing one trigram, ascending. Each id is stored as the
+// varint-encoded gap from the previous one, which is a byte for most ids
+// since keys sharing a trigram tend to be listed close together.
+typedef struct {
+    GByteArray *deltas;
+    guint32 last_id;
+    guint32 count;
+} Posting;
+
+struct _S3KeyIndex {
+    gint ref_count;
+    GRWLock lock;
+    GByteArray *arena;      // NUL-terminated keys, back to back
+    GArray *offsets;        // guint32 offset of each key in the arena
+    GHashTable *postings;   // Trigram of ASCII-folded bytes -> Posting
+    gboolean sorted;        // Keys arrived in strcmp() order, as listings return them
+};
+
+static void posting_free(gpointer data) {
+    Posting *posting = data;
+    g_byte_array_unref(posting->deltas);
+    g_free(posting);
+}
+
+static inline guchar fold(guchar c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// Keys never contain NUL, so a trigram is never 0 and can be a hash key as is.
+static inline guint32 trigram_at(const gchar *p) {
+    return ((guint32)fold(p[0]) << 16) | ((guint32)fold(p[1]) << 8) | fold(p[2]);
+}
+
+static inline const gchar *key_at(S3KeyIndex *index, guint32 id) {
+    return (const gchar *)index->arena->data + g_array_index(index->offsets, guint32, id);
+}
+
+static void posting_append(Posting *posting, guint32 id) {
+    // A key repeating a trigram only needs to be listed once.
+    if (posting->count && posting->last_id == id) return;
+    guint32 delta = id - posting->last_id;
+    while (delta >= 0x80) {
+        guint8 byte = (delta & 0x7f) | 0x80;
+        g_byte_array_append(posting->deltas, &byte, 1);
+        delta >>= 7;
+    }
+    guint8 byte = delta;
+    g_byte_array_append(posting->deltas, &byte, 1);
+    posting->last_id = id;
+    posting->count++;
+}
+
+static inline guint32 read_varint(const guint8 **cursor) {
+    guint32 value = 0;
+    guint shift = 0;
+    while (**cursor & 0x80) {
+        value |= (guint32)(**cursor & 0x7f) << shift;
+        shift += 7;
+        (*cursor)++;
+    }
+    value |= (guint32)**cursor << shift;
+    (*cursor)++;
+    return value;
+}
+
+S3KeyIndex *s3_key_index_new(void) {
+    S3KeyIndex *index = g_new0(S3KeyIndex, 1);
+    index->ref_count = 1;
+    g_rw_lock_init(&index->lock);
+    index->arena = g_byte_array_new();
+    index->offsets = g_array_new(FALSE, FALSE, sizeof(guint32));
+    index->postings = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, posting_free);
+    index->sorted = TRUE;
+    return index;
+}
+
+S3KeyIndex *s3_key_index_ref(S3KeyIndex *index) {
+    g_atomic_int_inc(&index->ref_count);
+    return index;
+}
+
+void s3_key_index_unref(S3KeyIndex *index) {
+    if (!index || !g_atomic_int_dec_and_test(&index->ref_count)) return;
+    g_hash_table_destroy(index->postings);
+    g_array_unref(index->offsets);
+    g_byte_array_unref(index->arena);
+    g_rw_lock_clear(&index->lock);
+    g_free(index);
+}
+
+void s3_key_index_add(S3KeyIndex *index, const S3Object *objects, guint n_objects) {
+    g_rw_lock_writer_lock(&index->lock);
+    for (guint i = 0; i < n_objects; i++) {
+        const gchar *key = objects[i].key;
+        gsize len = strlen(key);
+        if (index->arena->len + len + 1 > G_MAXUINT32) {
+            g_warning("Key index is full, %u keys indexed", index->offsets->len);
+            break;
+        }
+
+        guint32 id = index->offsets->len;
+        if (index->sorted && id > 0 && strcmp(key_at(index, id - 1), key) > 0) {
+            index->sorted = FALSE;
+        }
+        guint32 offset = index->arena->len;
+        g_byte_array_append(index->arena, (const guint8 *)key, len + 1);
+        g_array_append_val(index->offsets, offset);
+
+        for (gsize j = 0; j + 3 <= len; j++) {
+            gpointer trigram = GUINT_TO_POINTER(trigram_at(key + j));
+            Posting *posting = g_hash_table_lookup(index->postings, trigram);
+            if (!posting) {
+                posting = g_new0(Posting, 1);
+                posting->deltas = g_byte_array_new();
+                g_hash_table_insert(index->postings, trigram, posting);
+            }
+            posting_append(posting, id);
+        }
+    }
+    g_rw_lock_writer_unlock(&index->lock);
+}
+
+gboolean s3_key_index_add_page(const S3Object *objects, guint n_objects, gpointer user_data) {
+    s3_key_index_add((S3KeyIndex *)user_data, objects, n_objects);
+    return TRUE;
+}
+
+guint s3_key_index_get_n_keys(S3KeyIndex *index) {
+    g_rw_lock_reader_lock(&index->lock);
+    guint n = index->offsets->len;
+    g_rw_lock_reader_unlock(&index->lock);
+    return n;
+}
+
+// #############################################################################
+// # Queries
+// #############################################################################
+
+static gint compare_posting_count(gconstpointer a, gconstpointer b) {
+    const Posting *pa = *(Posting * const *)a;
+    const Posting *pb = *(Posting * const *)b;
+    return (pa->count > pb->count) - (pa->count < pb->count);
+}
+
+// Drops the candidates that are not in `posting`, walking both in order.
+static void intersect_posting(GArray *candidates, const Posting *posting) {
+    const guint8 *cursor = posting->deltas->data;
+    const guint8 *end = cursor + posting->deltas->len;
+    guint32 current = 0;
+    gboolean valid = FALSE;
+    guint kept = 0;
+    for (guint i = 0; i < candidates->len; i++) {
+        guint32 want = g_array_index(candidates, guint32, i);
+        while ((!valid || current < want) && cursor < end) {
+            current += read_varint(&cursor);
+            valid = TRUE;
+        }
+        if (valid && current == want) {
+            g_array_index(candidates, guint32, kept++) = want;
+        } else if (cursor >= end && (!valid || current < want)) {
+            break;
+        }
+    }
+    g_array_set_size(candidates, kept);
+}
+
+// Returns the keys containing every trigram of the literal parts of `needle`,
+// or NULL when the needle has no literal run long enough to narrow the search.
+static GArray *key_index_candidates(S3KeyIndex *index, const gchar *needle, gboolean glob) {
+    g_autoptr(GPtrArray) postings = g_ptr_array_new();
+    const gchar *run = needle;
+    while (*run) {
+        gsize run_len = glob ? strcspn(run, "*?") : strlen(run);
+        for (gsize j = 0; j + 3 <= run_len; j++) {
+            Posting *posting = g_hash_table_lookup(index->postings, GUINT_TO_POINTER(trigram_at(run + j)));
+            if (!posting) return g_array_new(FALSE, FALSE, sizeof(guint32));
+            g_ptr_array_add(postings, posting);
+        }
+        run += run_len;
+        if (*run) run++;
+    }
+    if (postings->len == 0) return NULL;
+
+    // Start from the rarest trigram so every later pass is as short as possible.
+    g_ptr_array_sort(postings, compare_posting_count);
+    const Posting *rarest = g_ptr_array_index(postings, 0);
+    GArray *candidates = g_array_sized_new(FALSE, FALSE, sizeof(guint32), rarest->count);
+    const guint8 *cursor = rarest->deltas->data;
+    const guint8 *end = cursor + rarest->deltas->len;
+    guint32 current = 0;
+    while (cursor < end) {
+        current += read_varint(&cursor);
+        g_array_append_val(candidates, current);
+    }
+    for (guint i = 1; i < postings->len && candidates->len > 0; i++) {
+        intersect_posting(candidates, g_ptr_array_index(postings, i));
+    }
+    return candidates;
+}
+
+static const gchar *find_nocase(const gchar *haystack, const gchar *needle, gsize needle_len) {
+    for (const gchar *p = haystack; *p; p++) {
+        if (fold(*p) == (guchar)needle[0] && g_ascii_strncasecmp(p, needle, needle_len) == 0) return p;
+    }
+    return NULL;
+}
+
+// `pattern` is lower case; '*' matches any run of bytes, '/' included.
+static gboolean glob_match(const gchar *pattern, const gchar *text) {
+    const gchar *star = NULL;
+    const gchar *resume = NULL;
+    while (*text) {
+        if (*pattern == '?' || (*pattern && *pattern != '*' && (guchar)*pattern == fold(*text))) {
+            pattern++;
+            text++;
+        } else if (*pattern == '*') {
+            star = pattern++;
+            resume = text;
+        } else if (star) {
+            pattern = star + 1;
+            text = ++resume;
+        } else {
+            return FALSE;
+        }
+    }
+    while (*pattern == '*') pattern++;
+    return *pattern == '\0';
+}
+
+typedef struct {
+    guint score;
+    guint length;
+    guint32 id;
+} RankedKey;
+
+static gboolean ranked_better(const RankedKey *a, const RankedKey *b) {
+    if (a->score != b->score) return a->score > b->score;
+    if (a->length != b->length) return a->length < b->length;
+    return a->id < b->id;
+}
+
+static gint compare_ranked(const void *a, const void *b) {
+    return ranked_better(a, b) ? -1 : ranked_better(b, a) ? 1 : 0;
+}
+
+// Keeps the best `limit` keys in a heap whose root is the worst of them.
+static void heap_offer(RankedKey *heap, guint *heap_len, guint limit, const RankedKey *key) {
+    guint i;
+    if (*heap_len < limit) {
+        i = (*heap_len)++;
+        heap[i] = *key;
+        while (i > 0) {
+            guint parent = (i - 1) / 2;
+            if (!ranked_better(&heap[parent], &heap[i])) break;
+            RankedKey tmp = heap[parent]; heap[parent] = heap[i]; heap[i] = tmp;
+            i = parent;
+        }
+        return;
+    }
+    if (!ranked_better(key, &heap[0])) return;
+    heap[0] = *key;
+    i = 0;
+    while (TRUE) {
+        guint worst = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < *heap_len && ranked_better(&heap[worst], &heap[left])) worst = left;
+        if (right < *heap_len && ranked_better(&heap[worst], &heap[right])) worst = right;
+        if (worst == i) break;
+        RankedKey tmp = heap[worst]; heap[worst] = heap[i]; heap[i] = tmp;
+        i = worst;
+    }
+}
+
+static guint substring_score(const gchar *key, const gchar *needle, gsize needle_len) {
+    const gchar *slash = strrchr(key, '/');
+    const gchar *base = slash ? slash + 1 : key;
+    if (g_ascii_strcasecmp(base, needle) == 0) return 3;
+    if (g_ascii_strncasecmp(base, needle, needle_len) == 0) return 2;
+    if (find_nocase(base, needle, needle_len)) return 1;
+    return 0;
+}
+
+gchar **s3_key_index_search(S3KeyIndex *index, const gchar *query, guint limit) {
+    GPtrArray *result = g_ptr_array_new();
+    if (query && *query && limit > 0) {
+        g_autofree gchar *needle = g_ascii_strdown(query, -1);
+        gsize needle_len = strlen(needle);
+        gboolean glob = strpbrk(needle, "*?") != NULL;
+        RankedKey *heap = g_new(RankedKey, limit);
+        guint heap_len = 0;
+
+        g_rw_lock_reader_lock(&index->lock);
+        GArray *candidates = key_index_candidates(index, needle, glob);
+        guint n = candidates ? candidates->len : index->offsets->len;
+        for (guint i = 0; i < n; i++) {
+            guint32 id = candidates ? g_array_index(candidates, guint32, i) : i;
+            const gchar *key = key_at(index, id);
+            RankedKey ranked = { 0, 0, id };
+            if (glob) {
+                if (!glob_match(needle, key)) continue;
+            } else {
+                if (!find_nocase(key, needle, needle_len)) continue;
+                ranked.score = substring_score(key, needle, needle_len);
+            }
+            ranked.length = strlen(key);
+            heap_offer(heap, &heap_len, limit, &ranked);
+        }
+        qsort(heap, heap_len, sizeof(RankedKey), compare_ranked);
+        for (guint i = 0; i < heap_len; i++) {
+            g_ptr_array_add(result, g_strdup(key_at(index, heap[i].id)));
+        }
+        g_rw_lock_reader_unlock(&index->lock);
+
+        if (candidates) g_array_unref(candidates);
+        g_free(heap);
+    }
+    g_ptr_array_add(result, NULL);
+    return (gchar **)g_ptr_array_free(result, FALSE);
+}
+
+static guint lower_bound(S3KeyIndex *index, const gchar *key) {
+    guint lo = 0, hi = index->offsets->len;
+    while (lo < hi) {
+        guint mid = lo + (hi - lo) / 2;
+        if (strcmp(key_at(index, mid), key) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// The path component of `key` after the first `prefix_len` bytes, including
+// its trailing '/' for folders, or NULL if nothing follows the prefix.
+static gchar *child_of(const gchar *key, gsize prefix_len) {
+    if (key[prefix_len] == '\0') return NULL;
+    const gchar *slash = strchr(key + prefix_len, '/');
+    return slash ? g_strndup(key, slash - key + 1) : g_strdup(key);
+}
+
+static gint compare_strings(gconstpointer a, gconstpointer b) {
+    return strcmp(*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+gchar **s3_key_index_complete(S3KeyIndex *index, const gchar *prefix, guint limit) {
+    GPtrArray *result = g_ptr_array_new();
+    gsize prefix_len = strlen(prefix);
+
+    g_rw_lock_reader_lock(&index->lock);
+    guint n = index->offsets->len;
+    if (index->sorted) {
+        guint i = lower_bound(index, prefix);
+        while (i < n && result->len < limit) {
+            const gchar *key = key_at(index, i);
+            if (strncmp(key, prefix, prefix_len) != 0) break;
+            gchar *child = child_of(key, prefix_len);
+            if (!child) {
+                i++;
+                continue;
+            }
+            g_ptr_array_add(result, child);
+            gsize child_len = strlen(child);
+            if (child[child_len - 1] != '/') {
+                i++;
+                continue;
+            }
+            // Everything under "child/" sorts before "child0", so one binary
+            // search skips the whole folder.
+            g_autofree gchar *next = g_strdup(child);
+            next[child_len - 1] = '/' + 1;
+            i = lower_bound(index, next);
+        }
+    } else {
+        g_autoptr(GHashTable) seen = g_hash_table_new(g_str_hash, g_str_equal);
+        for (guint i = 0; i < n && result->len < limit; i++) {
+            const gchar *key = key_at(index, i);
+            if (strncmp(key, prefix, prefix_len) != 0) continue;
+            gchar *child = child_of(key, prefix_len);
+            if (!child) continue;
+            if (g_hash_table_contains(seen, child)) {
+                g_free(child);
+                continue;
+            }
+            g_hash_table_add(seen, child);
+            g_ptr_array_add(result, child);
+        }
+        g_ptr_array_sort(result, compare_strings);
+    }
+    g_rw_lock_reader_unlock(&index->lock);
+
+    g_ptr_array_add(result, NULL);
+    return (gchar **)g_ptr_array_free(result, FALSE);
+}
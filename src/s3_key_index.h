@@ -0,0 +1,38 @@
+#ifndef MYS3_S3_KEY_INDEX_H
+#define MYS3_S3_KEY_INDEX_H
+
+#include <glib.h>
+#include "s3_client.h"
+
+G_BEGIN_DECLS
+
+// In-memory search index over object keys. Keys are added page by page while
+// a listing streams in and can be queried from any thread at the same time.
+// Matching ignores ASCII case.
+typedef struct _S3KeyIndex S3KeyIndex;
+
+S3KeyIndex *s3_key_index_new(void);
+S3KeyIndex *s3_key_index_ref(S3KeyIndex *index);
+void s3_key_index_unref(S3KeyIndex *index);
+
+void s3_key_index_add(S3KeyIndex *index, const S3Object *objects, guint n_objects);
+// S3ListPageCallback that adds each page to the S3KeyIndex in user_data.
+gboolean s3_key_index_add_page(const S3Object *objects, guint n_objects, gpointer user_data);
+guint s3_key_index_get_n_keys(S3KeyIndex *index);
+
+// Returns at most `limit` keys matching `query`, best first, as a
+// NULL-terminated array. A query containing '*' or '?' is a glob matched
+// against the whole key; anything else is a substring. Matches in the last
+// path component rank above matches in the directories, shorter keys above
+// longer ones.
+gchar **s3_key_index_search(S3KeyIndex *index, const gchar *query, guint limit);
+
+// Returns the distinct path components that follow `prefix`, as full paths
+// ending in '/' for folders, in key order.
+gchar **s3_key_index_complete(S3KeyIndex *index, const gchar *prefix, guint limit);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(S3KeyIndex, s3_key_index_unref)
+
+G_END_DECLS
+
+#endif // MYS3_S3_KEY_INDEX_H
@@ -0,0 +1,227 @@
+#include "s3_metrics.h"
+#include <stdatomic.h>
+#include <string.h>
+
+// Log-linear (HDR style) latency histogram in microseconds: values below 16
+// get their own bucket, above that every power of two is split into 16
+// sub-buckets, which keeps the relative error around 6% up to ~9 days.
+#define SUB_BUCKET_BITS 4
+#define SUB_BUCKETS (1 << SUB_BUCKET_BITS)
+#define MAX_EXPONENT 39
+#define HISTOGRAM_BUCKETS ((MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS)
+
+typedef struct {
+    atomic_uint_fast64_t buckets[HISTOGRAM_BUCKETS];
+    atomic_uint_fast64_t ok;
+    atomic_uint_fast64_t errors;
+    atomic_uint_fast64_t duration_sum_us;
+    atomic_uint_fast64_t bytes_in;
+    atomic_uint_fast64_t bytes_out;
+} OperationMetrics;
+
+static OperationMetrics operations[S3_OP_COUNT];
+static atomic_uint_fast64_t retries;
+static atomic_uint_fast64_t connections_new;
+static atomic_uint_fast64_t connections_reused;
+static atomic_uint_fast64_t cache_hits;
+static atomic_uint_fast64_t cache_misses;
+
+static const gchar *operation_names[S3_OP_COUNT] = {
+    "test_connection",
+    "list_buckets",
+    "list_objects",
+    "put_object",
+    "get_object",
+    "head_object",
+    "copy_object",
+    "delete_object",
+    "select_object_content",
+    "upload_part",
+    "multipart_upload",
+};
+
+const gchar *s3_metrics_operation_name(S3Operation op) {
+    return op < S3_OP_COUNT ? operation_names[op] : "unknown";
+}
+
+static guint bucket_index(guint64 value) {
+    if (value < SUB_BUCKETS) {
+        return (guint)value;
+    }
+    guint exponent = 63 - __builtin_clzll(value);
+    if (exponent > MAX_EXPONENT) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+    guint sub = (guint)(value >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+// Largest value that falls into the bucket.
+static guint64 bucket_upper_bound(guint index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    guint exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    guint64 sub = index % SUB_BUCKETS;
+    return ((SUB_BUCKETS + sub + 1) << (exponent - SUB_BUCKET_BITS)) - 1;
+}
+
+void s3_metrics_record(S3Operation op, gint64 duration_us, guint64 bytes_in, guint64 bytes_out, gboolean ok) {
+    if (op >= S3_OP_COUNT) return;
+    OperationMetrics *m = &operations[op];
+    guint64 duration = duration_us > 0 ? (guint64)duration_us : 0;
+
+    atomic_fetch_add_explicit(&m->buckets[bucket_index(duration)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(ok ? &m->ok : &m->errors, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&m->duration_sum_us, duration, memory_order_relaxed);
+    if (bytes_in) atomic_fetch_add_explicit(&m->bytes_in, bytes_in, memory_order_relaxed);
+    if (bytes_out) atomic_fetch_add_explicit(&m->bytes_out, bytes_out, memory_order_relaxed);
+}
+
+void s3_metrics_record_retry(void) {
+    atomic_fetch_add_explicit(&retries, 1, memory_order_relaxed);
+}
+
+void s3_metrics_record_connection(gboolean reused) {
+    atomic_fetch_add_explicit(reused ? &connections_reused : &connections_new, 1, memory_order_relaxed);
+}
+
+void s3_metrics_record_cache(gboolean hit) {
+    atomic_fetch_add_explicit(hit ? &cache_hits : &cache_misses, 1, memory_order_relaxed);
+}
+
+static guint64 load(atomic_uint_fast64_t *counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+// Copies the histogram so a percentile is computed over one consistent view.
+static guint64 snapshot_histogram(S3Operation op, guint64 *buckets) {
+    guint64 total = 0;
+    for (guint i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        buckets[i] = load(&operations[op].buckets[i]);
+        total += buckets[i];
+    }
+    return total;
+}
+
+static guint64 percentile_from(const guint64 *buckets, guint64 total, gdouble percentile) {
+    if (total == 0) return 0;
+    guint64 rank = (guint64)(percentile / 100.0 * total + 0.5);
+    if (rank == 0) rank = 1;
+    guint64 seen = 0;
+    for (guint i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return bucket_upper_bound(i);
+        }
+    }
+    return bucket_upper_bound(HISTOGRAM_BUCKETS - 1);
+}
+
+guint64 s3_metrics_latency_percentile(S3Operation op, gdouble percentile) {
+    if (op >= S3_OP_COUNT) return 0;
+    guint64 buckets[HISTOGRAM_BUCKETS];
+    guint64 total = snapshot_histogram(op, buckets);
+    return percentile_from(buckets, total, percentile);
+}
+
+static gdouble ratio(guint64 part, guint64 whole) {
+    return whole ? (gdouble)part / whole : 0.0;
+}
+
+gchar *s3_metrics_format_text(void) {
+    GString *text = g_string_new(NULL);
+    // The op column fits the longest name, e.g. select_object_content.
+    gint width = (gint)strlen("operation");
+    for (guint op = 0; op < S3_OP_COUNT; op++) width = MAX(width, (gint)strlen(operation_names[op]));
+    g_string_append_printf(text, "%-*s %8s %6s %9s %9s %9s %11s %11s\n",
+                           width, "operation", "count", "errors", "p50 ms", "p95 ms", "p99 ms", "bytes in", "bytes out");
+    for (guint op = 0; op < S3_OP_COUNT; op++) {
+        guint64 buckets[HISTOGRAM_BUCKETS];
+        guint64 total = snapshot_histogram(op, buckets);
+        if (total == 0) continue;
+        g_autofree gchar *in = g_format_size(load(&operations[op].bytes_in));
+        g_autofree gchar *out = g_format_size(load(&operations[op].bytes_out));
+        g_string_append_printf(text, "%-*s %8" G_GUINT64_FORMAT " %6" G_GUINT64_FORMAT " %9.1f %9.1f %9.1f %11s %11s\n",
+                               width, operation_names[op], total, load(&operations[op].errors),
+                               percentile_from(buckets, total, 50) / 1000.0,
+                               percentile_from(buckets, total, 95) / 1000.0,
+                               percentile_from(buckets, total, 99) / 1000.0,
+                               in, out);
+    }
+
+    guint64 reused = load(&connections_reused), fresh = load(&connections_new);
+    guint64 hits = load(&cache_hits), misses = load(&cache_misses);
+    g_string_append_printf(text, "\nretries: %" G_GUINT64_FORMAT "\n", load(&retries));
+    g_string_append_printf(text, "connections: %" G_GUINT64_FORMAT " new, %" G_GUINT64_FORMAT " reused (%.1f%% reuse)\n",
+                           fresh, reused, 100.0 * ratio(reused, reused + fresh));
+    g_string_append_printf(text, "cache: %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses (%.1f%% hit ratio)\n",
+                           hits, misses, 100.0 * ratio(hits, hits + misses));
+    return g_string_free(text, FALSE);
+}
+
+gchar *s3_metrics_format_prometheus(void) {
+    static const gdouble le_seconds[] = { 0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60 };
+    GString *text = g_string_new(NULL);
+
+    g_string_append(text, "# HELP mys3_request_duration_seconds Latency of S3 operations.\n"
+                          "# TYPE mys3_request_duration_seconds histogram\n");
+    for (guint op = 0; op < S3_OP_COUNT; op++) {
+        guint64 buckets[HISTOGRAM_BUCKETS];
+        guint64 total = snapshot_histogram(op, buckets);
+        guint64 cumulative = 0;
+        guint index = 0;
+        for (guint i = 0; i < G_N_ELEMENTS(le_seconds); i++) {
+            guint64 limit_us = (guint64)(le_seconds[i] * G_USEC_PER_SEC);
+            while (index < HISTOGRAM_BUCKETS && bucket_upper_bound(index) <= limit_us) {
+                cumulative += buckets[index++];
+            }
+            g_string_append_printf(text, "mys3_request_duration_seconds_bucket{op=\"%s\",le=\"%g\"} %" G_GUINT64_FORMAT "\n",
+                                   operation_names[op], le_seconds[i], cumulative);
+        }
+        g_string_append_printf(text, "mys3_request_duration_seconds_bucket{op=\"%s\",le=\"+Inf\"} %" G_GUINT64_FORMAT "\n",
+                               operation_names[op], total);
+        g_string_append_printf(text, "mys3_request_duration_seconds_sum{op=\"%s\"} %.6f\n",
+                               operation_names[op], load(&operations[op].duration_sum_us) / 1e6);
+        g_string_append_printf(text, "mys3_request_duration_seconds_count{op=\"%s\"} %" G_GUINT64_FORMAT "\n",
+                               operation_names[op], total);
+    }
+
+    g_string_append(text, "# HELP mys3_requests_total S3 operations by result.\n# TYPE mys3_requests_total counter\n");
+    for (guint op = 0; op < S3_OP_COUNT; op++) {
+        g_string_append_printf(text, "mys3_requests_total{op=\"%s\",result=\"ok\"} %" G_GUINT64_FORMAT "\n",
+                               operation_names[op], load(&operations[op].ok));
+        g_string_append_printf(text, "mys3_requests_total{op=\"%s\",result=\"error\"} %" G_GUINT64_FORMAT "\n",
+                               operation_names[op], load(&operations[op].errors));
+    }
+
+    g_string_append(text, "# HELP mys3_bytes_received_total Payload bytes received.\n# TYPE mys3_bytes_received_total counter\n");
+    for (guint op = 0; op < S3_OP_COUNT; op++) {
+        g_string_append_printf(text, "mys3_bytes_received_total{op=\"%s\"} %" G_GUINT64_FORMAT "\n",
+                               operation_names[op], load(&operations[op].bytes_in));
+    }
+    g_string_append(text, "# HELP mys3_bytes_sent_total Payload bytes sent.\n# TYPE mys3_bytes_sent_total counter\n");
+    for (guint op = 0; op < S3_OP_COUNT; op++) {
+        g_string_append_printf(text, "mys3_bytes_sent_total{op=\"%s\"} %" G_GUINT64_FORMAT "\n",
+                               operation_names[op], load(&operations[op].bytes_out));
+    }
+
+    g_string_append_printf(text, "# HELP mys3_retries_total Requests retried by the SDK.\n# TYPE mys3_retries_total counter\n"
+                                 "mys3_retries_total %" G_GUINT64_FORMAT "\n", load(&retries));
+    g_string_append_printf(text, "# HELP mys3_connections_total HTTP requests by connection reuse.\n# TYPE mys3_connections_total counter\n"
+                                 "mys3_connections_total{reused=\"true\"} %" G_GUINT64_FORMAT "\n"
+                                 "mys3_connections_total{reused=\"false\"} %" G_GUINT64_FORMAT "\n",
+                           load(&connections_reused), load(&connections_new));
+    g_string_append_printf(text, "# HELP mys3_cache_lookups_total Client side cache lookups.\n# TYPE mys3_cache_lookups_total counter\n"
+                                 "mys3_cache_lookups_total{result=\"hit\"} %" G_GUINT64_FORMAT "\n"
+                                 "mys3_cache_lookups_total{result=\"miss\"} %" G_GUINT64_FORMAT "\n",
+                           load(&cache_hits), load(&cache_misses));
+    return g_string_free(text, FALSE);
+}
+
+gboolean s3_metrics_write_prometheus(const gchar *path, GError **error) {
+    g_autofree gchar *text = s3_metrics_format_prometheus();
+    // g_file_set_contents writes a temporary file and renames it, so the
+    // textfile collector never sees a partial file.
+    return g_file_set_contents(path, text, -1, error);
+}
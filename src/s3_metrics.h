@@ -0,0 +1,46 @@
+#ifndef MYS3_S3_METRICS_H
+#define MYS3_S3_METRICS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Operations tracked by the metrics layer.
+typedef enum {
+    S3_OP_TEST_CONNECTION,
+    S3_OP_LIST_BUCKETS,
+    S3_OP_LIST_OBJECTS,
+    S3_OP_PUT_OBJECT,
+    S3_OP_GET_OBJECT,
+    S3_OP_HEAD_OBJECT,
+    S3_OP_COPY_OBJECT,
+    S3_OP_DELETE_OBJECT,
+    S3_OP_SELECT_OBJECT_CONTENT,
+    S3_OP_UPLOAD_PART,
+    S3_OP_MULTIPART_UPLOAD,     // Create, complete and abort
+    S3_OP_COUNT
+} S3Operation;
+
+// Recording functions only use relaxed atomic increments, so they are safe
+// to call from any thread on the transfer hot path.
+void s3_metrics_record(S3Operation op, gint64 duration_us, guint64 bytes_in, guint64 bytes_out, gboolean ok);
+void s3_metrics_record_retry(void);
+void s3_metrics_record_connection(gboolean reused);
+void s3_metrics_record_cache(gboolean hit);
+
+const gchar *s3_metrics_operation_name(S3Operation op);
+
+// Latency percentile (0..100) in microseconds, from the operation histogram.
+guint64 s3_metrics_latency_percentile(S3Operation op, gdouble percentile);
+
+// Human readable summary for the diagnostics panel.
+gchar *s3_metrics_format_text(void);
+
+// Prometheus text exposition format, and an atomic write of it to a file
+// for the node exporter textfile collector.
+gchar *s3_metrics_format_prometheus(void);
+gboolean s3_metrics_write_prometheus(const gchar *path, GError **error);
+
+G_END_DECLS
+
+#endif // MYS3_S3_METRICS_H
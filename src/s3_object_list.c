@@ -0,0 +1,1390 @@
+#include "s3_object_list.h"
+#include "s3_key_arena.h"
+#include <string.h>
+
+// #############################################################################
+// # S3ObjectItem
+// #############################################################################
+
+struct _S3ObjectItem {
+    GObject parent_instance;
+    S3Object object;
+    S3ObjectMetadata *metadata;
+    guint row;          // Row in the list's storage, G_MAXUINT once the item no longer stands for one
+};
+
+enum { ITEM_PROP_0, ITEM_PROP_METADATA, N_ITEM_PROPS };
+static GParamSpec *item_props[N_ITEM_PROPS];
+
+G_DEFINE_TYPE(S3ObjectItem, s3_object_item, G_TYPE_OBJECT)
+
+static void s3_object_item_finalize(GObject *object) {
+    S3ObjectItem *item = S3_OBJECT_ITEM(object);
+    g_free(item->object.key);
+    s3_object_metadata_free(item->metadata);
+    G_OBJECT_CLASS(s3_object_item_parent_class)->finalize(object);
+}
+
+static void s3_object_item_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec) {
+    S3ObjectItem *item = S3_OBJECT_ITEM(object);
+    switch (prop_id) {
+    case ITEM_PROP_METADATA:
+        g_value_set_pointer(value, item->metadata);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    }
+}
+
+static void s3_object_item_class_init(S3ObjectItemClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    object_class->finalize = s3_object_item_finalize;
+    object_class->get_property = s3_object_item_get_property;
+    item_props[ITEM_PROP_METADATA] = g_param_spec_pointer("metadata", NULL, NULL, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY);
+    g_object_class_install_properties(object_class, N_ITEM_PROPS, item_props);
+}
+
+static void s3_object_item_init(S3ObjectItem *item) {
+    (void)item;
+}
+
+static S3ObjectItem *s3_object_item_new(const gchar *key, guint64 size, gint64 last_modified) {
+    S3ObjectItem *item = g_object_new(S3_TYPE_OBJECT_ITEM, NULL);
+    item->object.key = g_strdup(key);
+    item->object.size = size;
+    item->object.last_modified = last_modified;
+    return item;
+}
+
+static void s3_object_item_set_metadata(S3ObjectItem *item, const S3ObjectMetadata *metadata) {
+    s3_object_metadata_free(item->metadata);
+    item->metadata = s3_object_metadata_copy(metadata);
+    g_object_notify_by_pspec(G_OBJECT(item), item_props[ITEM_PROP_METADATA]);
+}
+
+const S3Object *s3_object_item_get_object(S3ObjectItem *item) {
+    g_return_val_if_fail(S3_IS_OBJECT_ITEM(item), NULL);
+    return &item->object;
+}
+
+const gchar *s3_object_item_get_key(S3ObjectItem *item) {
+    g_return_val_if_fail(S3_IS_OBJECT_ITEM(item), NULL);
+    return item->object.key;
+}
+
+const S3ObjectMetadata *s3_object_item_get_metadata(S3ObjectItem *item) {
+    g_return_val_if_fail(S3_IS_OBJECT_ITEM(item), NULL);
+    return item->metadata;
+}
+
+// #############################################################################
+// # S3ObjectList
+// #############################################################################
+
+// Rows per thread below which splitting a sort is not worth a thread.
+#define SORT_MIN_ROWS_PER_CHUNK 65536
+// How often the filter pass checks for cancellation.
+#define FILTER_CANCEL_CHECK_ROWS 65536
+// How long metadata requests are collected before they are sent, so rows
+// that only flash past while scrolling are withdrawn before costing a HEAD.
+#define METADATA_BATCH_DELAY_MS 50
+// HEAD requests in flight at once.
+#define METADATA_CONCURRENCY 8
+
+// Hash table key for a storage row; row 0 must not become NULL.
+#define ROW_KEY(row) GUINT_TO_POINTER((row) + 1)
+
+typedef struct MetadataSource MetadataSource;
+typedef struct ObjectListSplice ObjectListSplice;
+
+struct _S3ObjectList {
+    GObject parent_instance;
+    S3KeyArena *keys;           // Front-coded keys in listing order
+    GArray *sizes;              // guint64
+    GArray *mtimes;             // gint64, milliseconds since the epoch
+    GArray *etags;              // guint64 hash of each ETag, 0 when unknown
+    GArray *order;              // guint32 row shown at each position, NULL for server order
+    GByteArray *collate_arena;  // Filename collation keys, kept after the first name sort
+    GArray *collate_offsets;    // guint32 offset of each collation key
+    guint generation;           // Bumped whenever the rows change
+    gint *storage_readers;      // Atomic count of sort jobs holding the row arrays, shared with them; NULL before the first
+    GCancellable *sort_cancellable;
+    GString *key_buffer;        // Decoded key returned by s3_object_list_get_key()
+    ObjectListSplice *splice;   // Set while s3_object_list_splice() emits its changes
+    GArray *positions;          // guint32 position of each row under `order`, G_MAXUINT32 when filtered out
+    // Lazily fetched metadata, only touched on the main thread.
+    MetadataSource *metadata_source;
+    GHashTable *metadata;       // ROW_KEY -> S3ObjectMetadata, NULL after a failed fetch
+    GHashTable *live_items;     // ROW_KEY -> S3ObjectItem handed out and still alive, not referenced
+    GHashTable *metadata_pending;   // ROW_KEY -> MetadataRequest queued or in flight
+    GPtrArray *metadata_batch;  // MetadataRequests not sent yet, in request order
+    guint metadata_batch_id;
+    guint metadata_epoch;       // Bumped whenever the rows are replaced
+    GThreadPool *metadata_pool;
+};
+
+static void s3_object_list_model_init(GListModelInterface *iface);
+static void s3_object_list_reset_metadata(S3ObjectList *list);
+static void metadata_source_unref(MetadataSource *source);
+
+G_DEFINE_TYPE_WITH_CODE(S3ObjectList, s3_object_list, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL, s3_object_list_model_init))
+
+static inline guint s3_object_list_row_at(S3ObjectList *list, guint position) {
+    return list->order ? g_array_index(list->order, guint32, position) : position;
+}
+
+static GType s3_object_list_get_item_type(GListModel *model) {
+    (void)model;
+    return S3_TYPE_OBJECT_ITEM;
+}
+
+// While a reconcile emits its changes one run at a time, the positions it
+// has reached show the new rows and the rest still show the old ones, so
+// the model is consistent at every items-changed.
+struct ObjectListSplice {
+    S3KeyArena *keys;           // Old rows
+    GArray *sizes;
+    GArray *mtimes;
+    GArray *order;              // Old order, NULL for server order
+    const guint32 *old_to_new;  // New row of each old row, G_MAXUINT32 if it was removed
+    const guint8 *modified;     // Per old row
+    guint n_old;                // Old positions
+    guint done_new;             // Positions before this show the new rows...
+    guint done_old;             // ...in place of the old positions before this
+};
+
+static guint s3_object_list_get_n_items(GListModel *model) {
+    S3ObjectList *list = S3_OBJECT_LIST(model);
+    if (list->splice) return list->splice->done_new + list->splice->n_old - list->splice->done_old;
+    return list->order ? list->order->len : s3_key_arena_get_n_keys(list->keys);
+}
+
+static void on_live_item_finalized(gpointer data, GObject *where_the_object_was) {
+    S3ObjectList *list = data;
+    S3ObjectItem *item = (S3ObjectItem *)where_the_object_was;
+    if (g_hash_table_lookup(list->live_items, ROW_KEY(item->row)) == item) {
+        g_hash_table_remove(list->live_items, ROW_KEY(item->row));
+    }
+}
+
+static void s3_object_list_detach_item(S3ObjectList *list, S3ObjectItem *item) {
+    g_object_weak_unref(G_OBJECT(item), on_live_item_finalized, list);
+    item->row = G_MAXUINT;
+}
+
+// Hands out the same item for a row while it is alive, so metadata arriving
+// later reaches the item a view has bound, and a view that is told about a
+// change finds its unchanged rows under the same items.
+static S3ObjectItem *s3_object_list_item_for_row(S3ObjectList *list, guint row) {
+    S3ObjectItem *item = g_hash_table_lookup(list->live_items, ROW_KEY(row));
+    if (item) return g_object_ref(item);
+
+    item = s3_object_item_new(s3_key_arena_get(list->keys, row, list->key_buffer),
+                              g_array_index(list->sizes, guint64, row),
+                              g_array_index(list->mtimes, gint64, row));
+    item->row = row;
+    item->metadata = s3_object_metadata_copy(g_hash_table_lookup(list->metadata, ROW_KEY(row)));
+    g_object_weak_ref(G_OBJECT(item), on_live_item_finalized, list);
+    g_hash_table_insert(list->live_items, ROW_KEY(row), item);
+    return item;
+}
+
+static gpointer s3_object_list_get_item(GListModel *model, guint position) {
+    S3ObjectList *list = S3_OBJECT_LIST(model);
+    if (position >= s3_object_list_get_n_items(model)) return NULL;
+    ObjectListSplice *splice = list->splice;
+    if (!splice || position < splice->done_new) {
+        return s3_object_list_item_for_row(list, s3_object_list_row_at(list, position));
+    }
+
+    guint old_position = splice->done_old + position - splice->done_new;
+    guint old_row = splice->order ? g_array_index(splice->order, guint32, old_position) : old_position;
+    guint32 new_row = splice->old_to_new[old_row];
+    if (new_row != G_MAXUINT32 && !splice->modified[old_row]) {
+        return s3_object_list_item_for_row(list, new_row);
+    }
+    // A row about to be removed or replaced: only its old contents are left.
+    S3ObjectItem *item = s3_object_item_new(s3_key_arena_get(splice->keys, old_row, list->key_buffer),
+                                            g_array_index(splice->sizes, guint64, old_row),
+                                            g_array_index(splice->mtimes, gint64, old_row));
+    item->row = G_MAXUINT;
+    return item;
+}
+
+static void s3_object_list_model_init(GListModelInterface *iface) {
+    iface->get_item_type = s3_object_list_get_item_type;
+    iface->get_n_items = s3_object_list_get_n_items;
+    iface->get_item = s3_object_list_get_item;
+}
+
+static void s3_object_list_drop_collation(S3ObjectList *list) {
+    g_clear_pointer(&list->collate_arena, g_byte_array_unref);
+    g_clear_pointer(&list->collate_offsets, g_array_unref);
+}
+
+static void s3_object_list_drop_positions(S3ObjectList *list) {
+    g_clear_pointer(&list->positions, g_array_unref);
+}
+
+static void s3_object_list_finalize(GObject *object) {
+    S3ObjectList *list = S3_OBJECT_LIST(object);
+    if (list->sort_cancellable) {
+        g_cancellable_cancel(list->sort_cancellable);
+        g_object_unref(list->sort_cancellable);
+    }
+    s3_key_arena_unref(list->keys);
+    g_array_unref(list->sizes);
+    g_array_unref(list->mtimes);
+    g_array_unref(list->etags);
+    g_clear_pointer(&list->storage_readers, g_atomic_rc_box_release);
+    g_clear_pointer(&list->order, g_array_unref);
+    s3_object_list_drop_collation(list);
+    s3_object_list_drop_positions(list);
+    g_string_free(list->key_buffer, TRUE);
+    // Requests in flight hold a reference, so none are left by now.
+    s3_object_list_reset_metadata(list);
+    if (list->metadata_pool) g_thread_pool_free(list->metadata_pool, FALSE, TRUE);
+    if (list->metadata_source) metadata_source_unref(list->metadata_source);
+    g_hash_table_unref(list->metadata);
+    g_hash_table_unref(list->live_items);
+    g_hash_table_unref(list->metadata_pending);
+    g_ptr_array_unref(list->metadata_batch);
+    G_OBJECT_CLASS(s3_object_list_parent_class)->finalize(object);
+}
+
+static void s3_object_list_class_init(S3ObjectListClass *klass) {
+    G_OBJECT_CLASS(klass)->finalize = s3_object_list_finalize;
+}
+
+static void s3_object_list_init_storage(S3ObjectList *list) {
+    list->keys = s3_key_arena_new();
+    list->sizes = g_array_new(FALSE, FALSE, sizeof(guint64));
+    list->mtimes = g_array_new(FALSE, FALSE, sizeof(gint64));
+    list->etags = g_array_new(FALSE, FALSE, sizeof(guint64));
+    g_clear_pointer(&list->storage_readers, g_atomic_rc_box_release);
+}
+
+static void s3_object_list_init(S3ObjectList *list) {
+    s3_object_list_init_storage(list);
+    list->key_buffer = g_string_new(NULL);
+    list->metadata = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)s3_object_metadata_free);
+    list->live_items = g_hash_table_new(g_direct_hash, g_direct_equal);
+    list->metadata_pending = g_hash_table_new(g_direct_hash, g_direct_equal);
+    list->metadata_batch = g_ptr_array_new();
+}
+
+S3ObjectList *s3_object_list_new(void) {
+    return g_object_new(S3_TYPE_OBJECT_LIST, NULL);
+}
+
+// Sort jobs read the row arrays without locking, so while a job holds a
+// snapshot the arrays are never modified in place: the first mutation works
+// on private copies. Once the jobs are done the arrays are written directly
+// again.
+static void s3_object_list_unshare_storage(S3ObjectList *list) {
+    if (!list->storage_readers || g_atomic_int_get(list->storage_readers) == 0) return;
+
+    S3KeyArena *keys = s3_key_arena_copy(list->keys);
+    s3_key_arena_unref(list->keys);
+    list->keys = keys;
+
+    GArray *copy = g_array_copy(list->sizes);
+    g_array_unref(list->sizes);
+    list->sizes = copy;
+    copy = g_array_copy(list->mtimes);
+    g_array_unref(list->mtimes);
+    list->mtimes = copy;
+
+    g_clear_pointer(&list->storage_readers, g_atomic_rc_box_release);
+}
+
+// FNV-1a of an ETag, enough to tell whether it changed in 8 bytes a row. 0
+// stands for unknown.
+static guint64 etag_hash(const gchar *etag) {
+    if (!etag || !*etag) return 0;
+    guint64 hash = G_GUINT64_CONSTANT(0xcbf29ce484222325);
+    for (const guchar *p = (const guchar *)etag; *p; p++) {
+        hash = (hash ^ *p) * G_GUINT64_CONSTANT(0x100000001b3);
+    }
+    return hash ? hash : 1;
+}
+
+void s3_object_list_append(S3ObjectList *list, const S3Object *objects, guint n_objects) {
+    g_return_if_fail(S3_IS_OBJECT_LIST(list));
+    if (n_objects == 0) return;
+
+    guint view_position = s3_object_list_get_n_items(G_LIST_MODEL(list));
+    guint position = s3_key_arena_get_n_keys(list->keys);
+
+    s3_object_list_unshare_storage(list);
+    s3_object_list_drop_collation(list);
+    list->generation++;
+
+    guint added = 0;
+    while (added < n_objects && s3_key_arena_append(list->keys, objects[added].key)) {
+        added++;
+    }
+    if (added < n_objects) {
+        g_warning("Object list is full, dropping %u rows", n_objects - added);
+        n_objects = added;
+        if (n_objects == 0) return;
+    }
+
+    // Grow the columns once per batch rather than once per row.
+    g_array_set_size(list->sizes, position + n_objects);
+    g_array_set_size(list->mtimes, position + n_objects);
+    g_array_set_size(list->etags, position + n_objects);
+    for (guint i = 0; i < n_objects; i++) {
+        g_array_index(list->sizes, guint64, position + i) = objects[i].size;
+        g_array_index(list->mtimes, gint64, position + i) = objects[i].last_modified;
+        g_array_index(list->etags, guint64, position + i) = etag_hash(objects[i].etag);
+    }
+    g_clear_pointer(&list->positions, g_array_unref);
+
+    // With an order applied, new rows go at the end until the next sort.
+    if (list->order) {
+        for (guint i = 0; i < n_objects; i++) {
+            guint32 row = position + i;
+            g_array_append_val(list->order, row);
+        }
+    }
+
+    g_list_model_items_changed(G_LIST_MODEL(list), view_position, 0, n_objects);
+}
+
+static void s3_object_list_reset(S3ObjectList *list) {
+    s3_key_arena_unref(list->keys);
+    g_array_unref(list->sizes);
+    g_array_unref(list->mtimes);
+    g_array_unref(list->etags);
+    s3_object_list_init_storage(list);
+    g_clear_pointer(&list->order, g_array_unref);
+    s3_object_list_drop_collation(list);
+    s3_object_list_drop_positions(list);
+    s3_object_list_reset_metadata(list);
+    list->generation++;
+}
+
+void s3_object_list_remove_all(S3ObjectList *list) {
+    g_return_if_fail(S3_IS_OBJECT_LIST(list));
+    guint removed = s3_object_list_get_n_items(G_LIST_MODEL(list));
+    s3_object_list_reset(list);
+    if (removed) {
+        g_list_model_items_changed(G_LIST_MODEL(list), 0, removed, 0);
+    }
+}
+
+#define SWAP_VALUES(type, a, b) G_STMT_START { type tmp_ = (a); (a) = (b); (b) = tmp_; } G_STMT_END
+
+void s3_object_list_take_contents(S3ObjectList *list, S3ObjectList *source) {
+    g_return_if_fail(S3_IS_OBJECT_LIST(list));
+    g_return_if_fail(S3_IS_OBJECT_LIST(source));
+    guint removed = s3_object_list_get_n_items(G_LIST_MODEL(list));
+
+    SWAP_VALUES(S3KeyArena *, list->keys, source->keys);
+    SWAP_VALUES(GArray *, list->sizes, source->sizes);
+    SWAP_VALUES(GArray *, list->mtimes, source->mtimes);
+    SWAP_VALUES(GArray *, list->etags, source->etags);
+    SWAP_VALUES(GArray *, list->order, source->order);
+    SWAP_VALUES(GByteArray *, list->collate_arena, source->collate_arena);
+    SWAP_VALUES(GArray *, list->collate_offsets, source->collate_offsets);
+    SWAP_VALUES(gint *, list->storage_readers, source->storage_readers);
+    s3_object_list_drop_positions(list);
+    s3_object_list_reset_metadata(list);
+    list->generation++;
+    s3_object_list_reset(source);
+
+    guint added = s3_object_list_get_n_items(G_LIST_MODEL(list));
+    if (removed || added) {
+        g_list_model_items_changed(G_LIST_MODEL(list), 0, removed, added);
+    }
+}
+
+const gchar *s3_object_list_get_key(S3ObjectList *list, guint position) {
+    g_return_val_if_fail(position < s3_object_list_get_n_items(G_LIST_MODEL(list)), NULL);
+    return s3_key_arena_get(list->keys, s3_object_list_row_at(list, position), list->key_buffer);
+}
+
+guint64 s3_object_list_get_size(S3ObjectList *list, guint position) {
+    g_return_val_if_fail(position < s3_object_list_get_n_items(G_LIST_MODEL(list)), 0);
+    return g_array_index(list->sizes, guint64, s3_object_list_row_at(list, position));
+}
+
+gint64 s3_object_list_get_last_modified(S3ObjectList *list, guint position) {
+    g_return_val_if_fail(position < s3_object_list_get_n_items(G_LIST_MODEL(list)), 0);
+    return g_array_index(list->mtimes, gint64, s3_object_list_row_at(list, position));
+}
+
+gboolean s3_object_list_append_page(const S3Object *objects, guint n_objects, gpointer user_data) {
+    s3_object_list_append(S3_OBJECT_LIST(user_data), objects, n_objects);
+    return TRUE;
+}
+
+// #############################################################################
+// # Lazy metadata
+// #############################################################################
+
+struct MetadataSource {
+    gint ref_count;
+    S3ObjectMetadataFunc func;
+    gpointer user_data;
+    GDestroyNotify destroy;
+};
+
+static MetadataSource *metadata_source_ref(MetadataSource *source) {
+    g_atomic_int_inc(&source->ref_count);
+    return source;
+}
+
+static void metadata_source_unref(MetadataSource *source) {
+    if (!g_atomic_int_dec_and_test(&source->ref_count)) return;
+    if (source->destroy) source->destroy(source->user_data);
+    g_free(source);
+}
+
+typedef struct {
+    S3ObjectList *list;         // Referenced once the request is sent
+    MetadataSource *source;
+    guint row;
+    guint epoch;
+    gchar *key;
+    gint cancelled;             // Skip the HEAD if it has not started
+    S3ObjectMetadata *metadata; // The answer
+    GError *error;
+} MetadataRequest;
+
+static void metadata_request_free(MetadataRequest *request) {
+    if (request->list) g_object_unref(request->list);
+    metadata_source_unref(request->source);
+    g_free(request->key);
+    s3_object_metadata_free(request->metadata);
+    g_clear_error(&request->error);
+    g_free(request);
+}
+
+static void s3_object_list_reset_metadata(S3ObjectList *list) {
+    list->metadata_epoch++;
+    g_hash_table_remove_all(list->metadata);
+
+    // Requests in flight are dropped when they come back.
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, list->metadata_pending);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_atomic_int_set(&((MetadataRequest *)value)->cancelled, TRUE);
+    }
+    g_hash_table_remove_all(list->metadata_pending);
+    for (guint i = 0; i < list->metadata_batch->len; i++) {
+        metadata_request_free(g_ptr_array_index(list->metadata_batch, i));
+    }
+    g_ptr_array_set_size(list->metadata_batch, 0);
+    g_clear_handle_id(&list->metadata_batch_id, g_source_remove);
+
+    // Items already handed out keep what they have but no longer stand for
+    // a row.
+    g_hash_table_iter_init(&iter, list->live_items);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        s3_object_list_detach_item(list, value);
+    }
+    g_hash_table_remove_all(list->live_items);
+}
+
+// Carries the metadata, items and requests of kept rows over to their new
+// rows after a reconcile. Those of removed and modified rows are dropped.
+static void s3_object_list_remap_metadata(S3ObjectList *list, const guint32 *old_to_new, const guint8 *modified) {
+    GHashTable *metadata = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)s3_object_metadata_free);
+    GHashTable *live_items = g_hash_table_new(g_direct_hash, g_direct_equal);
+    GHashTable *pending = g_hash_table_new(g_direct_hash, g_direct_equal);
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init(&iter, list->metadata);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        guint row = GPOINTER_TO_UINT(key) - 1;
+        if (old_to_new[row] == G_MAXUINT32 || modified[row]) continue;
+        g_hash_table_iter_steal(&iter);
+        g_hash_table_insert(metadata, ROW_KEY(old_to_new[row]), value);
+    }
+    g_hash_table_iter_init(&iter, list->live_items);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        S3ObjectItem *item = value;
+        if (old_to_new[item->row] == G_MAXUINT32 || modified[item->row]) {
+            s3_object_list_detach_item(list, item);
+        } else {
+            item->row = old_to_new[item->row];
+            g_hash_table_insert(live_items, ROW_KEY(item->row), item);
+        }
+    }
+    g_hash_table_iter_init(&iter, list->metadata_pending);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        MetadataRequest *request = value;
+        if (old_to_new[request->row] != G_MAXUINT32 && !modified[request->row]) {
+            request->row = old_to_new[request->row];
+            g_hash_table_insert(pending, ROW_KEY(request->row), request);
+        } else if (!request->list) {
+            g_ptr_array_remove(list->metadata_batch, request);
+            metadata_request_free(request);
+        } else {
+            g_atomic_int_set(&request->cancelled, TRUE);
+            request->row = G_MAXUINT;
+        }
+    }
+
+    g_hash_table_unref(list->metadata);
+    list->metadata = metadata;
+    g_hash_table_unref(list->live_items);
+    list->live_items = live_items;
+    g_hash_table_unref(list->metadata_pending);
+    list->metadata_pending = pending;
+}
+
+void s3_object_list_set_metadata_func(S3ObjectList *list, S3ObjectMetadataFunc func, gpointer user_data, GDestroyNotify destroy) {
+    g_return_if_fail(S3_IS_OBJECT_LIST(list));
+    if (list->metadata_source) metadata_source_unref(list->metadata_source);
+    list->metadata_source = NULL;
+    if (func) {
+        list->metadata_source = g_new0(MetadataSource, 1);
+        list->metadata_source->ref_count = 1;
+        list->metadata_source->func = func;
+        list->metadata_source->user_data = user_data;
+        list->metadata_source->destroy = destroy;
+    } else if (destroy) {
+        destroy(user_data);
+    }
+}
+
+static gboolean on_metadata_fetched(gpointer user_data) {
+    MetadataRequest *request = user_data;
+    S3ObjectList *list = request->list;
+    if (request->epoch == list->metadata_epoch && request->row != G_MAXUINT) {
+        if (g_hash_table_lookup(list->metadata_pending, ROW_KEY(request->row)) == request) {
+            g_hash_table_remove(list->metadata_pending, ROW_KEY(request->row));
+        }
+        // An answer for a withdrawn request is still worth keeping.
+        if (request->metadata || request->error) {
+            if (request->error) g_debug("No metadata for %s: %s", request->key, request->error->message);
+            g_hash_table_replace(list->metadata, ROW_KEY(request->row), g_steal_pointer(&request->metadata));
+            S3ObjectItem *item = g_hash_table_lookup(list->live_items, ROW_KEY(request->row));
+            const S3ObjectMetadata *metadata = g_hash_table_lookup(list->metadata, ROW_KEY(request->row));
+            if (item && metadata) s3_object_item_set_metadata(item, metadata);
+        }
+    }
+    metadata_request_free(request);
+    return G_SOURCE_REMOVE;
+}
+
+static void fetch_metadata(gpointer data, gpointer user_data) {
+    (void)user_data;
+    MetadataRequest *request = data;
+    if (!g_atomic_int_get(&request->cancelled)) {
+        request->metadata = request->source->func(request->key, request->source->user_data, &request->error);
+    }
+    g_idle_add(on_metadata_fetched, request);
+}
+
+static gboolean send_metadata_batch(gpointer user_data) {
+    S3ObjectList *list = user_data;
+    list->metadata_batch_id = 0;
+    if (!list->metadata_pool) {
+        list->metadata_pool = g_thread_pool_new(fetch_metadata, NULL, METADATA_CONCURRENCY, FALSE, NULL);
+    }
+    for (guint i = 0; i < list->metadata_batch->len; i++) {
+        MetadataRequest *request = g_ptr_array_index(list->metadata_batch, i);
+        request->list = g_object_ref(list);
+        g_thread_pool_push(list->metadata_pool, request, NULL);
+    }
+    g_ptr_array_set_size(list->metadata_batch, 0);
+    return G_SOURCE_REMOVE;
+}
+
+void s3_object_list_request_metadata(S3ObjectList *list, S3ObjectItem *item) {
+    g_return_if_fail(S3_IS_OBJECT_LIST(list));
+    g_return_if_fail(S3_IS_OBJECT_ITEM(item));
+    if (!list->metadata_source || item->row == G_MAXUINT) return;
+    if (g_hash_table_lookup(list->live_items, ROW_KEY(item->row)) != item) return;
+    if (g_hash_table_contains(list->metadata, ROW_KEY(item->row))) return;
+    if (g_hash_table_contains(list->metadata_pending, ROW_KEY(item->row))) return;
+
+    MetadataRequest *request = g_new0(MetadataRequest, 1);
+    request->source = metadata_source_ref(list->metadata_source);
+    request->row = item->row;
+    request->epoch = list->metadata_epoch;
+    request->key = g_strdup(item->object.key);
+    g_hash_table_insert(list->metadata_pending, ROW_KEY(item->row), request);
+    g_ptr_array_add(list->metadata_batch, request);
+    if (!list->metadata_batch_id) {
+        list->metadata_batch_id = g_timeout_add(METADATA_BATCH_DELAY_MS, send_metadata_batch, list);
+    }
+}
+
+void s3_object_list_cancel_metadata(S3ObjectList *list, S3ObjectItem *item) {
+    g_return_if_fail(S3_IS_OBJECT_LIST(list));
+    g_return_if_fail(S3_IS_OBJECT_ITEM(item));
+    if (item->row == G_MAXUINT || g_hash_table_lookup(list->live_items, ROW_KEY(item->row)) != item) return;
+    MetadataRequest *request = g_hash_table_lookup(list->metadata_pending, ROW_KEY(item->row));
+    if (!request) return;
+
+    g_hash_table_remove(list->metadata_pending, ROW_KEY(item->row));
+    if (!request->list) {
+        g_ptr_array_remove(list->metadata_batch, request);
+        metadata_request_free(request);
+    } else {
+        // Sent: a worker may not have picked it up yet.
+        g_atomic_int_set(&request->cancelled, TRUE);
+    }
+}
+
+// #############################################################################
+// # Reconciling with a newer listing
+// #############################################################################
+
+// Emits the runs of changes between the old view in `splice` and the new
+// view of `list`, front to back, advancing the splice past each run first.
+static void s3_object_list_emit_changes(S3ObjectList *list, ObjectListSplice *splice, guint n_added) {
+    const guint32 *old_to_new = splice->old_to_new;
+    const guint8 *modified = splice->modified;
+    guint n_new_rows = s3_key_arena_get_n_keys(list->keys);
+    guint i = 0, j = 0;
+
+    while (i < splice->n_old || (!splice->order && j < n_new_rows)) {
+        guint old_row = splice->order ? g_array_index(splice->order, guint32, i) : i;
+        if (i < splice->n_old && old_to_new[old_row] != G_MAXUINT32 && !modified[old_row] && (splice->order || old_to_new[old_row] == j)) {
+            i++;
+            j++;
+            continue;
+        }
+
+        guint i0 = i, j0 = j;
+        while (i < splice->n_old) {
+            old_row = splice->order ? g_array_index(splice->order, guint32, i) : i;
+            guint32 new_row = old_to_new[old_row];
+            if (new_row == G_MAXUINT32) {
+                i++;
+            } else if (!splice->order && j < new_row) {
+                j++;                    // Added in front of the next kept row
+            } else if (modified[old_row]) {
+                i++;
+                j++;
+            } else {
+                break;
+            }
+        }
+        // In server order, rows added after the last old row.
+        if (!splice->order && i == splice->n_old) j = n_new_rows;
+
+        splice->done_old = i;
+        splice->done_new = j;
+        g_list_model_items_changed(G_LIST_MODEL(list), j0, i - i0, j - j0);
+    }
+
+    // With an order applied, added rows go at the end until the next sort.
+    if (splice->order && n_added) {
+        splice->done_old = i;
+        splice->done_new = j + n_added;
+        g_list_model_items_changed(G_LIST_MODEL(list), j, 0, n_added);
+    }
+}
+
+static gboolean s3_object_list_row_changed(S3ObjectList *list, guint row, S3ObjectList *fresh, guint fresh_row) {
+    guint64 etag = g_array_index(list->etags, guint64, row);
+    guint64 fresh_etag = g_array_index(fresh->etags, guint64, fresh_row);
+    if (etag && fresh_etag) return etag != fresh_etag;
+    return g_array_index(list->sizes, guint64, row) != g_array_index(fresh->sizes, guint64, fresh_row) ||
+           g_array_index(list->mtimes, gint64, row) != g_array_index(fresh->mtimes, gint64, fresh_row);
+}
+
+// Replaces the rows of `list` with those of `fresh`, which is left empty.
+// `old_to_new` and `modified` say where each old row went; `added_rows` are
+// the new rows no old row became. Only the runs that changed are emitted.
+static void s3_object_list_splice(S3ObjectList *list, S3ObjectList *fresh, const guint32 *old_to_new, const guint8 *modified, GArray *added_rows) {
+    // Kept rows stay where they are; with an order applied, added rows
+    // join at the end like appended pages do.
+    GArray *new_order = NULL;
+    if (list->order) {
+        new_order = g_array_sized_new(FALSE, FALSE, sizeof(guint32), s3_key_arena_get_n_keys(fresh->keys));
+        for (guint k = 0; k < list->order->len; k++) {
+            guint32 new_row = old_to_new[g_array_index(list->order, guint32, k)];
+            if (new_row != G_MAXUINT32) g_array_append_val(new_order, new_row);
+        }
+        g_array_append_vals(new_order, added_rows->data, added_rows->len);
+    }
+
+    s3_object_list_remap_metadata(list, old_to_new, modified);
+
+    ObjectListSplice splice = { 0 };
+    splice.keys = list->keys;
+    splice.sizes = list->sizes;
+    splice.mtimes = list->mtimes;
+    splice.order = list->order;
+    splice.old_to_new = old_to_new;
+    splice.modified = modified;
+    splice.n_old = s3_object_list_get_n_items(G_LIST_MODEL(list));
+
+    // The old arrays now belong to the splice; a sort job may still hold
+    // them, which is fine as they are no longer written.
+    GArray *old_etags = list->etags;
+    list->keys = s3_key_arena_ref(fresh->keys);
+    list->sizes = g_array_ref(fresh->sizes);
+    list->mtimes = g_array_ref(fresh->mtimes);
+    list->etags = g_array_ref(fresh->etags);
+    g_clear_pointer(&list->storage_readers, g_atomic_rc_box_release);
+    if (fresh->storage_readers) list->storage_readers = g_atomic_rc_box_acquire(fresh->storage_readers);
+    list->order = new_order;
+    s3_object_list_drop_collation(list);
+    s3_object_list_drop_positions(list);
+    list->generation++;
+    s3_object_list_reset(fresh);
+
+    list->splice = &splice;
+    s3_object_list_emit_changes(list, &splice, added_rows->len);
+    list->splice = NULL;
+
+    s3_key_arena_unref(splice.keys);
+    g_array_unref(splice.sizes);
+    g_array_unref(splice.mtimes);
+    g_array_unref(old_etags);
+    if (splice.order) g_array_unref(splice.order);
+}
+
+gboolean s3_object_list_reconcile(S3ObjectList *list, S3ObjectList *fresh, S3ObjectListChanges *changes) {
+    g_return_val_if_fail(S3_IS_OBJECT_LIST(list), FALSE);
+    g_return_val_if_fail(S3_IS_OBJECT_LIST(fresh), FALSE);
+    g_return_val_if_fail(!list->splice, FALSE);
+    guint n_old_rows = s3_key_arena_get_n_keys(list->keys);
+    S3ObjectListChanges counts = { 0, 0, 0 };
+
+    // Both listings are in key order, so one pass pairs every key.
+    g_autoptr(GArray) old_to_new = g_array_sized_new(FALSE, FALSE, sizeof(guint32), n_old_rows);
+    g_array_set_size(old_to_new, n_old_rows);
+    guint8 *modified = g_new0(guint8, MAX(n_old_rows, 1));
+    g_autoptr(GArray) added_rows = g_array_new(FALSE, FALSE, sizeof(guint32));
+    S3KeyArenaIter old_iter, new_iter;
+    s3_key_arena_iter_init(&old_iter, list->keys, 0);
+    s3_key_arena_iter_init(&new_iter, fresh->keys, 0);
+    const gchar *old_key = s3_key_arena_iter_next(&old_iter);
+    const gchar *new_key = s3_key_arena_iter_next(&new_iter);
+    guint32 i = 0, j = 0;
+    while (old_key || new_key) {
+        gint cmp = !old_key ? 1 : !new_key ? -1 : strcmp(old_key, new_key);
+        if (cmp < 0) {
+            g_array_index(old_to_new, guint32, i++) = G_MAXUINT32;
+            counts.removed++;
+            old_key = s3_key_arena_iter_next(&old_iter);
+        } else if (cmp > 0) {
+            g_array_append_val(added_rows, j);
+            j++;
+            counts.added++;
+            new_key = s3_key_arena_iter_next(&new_iter);
+        } else {
+            if (s3_object_list_row_changed(list, i, fresh, j)) {
+                modified[i] = 1;
+                counts.modified++;
+            }
+            g_array_index(old_to_new, guint32, i++) = j++;
+            old_key = s3_key_arena_iter_next(&old_iter);
+            new_key = s3_key_arena_iter_next(&new_iter);
+        }
+    }
+    s3_key_arena_iter_clear(&old_iter);
+    s3_key_arena_iter_clear(&new_iter);
+    if (changes) *changes = counts;
+
+    if (counts.added == 0 && counts.removed == 0 && counts.modified == 0) {
+        // Same rows, but the fresh listing may know ETags a restored one did not.
+        SWAP_VALUES(GArray *, list->etags, fresh->etags);
+        s3_object_list_reset(fresh);
+        g_free(modified);
+        return FALSE;
+    }
+
+    s3_object_list_splice(list, fresh, (const guint32 *)old_to_new->data, modified, added_rows);
+    g_free(modified);
+    return TRUE;
+}
+
+// #############################################################################
+// # Local changes
+// #############################################################################
+
+// Position of a storage row in the model, G_MAXUINT when it is filtered out.
+// With an order applied the inverse permutation is built on first use.
+static guint s3_object_list_position_of_row(S3ObjectList *list, guint row) {
+    if (!list->order) return row;
+    if (!list->positions) {
+        guint n_rows = s3_key_arena_get_n_keys(list->keys);
+        list->positions = g_array_sized_new(FALSE, FALSE, sizeof(guint32), n_rows);
+        g_array_set_size(list->positions, n_rows);
+        memset(list->positions->data, 0xff, (gsize)n_rows * sizeof(guint32));
+        for (guint k = 0; k < list->order->len; k++) {
+            g_array_index(list->positions, guint32, g_array_index(list->order, guint32, k)) = k;
+        }
+    }
+    guint32 position = g_array_index(list->positions, guint32, row);
+    return position == G_MAXUINT32 ? G_MAXUINT : position;
+}
+
+gboolean s3_object_list_find(S3ObjectList *list, const gchar *key, guint *position) {
+    g_return_val_if_fail(S3_IS_OBJECT_LIST(list), FALSE);
+    g_return_val_if_fail(key != NULL, FALSE);
+    g_return_val_if_fail(!list->splice, FALSE);
+    g_autoptr(GString) buffer = g_string_new(NULL);
+    guint row;
+    if (!s3_key_arena_find(list->keys, key, buffer, &row)) return FALSE;
+    guint found = s3_object_list_position_of_row(list, row);
+    if (found == G_MAXUINT) return FALSE;
+    if (position) *position = found;
+    return TRUE;
+}
+
+// Drops what was fetched or handed out for a row whose contents changed.
+static void s3_object_list_forget_row(S3ObjectList *list, guint row) {
+    g_hash_table_remove(list->metadata, ROW_KEY(row));
+    S3ObjectItem *item = g_hash_table_lookup(list->live_items, ROW_KEY(row));
+    if (item) {
+        s3_object_list_detach_item(list, item);
+        g_hash_table_remove(list->live_items, ROW_KEY(row));
+    }
+    MetadataRequest *request = g_hash_table_lookup(list->metadata_pending, ROW_KEY(row));
+    if (!request) return;
+    g_hash_table_remove(list->metadata_pending, ROW_KEY(row));
+    if (!request->list) {
+        g_ptr_array_remove(list->metadata_batch, request);
+        metadata_request_free(request);
+    } else {
+        g_atomic_int_set(&request->cancelled, TRUE);
+        request->row = G_MAXUINT;
+    }
+}
+
+// One change to a key, located in the rows by binary search.
+typedef struct {
+    const gchar *key;
+    const S3Object *object;     // NULL to remove the row
+    guint seq;                  // Order given, so the last change to a key wins
+    guint row;                  // Row of the key, or where it would be inserted
+    gboolean found;
+} RowEdit;
+
+static gint compare_row_edits(gconstpointer a, gconstpointer b) {
+    const RowEdit *x = a, *y = b;
+    gint cmp = strcmp(x->key, y->key);
+    return cmp ? cmp : (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+static gboolean s3_object_list_row_differs(S3ObjectList *list, guint row, const S3Object *object) {
+    guint64 etag = etag_hash(object->etag);
+    guint64 old_etag = g_array_index(list->etags, guint64, row);
+    if (etag && old_etag) return etag != old_etag;
+    return g_array_index(list->sizes, guint64, row) != object->size ||
+           g_array_index(list->mtimes, gint64, row) != object->last_modified;
+}
+
+// Overwrites rows whose keys are all in the list. Every key stays where it
+// is, so a sort under way still applies and the generation is left alone.
+static gboolean s3_object_list_update_rows(S3ObjectList *list, GArray *edits, S3ObjectListChanges *changes) {
+    S3ObjectListChanges counts = { 0, 0, 0 };
+    g_autoptr(GArray) updated = g_array_new(FALSE, FALSE, sizeof(guint));
+    for (guint i = 0; i < edits->len; i++) {
+        const RowEdit *edit = &g_array_index(edits, RowEdit, i);
+        if (!s3_object_list_row_differs(list, edit->row, edit->object)) continue;
+
+        s3_object_list_unshare_storage(list);
+        g_array_index(list->sizes, guint64, edit->row) = edit->object->size;
+        g_array_index(list->mtimes, gint64, edit->row) = edit->object->last_modified;
+        g_array_index(list->etags, guint64, edit->row) = etag_hash(edit->object->etag);
+        s3_object_list_forget_row(list, edit->row);
+        g_array_append_val(updated, edit->row);
+        counts.modified++;
+    }
+    if (changes) *changes = counts;
+
+    for (guint i = 0; i < updated->len; i++) {
+        guint position = s3_object_list_position_of_row(list, g_array_index(updated, guint, i));
+        if (position != G_MAXUINT) g_list_model_items_changed(G_LIST_MODEL(list), position, 1, 1);
+    }
+    return counts.modified > 0;
+}
+
+// Appends one row to a list no view is bound to. Returns the row, or
+// G_MAXUINT32 when the list is full.
+static guint32 s3_object_list_append_row(S3ObjectList *list, const gchar *key, guint64 size, gint64 last_modified, guint64 etag) {
+    guint32 row = s3_key_arena_get_n_keys(list->keys);
+    if (!s3_key_arena_append(list->keys, key)) {
+        g_warning("Object list is full, dropping %s", key);
+        return G_MAXUINT32;
+    }
+    g_array_append_val(list->sizes, size);
+    g_array_append_val(list->mtimes, last_modified);
+    g_array_append_val(list->etags, etag);
+    return row;
+}
+
+// Copies old row `row`, whose key is `key`, to `fresh` as it is.
+static guint32 s3_object_list_keep_row(S3ObjectList *list, S3ObjectList *fresh, guint row, const gchar *key) {
+    return s3_object_list_append_row(fresh, key, g_array_index(list->sizes, guint64, row),
+                                     g_array_index(list->mtimes, gint64, row), g_array_index(list->etags, guint64, row));
+}
+
+gboolean s3_object_list_apply_changes(S3ObjectList *list, const S3Object *objects, guint n_objects, const gchar * const *removed_keys, S3ObjectListChanges *changes) {
+    g_return_val_if_fail(S3_IS_OBJECT_LIST(list), FALSE);
+    g_return_val_if_fail(!list->splice, FALSE);
+    guint n_old_rows = s3_key_arena_get_n_keys(list->keys);
+    S3ObjectListChanges counts = { 0, 0, 0 };
+
+    // Removals are numbered after the objects, so they win for the same key.
+    g_autoptr(GArray) all = g_array_sized_new(FALSE, FALSE, sizeof(RowEdit), n_objects);
+    for (guint i = 0; i < n_objects; i++) {
+        RowEdit edit = { objects[i].key, &objects[i], i, 0, FALSE };
+        g_array_append_val(all, edit);
+    }
+    for (guint i = 0; removed_keys && removed_keys[i]; i++) {
+        RowEdit edit = { removed_keys[i], NULL, n_objects + i, 0, FALSE };
+        g_array_append_val(all, edit);
+    }
+    g_array_sort(all, compare_row_edits);
+
+    // The last change to each key, located in the rows. Removing a key that
+    // is not there changes nothing.
+    g_autoptr(GString) buffer = g_string_new(NULL);
+    g_autoptr(GArray) edits = g_array_sized_new(FALSE, FALSE, sizeof(RowEdit), all->len);
+    gboolean in_place = TRUE;
+    for (guint i = 0; i < all->len; i++) {
+        RowEdit edit = g_array_index(all, RowEdit, i);
+        if (i + 1 < all->len && strcmp(edit.key, g_array_index(all, RowEdit, i + 1).key) == 0) continue;
+        edit.found = s3_key_arena_find(list->keys, edit.key, buffer, &edit.row);
+        if (!edit.found && !edit.object) continue;
+        in_place = in_place && edit.found && edit.object;
+        g_array_append_val(edits, edit);
+    }
+    if (edits->len == 0) {
+        if (changes) *changes = counts;
+        return FALSE;
+    }
+    if (in_place) return s3_object_list_update_rows(list, edits, changes);
+
+    // Keys come and go. The front-coded arena only appends, so the rows
+    // before the first change are copied as they are, and only the rows
+    // after it are decoded and merged with the edits. Views are told about
+    // the changed runs only.
+    guint first = g_array_index(edits, RowEdit, 0).row;
+    g_autoptr(S3ObjectList) fresh = s3_object_list_new();
+    s3_key_arena_unref(fresh->keys);
+    fresh->keys = s3_key_arena_copy_prefix(list->keys, first);
+    g_array_append_vals(fresh->sizes, list->sizes->data, first);
+    g_array_append_vals(fresh->mtimes, list->mtimes->data, first);
+    g_array_append_vals(fresh->etags, list->etags->data, first);
+
+    g_autoptr(GArray) old_to_new = g_array_sized_new(FALSE, FALSE, sizeof(guint32), n_old_rows);
+    g_array_set_size(old_to_new, n_old_rows);
+    guint32 *new_rows = (guint32 *)old_to_new->data;
+    guint8 *modified = g_new0(guint8, MAX(n_old_rows, 1));
+    g_autoptr(GArray) added_rows = g_array_new(FALSE, FALSE, sizeof(guint32));
+    for (guint row = 0; row < first; row++) new_rows[row] = row;
+
+    S3KeyArenaIter iter;
+    s3_key_arena_iter_init(&iter, list->keys, first);
+    guint row = first;
+    for (guint e = 0; e <= edits->len; e++) {
+        const RowEdit *edit = e < edits->len ? &g_array_index(edits, RowEdit, e) : NULL;
+        for (guint until = edit ? edit->row : n_old_rows; row < until; row++) {
+            new_rows[row] = s3_object_list_keep_row(list, fresh, row, s3_key_arena_iter_next(&iter));
+        }
+        if (!edit) break;
+
+        const S3Object *object = edit->object;
+        if (!edit->found) {
+            guint32 new_row = s3_object_list_append_row(fresh, object->key, object->size, object->last_modified, etag_hash(object->etag));
+            if (new_row != G_MAXUINT32) {
+                g_array_append_val(added_rows, new_row);
+                counts.added++;
+            }
+            continue;
+        }
+        const gchar *key = s3_key_arena_iter_next(&iter);
+        if (!object) {
+            new_rows[row] = G_MAXUINT32;
+            counts.removed++;
+        } else if (s3_object_list_row_differs(list, row, object)) {
+            new_rows[row] = s3_object_list_append_row(fresh, key, object->size, object->last_modified, etag_hash(object->etag));
+            modified[row] = 1;
+            counts.modified++;
+        } else {
+            new_rows[row] = s3_object_list_keep_row(list, fresh, row, key);
+        }
+        row++;
+    }
+    s3_key_arena_iter_clear(&iter);
+    if (changes) *changes = counts;
+
+    s3_object_list_splice(list, fresh, new_rows, modified, added_rows);
+    g_free(modified);
+    return TRUE;
+}
+
+// #############################################################################
+// # Background sorting and filtering
+// #############################################################################
+
+// Everything a sort thread needs, referenced rather than copied from the list.
+typedef struct {
+    S3KeyArena *keys;
+    GArray *sizes;
+    GArray *mtimes;
+    GByteArray *collate_arena;
+    GArray *collate_offsets;
+    guint generation;
+    S3ObjectSortColumn column;
+    gboolean descending;
+    gchar *filter;      // Case-folded, NULL to keep every row
+    gboolean filter_is_ascii;
+    GArray *order;      // Result, NULL for server order
+    gint *storage_readers;  // The list's count this job is part of
+} SortJob;
+
+static void sort_job_free(gpointer data) {
+    SortJob *job = data;
+    s3_key_arena_unref(job->keys);
+    g_array_unref(job->sizes);
+    g_array_unref(job->mtimes);
+    // The list may write its arrays in place again once this reaches 0.
+    g_atomic_int_add(job->storage_readers, -1);
+    g_atomic_rc_box_release(job->storage_readers);
+    if (job->collate_arena) g_byte_array_unref(job->collate_arena);
+    if (job->collate_offsets) g_array_unref(job->collate_offsets);
+    g_free(job->filter);
+    if (job->order) g_array_unref(job->order);
+    g_free(job);
+}
+
+static inline const gchar *sort_job_collate_key(const SortJob *job, guint32 row) {
+    return (const gchar *)job->collate_arena->data + g_array_index(job->collate_offsets, guint32, row);
+}
+
+static guint sort_job_n_chunks(guint n_rows) {
+    guint n_chunks = MIN((guint)g_get_num_processors(), n_rows / SORT_MIN_ROWS_PER_CHUNK);
+    return MAX(n_chunks, 1);
+}
+
+// Runs func over n_chunks consecutive structs of chunk_size bytes, one thread
+// each, and waits for all of them.
+static void run_chunks(gpointer chunks, gsize chunk_size, guint n_chunks, GThreadFunc func) {
+    if (n_chunks == 1) {
+        func(chunks);
+        return;
+    }
+    GThread **threads = g_new(GThread *, n_chunks);
+    for (guint i = 0; i < n_chunks; i++) {
+        threads[i] = g_thread_new("list-sort", func, (guint8 *)chunks + i * chunk_size);
+    }
+    for (guint i = 0; i < n_chunks; i++) {
+        g_thread_join(threads[i]);
+    }
+    g_free(threads);
+}
+
+typedef struct {
+    const SortJob *job;
+    guint begin;
+    guint end;
+    GByteArray *arena;
+    GArray *offsets;
+} CollateChunk;
+
+static gpointer collate_chunk(gpointer data) {
+    CollateChunk *chunk = data;
+    chunk->arena = g_byte_array_new();
+    chunk->offsets = g_array_sized_new(FALSE, FALSE, sizeof(guint32), chunk->end - chunk->begin);
+    S3KeyArenaIter iter;
+    s3_key_arena_iter_init(&iter, chunk->job->keys, chunk->begin);
+    for (guint row = chunk->begin; row < chunk->end; row++) {
+        gchar *collate_key = g_utf8_collate_key_for_filename(s3_key_arena_iter_next(&iter), -1);
+        guint32 offset = chunk->arena->len;
+        g_array_append_val(chunk->offsets, offset);
+        g_byte_array_append(chunk->arena, (const guint8 *)collate_key, strlen(collate_key) + 1);
+        g_free(collate_key);
+    }
+    s3_key_arena_iter_clear(&iter);
+    return NULL;
+}
+
+// Computes one collation key per row. The keys are handed back to the list so
+// later name sorts only compare bytes.
+static void sort_job_compute_collation(SortJob *job) {
+    guint n_rows = s3_key_arena_get_n_keys(job->keys);
+    guint n_chunks = sort_job_n_chunks(n_rows);
+    CollateChunk *chunks = g_new0(CollateChunk, n_chunks);
+    for (guint i = 0; i < n_chunks; i++) {
+        chunks[i].job = job;
+        chunks[i].begin = (guint)((guint64)n_rows * i / n_chunks);
+        chunks[i].end = (guint)((guint64)n_rows * (i + 1) / n_chunks);
+    }
+    run_chunks(chunks, sizeof(CollateChunk), n_chunks, collate_chunk);
+
+    gsize total = 0;
+    for (guint i = 0; i < n_chunks; i++) total += chunks[i].arena->len;
+
+    // Offsets are 32-bit; beyond that name sorts fall back to byte order.
+    if (total <= G_MAXUINT32) {
+        job->collate_arena = g_byte_array_sized_new(total);
+        job->collate_offsets = g_array_sized_new(FALSE, FALSE, sizeof(guint32), n_rows);
+        for (guint i = 0; i < n_chunks; i++) {
+            guint32 base = job->collate_arena->len;
+            for (guint j = 0; j < chunks[i].offsets->len; j++) {
+                guint32 offset = base + g_array_index(chunks[i].offsets, guint32, j);
+                g_array_append_val(job->collate_offsets, offset);
+            }
+            g_byte_array_append(job->collate_arena, chunks[i].arena->data, chunks[i].arena->len);
+        }
+    }
+    for (guint i = 0; i < n_chunks; i++) {
+        g_byte_array_unref(chunks[i].arena);
+        g_array_unref(chunks[i].offsets);
+    }
+    g_free(chunks);
+}
+
+static gboolean contains_ascii_nocase(const gchar *haystack, const gchar *needle, gsize needle_len) {
+    gchar first = needle[0];
+    for (const gchar *p = haystack; *p; p++) {
+        if (g_ascii_tolower(*p) == first && g_ascii_strncasecmp(p, needle, needle_len) == 0) return TRUE;
+    }
+    return FALSE;
+}
+
+static gboolean sort_job_key_matches(const SortJob *job, const gchar *key, gsize filter_len) {
+    if (job->filter_is_ascii) {
+        return contains_ascii_nocase(key, job->filter, filter_len);
+    }
+    g_autofree gchar *folded = g_utf8_casefold(key, -1);
+    return strstr(folded, job->filter) != NULL;
+}
+
+static gint compare_rows(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const SortJob *job = user_data;
+    guint32 row_a = *(const guint32 *)a;
+    guint32 row_b = *(const guint32 *)b;
+    gint cmp = 0;
+
+    switch (job->column) {
+    case S3_OBJECT_SORT_NAME:
+        // Without collation keys, server order is already byte order.
+        if (job->collate_arena) {
+            cmp = strcmp(sort_job_collate_key(job, row_a), sort_job_collate_key(job, row_b));
+        }
+        break;
+    case S3_OBJECT_SORT_SIZE: {
+        guint64 size_a = g_array_index(job->sizes, guint64, row_a);
+        guint64 size_b = g_array_index(job->sizes, guint64, row_b);
+        cmp = (size_a > size_b) - (size_a < size_b);
+        break;
+    }
+    case S3_OBJECT_SORT_MODIFIED: {
+        gint64 mtime_a = g_array_index(job->mtimes, gint64, row_a);
+        gint64 mtime_b = g_array_index(job->mtimes, gint64, row_b);
+        cmp = (mtime_a > mtime_b) - (mtime_a < mtime_b);
+        break;
+    }
+    case S3_OBJECT_SORT_NONE:
+        break;
+    }
+
+    if (job->descending) cmp = -cmp;
+    // Fall back to server order so equal rows keep a stable position.
+    return cmp != 0 ? cmp : (row_a > row_b) - (row_a < row_b);
+}
+
+typedef struct {
+    const SortJob *job;
+    guint32 *rows;
+    guint n_rows;
+} SortChunk;
+
+static gpointer sort_chunk(gpointer data) {
+    SortChunk *chunk = data;
+    g_qsort_with_data(chunk->rows, chunk->n_rows, sizeof(guint32), compare_rows, (gpointer)chunk->job);
+    return NULL;
+}
+
+typedef struct {
+    const SortJob *job;
+    const guint32 *left;
+    guint n_left;
+    const guint32 *right;
+    guint n_right;
+    guint32 *out;
+} MergeChunk;
+
+static gpointer merge_chunk(gpointer data) {
+    MergeChunk *chunk = data;
+    guint i = 0, j = 0, k = 0;
+    while (i < chunk->n_left && j < chunk->n_right) {
+        if (compare_rows(&chunk->left[i], &chunk->right[j], (gpointer)chunk->job) <= 0) {
+            chunk->out[k++] = chunk->left[i++];
+        } else {
+            chunk->out[k++] = chunk->right[j++];
+        }
+    }
+    memcpy(chunk->out + k, chunk->left + i, (chunk->n_left - i) * sizeof(guint32));
+    k += chunk->n_left - i;
+    memcpy(chunk->out + k, chunk->right + j, (chunk->n_right - j) * sizeof(guint32));
+    return NULL;
+}
+
+// Sorts job->order with one thread per chunk, then merges the sorted runs
+// pairwise, each merge level in parallel as well.
+static void sort_job_sort(SortJob *job) {
+    guint n = job->order->len;
+    guint n_runs = sort_job_n_chunks(n);
+    guint *bounds = g_new(guint, n_runs + 1);
+    SortChunk *chunks = g_new(SortChunk, n_runs);
+    for (guint i = 0; i <= n_runs; i++) {
+        bounds[i] = (guint)((guint64)n * i / n_runs);
+    }
+    for (guint i = 0; i < n_runs; i++) {
+        chunks[i].job = job;
+        chunks[i].rows = (guint32 *)job->order->data + bounds[i];
+        chunks[i].n_rows = bounds[i + 1] - bounds[i];
+    }
+    run_chunks(chunks, sizeof(SortChunk), n_runs, sort_chunk);
+    g_free(chunks);
+
+    guint32 *src = (guint32 *)job->order->data;
+    guint32 *scratch = n_runs > 1 ? g_new(guint32, n) : NULL;
+    guint32 *dst = scratch;
+    while (n_runs > 1) {
+        guint n_pairs = (n_runs + 1) / 2;
+        MergeChunk *merges = g_new(MergeChunk, n_pairs);
+        guint *next_bounds = g_new(guint, n_pairs + 1);
+        for (guint p = 0; p < n_pairs; p++) {
+            guint lo = bounds[2 * p];
+            guint mid = bounds[MIN(2 * p + 1, n_runs)];
+            guint hi = bounds[MIN(2 * p + 2, n_runs)];
+            merges[p] = (MergeChunk){ job, src + lo, mid - lo, src + mid, hi - mid, dst + lo };
+            next_bounds[p] = lo;
+        }
+        next_bounds[n_pairs] = n;
+        run_chunks(merges, sizeof(MergeChunk), n_pairs, merge_chunk);
+        g_free(merges);
+        g_free(bounds);
+        bounds = next_bounds;
+        n_runs = n_pairs;
+        SWAP_VALUES(guint32 *, src, dst);
+    }
+    if (src != (guint32 *)job->order->data) {
+        memcpy(job->order->data, src, n * sizeof(guint32));
+    }
+    g_free(scratch);
+    g_free(bounds);
+}
+
+static void sort_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    (void)source_object;
+    SortJob *job = task_data;
+    guint n_rows = s3_key_arena_get_n_keys(job->keys);
+
+    if (job->column == S3_OBJECT_SORT_NONE && !job->filter) {
+        g_task_return_boolean(task, TRUE);
+        return;
+    }
+
+    if (job->column == S3_OBJECT_SORT_NAME && !job->collate_arena) {
+        sort_job_compute_collation(job);
+        if (g_task_return_error_if_cancelled(task)) return;
+    }
+
+    job->order = g_array_sized_new(FALSE, FALSE, sizeof(guint32), n_rows);
+    if (job->filter) {
+        gsize filter_len = strlen(job->filter);
+        S3KeyArenaIter iter;
+        s3_key_arena_iter_init(&iter, job->keys, 0);
+        for (guint32 row = 0; row < n_rows; row++) {
+            if (row % FILTER_CANCEL_CHECK_ROWS == 0 && g_cancellable_is_cancelled(cancellable)) break;
+            if (sort_job_key_matches(job, s3_key_arena_iter_next(&iter), filter_len)) {
+                g_array_append_val(job->order, row);
+            }
+        }
+        s3_key_arena_iter_clear(&iter);
+    } else {
+        g_array_set_size(job->order, n_rows);
+        for (guint32 row = 0; row < n_rows; row++) {
+            g_array_index(job->order, guint32, row) = row;
+        }
+    }
+    if (g_task_return_error_if_cancelled(task)) return;
+
+    if (job->column != S3_OBJECT_SORT_NONE) {
+        sort_job_sort(job);
+    }
+    g_task_return_boolean(task, TRUE);
+}
+
+void s3_object_list_sort_async(S3ObjectList *list, S3ObjectSortColumn column, gboolean descending, const gchar *filter, GAsyncReadyCallback callback, gpointer user_data) {
+    g_return_if_fail(S3_IS_OBJECT_LIST(list));
+
+    // A newer request supersedes whatever is still running.
+    if (list->sort_cancellable) {
+        g_cancellable_cancel(list->sort_cancellable);
+        g_object_unref(list->sort_cancellable);
+    }
+    list->sort_cancellable = g_cancellable_new();
+
+    SortJob *job = g_new0(SortJob, 1);
+    job->keys = s3_key_arena_ref(list->keys);
+    job->sizes = g_array_ref(list->sizes);
+    job->mtimes = g_array_ref(list->mtimes);
+    if (list->collate_arena) {
+        job->collate_arena = g_byte_array_ref(list->collate_arena);
+        job->collate_offsets = g_array_ref(list->collate_offsets);
+    }
+    job->generation = list->generation;
+    job->column = column;
+    job->descending = descending;
+    if (filter && *filter) {
+        job->filter_is_ascii = TRUE;
+        for (const gchar *p = filter; *p; p++) {
+            if ((guchar)*p >= 0x80) {
+                job->filter_is_ascii = FALSE;
+                break;
+            }
+        }
+        job->filter = job->filter_is_ascii ? g_ascii_strdown(filter, -1) : g_utf8_casefold(filter, -1);
+    }
+    if (!list->storage_readers) list->storage_readers = g_atomic_rc_box_new0(gint);
+    job->storage_readers = g_atomic_rc_box_acquire(list->storage_readers);
+    g_atomic_int_inc(job->storage_readers);
+
+    GTask *task = g_task_new(list, list->sort_cancellable, callback, user_data);
+    g_task_set_source_tag(task, s3_object_list_sort_async);
+    g_task_set_task_data(task, job, sort_job_free);
+    g_task_run_in_thread(task, sort_thread);
+    g_object_unref(task);
+}
+
+gboolean s3_object_list_sort_finish(S3ObjectList *list, GAsyncResult *result, GError **error) {
+    g_return_val_if_fail(g_task_is_valid(result, list), FALSE);
+    GTask *task = G_TASK(result);
+    if (!g_task_propagate_boolean(task, error)) return FALSE;
+
+    SortJob *job = g_task_get_task_data(task);
+    if (job->generation != list->generation) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_CANCELLED, "The list changed while it was being sorted");
+        return FALSE;
+    }
+
+    if (job->collate_arena && !list->collate_arena) {
+        list->collate_arena = g_byte_array_ref(job->collate_arena);
+        list->collate_offsets = g_array_ref(job->collate_offsets);
+    }
+
+    // Swap the whole permutation in at once: the view sees one change.
+    guint removed = s3_object_list_get_n_items(G_LIST_MODEL(list));
+    g_clear_pointer(&list->order, g_array_unref);
+    g_clear_pointer(&list->positions, g_array_unref);
+    list->order = g_steal_pointer(&job->order);
+    guint added = s3_object_list_get_n_items(G_LIST_MODEL(list));
+    if (removed || added) {
+        g_list_model_items_changed(G_LIST_MODEL(list), 0, removed, added);
+    }
+    return TRUE;
+}
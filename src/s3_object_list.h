@@ -0,0 +1,109 @@
+#ifndef MYS3_S3_OBJECT_LIST_H
+#define MYS3_S3_OBJECT_LIST_H
+
+#include <gio/gio.h>
+#include "s3_client.h"
+
+G_BEGIN_DECLS
+
+// Item handed out by S3ObjectList. It is created on demand for the rows a
+// view actually binds and owns a copy of the row's S3Object.
+#define S3_TYPE_OBJECT_ITEM (s3_object_item_get_type())
+G_DECLARE_FINAL_TYPE(S3ObjectItem, s3_object_item, S3, OBJECT_ITEM, GObject)
+
+const S3Object *s3_object_item_get_object(S3ObjectItem *item);
+const gchar *s3_object_item_get_key(S3ObjectItem *item);
+// Extended metadata of the row, or NULL until it has been fetched. The
+// "metadata" property is notified when it arrives.
+const S3ObjectMetadata *s3_object_item_get_metadata(S3ObjectItem *item);
+
+// GListModel of S3ObjectItem backed by a struct-of-arrays store: keys are
+// front-coded in an S3KeyArena, sizes and mtimes live in flat arrays. A row
+// costs the bytes its key does not share with the previous key plus about 18
+// bytes until it is bound.
+#define S3_TYPE_OBJECT_LIST (s3_object_list_get_type())
+G_DECLARE_FINAL_TYPE(S3ObjectList, s3_object_list, S3, OBJECT_LIST, GObject)
+
+S3ObjectList *s3_object_list_new(void);
+
+// Appends rows, emitting a single items-changed for the batch.
+void s3_object_list_append(S3ObjectList *list, const S3Object *objects, guint n_objects);
+void s3_object_list_remove_all(S3ObjectList *list);
+// Moves the rows of `source` into `list`, replacing its contents with one
+// items-changed. `source` is left empty.
+void s3_object_list_take_contents(S3ObjectList *list, S3ObjectList *source);
+
+typedef struct {
+    guint added;
+    guint removed;
+    guint modified;     // Same key with another ETag, or size or mtime where the ETag is unknown
+} S3ObjectListChanges;
+
+// Brings the list up to date with `fresh`, a newer listing of the same
+// folder, and leaves `fresh` empty. Both are in key order, so one merge pass
+// pairs their keys; only the runs of added, removed and modified rows are
+// emitted, and unchanged rows keep their position, item and metadata. With
+// a sort or filter applied, added rows go at the end until the next sort.
+// Returns FALSE, emitting nothing, if no row changed.
+gboolean s3_object_list_reconcile(S3ObjectList *list, S3ObjectList *fresh, S3ObjectListChanges *changes);
+
+// Applies changes made by this client without listing the folder again:
+// `objects` are added, or replace the rows with the same keys, and
+// `removed_keys` (NULL-terminated, may be NULL) are dropped. Rows are found
+// by binary search over the keys, which are in listing order. Replacing
+// existing keys writes them in place; otherwise the rows before the first
+// change are copied as they are, the rest are merged with the changes, and
+// only the changed runs are emitted. Returns FALSE, emitting nothing, if no
+// row changed.
+gboolean s3_object_list_apply_changes(S3ObjectList *list, const S3Object *objects, guint n_objects, const gchar * const *removed_keys, S3ObjectListChanges *changes);
+// Model position of `key`. Returns FALSE if it is not in the list or is
+// filtered out.
+gboolean s3_object_list_find(S3ObjectList *list, const gchar *key, guint *position);
+
+// Row accessors that do not materialize an item. Positions are those of
+// the model, after any sort or filter. The key is decoded into a buffer owned
+// by the list and stays valid until the next call.
+const gchar *s3_object_list_get_key(S3ObjectList *list, guint position);
+guint64 s3_object_list_get_size(S3ObjectList *list, guint position);
+gint64 s3_object_list_get_last_modified(S3ObjectList *list, guint position);
+
+// Fetches the extended metadata of `key`. Runs on a worker thread; returns
+// NULL and sets `error` on failure.
+typedef S3ObjectMetadata *(*S3ObjectMetadataFunc)(const gchar *key, gpointer user_data, GError **error);
+
+// Sets how extended metadata is fetched for the current rows. It is fetched
+// per row, only for the items a view asks for, and kept with the rows until
+// they are replaced; failures are kept too, so they are not retried.
+void s3_object_list_set_metadata_func(S3ObjectList *list, S3ObjectMetadataFunc func, gpointer user_data, GDestroyNotify destroy);
+// Queues a fetch for an item handed out by the list, unless its metadata is
+// known or already on the way. Requests made in quick succession go out
+// together, a few at a time, and the item's "metadata" property is notified
+// when the answer comes back. Items from before the rows were replaced are
+// ignored.
+void s3_object_list_request_metadata(S3ObjectList *list, S3ObjectItem *item);
+// Withdraws the request for an item that is no longer shown, if it has not
+// been sent yet.
+void s3_object_list_cancel_metadata(S3ObjectList *list, S3ObjectItem *item);
+
+// S3ListPageCallback that appends each page to the S3ObjectList in user_data.
+gboolean s3_object_list_append_page(const S3Object *objects, guint n_objects, gpointer user_data);
+
+typedef enum {
+    S3_OBJECT_SORT_NONE,        // Server order
+    S3_OBJECT_SORT_NAME,        // g_utf8_collate_key_for_filename() order
+    S3_OBJECT_SORT_SIZE,
+    S3_OBJECT_SORT_MODIFIED
+} S3ObjectSortColumn;
+
+// Sorts and filters the list on worker threads. `filter` keeps rows whose key
+// contains it, ignoring case; NULL or "" keeps every row. Starting a new sort
+// cancels the previous one. The model is untouched until
+// s3_object_list_sort_finish() is called from `callback`.
+void s3_object_list_sort_async(S3ObjectList *list, S3ObjectSortColumn column, gboolean descending, const gchar *filter, GAsyncReadyCallback callback, gpointer user_data);
+// Installs the sorted order with a single items-changed. Fails with
+// G_IO_ERROR_CANCELLED if the sort was superseded or the rows changed.
+gboolean s3_object_list_sort_finish(S3ObjectList *list, GAsyncResult *result, GError **error);
+
+G_END_DECLS
+
+#endif // MYS3_S3_OBJECT_LIST_H
@@ -0,0 +1,220 @@
+#include "s3_stream_copy.h"
+#include "s3_client.h"
+#include "trace.h"
+
+#define S3_STREAM_COPY_DEFAULT_PART_SIZE (8 * 1024 * 1024)
+#define S3_STREAM_COPY_MIN_PART_SIZE (5 * 1024 * 1024)
+#define S3_STREAM_COPY_MAX_PARTS 10000
+#define S3_STREAM_COPY_DEFAULT_BUFFERS 8
+#define S3_STREAM_COPY_DEFAULT_READERS 4
+#define S3_STREAM_COPY_DEFAULT_WRITERS 4
+// How often a thread blocked on a queue checks for failure or cancellation.
+#define S3_STREAM_COPY_POLL_US (100 * 1000)
+
+typedef struct {
+    guint8 *data;       // part_size bytes, reused for part after part
+    guint part;
+    gsize length;
+} CopyBuffer;
+
+typedef struct {
+    const S3StreamCopyOptions *options;
+    GCancellable *cancellable;
+    gchar *upload_id;
+    guint64 size;
+    gsize part_size;
+    guint n_parts;
+    GAsyncQueue *free_buffers;  // The pool: CopyBuffers ready for a GET
+    GAsyncQueue *full_buffers;  // CopyBuffers waiting for an UploadPart
+    gint stop;
+    GMutex lock;                // Guards everything below and serializes the callback
+    guint next_part;            // Next part for a reader to fetch
+    guint parts_unclaimed;      // Parts no writer has taken yet
+    gchar **etags;              // Per part; NULL until that part is uploaded
+    S3StreamCopyStats stats;
+    GError *error;              // First failure
+} CopyPipeline;
+
+static gboolean pipeline_stopped(CopyPipeline *p) {
+    return g_atomic_int_get(&p->stop) || g_cancellable_is_cancelled(p->cancellable);
+}
+
+static void pipeline_fail(CopyPipeline *p, GError *error) {
+    g_mutex_lock(&p->lock);
+    if (!p->error) {
+        p->error = error;
+    } else {
+        g_error_free(error);
+    }
+    g_mutex_unlock(&p->lock);
+    g_atomic_int_set(&p->stop, TRUE);
+}
+
+// Takes a buffer from `queue`, giving up once the copy stops.
+static CopyBuffer *pipeline_pop(CopyPipeline *p, GAsyncQueue *queue) {
+    CopyBuffer *buffer = NULL;
+    while (!buffer && !pipeline_stopped(p)) buffer = g_async_queue_timeout_pop(queue, S3_STREAM_COPY_POLL_US);
+    return buffer;
+}
+
+static gpointer reader_thread(gpointer user_data) {
+    CopyPipeline *p = (CopyPipeline *)user_data;
+    const S3StreamCopyOptions *o = p->options;
+    while (!pipeline_stopped(p)) {
+        g_mutex_lock(&p->lock);
+        guint part = p->next_part < p->n_parts ? p->next_part++ : G_MAXUINT;
+        g_mutex_unlock(&p->lock);
+        if (part == G_MAXUINT) break;
+
+        // Waiting here for the writers to hand a buffer back is the
+        // backpressure that keeps a fast source from running ahead.
+        CopyBuffer *buffer = pipeline_pop(p, p->free_buffers);
+        if (!buffer) break;
+        guint64 offset = (guint64)part * p->part_size;
+        gsize length = (gsize)MIN((guint64)p->part_size, p->size - offset);
+        buffer->part = part;
+        buffer->length = 0;
+        GError *error = NULL;
+        if (length > 0 && !s3_client_download_range_into(o->src_endpoint, o->src_access_key, o->src_secret_key, o->src_bucket, o->src_key, offset, length, buffer->data, o->src_use_ssl, &buffer->length, &error)) {
+            g_prefix_error(&error, "Reading part %u: ", part + 1);
+            pipeline_fail(p, error);
+            g_async_queue_push(p->free_buffers, buffer);
+            break;
+        }
+        if (buffer->length != length) {
+            pipeline_fail(p, g_error_new(G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "%s changed while it was copied", o->src_key));
+            g_async_queue_push(p->free_buffers, buffer);
+            break;
+        }
+        g_mutex_lock(&p->lock);
+        p->stats.bytes_read += length;
+        g_mutex_unlock(&p->lock);
+        g_async_queue_push(p->full_buffers, buffer);
+    }
+    return NULL;
+}
+
+static gpointer writer_thread(gpointer user_data) {
+    CopyPipeline *p = (CopyPipeline *)user_data;
+    const S3StreamCopyOptions *o = p->options;
+    while (!pipeline_stopped(p)) {
+        g_mutex_lock(&p->lock);
+        gboolean done = p->parts_unclaimed == 0;
+        g_mutex_unlock(&p->lock);
+        if (done) break;
+
+        CopyBuffer *buffer = g_async_queue_timeout_pop(p->full_buffers, S3_STREAM_COPY_POLL_US);
+        if (!buffer) continue;
+        g_mutex_lock(&p->lock);
+        p->parts_unclaimed--;
+        g_mutex_unlock(&p->lock);
+
+        GError *error = NULL;
+        guint part = buffer->part;
+        gsize length = buffer->length;
+        gchar *etag = s3_client_upload_part(o->dst_endpoint, o->dst_access_key, o->dst_secret_key, o->dst_bucket, o->dst_key, p->upload_id, part + 1, buffer->data, length, o->dst_use_ssl, &error);
+        g_async_queue_push(p->free_buffers, buffer);
+        if (!etag) {
+            g_prefix_error(&error, "Writing part %u: ", part + 1);
+            pipeline_fail(p, error);
+            break;
+        }
+
+        g_mutex_lock(&p->lock);
+        p->etags[part] = etag;
+        p->stats.bytes_written += length;
+        p->stats.parts_done++;
+        if (o->progress_callback) o->progress_callback(&p->stats, o->user_data);
+        g_mutex_unlock(&p->lock);
+    }
+    return NULL;
+}
+
+// Smallest multiple of 1 MiB, at least `requested`, that splits `size` into
+// no more than S3_STREAM_COPY_MAX_PARTS parts.
+static gsize choose_part_size(guint64 size, gsize requested) {
+    guint64 part_size = MAX(requested ? requested : S3_STREAM_COPY_DEFAULT_PART_SIZE, S3_STREAM_COPY_MIN_PART_SIZE);
+    guint64 needed = (size + S3_STREAM_COPY_MAX_PARTS - 1) / S3_STREAM_COPY_MAX_PARTS;
+    if (needed > part_size) part_size = (needed + 1024 * 1024 - 1) / (1024 * 1024) * (1024 * 1024);
+    return (gsize)part_size;
+}
+
+// Runs the readers and writers over an upload that has been created, then
+// completes it, or aborts it on failure.
+static gboolean pipeline_run(CopyPipeline *p, GError **error) {
+    const S3StreamCopyOptions *o = p->options;
+    // A small object gets as many buffers as it has parts, each no bigger
+    // than the object.
+    guint n_buffers = MIN(o->n_buffers ? o->n_buffers : S3_STREAM_COPY_DEFAULT_BUFFERS, p->n_parts);
+    gsize capacity = (gsize)MAX(MIN((guint64)p->part_size, p->size), 1);
+    p->free_buffers = g_async_queue_new();
+    p->full_buffers = g_async_queue_new();
+    for (guint i = 0; i < n_buffers; i++) {
+        CopyBuffer *buffer = g_new0(CopyBuffer, 1);
+        buffer->data = g_malloc(capacity);
+        g_async_queue_push(p->free_buffers, buffer);
+    }
+
+    guint n_readers = MIN(o->n_readers ? o->n_readers : S3_STREAM_COPY_DEFAULT_READERS, p->n_parts);
+    guint n_writers = MIN(o->n_writers ? o->n_writers : S3_STREAM_COPY_DEFAULT_WRITERS, p->n_parts);
+    GPtrArray *threads = g_ptr_array_new();
+    for (guint i = 0; i < n_readers; i++) g_ptr_array_add(threads, g_thread_new("s3-copy-read", reader_thread, p));
+    for (guint i = 0; i < n_writers; i++) g_ptr_array_add(threads, g_thread_new("s3-copy-write", writer_thread, p));
+    for (guint i = 0; i < threads->len; i++) g_thread_join(g_ptr_array_index(threads, i));
+    g_ptr_array_free(threads, TRUE);
+
+    CopyBuffer *buffer;
+    while ((buffer = g_async_queue_try_pop(p->free_buffers)) || (buffer = g_async_queue_try_pop(p->full_buffers))) {
+        g_free(buffer->data);
+        g_free(buffer);
+    }
+    g_async_queue_unref(p->free_buffers);
+    g_async_queue_unref(p->full_buffers);
+
+    gboolean ok = FALSE;
+    if (p->error) {
+        g_propagate_error(error, g_steal_pointer(&p->error));
+    } else if (!g_cancellable_set_error_if_cancelled(p->cancellable, error)) {
+        ok = s3_client_complete_multipart_upload(o->dst_endpoint, o->dst_access_key, o->dst_secret_key, o->dst_bucket, o->dst_key, p->upload_id, (const gchar * const *)p->etags, p->n_parts, o->dst_use_ssl, error);
+    }
+    if (!ok) {
+        // Otherwise the uploaded parts linger, and are billed, until a
+        // lifecycle rule removes them.
+        g_autoptr(GError) abort_error = NULL;
+        if (!s3_client_abort_multipart_upload(o->dst_endpoint, o->dst_access_key, o->dst_secret_key, o->dst_bucket, o->dst_key, p->upload_id, o->dst_use_ssl, &abort_error)) {
+            g_warning("Failed to abort the multipart upload of %s: %s", o->dst_key, abort_error->message);
+        }
+    }
+    return ok;
+}
+
+gboolean s3_stream_copy_run(const S3StreamCopyOptions *o, GCancellable *cancellable, S3StreamCopyStats *stats, GError **error) {
+    gint64 span = trace_begin();
+    CopyPipeline p = { 0 };
+    p.options = o;
+    p.cancellable = cancellable;
+    g_mutex_init(&p.lock);
+
+    gboolean ok = s3_client_head_object(o->src_endpoint, o->src_access_key, o->src_secret_key, o->src_bucket, o->src_key, o->src_use_ssl, &p.size, NULL, error);
+    if (ok) {
+        p.part_size = choose_part_size(p.size, o->part_size);
+        p.n_parts = (guint)MAX((p.size + p.part_size - 1) / p.part_size, 1);
+        p.parts_unclaimed = p.n_parts;
+        p.etags = g_new0(gchar *, p.n_parts + 1);
+        p.stats.bytes_total = p.size;
+        p.stats.part_size = p.part_size;
+        p.stats.parts_total = p.n_parts;
+        p.upload_id = s3_client_create_multipart_upload(o->dst_endpoint, o->dst_access_key, o->dst_secret_key, o->dst_bucket, o->dst_key, o->dst_use_ssl, error);
+        ok = p.upload_id != NULL;
+    }
+    if (ok) ok = pipeline_run(&p, error);
+
+    if (stats) *stats = p.stats;
+    g_free(p.upload_id);
+    // A failed part leaves a NULL gap, so g_strfreev would stop early.
+    for (guint i = 0; p.etags && i < p.n_parts; i++) g_free(p.etags[i]);
+    g_free(p.etags);
+    g_mutex_clear(&p.lock);
+    trace_end_detail(span, "s3", "stream_copy", o->src_key);
+    return ok;
+}
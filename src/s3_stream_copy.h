@@ -0,0 +1,52 @@
+#ifndef MYS3_S3_STREAM_COPY_H
+#define MYS3_S3_STREAM_COPY_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct {
+    guint64 bytes_total;
+    guint64 bytes_read;         // Fetched from the source
+    guint64 bytes_written;      // Uploaded to the destination
+    guint64 part_size;
+    guint parts_total;
+    guint parts_done;
+} S3StreamCopyStats;
+
+// Runs on a worker thread after each uploaded part, one call at a time.
+typedef void (*S3StreamCopyProgressCallback)(const S3StreamCopyStats *stats, gpointer user_data);
+
+typedef struct {
+    const gchar *src_endpoint;
+    const gchar *src_access_key;
+    const gchar *src_secret_key;
+    gboolean src_use_ssl;
+    const gchar *src_bucket;
+    const gchar *src_key;
+    const gchar *dst_endpoint;
+    const gchar *dst_access_key;
+    const gchar *dst_secret_key;
+    gboolean dst_use_ssl;
+    const gchar *dst_bucket;
+    const gchar *dst_key;
+    gsize part_size;            // 0 for the default; raised to fit 10000 parts
+    guint n_buffers;            // Parts held in memory at once; 0 for the default
+    guint n_readers;            // Concurrent ranged GETs; 0 for the default
+    guint n_writers;            // Concurrent UploadParts; 0 for the default
+    S3StreamCopyProgressCallback progress_callback;  // May be NULL
+    gpointer user_data;
+} S3StreamCopyOptions;
+
+// Copies an object between two connections, which may be different
+// endpoints, without going through local disk. Ranged GETs on the source
+// fill buffers from a fixed pool and concurrent UploadParts of a multipart
+// upload on the destination drain them; a GET waits for a free buffer, so
+// memory stays at n_buffers * part_size whatever the object size and the
+// faster side is held to the pace of the slower one. The multipart upload is
+// aborted on failure or cancellation. Blocks until the copy ends.
+gboolean s3_stream_copy_run(const S3StreamCopyOptions *options, GCancellable *cancellable, S3StreamCopyStats *stats, GError **error);
+
+G_END_DECLS
+
+#endif // MYS3_S3_STREAM_COPY_H
@@ -0,0 +1,134 @@
+#include "session.h"
+#include <errno.h>
+#include <glib/gstdio.h>
+
+#define SESSION_VERSION 1
+// Objects handed to the page callback at a time.
+#define SESSION_PAGE_SIZE 512
+
+static gchar *session_get_path(void) {
+    return g_build_filename(g_get_user_cache_dir(), "mys3-client", "session.gvariant", NULL);
+}
+
+MyS3Session *session_new(const gchar *endpoint) {
+    MyS3Session *session = g_new0(MyS3Session, 1);
+    session->endpoint = g_strdup(endpoint);
+    session->tabs = g_array_new(FALSE, FALSE, sizeof(MyS3SessionTab));
+    return session;
+}
+
+void session_free(MyS3Session *session) {
+    if (!session) return;
+    g_free(session->endpoint);
+    g_strfreev(session->buckets);
+    g_strfreev(session->expanded);
+    g_free(session->folder);
+    g_clear_pointer(&session->objects, g_variant_unref);
+    for (guint i = 0; i < session->tabs->len; i++) g_free(g_array_index(session->tabs, MyS3SessionTab, i).key);
+    g_array_unref(session->tabs);
+    g_free(session);
+}
+
+MyS3Session *session_load(const gchar *endpoint) {
+    g_autofree gchar *path = session_get_path();
+    g_autoptr(GError) error = NULL;
+    // Mapped rather than read: the listing is used in place, and saving
+    // replaces the file instead of writing into it.
+    GMappedFile *file = g_mapped_file_new(path, FALSE, &error);
+    if (!file) {
+        g_debug("No session snapshot: %s", error->message);
+        return NULL;
+    }
+    g_autoptr(GBytes) bytes = g_mapped_file_get_bytes(file);
+    g_mapped_file_unref(file);
+    g_autoptr(GVariant) root = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE_VARDICT, bytes, FALSE));
+
+    guint32 version = 0;
+    const gchar *saved_endpoint = NULL;
+    if (!g_variant_lookup(root, "version", "u", &version) || version != SESSION_VERSION) return NULL;
+    if (!g_variant_lookup(root, "endpoint", "&s", &saved_endpoint) || g_strcmp0(saved_endpoint, endpoint) != 0) return NULL;
+
+    MyS3Session *session = session_new(endpoint);
+    if (!g_variant_lookup(root, "buckets", "^as", &session->buckets)) session->buckets = g_new0(gchar *, 1);
+    if (!g_variant_lookup(root, "expanded", "^as", &session->expanded)) session->expanded = g_new0(gchar *, 1);
+    g_variant_lookup(root, "folder", "s", &session->folder);
+    session->objects = g_variant_lookup_value(root, "objects", G_VARIANT_TYPE("a(stx)"));
+
+    g_autoptr(GVariantIter) tabs = NULL;
+    if (g_variant_lookup(root, "tabs", "a(st)", &tabs)) {
+        const gchar *key;
+        guint64 size;
+        while (g_variant_iter_next(tabs, "(&st)", &key, &size)) session_add_tab(session, key, size);
+    }
+    return session;
+}
+
+gboolean session_save(const MyS3Session *session, GError **error) {
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&builder, "{sv}", "version", g_variant_new_uint32(SESSION_VERSION));
+    g_variant_builder_add(&builder, "{sv}", "endpoint", g_variant_new_string(session->endpoint ? session->endpoint : ""));
+    if (session->buckets) g_variant_builder_add(&builder, "{sv}", "buckets", g_variant_new_strv((const gchar * const *)session->buckets, -1));
+    if (session->expanded) g_variant_builder_add(&builder, "{sv}", "expanded", g_variant_new_strv((const gchar * const *)session->expanded, -1));
+    if (session->folder) g_variant_builder_add(&builder, "{sv}", "folder", g_variant_new_string(session->folder));
+    if (session->objects) g_variant_builder_add(&builder, "{sv}", "objects", session->objects);
+
+    GVariantBuilder tabs;
+    g_variant_builder_init(&tabs, G_VARIANT_TYPE("a(st)"));
+    for (guint i = 0; i < session->tabs->len; i++) {
+        const MyS3SessionTab *tab = &g_array_index(session->tabs, MyS3SessionTab, i);
+        g_variant_builder_add(&tabs, "(st)", tab->key, tab->size);
+    }
+    g_variant_builder_add(&builder, "{sv}", "tabs", g_variant_builder_end(&tabs));
+
+    g_autoptr(GVariant) root = g_variant_ref_sink(g_variant_builder_end(&builder));
+    g_autofree gchar *path = session_get_path();
+    g_autofree gchar *dir = g_path_get_dirname(path);
+    if (g_mkdir_with_parents(dir, 0700) != 0) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "Cannot create %s", dir);
+        return FALSE;
+    }
+    return g_file_set_contents(path, g_variant_get_data(root), g_variant_get_size(root), error);
+}
+
+void session_set_listing(MyS3Session *session, const gchar *folder, S3ObjectList *list) {
+    g_free(session->folder);
+    session->folder = g_strdup(folder);
+    g_clear_pointer(&session->objects, g_variant_unref);
+    guint n_objects = g_list_model_get_n_items(G_LIST_MODEL(list));
+    if (!folder || n_objects > SESSION_MAX_OBJECTS) return;
+
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(stx)"));
+    for (guint i = 0; i < n_objects; i++) {
+        g_variant_builder_add(&builder, "(stx)", s3_object_list_get_key(list, i), s3_object_list_get_size(list, i), s3_object_list_get_last_modified(list, i));
+    }
+    session->objects = g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+void session_add_tab(MyS3Session *session, const gchar *key, guint64 size) {
+    MyS3SessionTab tab = { g_strdup(key), size };
+    g_array_append_val(session->tabs, tab);
+}
+
+void session_foreach_object_page(const MyS3Session *session, S3ListPageCallback callback, gpointer user_data) {
+    if (!session->objects) return;
+    S3Object page[SESSION_PAGE_SIZE];
+    guint n = 0;
+    GVariantIter iter;
+    g_variant_iter_init(&iter, session->objects);
+    const gchar *key;
+    guint64 size;
+    gint64 last_modified;
+    while (g_variant_iter_next(&iter, "(&stx)", &key, &size, &last_modified)) {
+        page[n].key = (gchar *)key;
+        page[n].size = size;
+        page[n].last_modified = last_modified;
+        page[n].etag = NULL;
+        if (++n == SESSION_PAGE_SIZE) {
+            if (!callback(page, n, user_data)) return;
+            n = 0;
+        }
+    }
+    if (n > 0) callback(page, n, user_data);
+}
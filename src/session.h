@@ -0,0 +1,53 @@
+#ifndef MYS3_SESSION_H
+#define MYS3_SESSION_H
+
+#include <glib.h>
+#include "s3_client.h"
+#include "s3_object_list.h"
+
+G_BEGIN_DECLS
+
+// Most objects a snapshot keeps of the listed folder. Larger listings are
+// left out and come back with the first refresh.
+#define SESSION_MAX_OBJECTS 200000
+
+typedef struct {
+    gchar *key;
+    guint64 size;
+} MyS3SessionTab;
+
+// What the main window showed when it was last closed: the bucket list, the
+// expanded tree rows, the listed folder with its objects and the open editor
+// tabs. It is read at launch so the window is usable before the SDK is up or
+// the network has answered, then revalidated in the background. Stored as a
+// GVariant under the user cache directory; one for another endpoint is
+// ignored.
+typedef struct {
+    gchar *endpoint;
+    gchar **buckets;
+    gchar **expanded;   // full_path of each expanded tree row
+    gchar *folder;      // Listed folder, or NULL
+    GVariant *objects;  // a(stx): key, size and mtime of its listing, or NULL
+    GArray *tabs;       // MyS3SessionTab
+} MyS3Session;
+
+MyS3Session *session_new(const gchar *endpoint);
+// Returns NULL if there is no usable snapshot for `endpoint`.
+MyS3Session *session_load(const gchar *endpoint);
+gboolean session_save(const MyS3Session *session, GError **error);
+void session_free(MyS3Session *session);
+
+// Records the rows of `list` as the listing of `folder`, unless there are
+// more than SESSION_MAX_OBJECTS.
+void session_set_listing(MyS3Session *session, const gchar *folder, S3ObjectList *list);
+void session_add_tab(MyS3Session *session, const gchar *key, guint64 size);
+
+// Hands the stored listing to `callback` in pages, like a live listing.
+// The keys point into the snapshot.
+void session_foreach_object_page(const MyS3Session *session, S3ListPageCallback callback, gpointer user_data);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(MyS3Session, session_free)
+
+G_END_DECLS
+
+#endif // MYS3_SESSION_H
@@ -19,6 +19,11 @@ settings_load(void) {
     // Set defaults
     settings->use_ssl = TRUE;
     settings->use_path_style = FALSE;
+    settings->transfer_backend = S3_TRANSFER_BACKEND_CLASSIC;
+    settings->crt_threshold_mb = 16;
+    settings->crt_target_gbps = 5.0;
+    settings->prometheus_interval_seconds = 15;
+    settings->dest_use_ssl = TRUE;
 
     if (g_key_file_load_from_file(key_file, file_path, G_KEY_FILE_NONE, &error)) {
         settings->endpoint = g_key_file_get_string(key_file, "Connection", "Endpoint", NULL);
@@ -38,6 +43,38 @@ settings_load(void) {
         }
         settings->logging_enabled = g_key_file_get_boolean(key_file, "Logging", "Enabled", NULL);
         settings->log_level = g_key_file_get_integer(key_file, "Logging", "Level", NULL);
+        if (g_key_file_has_group(key_file, "Transfer")) {
+            settings->transfer_backend = g_key_file_get_integer(key_file, "Transfer", "Backend", NULL);
+            gint threshold_mb = g_key_file_get_integer(key_file, "Transfer", "CrtThresholdMB", &error);
+            if (error) {
+                g_clear_error(&error);
+            } else if (threshold_mb > 0) {
+                settings->crt_threshold_mb = threshold_mb;
+            }
+            gdouble target_gbps = g_key_file_get_double(key_file, "Transfer", "CrtTargetGbps", &error);
+            if (error) {
+                g_clear_error(&error);
+            } else if (target_gbps > 0) {
+                settings->crt_target_gbps = target_gbps;
+            }
+        }
+        if (g_key_file_has_group(key_file, "Metrics")) {
+            settings->prometheus_file = g_key_file_get_string(key_file, "Metrics", "PrometheusFile", NULL);
+            gint interval = g_key_file_get_integer(key_file, "Metrics", "PrometheusIntervalSeconds", &error);
+            if (error) {
+                g_clear_error(&error);
+            } else if (interval > 0) {
+                settings->prometheus_interval_seconds = interval;
+            }
+        }
+        if (g_key_file_has_group(key_file, "Destination")) {
+            settings->dest_endpoint = g_key_file_get_string(key_file, "Destination", "Endpoint", NULL);
+            settings->dest_use_ssl = g_key_file_get_boolean(key_file, "Destination", "UseSSL", &error);
+            if (error) {
+                g_clear_error(&error);
+                settings->dest_use_ssl = TRUE;
+            }
+        }
     } else {
         g_debug("Could not load settings file: %s", error->message);
     }
@@ -64,6 +101,20 @@ settings_save(MyS3Settings *settings) {
     g_key_file_set_boolean(key_file, "Logging", "Enabled", settings->logging_enabled);
     g_key_file_set_integer(key_file, "Logging", "Level", settings->log_level);
 
+    g_key_file_set_integer(key_file, "Transfer", "Backend", settings->transfer_backend);
+    g_key_file_set_integer(key_file, "Transfer", "CrtThresholdMB", settings->crt_threshold_mb);
+    g_key_file_set_double(key_file, "Transfer", "CrtTargetGbps", settings->crt_target_gbps);
+
+    if (settings->prometheus_file) {
+        g_key_file_set_string(key_file, "Metrics", "PrometheusFile", settings->prometheus_file);
+    }
+    g_key_file_set_integer(key_file, "Metrics", "PrometheusIntervalSeconds", settings->prometheus_interval_seconds);
+
+    if (settings->dest_endpoint && *settings->dest_endpoint) {
+        g_key_file_set_string(key_file, "Destination", "Endpoint", settings->dest_endpoint);
+        g_key_file_set_boolean(key_file, "Destination", "UseSSL", settings->dest_use_ssl);
+    }
+
     if (!g_key_file_save_to_file(key_file, file_path, &error)) {
         g_warning("Failed to save settings: %s", error->message);
     }
@@ -72,11 +123,23 @@ settings_save(MyS3Settings *settings) {
     g_free(dir_path);
 }
 
+void
+settings_apply_transfer_backend(const MyS3Settings *settings) {
+    if (!s3_client_set_transfer_backend(settings->transfer_backend,
+                                        (guint64)settings->crt_threshold_mb * 1024 * 1024,
+                                        settings->crt_target_gbps)) {
+        g_warning("CRT transfer backend is not available in this build. Using the classic client.");
+        s3_client_set_transfer_backend(S3_TRANSFER_BACKEND_CLASSIC, 0, 0);
+    }
+}
+
 void
 settings_free(MyS3Settings *settings) {
     if (!settings) return;
     g_free(settings->endpoint);
     g_free(settings->region);
     g_free(settings->bucket);
+    g_free(settings->prometheus_file);
+    g_free(settings->dest_endpoint);
     g_free(settings);
 }
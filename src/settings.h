@@ -1,9 +1,10 @@
 #ifndef MYS3_SETTINGS_H
 #define MYS3_SETTINGS_H
 
-#include <gtk/gtk.h>
+#include <glib.h>
 
 #include "logging.h"
+#include "s3_client.h"
 
 typedef struct {
   gchar *endpoint;
@@ -13,8 +14,22 @@ typedef struct {
   gboolean use_path_style;
   gboolean logging_enabled;
   LogLevel log_level;
+  S3TransferBackend transfer_backend;
+  guint crt_threshold_mb;
+  gdouble crt_target_gbps;
+  gchar *prometheus_file;
+  guint prometheus_interval_seconds;
+  // Second connection that `mys3-cli cp/mv --to-destination` streams
+  // objects into. Its credentials are in the keychain under
+  // SETTINGS_DESTINATION_CREDENTIALS.
+  gchar *dest_endpoint;
+  gboolean dest_use_ssl;
 } MyS3Settings;
 
+#define SETTINGS_DESTINATION_CREDENTIALS "mys3-client-destination"
+
+void settings_apply_transfer_backend(const MyS3Settings *settings);
+
 MyS3Settings *settings_load(void);
 void settings_save(MyS3Settings *settings);
 void settings_free(MyS3Settings *settings);
@@ -0,0 +1,147 @@
+#include "text_search.h"
+#include <string.h>
+
+// Literal, case-sensitive patterns skip the regex engine entirely. Everything
+// else compiles to a GRegex, which G_REGEX_OPTIMIZE JIT-compiles.
+struct _TextMatcher {
+    gchar *literal;
+    gsize literal_length;
+    GRegex *regex;
+};
+
+TextMatcher *text_matcher_new(const gchar *pattern, TextSearchFlags flags, GError **error) {
+    g_return_val_if_fail(pattern && *pattern, NULL);
+    TextMatcher *matcher = g_new0(TextMatcher, 1);
+    if (!(flags & TEXT_SEARCH_REGEX) && !(flags & TEXT_SEARCH_CASE_INSENSITIVE)) {
+        matcher->literal = g_strdup(pattern);
+        matcher->literal_length = strlen(pattern);
+        return matcher;
+    }
+    g_autofree gchar *escaped = (flags & TEXT_SEARCH_REGEX) ? NULL : g_regex_escape_string(pattern, -1);
+    GRegexCompileFlags compile_flags = G_REGEX_OPTIMIZE | G_REGEX_MULTILINE;
+    if (flags & TEXT_SEARCH_CASE_INSENSITIVE) compile_flags |= G_REGEX_CASELESS;
+    if (flags & TEXT_SEARCH_RAW) compile_flags |= G_REGEX_RAW;
+    matcher->regex = g_regex_new(escaped ? escaped : pattern, compile_flags, 0, error);
+    if (!matcher->regex) {
+        g_free(matcher);
+        return NULL;
+    }
+    return matcher;
+}
+
+void text_matcher_free(TextMatcher *matcher) {
+    if (!matcher) return;
+    g_free(matcher->literal);
+    if (matcher->regex) g_regex_unref(matcher->regex);
+    g_free(matcher);
+}
+
+// Candidates come from memchr on the first byte, which libc vectorizes, and
+// are confirmed with memcmp.
+static const gchar *find_literal(const gchar *haystack, gsize length, const gchar *needle, gsize needle_length) {
+    if (needle_length > length) return NULL;
+    const gchar *last = haystack + (length - needle_length);
+    const gchar *p = haystack;
+    while (p <= last && (p = memchr(p, needle[0], last - p + 1))) {
+        if (memcmp(p, needle, needle_length) == 0) return p;
+        p++;
+    }
+    return NULL;
+}
+
+gboolean text_matcher_find(const TextMatcher *matcher, const gchar *text, gsize length, gsize from, TextMatch *match) {
+    if (from > length) return FALSE;
+    if (matcher->literal) {
+        const gchar *hit = find_literal(text + from, length - from, matcher->literal, matcher->literal_length);
+        if (!hit) return FALSE;
+        match->start = hit - text;
+        match->end = match->start + matcher->literal_length;
+        return TRUE;
+    }
+    g_autoptr(GMatchInfo) info = NULL;
+    if (!g_regex_match_full(matcher->regex, text, length, from, 0, &info, NULL)) return FALSE;
+    gint start = 0, end = 0;
+    g_match_info_fetch_pos(info, 0, &start, &end);
+    match->start = start;
+    match->end = end;
+    return TRUE;
+}
+
+GArray *text_matcher_find_all(const TextMatcher *matcher, const gchar *text, gsize length, guint limit) {
+    GArray *matches = g_array_new(FALSE, FALSE, sizeof(TextMatch));
+    if (matcher->literal) {
+        TextMatch match;
+        gsize from = 0;
+        while ((limit == 0 || matches->len < limit) && text_matcher_find(matcher, text, length, from, &match)) {
+            g_array_append_val(matches, match);
+            from = match.end;
+        }
+        return matches;
+    }
+    g_autoptr(GMatchInfo) info = NULL;
+    g_regex_match_full(matcher->regex, text, length, 0, 0, &info, NULL);
+    while (g_match_info_matches(info) && (limit == 0 || matches->len < limit)) {
+        gint start = 0, end = 0;
+        g_match_info_fetch_pos(info, 0, &start, &end);
+        TextMatch match = { start, end };
+        g_array_append_val(matches, match);
+        g_match_info_next(info, NULL);
+    }
+    return matches;
+}
+
+gchar *text_matcher_replace_all(const TextMatcher *matcher, const gchar *text, gsize length, const gchar *replacement, GArray *replaced, guint *n_replaced, gsize *out_length, GError **error) {
+    if (matcher->regex && !g_regex_check_replacement(replacement, NULL, error)) return NULL;
+    GString *out = g_string_sized_new(length);
+    gsize replacement_length = strlen(replacement);
+    guint n = 0;
+    gsize copied = 0;
+
+    if (matcher->literal) {
+        TextMatch match;
+        while (text_matcher_find(matcher, text, length, copied, &match)) {
+            g_string_append_len(out, text + copied, match.start - copied);
+            TextMatch placed = { out->len, out->len + replacement_length };
+            g_string_append_len(out, replacement, replacement_length);
+            if (replaced) g_array_append_val(replaced, placed);
+            copied = match.end;
+            n++;
+        }
+    } else {
+        g_autoptr(GMatchInfo) info = NULL;
+        g_regex_match_full(matcher->regex, text, length, 0, 0, &info, NULL);
+        while (g_match_info_matches(info)) {
+            gint start = 0, end = 0;
+            g_match_info_fetch_pos(info, 0, &start, &end);
+            g_string_append_len(out, text + copied, start - copied);
+            g_autofree gchar *expanded = g_match_info_expand_references(info, replacement, error);
+            if (!expanded) {
+                g_string_free(out, TRUE);
+                return NULL;
+            }
+            TextMatch placed = { out->len, out->len + strlen(expanded) };
+            g_string_append(out, expanded);
+            if (replaced) g_array_append_val(replaced, placed);
+            copied = end;
+            n++;
+            g_match_info_next(info, NULL);
+        }
+    }
+    g_string_append_len(out, text + copied, length - copied);
+    if (n_replaced) *n_replaced = n;
+    if (out_length) *out_length = out->len;
+    return g_string_free(out, FALSE);
+}
+
+void text_matches_to_char_offsets(const gchar *text, GArray *matches) {
+    gsize byte = 0, chars = 0;
+    for (guint i = 0; i < matches->len; i++) {
+        TextMatch *match = &g_array_index(matches, TextMatch, i);
+        gsize start = match->start, end = match->end;
+        chars += g_utf8_strlen(text + byte, start - byte);
+        match->start = chars;
+        chars += g_utf8_strlen(text + start, end - start);
+        match->end = chars;
+        byte = end;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef MYS3_TEXT_SEARCH_H
+#define MYS3_TEXT_SEARCH_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+    TEXT_SEARCH_REGEX            = 1 << 0,
+    TEXT_SEARCH_CASE_INSENSITIVE = 1 << 1,
+    TEXT_SEARCH_RAW              = 1 << 2,   // Text is arbitrary bytes, not UTF-8
+} TextSearchFlags;
+
+// A match as byte offsets [start, end) into the searched text.
+typedef struct {
+    gsize start;
+    gsize end;
+} TextMatch;
+
+// A compiled search pattern. Matching never modifies the matcher, so one
+// matcher may be used from several threads at once.
+typedef struct _TextMatcher TextMatcher;
+
+TextMatcher *text_matcher_new(const gchar *pattern, TextSearchFlags flags, GError **error);
+void text_matcher_free(TextMatcher *matcher);
+
+// Finds the first match starting at or after byte `from`.
+gboolean text_matcher_find(const TextMatcher *matcher, const gchar *text, gsize length, gsize from, TextMatch *match);
+// Returns every non-overlapping match, in order, up to `limit` (0 for all).
+GArray *text_matcher_find_all(const TextMatcher *matcher, const gchar *text, gsize length, guint limit);
+
+// Builds `text` with every match replaced in a single pass. Regex
+// replacements may use \0-\9 and \g<name>. `replaced`, if not NULL, receives
+// the position of each replacement in the returned text.
+gchar *text_matcher_replace_all(const TextMatcher *matcher, const gchar *text, gsize length, const gchar *replacement, GArray *replaced, guint *n_replaced, gsize *out_length, GError **error);
+
+// Rewrites sorted byte-offset matches into character offsets, as used by
+// GtkTextBuffer, with one walk over the text.
+void text_matches_to_char_offsets(const gchar *text, GArray *matches);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(TextMatcher, text_matcher_free)
+
+G_END_DECLS
+
+#endif // MYS3_TEXT_SEARCH_H
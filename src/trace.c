@@ -0,0 +1,314 @@
+#include "trace.h"
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+
+#define TRACE_CHUNK_EVENTS 1024
+// A thread's partially filled chunk is handed to the writer once it is this old.
+#define TRACE_FLUSH_INTERVAL_US G_USEC_PER_SEC
+
+typedef struct {
+    const gchar *category;
+    const gchar *name;
+    gchar *detail;
+    gint64 ts;
+    gint64 dur;
+} TraceEvent;
+
+typedef struct {
+    guint tid;
+    gchar *thread_name;  // Only set on a thread's first chunk
+    guint n_events;
+    gint64 created;
+    TraceEvent events[TRACE_CHUNK_EVENTS];
+} TraceChunk;
+
+// The lock is only contended when the writer sweeps stale chunks or tracing
+// stops; on the recording path it is always free.
+typedef struct {
+    GMutex lock;
+    guint tid;
+    gboolean named;
+    TraceChunk *chunk;
+} ThreadBuffer;
+
+static gint tracing = 0;
+// Threads inside record_event; trace_stop waits for them after turning
+// tracing off so no event lands in a buffer once the final sweep is done.
+static gint recorders = 0;
+static GMutex control_lock;
+static GMutex registry_lock;
+static GList *registry = NULL;
+static GAsyncQueue *full_chunks = NULL;
+static GThread *writer_thread = NULL;
+static GThread *main_thread = NULL;
+static FILE *trace_file = NULL;
+static gint next_tid = 0;
+static TraceChunk stop_marker;
+
+static void trace_chunk_free(TraceChunk *chunk) {
+    for (guint i = 0; i < chunk->n_events; i++) {
+        g_free(chunk->events[i].detail);
+    }
+    g_free(chunk->thread_name);
+    g_free(chunk);
+}
+
+static void thread_buffer_free(gpointer data) {
+    ThreadBuffer *tb = data;
+    // Handing off under registry_lock orders this against trace_stop's sweep:
+    // the chunk is either queued before the stop marker or already taken.
+    g_mutex_lock(&registry_lock);
+    registry = g_list_remove(registry, tb);
+    if (tb->chunk) {
+        g_async_queue_push(full_chunks, tb->chunk);
+    }
+    g_mutex_unlock(&registry_lock);
+    g_mutex_clear(&tb->lock);
+    g_free(tb);
+}
+
+static GPrivate thread_buffer_key = G_PRIVATE_INIT(thread_buffer_free);
+
+static ThreadBuffer *get_thread_buffer(void) {
+    ThreadBuffer *tb = g_private_get(&thread_buffer_key);
+    if (G_UNLIKELY(!tb)) {
+        tb = g_new0(ThreadBuffer, 1);
+        g_mutex_init(&tb->lock);
+        tb->tid = (guint)g_atomic_int_add(&next_tid, 1) + 1;
+        g_private_set(&thread_buffer_key, tb);
+        g_mutex_lock(&registry_lock);
+        registry = g_list_prepend(registry, tb);
+        g_mutex_unlock(&registry_lock);
+    }
+    return tb;
+}
+
+// Caller holds tb->lock.
+static void hand_off_chunk(ThreadBuffer *tb) {
+    if (tb->chunk) {
+        g_async_queue_push(full_chunks, tb->chunk);
+        tb->chunk = NULL;
+    }
+}
+
+static void record_event(const gchar *category, const gchar *name, gchar *detail, gint64 ts, gint64 dur) {
+    g_atomic_int_inc(&recorders);
+    if (!g_atomic_int_get(&tracing)) {
+        g_atomic_int_add(&recorders, -1);
+        g_free(detail);
+        return;
+    }
+    ThreadBuffer *tb = get_thread_buffer();
+    g_mutex_lock(&tb->lock);
+    if (!tb->chunk) {
+        tb->chunk = g_new(TraceChunk, 1);
+        tb->chunk->tid = tb->tid;
+        tb->chunk->n_events = 0;
+        tb->chunk->created = g_get_monotonic_time();
+        tb->chunk->thread_name = NULL;
+        if (!tb->named) {
+            tb->chunk->thread_name = g_thread_self() == main_thread ? g_strdup("main") : g_strdup_printf("worker %u", tb->tid);
+            tb->named = TRUE;
+        }
+    }
+
+    TraceEvent *event = &tb->chunk->events[tb->chunk->n_events++];
+    event->category = category;
+    event->name = name;
+    event->detail = detail;
+    event->ts = ts;
+    event->dur = dur;
+
+    if (tb->chunk->n_events == TRACE_CHUNK_EVENTS || ts + dur - tb->chunk->created > TRACE_FLUSH_INTERVAL_US) {
+        hand_off_chunk(tb);
+    }
+    g_mutex_unlock(&tb->lock);
+    g_atomic_int_add(&recorders, -1);
+}
+
+// Moves every thread's pending chunk to the queue; with `older_than` > 0
+// only chunks created before that time.
+static void collect_chunks(gint64 older_than) {
+    g_mutex_lock(&registry_lock);
+    for (GList *l = registry; l != NULL; l = l->next) {
+        ThreadBuffer *tb = l->data;
+        g_mutex_lock(&tb->lock);
+        if (tb->chunk && (older_than == 0 || tb->chunk->created < older_than)) {
+            hand_off_chunk(tb);
+        }
+        g_mutex_unlock(&tb->lock);
+    }
+    g_mutex_unlock(&registry_lock);
+}
+
+void trace_append_json_string(GString *out, const gchar *s) {
+    g_string_append_c(out, '"');
+    for (const guchar *p = (const guchar *)(s ? s : ""); *p; p++) {
+        switch (*p) {
+            case '"': g_string_append(out, "\\\""); break;
+            case '\\': g_string_append(out, "\\\\"); break;
+            case '\n': g_string_append(out, "\\n"); break;
+            case '\r': g_string_append(out, "\\r"); break;
+            case '\t': g_string_append(out, "\\t"); break;
+            default:
+                if (*p < 0x20) {
+                    g_string_append_printf(out, "\\u%04x", *p);
+                } else {
+                    g_string_append_c(out, (gchar)*p);
+                }
+        }
+    }
+    g_string_append_c(out, '"');
+}
+
+static void write_chunk(GString *out, gint pid, const TraceChunk *chunk, gboolean *first) {
+    if (chunk->thread_name) {
+        g_string_append_printf(out, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":",
+                               *first ? "" : ",\n", pid, chunk->tid);
+        trace_append_json_string(out, chunk->thread_name);
+        g_string_append(out, "}}");
+        *first = FALSE;
+    }
+    for (guint i = 0; i < chunk->n_events; i++) {
+        const TraceEvent *event = &chunk->events[i];
+        g_string_append(out, *first ? "{\"ph\":\"X\",\"name\":" : ",\n{\"ph\":\"X\",\"name\":");
+        trace_append_json_string(out, event->name);
+        g_string_append(out, ",\"cat\":");
+        trace_append_json_string(out, event->category);
+        g_string_append_printf(out, ",\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ",\"pid\":%d,\"tid\":%u",
+                               event->ts, event->dur, pid, chunk->tid);
+        if (event->detail) {
+            g_string_append(out, ",\"args\":{\"detail\":");
+            trace_append_json_string(out, event->detail);
+            g_string_append_c(out, '}');
+        }
+        g_string_append_c(out, '}');
+        *first = FALSE;
+    }
+}
+
+static gpointer trace_writer(gpointer user_data) {
+    FILE *file = user_data;
+#ifdef G_OS_UNIX
+    gint pid = (gint)getpid();
+#else
+    gint pid = 1;
+#endif
+    GString *out = g_string_sized_new(64 * 1024);
+    gboolean first = TRUE;
+
+    fputs("[\n", file);
+    for (;;) {
+        TraceChunk *chunk = g_async_queue_timeout_pop(full_chunks, TRACE_FLUSH_INTERVAL_US);
+        if (!chunk) {
+            // Idle threads keep their partial chunk until swept here.
+            collect_chunks(g_get_monotonic_time() - TRACE_FLUSH_INTERVAL_US);
+            continue;
+        }
+        if (chunk == &stop_marker) {
+            // Threads that exited during the final sweep may have queued
+            // their chunk behind the marker.
+            while ((chunk = g_async_queue_try_pop(full_chunks))) {
+                write_chunk(out, pid, chunk, &first);
+                trace_chunk_free(chunk);
+            }
+            break;
+        }
+
+        write_chunk(out, pid, chunk, &first);
+        trace_chunk_free(chunk);
+        if (out->len > 48 * 1024 || g_async_queue_length(full_chunks) <= 0) {
+            fwrite(out->str, 1, out->len, file);
+            fflush(file);
+            g_string_truncate(out, 0);
+        }
+    }
+    fwrite(out->str, 1, out->len, file);
+    fputs("\n]\n", file);
+    g_string_free(out, TRUE);
+    return NULL;
+}
+
+gboolean trace_start(const gchar *path, GError **error) {
+    g_mutex_lock(&control_lock);
+    if (g_atomic_int_get(&tracing)) {
+        g_mutex_unlock(&control_lock);
+        return TRUE;
+    }
+
+    FILE *file = g_fopen(path, "w");
+    if (!file) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "Could not open trace file %s: %s", path, g_strerror(errno));
+        g_mutex_unlock(&control_lock);
+        return FALSE;
+    }
+
+    if (!full_chunks) {
+        full_chunks = g_async_queue_new();
+    }
+    if (!main_thread) {
+        main_thread = g_thread_self();
+    }
+    trace_file = file;
+    writer_thread = g_thread_new("trace-writer", trace_writer, file);
+    g_atomic_int_set(&tracing, 1);
+    g_mutex_unlock(&control_lock);
+    return TRUE;
+}
+
+void trace_stop(void) {
+    g_mutex_lock(&control_lock);
+    if (!g_atomic_int_compare_and_exchange(&tracing, 1, 0)) {
+        g_mutex_unlock(&control_lock);
+        return;
+    }
+    // Stop recording first, then flush everything already recorded.
+    while (g_atomic_int_get(&recorders) > 0) {
+        g_thread_yield();
+    }
+    collect_chunks(0);
+    g_async_queue_push(full_chunks, &stop_marker);
+    g_thread_join(writer_thread);
+    writer_thread = NULL;
+    TraceChunk *chunk;
+    while ((chunk = g_async_queue_try_pop(full_chunks))) {
+        trace_chunk_free(chunk);
+    }
+    fclose(trace_file);
+    trace_file = NULL;
+    g_mutex_unlock(&control_lock);
+}
+
+void trace_init(void) {
+    const gchar *path = g_getenv("MYS3_TRACE");
+    if (!path || !*path) return;
+
+    g_autoptr(GError) error = NULL;
+    if (!trace_start(path, &error)) {
+        g_warning("Tracing disabled: %s", error->message);
+    }
+}
+
+gint64 trace_begin(void) {
+    return g_atomic_int_get(&tracing) ? g_get_monotonic_time() : 0;
+}
+
+void trace_end(gint64 start, const gchar *category, const gchar *name) {
+    if (start == 0 || !g_atomic_int_get(&tracing)) return;
+    record_event(category, name, NULL, start, g_get_monotonic_time() - start);
+}
+
+void trace_end_detail(gint64 start, const gchar *category, const gchar *name, const gchar *detail) {
+    if (start == 0 || !g_atomic_int_get(&tracing)) return;
+    record_event(category, name, g_strdup(detail), start, g_get_monotonic_time() - start);
+}
+
+void trace_span(const gchar *category, const gchar *name, gint64 start, gint64 duration) {
+    if (!g_atomic_int_get(&tracing)) return;
+    record_event(category, name, NULL, start, duration);
+}
@@ -0,0 +1,39 @@
+#ifndef MYS3_TRACE_H
+#define MYS3_TRACE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Opt-in recorder for Chrome trace-event JSON (chrome://tracing or
+// ui.perfetto.dev). Set MYS3_TRACE=<file> to enable it for a run.
+//
+// Events go into per-thread buffers without locking across threads; full
+// buffers are handed to a background thread that writes the file.
+
+// Starts tracing if MYS3_TRACE is set. Called from s3_client_init().
+void trace_init(void);
+gboolean trace_start(const gchar *path, GError **error);
+// Writes out all buffered events and closes the file.
+void trace_stop(void);
+
+// Returns a start timestamp, or 0 when tracing is off so the matching
+// trace_end() is a no-op.
+gint64 trace_begin(void);
+
+// Records a complete span from `start`. `category` and `name` must be static
+// or interned strings; `detail` (optional) is copied and shown as an arg.
+void trace_end(gint64 start, const gchar *category, const gchar *name);
+void trace_end_detail(gint64 start, const gchar *category, const gchar *name, const gchar *detail);
+
+// Records a span with an explicit start and duration, for phases that are
+// reported after the fact (e.g. the SDK's HTTP timings).
+void trace_span(const gchar *category, const gchar *name, gint64 start, gint64 duration);
+
+// Appends `s` as a quoted, escaped JSON string; NULL is written as "".
+// Shared with the CLI's NDJSON output.
+void trace_append_json_string(GString *out, const gchar *s);
+
+G_END_DECLS
+
+#endif // MYS3_TRACE_H
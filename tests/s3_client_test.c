@@ -0,0 +1,178 @@
+#include <glib.h>
+#include <string.h>
+#include "s3_client.h"
+#include "fake_s3_server.h"
+
+// Runs the client against the bundled fake server, one server per test, so
+// request counts and injected faults are deterministic.
+
+#define BUCKET "test"
+
+typedef struct {
+    FakeS3Server *server;
+    const gchar *endpoint;
+} Fixture;
+
+static void fixture_set_up(Fixture *f, gconstpointer data) {
+    (void)data;
+    g_autoptr(GError) error = NULL;
+    f->server = fake_s3_server_start(0, &error);
+    g_assert_no_error(error);
+    f->endpoint = fake_s3_server_get_endpoint(f->server);
+    fake_s3_server_create_bucket(f->server, BUCKET);
+}
+
+static void fixture_tear_down(Fixture *f, gconstpointer data) {
+    (void)data;
+    fake_s3_server_stop(f->server);
+}
+
+static guint64 requests_served(Fixture *f) {
+    FakeS3Stats stats;
+    fake_s3_server_get_stats(f->server, &stats);
+    return stats.requests;
+}
+
+// #############################################################################
+// # Faults
+// #############################################################################
+
+static void test_retries_slowdown(Fixture *f, gconstpointer data) {
+    (void)data;
+    fake_s3_server_put_object(f->server, BUCKET, "object", "hello", 5);
+    FakeS3Faults faults = { .slowdown_every = 2 };
+    fake_s3_server_set_faults(f->server, &faults);
+
+    // Of two back-to-back GETs at least one lands on an even request and is
+    // answered with 503 SlowDown, which the client must retry past.
+    for (int i = 0; i < 2; i++) {
+        g_autoptr(GError) error = NULL;
+        gsize length = 0;
+        g_autofree gchar *body = s3_client_download_object_to_buffer(f->endpoint, "fake", "fake", BUCKET, "object", FALSE, &length, &error);
+        g_assert_no_error(error);
+        g_assert_nonnull(body);
+        g_assert_cmpmem(body, length, "hello", 5);
+    }
+
+    FakeS3Stats stats;
+    fake_s3_server_get_stats(f->server, &stats);
+    g_assert_cmpuint(stats.slowdowns, >=, 1);
+    g_assert_cmpuint(stats.requests, >, 2);
+}
+
+static void test_fails_on_disconnect(Fixture *f, gconstpointer data) {
+    (void)data;
+    g_autofree guint8 *content = g_malloc0(64 * 1024);
+    fake_s3_server_put_object(f->server, BUCKET, "object", content, 64 * 1024);
+    FakeS3Faults faults = { .disconnect_every = 1, .disconnect_after_bytes = 1024 };
+    fake_s3_server_set_faults(f->server, &faults);
+
+    // Every attempt is cut short, so the download has to fail rather than
+    // return a truncated body.
+    g_autoptr(GError) error = NULL;
+    gsize length = 0;
+    g_autofree gchar *body = s3_client_download_object_to_buffer(f->endpoint, "fake", "fake", BUCKET, "object", FALSE, &length, &error);
+    g_assert_null(body);
+    g_assert_nonnull(error);
+
+    FakeS3Stats stats;
+    fake_s3_server_get_stats(f->server, &stats);
+    g_assert_cmpuint(stats.disconnects, >=, 1);
+}
+
+// #############################################################################
+// # Listing
+// #############################################################################
+
+typedef struct {
+    GPtrArray *keys;
+    GPtrArray *prefixes;
+    guint pages;
+} Listed;
+
+static gboolean collect_page(const S3Object *objects, guint n_objects, gpointer user_data) {
+    Listed *listed = (Listed*)user_data;
+    listed->pages++;
+    for (guint i = 0; i < n_objects; i++) g_ptr_array_add(listed->keys, g_strdup(objects[i].key));
+    return TRUE;
+}
+
+static gboolean collect_prefixes(const gchar * const *prefixes, guint n_prefixes, gpointer user_data) {
+    Listed *listed = (Listed*)user_data;
+    for (guint i = 0; i < n_prefixes; i++) g_ptr_array_add(listed->prefixes, g_strdup(prefixes[i]));
+    return TRUE;
+}
+
+static void assert_listed(GPtrArray *listed, const gchar * const *expected) {
+    g_assert_cmpuint(listed->len, ==, g_strv_length((gchar**)expected));
+    for (guint i = 0; i < listed->len; i++) g_assert_cmpstr(g_ptr_array_index(listed, i), ==, expected[i]);
+}
+
+static void test_lists_pages(Fixture *f, gconstpointer data) {
+    (void)data;
+    const guint n_keys = 250;
+    for (guint i = 0; i < n_keys; i++) {
+        g_autofree gchar *key = g_strdup_printf("obj-%04u", i);
+        fake_s3_server_put_object(f->server, BUCKET, key, "x", 1);
+    }
+    FakeS3Faults faults = { .max_keys = 100 };
+    fake_s3_server_set_faults(f->server, &faults);
+
+    Listed listed = { g_ptr_array_new_with_free_func(g_free), NULL, 0 };
+    g_autoptr(GError) error = NULL;
+    guint64 before = requests_served(f);
+    gboolean ok = s3_client_list_objects_paged(f->endpoint, "fake", "fake", BUCKET, NULL, FALSE, collect_page, &listed, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    // Each continuation token picks up right after the previous page.
+    g_assert_cmpuint(listed.pages, ==, 3);
+    g_assert_cmpuint(requests_served(f) - before, ==, 3);
+    g_assert_cmpuint(listed.keys->len, ==, n_keys);
+    for (guint i = 0; i < n_keys; i++) {
+        g_autofree gchar *key = g_strdup_printf("obj-%04u", i);
+        g_assert_cmpstr(g_ptr_array_index(listed.keys, i), ==, key);
+    }
+    g_ptr_array_unref(listed.keys);
+}
+
+static void test_lists_common_prefixes(Fixture *f, gconstpointer data) {
+    (void)data;
+    static const gchar * const keys[] = { "a/1", "a/2", "a/3", "b/1", "b/2", "c", "d/1", "d/2", "d/3", NULL };
+    for (guint i = 0; keys[i]; i++) fake_s3_server_put_object(f->server, BUCKET, keys[i], "x", 1);
+    FakeS3Faults faults = { .max_keys = 2 };
+    fake_s3_server_set_faults(f->server, &faults);
+
+    Listed listed = { g_ptr_array_new_with_free_func(g_free), g_ptr_array_new_with_free_func(g_free), 0 };
+    g_autoptr(GError) error = NULL;
+    guint64 before = requests_served(f);
+    gboolean ok = s3_client_list_objects_delimited(f->endpoint, "fake", "fake", BUCKET, NULL, FALSE, collect_page, collect_prefixes, &listed, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    // The first page fills up with "a/" and "b/" while "b/2" is still
+    // rolling into "b/"; the second resumes inside "b/" without repeating
+    // it, and "d/2" and "d/3" folding into a full page must not make it
+    // look truncated.
+    static const gchar * const expected_prefixes[] = { "a/", "b/", "d/", NULL };
+    static const gchar * const expected_keys[] = { "c", NULL };
+    assert_listed(listed.prefixes, expected_prefixes);
+    assert_listed(listed.keys, expected_keys);
+    g_assert_cmpuint(requests_served(f) - before, ==, 2);
+    g_ptr_array_unref(listed.keys);
+    g_ptr_array_unref(listed.prefixes);
+}
+
+int main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    s3_client_init();
+
+    g_test_add("/s3-client/faults/slowdown-retry", Fixture, NULL, fixture_set_up, test_retries_slowdown, fixture_tear_down);
+    g_test_add("/s3-client/faults/disconnect", Fixture, NULL, fixture_set_up, test_fails_on_disconnect, fixture_tear_down);
+    g_test_add("/s3-client/list/pages", Fixture, NULL, fixture_set_up, test_lists_pages, fixture_tear_down);
+    g_test_add("/s3-client/list/common-prefixes", Fixture, NULL, fixture_set_up, test_lists_common_prefixes, fixture_tear_down);
+
+    int status = g_test_run();
+    s3_client_cleanup();
+    return status;
+}